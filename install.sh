@@ -48,6 +48,7 @@ apt install -y \
     dkms \
     cmake \
     libboost-all-dev \
+    zlib1g-dev \
     libgstreamer1.0-dev \
     libgstreamer-plugins-base1.0-dev \
     libgstreamer-plugins-bad1.0-dev \
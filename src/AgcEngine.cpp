@@ -0,0 +1,484 @@
+#include "AgcEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AGC_HAS_AVX2 1
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define AGC_HAS_NEON 1
+#endif
+
+namespace
+{
+    // FIXED_10_6: degrees C = value / 64 - 40
+    constexpr static inline auto const n_fixedScale = 64.0;
+    constexpr static inline auto const n_fixedOffset = 40.0;
+    // the automatic range never gets narrower than this (raw units, 2 degrees C)
+    // so that sensor noise in a uniform scene is not stretched over the whole palette
+    constexpr static inline auto const n_minAutoSpan = 128.0;
+    // weight of the current frame when smoothing the automatic range and the histogram
+    constexpr static inline auto const n_rangeSmoothing = 0.2;
+    constexpr static inline auto const n_histogramSmoothing = 0.2f;
+    constexpr static inline auto const n_defaultPlateau = 0.01;
+    constexpr static inline auto const n_binMax = uint32_t(AgcEngine::n_transferSize - 1);
+
+    double _toRaw(double temperature)
+    {
+        return std::clamp((temperature + n_fixedOffset) * n_fixedScale, 0.0, 65535.0);
+    }
+
+    double _toTemperature(double raw)
+    {
+        return raw / n_fixedScale - n_fixedOffset;
+    }
+
+    void _minMaxScalar(uint16_t const *p_src, int width, uint16_t *p_low, uint16_t *p_high)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            *p_low = std::min(*p_low, p_src[x]);
+            *p_high = std::max(*p_high, p_src[x]);
+        }
+    }
+
+    void _binScalar(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_bins)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            p_bins[x] = uint16_t((uint32_t(std::min(std::max(p_src[x], low), high) - low) * scale) >> 16);
+        }
+    }
+
+#ifdef AGC_HAS_AVX2
+    __attribute__((target("avx2"))) void _minMaxAvx2(uint16_t const *p_src, int width, uint16_t *p_low, uint16_t *p_high)
+    {
+        auto lowV = _mm256_set1_epi16((short)*p_low);
+        auto highV = _mm256_set1_epi16((short)*p_high);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            auto const value = _mm256_loadu_si256((__m256i const *)(p_src + x));
+            lowV = _mm256_min_epu16(lowV, value);
+            highV = _mm256_max_epu16(highV, value);
+        }
+        alignas(32) uint16_t p_lows[16];
+        alignas(32) uint16_t p_highs[16];
+        _mm256_store_si256((__m256i *)p_lows, lowV);
+        _mm256_store_si256((__m256i *)p_highs, highV);
+        *p_low = *std::min_element(p_lows, p_lows + 16);
+        *p_high = *std::max_element(p_highs, p_highs + 16);
+        _minMaxScalar(p_src + x, width - x, p_low, p_high);
+    }
+
+    __attribute__((target("avx2"))) __m256i _binAvx2(uint16_t const *p_src, __m256i lowV, __m256i highV, __m256i scaleV)
+    {
+        auto value = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const *)p_src));
+        value = _mm256_min_epi32(_mm256_max_epi32(value, lowV), highV);
+        return _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(value, lowV), scaleV), 16);
+    }
+
+    __attribute__((target("avx2"))) void _binAvx2(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_bins)
+    {
+        auto const lowV = _mm256_set1_epi32(low);
+        auto const highV = _mm256_set1_epi32(high);
+        auto const scaleV = _mm256_set1_epi32((int)scale);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            auto const first = _binAvx2(p_src + x, lowV, highV, scaleV);
+            auto const second = _binAvx2(p_src + x + 8, lowV, highV, scaleV);
+            // packing works per 128 bit lane, restore the pixel order afterwards
+            _mm256_storeu_si256((__m256i *)(p_bins + x), _mm256_permute4x64_epi64(_mm256_packus_epi32(first, second), 0xD8));
+        }
+        _binScalar(p_src + x, width - x, low, high, scale, p_bins + x);
+    }
+#endif
+
+#ifdef AGC_HAS_NEON
+    void _minMaxNeon(uint16_t const *p_src, int width, uint16_t *p_low, uint16_t *p_high)
+    {
+        auto lowV = vdupq_n_u16(*p_low);
+        auto highV = vdupq_n_u16(*p_high);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            auto const value = vld1q_u16(p_src + x);
+            lowV = vminq_u16(lowV, value);
+            highV = vmaxq_u16(highV, value);
+        }
+        *p_low = vminvq_u16(lowV);
+        *p_high = vmaxvq_u16(highV);
+        _minMaxScalar(p_src + x, width - x, p_low, p_high);
+    }
+
+    void _binNeon(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_bins)
+    {
+        auto const lowV = vdupq_n_u16(low);
+        auto const highV = vdupq_n_u16(high);
+        auto const scaleV = vdupq_n_u32(scale);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            auto const delta = vsubq_u16(vminq_u16(vmaxq_u16(vld1q_u16(p_src + x), lowV), highV), lowV);
+            auto const first = vshrq_n_u32(vmulq_u32(vmovl_u16(vget_low_u16(delta)), scaleV), 16);
+            auto const second = vshrq_n_u32(vmulq_u32(vmovl_u16(vget_high_u16(delta)), scaleV), 16);
+            vst1q_u16(p_bins + x, vcombine_u16(vmovn_u32(first), vmovn_u32(second)));
+        }
+        _binScalar(p_src + x, width - x, low, high, scale, p_bins + x);
+    }
+#endif
+
+    bool _hasVectorSupport()
+    {
+#if defined(AGC_HAS_AVX2)
+        return __builtin_cpu_supports("avx2");
+#elif defined(AGC_HAS_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void _minMax(bool vectorized, uint16_t const *p_src, int width, uint16_t *p_low, uint16_t *p_high)
+    {
+#if defined(AGC_HAS_AVX2)
+        if (vectorized)
+        {
+            _minMaxAvx2(p_src, width, p_low, p_high);
+            return;
+        }
+#elif defined(AGC_HAS_NEON)
+        if (vectorized)
+        {
+            _minMaxNeon(p_src, width, p_low, p_high);
+            return;
+        }
+#endif
+        _minMaxScalar(p_src, width, p_low, p_high);
+    }
+
+    void _bin(bool vectorized, uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_bins)
+    {
+#if defined(AGC_HAS_AVX2)
+        if (vectorized)
+        {
+            _binAvx2(p_src, width, low, high, scale, p_bins);
+            return;
+        }
+#elif defined(AGC_HAS_NEON)
+        if (vectorized)
+        {
+            _binNeon(p_src, width, low, high, scale, p_bins);
+            return;
+        }
+#endif
+        _binScalar(p_src, width, low, high, scale, p_bins);
+    }
+}
+
+AgcEngine::AgcEngine()
+    : m_mode{Mode::Linear},
+      m_locked{false},
+      m_vectorized{_hasVectorSupport()},
+      m_plateau{n_defaultPlateau},
+      m_rangeLow{0.0},
+      m_rangeHigh{0.0},
+      m_low{0},
+      m_high{1},
+      m_scale{n_binMax << 16},
+      m_transferVersion{0},
+      m_updateNs{0.0},
+      m_transfer{},
+      m_histogram{},
+      m_histogramLow{0},
+      m_histogramHigh{0},
+      m_rebinnedHistogram{},
+      m_laneHistograms{},
+      m_bins{}
+{
+    _setIdentityTransfer();
+}
+
+void AgcEngine::setLinear()
+{
+    m_mode = Mode::Linear;
+    m_locked = false;
+    // start over from the next frame
+    m_rangeLow = 0.0;
+    m_rangeHigh = 0.0;
+    _setIdentityTransfer();
+}
+
+void AgcEngine::setLinear(double minTemperature, double maxTemperature)
+{
+    if (maxTemperature < minTemperature)
+    {
+        std::swap(minTemperature, maxTemperature);
+    }
+    m_mode = Mode::Linear;
+    m_locked = true;
+    _setRange(_toRaw(minTemperature), _toRaw(maxTemperature));
+    _setIdentityTransfer();
+}
+
+void AgcEngine::lock()
+{
+    m_mode = Mode::Linear;
+    m_locked = true;
+    _setRange(m_low, m_high);
+    _setIdentityTransfer();
+}
+
+void AgcEngine::setHistEq(double plateau)
+{
+    if (m_mode != Mode::HistEq)
+    {
+        // start over from the next frame
+        m_histogramLow = 0;
+        m_histogramHigh = 0;
+    }
+    m_mode = Mode::HistEq;
+    m_locked = false;
+    m_plateau = std::clamp(plateau, 1.0 / double(n_transferSize), 1.0);
+}
+
+void AgcEngine::setWindow(double centerTemperature, double widthTemperature)
+{
+    widthTemperature = std::max(std::abs(widthTemperature), 1.0 / n_fixedScale);
+    m_mode = Mode::Window;
+    m_locked = true;
+    _setRange(_toRaw(centerTemperature - widthTemperature / 2.0), _toRaw(centerTemperature + widthTemperature / 2.0));
+    _setIdentityTransfer();
+}
+
+AgcEngine::Mode AgcEngine::getMode() const
+{
+    return m_mode;
+}
+
+void AgcEngine::setVectorized(bool vectorized)
+{
+    m_vectorized = vectorized && _hasVectorSupport();
+}
+
+void AgcEngine::update(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    if (m_locked || width <= 0 || height <= 0)
+    {
+        return;
+    }
+    auto const startTime = std::chrono::steady_clock::now();
+    _updateRange(p_src, srcStride, width, height);
+    if (m_mode == Mode::HistEq)
+    {
+        _updateHistogram(p_src, srcStride, width, height);
+    }
+    m_updateNs = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+uint16_t AgcEngine::getLow() const
+{
+    return m_low;
+}
+
+uint16_t AgcEngine::getHigh() const
+{
+    return m_high;
+}
+
+uint32_t AgcEngine::getScale() const
+{
+    return m_scale;
+}
+
+std::array<uint16_t, AgcEngine::n_transferSize> const &AgcEngine::getTransfer() const
+{
+    return m_transfer;
+}
+
+uint64_t AgcEngine::getTransferVersion() const
+{
+    return m_transferVersion;
+}
+
+std::string AgcEngine::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    switch (m_mode)
+    {
+    case Mode::HistEq:
+        ss << "mode=histeq, plateau=" << m_plateau;
+        break;
+    case Mode::Window:
+        ss << "mode=window";
+        break;
+    case Mode::Linear:
+    default:
+        ss << "mode=linear, locked=" << (m_locked ? "true" : "false");
+        break;
+    }
+    ss << ", rangeC={" << _toTemperature(m_low) << ", " << _toTemperature(m_high) << "}";
+    ss << ", updateMs=" << std::setprecision(3) << m_updateNs / 1e6;
+    ss << ", vectorized=" << (m_vectorized ? "true" : "false");
+    ss << "}";
+    return ss.str();
+}
+
+void AgcEngine::_setRange(double rangeLow, double rangeHigh)
+{
+    m_rangeLow = rangeLow;
+    m_rangeHigh = rangeHigh;
+    m_low = (uint16_t)std::clamp<long>(std::lround(m_rangeLow), 0, 65534);
+    m_high = (uint16_t)std::clamp<long>(std::lround(m_rangeHigh), m_low + 1, 65535);
+    m_scale = (n_binMax << 16) / uint32_t(m_high - m_low);
+}
+
+void AgcEngine::_updateRange(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    uint16_t frameLow = UINT16_MAX;
+    uint16_t frameHigh = 0;
+    for (int y = 0; y < height; ++y)
+    {
+        _minMax(m_vectorized, (uint16_t const *)((uint8_t const *)p_src + y * srcStride), width, &frameLow, &frameHigh);
+    }
+    auto rangeLow = m_rangeLow;
+    auto rangeHigh = m_rangeHigh;
+    if (rangeHigh <= rangeLow)
+    {
+        rangeLow = frameLow;
+        rangeHigh = frameHigh;
+    }
+    else
+    {
+        rangeLow += n_rangeSmoothing * (frameLow - rangeLow);
+        rangeHigh += n_rangeSmoothing * (frameHigh - rangeHigh);
+    }
+    if (rangeHigh - rangeLow < n_minAutoSpan)
+    {
+        auto const center = (rangeHigh + rangeLow) / 2.0;
+        rangeLow = std::max(0.0, center - n_minAutoSpan / 2.0);
+        rangeHigh = std::min(65535.0, rangeLow + n_minAutoSpan);
+    }
+    _setRange(rangeLow, rangeHigh);
+}
+
+void AgcEngine::_updateHistogram(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    for (auto &laneHistogram : m_laneHistograms)
+    {
+        laneHistogram.fill(0);
+    }
+    for (int y = 0; y < height; ++y)
+    {
+        auto const *const p_row = (uint16_t const *)((uint8_t const *)p_src + y * srcStride);
+        for (int x = 0; x < width; x += (int)m_bins.size())
+        {
+            auto const count = std::min(width - x, (int)m_bins.size());
+            _bin(m_vectorized, p_row + x, count, m_low, m_high, m_scale, m_bins.data());
+            int i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                ++m_laneHistograms[0][m_bins[i]];
+                ++m_laneHistograms[1][m_bins[i + 1]];
+                ++m_laneHistograms[2][m_bins[i + 2]];
+                ++m_laneHistograms[3][m_bins[i + 3]];
+            }
+            for (; i < count; ++i)
+            {
+                ++m_laneHistograms[0][m_bins[i]];
+            }
+        }
+    }
+    // smooth over frames in the bins of the current limits, then clip every bin at the plateau and equalize
+    auto const primed = m_histogramHigh > m_histogramLow;
+    _rebinHistogram();
+    auto const plateau = float(m_plateau * double(width) * double(height));
+    double total = 0.0;
+    for (size_t i = 0; i < n_transferSize; ++i)
+    {
+        auto const frameCount = float(m_laneHistograms[0][i] + m_laneHistograms[1][i] + m_laneHistograms[2][i] + m_laneHistograms[3][i]);
+        m_histogram[i] = primed ? m_histogram[i] + n_histogramSmoothing * (frameCount - m_histogram[i]) : frameCount;
+        total += std::min(m_histogram[i], plateau);
+    }
+    if (total > 0.0)
+    {
+        double cumulative = 0.0;
+        bool changed = false;
+        for (size_t i = 0; i < n_transferSize; ++i)
+        {
+            // center of the bin's share of the output range
+            auto const clipped = std::min(m_histogram[i], plateau);
+            auto const position = (uint16_t)std::lround((cumulative + clipped / 2.0) / total * n_binMax);
+            changed = changed || position != m_transfer[i];
+            m_transfer[i] = position;
+            cumulative += clipped;
+        }
+        if (changed)
+        {
+            ++m_transferVersion;
+        }
+    }
+}
+
+// move the smoothed histogram onto the bins of the current limits, the count of an old bin is spread
+// over the new bins it overlaps, counts outside the new limits go to the end bins like clamped pixels
+void AgcEngine::_rebinHistogram()
+{
+    if (m_histogramLow == m_low && m_histogramHigh == m_high)
+    {
+        return;
+    }
+    if (m_histogramHigh > m_histogramLow)
+    {
+        m_rebinnedHistogram.fill(0.0f);
+        // bin i covers [low + i * width, low + (i + 1) * width) with width = (high - low) / n_binMax,
+        // start and end are the old bin's edges counted in new bins
+        auto const binRatio = double(m_histogramHigh - m_histogramLow) / double(m_high - m_low);
+        auto const offset = double(int(m_histogramLow) - int(m_low)) * double(n_binMax) / double(m_high - m_low);
+        for (size_t i = 0; i < n_transferSize; ++i)
+        {
+            if (m_histogram[i] == 0.0f)
+            {
+                continue;
+            }
+            auto const start = offset + double(i) * binRatio;
+            auto const end = start + binRatio;
+            auto const density = double(m_histogram[i]) / binRatio;
+            if (start < 0.0)
+            {
+                m_rebinnedHistogram[0] += float((std::min(end, 0.0) - start) * density);
+            }
+            if (end > double(n_transferSize))
+            {
+                m_rebinnedHistogram[n_binMax] += float((end - std::max(start, double(n_transferSize))) * density);
+            }
+            for (auto position = std::max(start, 0.0); position < std::min(end, double(n_transferSize));)
+            {
+                auto const bin = std::floor(position);
+                auto const next = std::min({bin + 1.0, end, double(n_transferSize)});
+                m_rebinnedHistogram[size_t(bin)] += float((next - position) * density);
+                position = next;
+            }
+        }
+        m_histogram = m_rebinnedHistogram;
+    }
+    m_histogramLow = m_low;
+    m_histogramHigh = m_high;
+}
+
+void AgcEngine::_setIdentityTransfer()
+{
+    for (size_t i = 0; i < n_transferSize; ++i)
+    {
+        m_transfer[i] = uint16_t(i);
+    }
+    ++m_transferVersion;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Automatic gain control on FIXED_10_6 thermography frames.
+// The raw values between a low and a high value are quantized into n_transferSize bins,
+// the transfer table then maps every bin onto a palette position (composed with the palette by the Colorizer).
+// Linear: the range follows the smoothed frame minimum and maximum, or is locked at fixed temperatures.
+// HistEq: histogram equalization with a plateau over the smoothed range of Linear, the histogram is exponentially
+// smoothed over frames after re-binning the previous one onto the current limits.
+// Window: a fixed temperature window (center and width), the temperature to color mapping never changes.
+class AgcEngine
+{
+public:
+    static constexpr size_t n_transferSize = 1024;
+    enum class Mode
+    {
+        Linear,
+        HistEq,
+        Window
+    };
+    AgcEngine();
+    // linear, the range follows the scene
+    void setLinear();
+    // linear, the range is locked at the temperatures (degrees C)
+    void setLinear(double minTemperature, double maxTemperature);
+    // linear, lock the range currently in use
+    void lock();
+    // histogram equalization, plateau is the largest fraction of the pixels counted in one bin (0-1]
+    void setHistEq(double plateau);
+    // fixed window, temperatures in degrees C
+    void setWindow(double centerTemperature, double widthTemperature);
+    Mode getMode() const;
+    // use AVX2/NEON for the frame statistics when the CPU supports them
+    void setVectorized(bool vectorized);
+    // update the range (and the histogram) from a frame, nothing is done when the mapping is fixed
+    void update(uint16_t const *p_src, size_t srcStride, int width, int height);
+    // raw value mapped to the first and to the last bin
+    uint16_t getLow() const;
+    uint16_t getHigh() const;
+    // bin = (clamp(value, low, high) - low) * scale >> 16
+    uint32_t getScale() const;
+    // bin -> palette position (0 to n_transferSize - 1)
+    std::array<uint16_t, n_transferSize> const &getTransfer() const;
+    // changes every time the transfer table changes
+    uint64_t getTransferVersion() const;
+    // Get a string representing the mode, the range and the cost of the last update
+    std::string getStatus() const;
+
+private:
+    void _setRange(double rangeLow, double rangeHigh);
+    void _updateRange(uint16_t const *p_src, size_t srcStride, int width, int height);
+    void _updateHistogram(uint16_t const *p_src, size_t srcStride, int width, int height);
+    void _rebinHistogram();
+    void _setIdentityTransfer();
+    Mode m_mode;
+    bool m_locked;
+    bool m_vectorized;
+    double m_plateau;
+    double m_rangeLow;
+    double m_rangeHigh;
+    uint16_t m_low;
+    uint16_t m_high;
+    uint32_t m_scale;
+    uint64_t m_transferVersion;
+    double m_updateNs;
+    std::array<uint16_t, n_transferSize> m_transfer;
+    std::array<float, n_transferSize> m_histogram;
+    // raw limits the smoothed histogram is binned over, equal = no history
+    uint16_t m_histogramLow;
+    uint16_t m_histogramHigh;
+    std::array<float, n_transferSize> m_rebinnedHistogram;
+    // one histogram per lane so that neighboring equal pixels do not serialize on the same counter
+    alignas(32) std::array<std::array<uint32_t, n_transferSize>, 4> m_laneHistograms;
+    alignas(32) std::array<uint16_t, 4096> m_bins;
+};
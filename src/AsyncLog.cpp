@@ -0,0 +1,214 @@
+#include "AsyncLog.h"
+#include <syslog.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    constexpr static inline auto const n_queueSize = size_t(1024); // must be a power of two
+    constexpr static inline auto const n_maxMessageLength = size_t(256);
+    constexpr static inline auto const n_drainInterval = std::chrono::milliseconds(20);
+    constexpr static inline auto const n_coalesceWindow = std::chrono::seconds(10);
+
+    struct LogSlot
+    {
+        std::atomic<size_t> sequence;
+        int priority;
+        char p_text[n_maxMessageLength];
+    };
+
+    // bounded multi-producer queue (Vyukov), consumed by the drain thread only
+    std::array<LogSlot, n_queueSize> n_slots;
+    std::atomic<size_t> n_enqueuePos{0};
+    size_t n_dequeuePos = 0;
+    std::atomic_bool n_slotsInitialized{false};
+
+    std::thread n_drainThread;
+    std::atomic_bool n_drainThreadRunning{false};
+    std::atomic<uint64_t> n_queuedCount{0};
+    std::atomic<uint64_t> n_droppedCount{0};
+    std::atomic<uint64_t> n_coalescedCount{0};
+
+    struct RecentMessage
+    {
+        int priority;
+        uint64_t repeatCount;
+        std::chrono::steady_clock::time_point windowStart;
+    };
+    // only touched by the drain thread
+    std::unordered_map<std::string, RecentMessage> n_recentMessages;
+
+    void _initializeSlots()
+    {
+        if (!n_slotsInitialized.exchange(true))
+        {
+            for (size_t i = 0; i < n_queueSize; ++i)
+            {
+                n_slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool _enqueue(int priority, char const *p_format, va_list args)
+    {
+        auto pos = n_enqueuePos.load(std::memory_order_relaxed);
+        LogSlot *p_slot = nullptr;
+        for (;;)
+        {
+            p_slot = &n_slots[pos & (n_queueSize - 1)];
+            auto const sequence = p_slot->sequence.load(std::memory_order_acquire);
+            auto const diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (n_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                // the queue is full
+                return false;
+            }
+            else
+            {
+                pos = n_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        p_slot->priority = priority;
+        std::vsnprintf(p_slot->p_text, n_maxMessageLength, p_format, args);
+        p_slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool _dequeue(int *p_priority, std::string *p_text)
+    {
+        auto &slot = n_slots[n_dequeuePos & (n_queueSize - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != n_dequeuePos + 1)
+        {
+            return false;
+        }
+        *p_priority = slot.priority;
+        p_text->assign(slot.p_text);
+        slot.sequence.store(n_dequeuePos + n_queueSize, std::memory_order_release);
+        ++n_dequeuePos;
+        return true;
+    }
+
+    void _flushRepeats(bool force)
+    {
+        auto const now = std::chrono::steady_clock::now();
+        for (auto it = std::begin(n_recentMessages); it != std::end(n_recentMessages);)
+        {
+            auto &recent = it->second;
+            if (force || now - recent.windowStart >= n_coalesceWindow)
+            {
+                if (recent.repeatCount > 0)
+                {
+                    auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(now - recent.windowStart).count();
+                    syslog(recent.priority, "%s (repeated %llu times in %llds)", it->first.c_str(), (unsigned long long)recent.repeatCount, (long long)seconds);
+                    // keep coalescing while the message keeps coming
+                    recent.repeatCount = 0;
+                    recent.windowStart = now;
+                    ++it;
+                }
+                else
+                {
+                    it = n_recentMessages.erase(it);
+                }
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void _drain()
+    {
+        int priority = LOG_INFO;
+        std::string text;
+        while (_dequeue(&priority, &text))
+        {
+            if (auto it = n_recentMessages.find(text); it != std::end(n_recentMessages))
+            {
+                ++it->second.repeatCount;
+                ++n_coalescedCount;
+            }
+            else
+            {
+                syslog(priority, "%s", text.c_str());
+                n_recentMessages.emplace(text, RecentMessage{priority, 0, std::chrono::steady_clock::now()});
+            }
+        }
+    }
+}
+
+void AsyncLog::start()
+{
+    if (!n_drainThreadRunning)
+    {
+        _initializeSlots();
+        n_drainThreadRunning = true;
+        n_drainThread = std::thread([]()
+                                    {
+            while (n_drainThreadRunning)
+            {
+                std::this_thread::sleep_for(n_drainInterval);
+                _drain();
+                _flushRepeats(false);
+            } });
+    }
+}
+
+void AsyncLog::stop()
+{
+    if (n_drainThreadRunning)
+    {
+        n_drainThreadRunning = false;
+        if (n_drainThread.joinable())
+        {
+            n_drainThread.join();
+        }
+        _drain();
+        _flushRepeats(true);
+        n_recentMessages.clear();
+    }
+}
+
+void AsyncLog::log(int priority, char const *p_format, ...)
+{
+    va_list args;
+    va_start(args, p_format);
+    if (!n_drainThreadRunning)
+    {
+        vsyslog(priority, p_format, args);
+    }
+    else if (_enqueue(priority, p_format, args))
+    {
+        ++n_queuedCount;
+    }
+    else
+    {
+        ++n_droppedCount;
+    }
+    va_end(args);
+}
+
+std::string AsyncLog::getStatus()
+{
+    std::stringstream ss;
+    ss << "{";
+    ss << "running=" << (n_drainThreadRunning ? "true" : "false");
+    ss << ", queued=" << n_queuedCount;
+    ss << ", coalesced=" << n_coalescedCount;
+    ss << ", dropped=" << n_droppedCount;
+    ss << "}";
+    return ss.str();
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+// Non-blocking syslog replacement for the frame path.
+// Messages are formatted by the caller into a lock-free queue and written to syslog by a
+// background thread, so a slow journal never stalls a frame callback.
+// Identical messages repeated within the coalescing window are logged once, followed by
+// a summary such as "repeated 270 times in 10s".
+class AsyncLog
+{
+public:
+    // start the background thread (must be called after the daemon forks)
+    static void start();
+    // flush pending messages and stop the background thread
+    static void stop();
+    // queue a message with a syslog priority, never blocks
+    // falls back to syslog() when the background thread is not running
+    static void log(int priority, char const *p_format, ...) __attribute__((format(printf, 2, 3)));
+    // Get a string representing the logger status (queued, dropped and coalesced messages)
+    static std::string getStatus();
+};
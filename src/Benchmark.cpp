@@ -0,0 +1,354 @@
+#include "Benchmark.h"
+#include "Colorizer.h"
+#include "AgcEngine.h"
+#include "HotspotDetector.h"
+#include "Isotherm.h"
+#include "TemporalFilter.h"
+#include "VideoEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace
+{
+    constexpr static inline auto const n_frameWidth = 320;
+    constexpr static inline auto const n_frameHeight = 240;
+    constexpr static inline auto const n_frameRate = 27.0;
+    constexpr static inline auto const n_warmupFrames = 20;
+    constexpr static inline auto const n_frameCount = 500;
+    // frames encoded for the bitrate comparison, every one has its own noise
+    constexpr static inline auto const n_encodeFrameCount = 270;
+
+    // a FIXED_10_6 scene: 20 degrees C background with a gradient, a 60 degrees C hotspot and noise
+    std::vector<uint16_t> _makeThermographyFrame(int frameIndex)
+    {
+        std::vector<uint16_t> frame(size_t(n_frameWidth) * n_frameHeight);
+        uint32_t noise = 12345u + uint32_t(frameIndex) * 7919u;
+        for (int y = 0; y < n_frameHeight; ++y)
+        {
+            for (int x = 0; x < n_frameWidth; ++x)
+            {
+                noise = noise * 1664525u + 1013904223u;
+                auto const dx = x - (n_frameWidth / 2 + frameIndex % 40);
+                auto const dy = y - n_frameHeight / 3;
+                auto temperature = 20.0 + 10.0 * x / n_frameWidth + double(noise >> 28) / 32.0;
+                if (dx * dx + dy * dy < 400)
+                {
+                    temperature = 60.0;
+                }
+                frame[size_t(y) * n_frameWidth + x] = (uint16_t)std::lround((temperature + 40.0) * 64.0);
+            }
+        }
+        return frame;
+    }
+
+    // time fn over n_frameCount frames and append a line with the per frame cost
+    template <typename Function>
+    void _time(std::stringstream &ss, std::string const &name, Function &&fn)
+    {
+        for (int i = 0; i < n_warmupFrames; ++i)
+        {
+            fn(i);
+        }
+        auto const startTime = std::chrono::steady_clock::now();
+        for (int i = 0; i < n_frameCount; ++i)
+        {
+            fn(i);
+        }
+        auto const elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+        auto const frameUs = elapsedUs / n_frameCount;
+        ss << "  " << std::left << std::setw(28) << name << std::right
+           << std::setw(10) << frameUs << " us/frame"
+           << std::setw(10) << double(n_frameWidth) * n_frameHeight / frameUs << " Mpixel/s"
+           << std::setw(8) << frameUs * n_frameRate / 1e4 << " % of a core at 27 Hz\n";
+    }
+
+    void _benchmarkColorizer(std::stringstream &ss)
+    {
+        ss << "Colorizer (FIXED_10_6 -> palette, automatic linear AGC, palette IRON):\n";
+        std::vector<std::vector<uint16_t>> frames;
+        for (int i = 0; i < 8; ++i)
+        {
+            frames.push_back(_makeThermographyFrame(i));
+        }
+        std::vector<uint32_t> argbFrame(size_t(n_frameWidth) * n_frameHeight);
+        std::vector<uint8_t> greyFrame(size_t(n_frameWidth) * n_frameHeight);
+        std::vector<uint32_t> referenceFrame(argbFrame.size());
+        Colorizer colorizer;
+        colorizer.setPalette(5);
+        for (auto const implementation : {Colorizer::Implementation::Scalar, Colorizer::Implementation::Neon, Colorizer::Implementation::Avx2})
+        {
+            colorizer.setImplementation(implementation);
+            if (colorizer.getImplementation() != implementation)
+            {
+                ss << "  " << Colorizer::getImplementationName(implementation) << " not supported on this CPU\n";
+                continue;
+            }
+            std::string const name = Colorizer::getImplementationName(implementation);
+            colorizer.getAgc().setLinear(0.0, 100.0);
+            colorizer.colorizeArgb(frames[0].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, argbFrame.data());
+            if (implementation == Colorizer::Implementation::Scalar)
+            {
+                referenceFrame = argbFrame;
+            }
+            else if (argbFrame != referenceFrame)
+            {
+                ss << "  " << name << " output DIFFERS from scalar\n";
+            }
+            colorizer.getAgc().setLinear();
+            _time(ss, name + " ARGB", [&](int i)
+                  { auto const &frame = frames[size_t(i) % frames.size()];
+                    colorizer.colorizeArgb(frame.data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, argbFrame.data()); });
+            _time(ss, name + " GREY", [&](int i)
+                  { auto const &frame = frames[size_t(i) % frames.size()];
+                    colorizer.colorizeGrey(frame.data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, greyFrame.data()); });
+        }
+        colorizer.setImplementation(Colorizer::getBestImplementation());
+        colorizer.getAgc().setHistEq(0.01);
+        _time(ss, std::string(Colorizer::getImplementationName(colorizer.getImplementation())) + " ARGB histeq", [&](int i)
+              { auto const &frame = frames[size_t(i) % frames.size()];
+                colorizer.colorizeArgb(frame.data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, argbFrame.data()); });
+        ss << "  SDK colorization runs inside libseekcamera, compare FRAMESTATS latencyMs and\n"
+              "  processingMs with COLORIZER ON and OFF on a connected camera.\n";
+    }
+
+    // the AGC update alone, it runs once per colorized frame
+    void _benchmarkAgc(std::stringstream &ss)
+    {
+        ss << "AGC update (range and histogram from the FIXED_10_6 frame):\n";
+        std::vector<std::vector<uint16_t>> frames;
+        for (int i = 0; i < 8; ++i)
+        {
+            frames.push_back(_makeThermographyFrame(i));
+        }
+        AgcEngine agc;
+        for (auto const vectorized : {false, true})
+        {
+            agc.setVectorized(vectorized);
+            std::string const name = vectorized ? "vectorized" : "scalar";
+            agc.setLinear();
+            _time(ss, name + " linear", [&](int i)
+                  { agc.update(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight); });
+            agc.setHistEq(0.01);
+            _time(ss, name + " histeq", [&](int i)
+                  { agc.update(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight); });
+        }
+    }
+
+    // compare-and-blend alone (SDK colorization) and fused into the echothermd colorizer
+    void _benchmarkIsotherm(std::stringstream &ss)
+    {
+        ss << "Isotherm (bands 25-28 C green 60%, 55-100 C red):\n";
+        std::vector<std::vector<uint16_t>> frames;
+        for (int i = 0; i < 8; ++i)
+        {
+            frames.push_back(_makeThermographyFrame(i));
+        }
+        std::vector<Isotherm::Band> bands(2);
+        Isotherm::parseBand("25:28:green:0.6", &bands[0]);
+        Isotherm::parseBand("55:100:red", &bands[1]);
+        Isotherm isotherm;
+        isotherm.setBands(bands);
+        std::vector<uint8_t> colorFrame(size_t(n_frameWidth) * n_frameHeight * 4, 128);
+        std::vector<uint8_t> argbFrame(colorFrame.size());
+        std::vector<uint8_t> referenceFrame(colorFrame.size());
+        auto const apply = [&](int i)
+        {
+            isotherm.apply(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), colorFrame.data(), n_frameWidth * 4,
+                           argbFrame.data(), n_frameWidth * 4, n_frameWidth, n_frameHeight, 4);
+            isotherm.finishFrame();
+        };
+        for (auto const vectorized : {false, true})
+        {
+            isotherm.setVectorized(vectorized);
+            apply(0);
+            if (!vectorized)
+            {
+                referenceFrame = argbFrame;
+            }
+            else if (argbFrame != referenceFrame)
+            {
+                ss << "  vectorized output DIFFERS from scalar\n";
+            }
+            _time(ss, vectorized ? "vectorized ARGB blend" : "scalar ARGB blend", apply);
+        }
+        Colorizer colorizer;
+        colorizer.getAgc().setLinear(0.0, 100.0);
+        _time(ss, "colorize ARGB", [&](int i)
+              { colorizer.colorizeArgb(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, (uint32_t *)argbFrame.data()); });
+        colorizer.setIsotherm(&isotherm);
+        _time(ss, "colorize ARGB + isotherm", [&](int i)
+              { colorizer.colorizeArgb(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, (uint32_t *)argbFrame.data()); });
+    }
+
+    // threshold, connected components and blob statistics, as run on the hotspot detector thread
+    void _benchmarkHotspots(std::stringstream &ss)
+    {
+        ss << "Hotspot detection (threshold 45 C, 8-connected blobs, centroid/area/peak):\n";
+        std::vector<std::vector<uint16_t>> frames;
+        for (int i = 0; i < 8; ++i)
+        {
+            frames.push_back(_makeThermographyFrame(i));
+        }
+        HotspotDetector detector;
+        detector.start(45.0, 4, nullptr);
+        for (auto const vectorized : {false, true})
+        {
+            detector.setVectorized(vectorized);
+            _time(ss, vectorized ? "vectorized detect" : "scalar detect", [&](int i)
+                  { detector.detect(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight); });
+        }
+        detector.stop();
+    }
+
+    // encode the colorized scene with the recording codec and return the file size in bytes, 0 on failure
+    uintmax_t _encodedSize(double denoiseStrength)
+    {
+        auto const filePath = std::filesystem::temp_directory_path() / "echotherm_benchmark.mp4";
+        uintmax_t fileSize = 0;
+        {
+            cv::VideoWriter videoWriter(filePath.string(), cv::VideoWriter::fourcc('m', 'p', '4', 'v'), n_frameRate, cv::Size(n_frameWidth, n_frameHeight), true);
+            if (!videoWriter.isOpened())
+            {
+                return 0;
+            }
+            Colorizer colorizer;
+            colorizer.setPalette(5);
+            colorizer.getAgc().setLinear(10.0, 70.0);
+            TemporalFilter temporalFilter;
+            temporalFilter.setStrength(denoiseStrength);
+            cv::Mat argbFrame(n_frameHeight, n_frameWidth, CV_8UC4);
+            cv::Mat bgrFrame;
+            for (int i = 0; i < n_encodeFrameCount; ++i)
+            {
+                auto const frame = _makeThermographyFrame(i);
+                auto const *p_src = frame.data();
+                if (temporalFilter.isEnabled())
+                {
+                    p_src = temporalFilter.filter16(p_src, n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight);
+                }
+                colorizer.colorizeArgb(p_src, n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, (uint32_t *)argbFrame.data);
+                cv::cvtColor(argbFrame, bgrFrame, cv::COLOR_BGRA2BGR);
+                videoWriter.write(bgrFrame);
+            }
+        }
+        std::error_code errorCode;
+        fileSize = std::filesystem::file_size(filePath, errorCode);
+        std::filesystem::remove(filePath, errorCode);
+        return fileSize;
+    }
+
+    void _benchmarkTemporalFilter(std::stringstream &ss)
+    {
+        ss << "Temporal noise reduction (strength 0.75):\n";
+        std::vector<std::vector<uint16_t>> frames;
+        std::vector<std::vector<uint32_t>> argbFrames;
+        Colorizer colorizer;
+        colorizer.setPalette(5);
+        for (int i = 0; i < 8; ++i)
+        {
+            frames.push_back(_makeThermographyFrame(i));
+            argbFrames.emplace_back(size_t(n_frameWidth) * n_frameHeight);
+            colorizer.colorizeArgb(frames.back().data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, argbFrames.back().data());
+        }
+        TemporalFilter temporalFilter;
+        temporalFilter.setStrength(0.75);
+        for (auto const vectorized : {false, true})
+        {
+            temporalFilter.setVectorized(vectorized);
+            std::string const name = vectorized ? "vectorized" : "scalar";
+            _time(ss, name + " FIXED_10_6", [&](int i)
+                  { temporalFilter.filter16(frames[size_t(i) % frames.size()].data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight); });
+            _time(ss, name + " ARGB", [&](int i)
+                  { temporalFilter.filter8((uint8_t const *)argbFrames[size_t(i) % argbFrames.size()].data(), n_frameWidth * sizeof(uint32_t), n_frameWidth, n_frameHeight, 4); });
+        }
+        auto const unfilteredSize = _encodedSize(0.0);
+        auto const filteredSize = _encodedSize(0.75);
+        if (unfilteredSize == 0 || filteredSize == 0)
+        {
+            ss << "  mp4v encoder not available, bitrate comparison skipped\n";
+            return;
+        }
+        auto const kbps = [](uintmax_t size)
+        { return double(size) * 8.0 / 1000.0 / (n_encodeFrameCount / n_frameRate); };
+        ss << "  mp4v encode of " << n_encodeFrameCount << " frames: " << kbps(unfilteredSize) << " kbit/s unfiltered, "
+           << kbps(filteredSize) << " kbit/s filtered (" << 100.0 * (1.0 - double(filteredSize) / double(unfilteredSize)) << " % less)\n";
+    }
+
+    void _benchmarkVideoEncoders(std::stringstream &ss)
+    {
+        ss << "Recording encoders (colorized scene, " << n_encodeFrameCount << " frames at " << n_frameRate << " fps):\n";
+        // one second of distinct frames, colorized once outside of the timing
+        std::vector<cv::Mat> bgrFrames;
+        Colorizer colorizer;
+        colorizer.setPalette(5);
+        colorizer.getAgc().setLinear(10.0, 70.0);
+        cv::Mat argbFrame(n_frameHeight, n_frameWidth, CV_8UC4);
+        for (int i = 0; i < int(n_frameRate); ++i)
+        {
+            auto const frame = _makeThermographyFrame(i);
+            colorizer.colorizeArgb(frame.data(), n_frameWidth * sizeof(uint16_t), n_frameWidth, n_frameHeight, (uint32_t *)argbFrame.data);
+            bgrFrames.emplace_back();
+            cv::cvtColor(argbFrame, bgrFrames.back(), cv::COLOR_BGRA2BGR);
+        }
+        auto const cores = std::max(1, int(std::thread::hardware_concurrency()));
+        for (auto const &codec : VideoEncoder::getCodecs())
+        {
+            for (auto const threads : {1, cores})
+            {
+                if (threads == cores && cores == 1)
+                {
+                    continue;
+                }
+                std::stringstream name;
+                name << codec.p_name << " " << codec.extensions.front() << ", " << threads << " thread" << (threads > 1 ? "s" : "");
+                auto const filePath = std::filesystem::temp_directory_path() / ("echotherm_benchmark" + codec.extensions.front());
+                auto p_writer = VideoEncoder::open(filePath, codec, n_frameRate, n_frameWidth, n_frameHeight, true, threads);
+                if (!p_writer->isOpened())
+                {
+                    ss << "  " << std::left << std::setw(28) << name.str() << std::right << " not available in this OpenCV build\n";
+                    break;
+                }
+                auto const startTime = std::chrono::steady_clock::now();
+                for (int i = 0; i < n_encodeFrameCount; ++i)
+                {
+                    p_writer->write(bgrFrames[size_t(i) % bgrFrames.size()]);
+                }
+                auto const encodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() / n_encodeFrameCount;
+                p_writer.reset();
+                std::error_code errorCode;
+                auto const fileSize = std::filesystem::file_size(filePath, errorCode);
+                std::filesystem::remove(filePath, errorCode);
+                ss << "  " << std::left << std::setw(28) << name.str() << std::right
+                   << std::setw(10) << encodeMs << " ms/frame"
+                   << std::setw(10) << double(fileSize) * 8.0 / 1000.0 / (n_encodeFrameCount / n_frameRate) << " kbit/s"
+                   << std::setw(8) << encodeMs * n_frameRate / 10.0 << " % of the frame interval"
+                   << (codec.lossless ? ", lossless" : "") << "\n";
+            }
+        }
+    }
+}
+
+std::string Benchmark::run()
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "EchoTherm pipeline benchmark, " << n_frameWidth << "x" << n_frameHeight << ", " << n_frameCount << " frames per test\n";
+    _benchmarkColorizer(ss);
+    _benchmarkAgc(ss);
+    _benchmarkIsotherm(ss);
+    _benchmarkHotspots(ss);
+    _benchmarkTemporalFilter(ss);
+    _benchmarkVideoEncoders(ss);
+    return ss.str();
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+
+// Micro benchmarks of the daemon's frame pipeline stages on synthetic 320x240 frames,
+// run with echothermd --benchmark (no camera needed), the report is printed to stdout.
+class Benchmark
+{
+public:
+    // run every benchmark and return the report
+    static std::string run();
+};
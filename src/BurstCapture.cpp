@@ -0,0 +1,248 @@
+#include "BurstCapture.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <syslog.h>
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+
+namespace
+{
+    constexpr static inline char const *np_streamNames[]{"output", "thermography"};
+    // gaps listed in the status, the count covers all of them
+    constexpr static inline auto const n_maxListedGaps = size_t(8);
+}
+
+struct BurstCapture::Slot
+{
+    cv::Mat image;
+    std::vector<uint8_t> header;
+    uint32_t fpaFrameCount;
+    uint64_t timestampUtcNs;
+};
+
+BurstCapture::BurstCapture(size_t frameCount, bool output, bool thermography)
+    : m_frameCount{frameCount},
+      m_requested{output, thermography},
+      m_slots{},
+      m_counts{},
+      m_complete{!output, !thermography},
+      m_errors{},
+      m_thermographyFormat{0},
+      m_bytes{0},
+      m_mut{},
+      m_capturedCondition{}
+{
+}
+
+BurstCapture::~BurstCapture()
+{
+    MemoryBudget::release(MemoryBudget::Category::Burst, m_bytes);
+}
+
+std::string BurstCapture::allocate(Stream stream, int rows, int cols, int type, size_t headerSize)
+{
+    TRACE_SCOPE("BurstCapture::allocate");
+    auto const index = size_t(stream);
+    auto &slots = m_slots[index];
+    if (!m_requested[index] || !slots.empty())
+    {
+        return {};
+    }
+    // all at once, so that nothing is allocated while the burst runs
+    auto const bytes = m_frameCount * (size_t(rows) * size_t(cols) * CV_ELEM_SIZE(type) + headerSize);
+    if (!MemoryBudget::tryAcquire(MemoryBudget::Category::Burst, bytes))
+    {
+        syslog(LOG_WARNING, "Burst of %zu %s frames refused because the memory budget is exhausted.", m_frameCount, np_streamNames[index]);
+        return "the memory budget is exhausted";
+    }
+    m_bytes += bytes;
+    slots.resize(m_frameCount);
+    for (auto &slot : slots)
+    {
+        slot.image.create(rows, cols, type);
+        slot.header.resize(headerSize);
+    }
+    return {};
+}
+
+bool BurstCapture::wantsFrame(Stream stream) const
+{
+    return m_requested[size_t(stream)] && m_counts[size_t(stream)] < m_frameCount && m_errors[size_t(stream)].empty();
+}
+
+void BurstCapture::addOutputFrame(cv::Mat const &frame, uint32_t fpaFrameCount, uint64_t timestampUtcNs)
+{
+    TRACE_SCOPE("BurstCapture::addOutputFrame");
+    if (auto *const p_slot = _nextSlot(Stream::Output, frame, 0))
+    {
+        frame.copyTo(p_slot->image);
+        p_slot->fpaFrameCount = fpaFrameCount;
+        p_slot->timestampUtcNs = timestampUtcNs;
+    }
+}
+
+void BurstCapture::addThermographyFrame(cv::Mat const &pixels, void const *p_header, size_t headerSize, int frameFormat,
+                                        uint32_t fpaFrameCount, uint64_t timestampUtcNs)
+{
+    TRACE_SCOPE("BurstCapture::addThermographyFrame");
+    if (m_counts[size_t(Stream::Thermography)] == 0)
+    {
+        m_thermographyFormat = frameFormat;
+    }
+    else if (frameFormat != m_thermographyFormat)
+    {
+        m_errors[size_t(Stream::Thermography)] = "the radiometric format changed";
+        _complete(Stream::Thermography);
+        return;
+    }
+    if (auto *const p_slot = _nextSlot(Stream::Thermography, pixels, headerSize))
+    {
+        pixels.copyTo(p_slot->image);
+        std::memcpy(p_slot->header.data(), p_header, headerSize);
+        p_slot->fpaFrameCount = fpaFrameCount;
+        p_slot->timestampUtcNs = timestampUtcNs;
+    }
+}
+
+BurstCapture::Slot *BurstCapture::_nextSlot(Stream stream, cv::Mat const &image, size_t headerSize)
+{
+    auto const index = size_t(stream);
+    if (m_complete[index])
+    {
+        return nullptr;
+    }
+    auto const &slots = m_slots[index];
+    if (slots.empty())
+    {
+        m_errors[index] = "the slots were not allocated";
+        _complete(stream);
+        return nullptr;
+    }
+    if (slots.front().image.rows != image.rows || slots.front().image.cols != image.cols || slots.front().image.type() != image.type() || slots.front().header.size() != headerSize)
+    {
+        m_errors[index] = "the frame geometry changed";
+        _complete(stream);
+        return nullptr;
+    }
+    auto *const p_slot = &m_slots[index][m_counts[index]];
+    if (++m_counts[index] == m_frameCount)
+    {
+        // the caller fills the slot under the camera lock, which is taken before the frames are read
+        _complete(stream);
+    }
+    return p_slot;
+}
+
+void BurstCapture::_complete(Stream stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mut);
+        m_complete[size_t(stream)] = true;
+    }
+    m_capturedCondition.notify_all();
+}
+
+bool BurstCapture::waitCaptured(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(m_mut);
+    return m_capturedCondition.wait_for(lock, timeout, [this]()
+                                        { return std::all_of(std::begin(m_complete), std::end(m_complete), [](bool complete)
+                                                             { return complete; }); });
+}
+
+size_t BurstCapture::getFrameCount(Stream stream) const
+{
+    return m_counts[size_t(stream)];
+}
+
+cv::Mat const &BurstCapture::getImage(Stream stream, size_t index) const
+{
+    return m_slots[size_t(stream)][index].image;
+}
+
+uint32_t BurstCapture::getFpaFrameCount(Stream stream, size_t index) const
+{
+    return m_slots[size_t(stream)][index].fpaFrameCount;
+}
+
+std::vector<uint8_t> const &BurstCapture::getHeader(size_t index) const
+{
+    return m_slots[size_t(Stream::Thermography)][index].header;
+}
+
+int BurstCapture::getThermographyFormat() const
+{
+    return m_thermographyFormat;
+}
+
+std::string BurstCapture::_getStreamStatus(Stream stream) const
+{
+    auto const index = size_t(stream);
+    auto const &slots = m_slots[index];
+    auto const count = m_counts[index];
+    // the nominal step, the sensor may count more than one per delivered frame
+    uint32_t step = 0;
+    for (size_t i = 1; i < count; ++i)
+    {
+        auto const delta = slots[i].fpaFrameCount - slots[i - 1].fpaFrameCount;
+        if (delta > 0 && (step == 0 || delta < step))
+        {
+            step = delta;
+        }
+    }
+    size_t gapCount = 0;
+    uint64_t missingCount = 0;
+    std::stringstream gaps;
+    for (size_t i = 1; step > 0 && i < count; ++i)
+    {
+        auto const delta = slots[i].fpaFrameCount - slots[i - 1].fpaFrameCount;
+        if (delta > step)
+        {
+            auto const missing = delta / step - 1;
+            if (gapCount < n_maxListedGaps)
+            {
+                gaps << (gapCount == 0 ? "" : ", ") << slots[i - 1].fpaFrameCount << "+" << missing;
+            }
+            ++gapCount;
+            missingCount += missing;
+        }
+    }
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "{frames=" << count << "/" << m_frameCount;
+    if (count > 0)
+    {
+        ss << ", fpaFrames=" << slots.front().fpaFrameCount << "-" << slots[count - 1].fpaFrameCount
+           << ", fpaStep=" << step << ", gaps=" << gapCount << ", missing=" << missingCount;
+        if (gapCount > 0)
+        {
+            // fpa_frame_count before the gap + frames missing
+            ss << ", gapsAfter=[" << gaps.str() << (gapCount > n_maxListedGaps ? ", ..." : "") << "]";
+        }
+        ss << ", durationMs=" << double(slots[count - 1].timestampUtcNs - slots.front().timestampUtcNs) / 1e6;
+    }
+    if (!m_errors[index].empty())
+    {
+        ss << ", error=" << m_errors[index];
+    }
+    ss << "}";
+    return ss.str();
+}
+
+std::string BurstCapture::getStatus() const
+{
+    std::stringstream ss;
+    ss << "{";
+    for (size_t index = 0; index < size_t(Stream::Count); ++index)
+    {
+        if (m_requested[index])
+        {
+            ss << (ss.tellp() > 1 ? ", " : "") << np_streamNames[index] << "=" << _getStreamStatus(Stream(index));
+        }
+    }
+    ss << "}";
+    return ss.str();
+}
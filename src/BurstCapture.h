@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cv
+{
+    class Mat;
+}
+
+// Consecutive frames at the full frame rate, for calibration and short transient events: frameCount
+// output frames and/or frameCount thermography frames with their camera frame header. The slots of a
+// stream are allocated by allocate() and accounted in MemoryBudget as burst before the burst is handed
+// to the frame callback, so the frame callback only copies; the frames are encoded and written after
+// the capture.
+// Each frame keeps the fpa_frame_count of its camera frame header. The smallest step between two
+// frames of the burst is taken as the nominal step, a larger one is reported as a gap.
+// allocate() is called before the burst is handed to the frame callback, wantsFrame() and the add
+// functions from the frame callback, waitCaptured() from another thread; the frames are read once
+// the frame callback no longer adds to the burst.
+class BurstCapture
+{
+public:
+    enum class Stream
+    {
+        Output = 0,
+        Thermography,
+        Count
+    };
+    BurstCapture(size_t frameCount, bool output, bool thermography);
+    ~BurstCapture();
+    // allocate the slots of a requested stream for frames of this geometry and header size
+    // return an empty string on success, otherwise why they could not be allocated
+    std::string allocate(Stream stream, int rows, int cols, int type, size_t headerSize);
+    // whether the stream still takes frames
+    bool wantsFrame(Stream stream) const;
+    // copy the frame into the next slot of the stream, ignored once the stream is complete
+    void addOutputFrame(cv::Mat const &frame, uint32_t fpaFrameCount, uint64_t timestampUtcNs);
+    void addThermographyFrame(cv::Mat const &pixels, void const *p_header, size_t headerSize, int frameFormat,
+                              uint32_t fpaFrameCount, uint64_t timestampUtcNs);
+    // wait until every requested stream is complete or failed, return false on timeout
+    bool waitCaptured(std::chrono::milliseconds timeout);
+    size_t getFrameCount(Stream stream) const;
+    cv::Mat const &getImage(Stream stream, size_t index) const;
+    uint32_t getFpaFrameCount(Stream stream, size_t index) const;
+    // camera frame header of a thermography frame
+    std::vector<uint8_t> const &getHeader(size_t index) const;
+    int getThermographyFormat() const;
+    // Get a string representing the frames captured per stream, the gaps and the capture duration
+    std::string getStatus() const;
+
+private:
+    struct Slot;
+    // the next slot of the stream, nullptr when the stream is complete or the frame does not fit its slots
+    Slot *_nextSlot(Stream stream, cv::Mat const &image, size_t headerSize);
+    void _complete(Stream stream);
+    std::string _getStreamStatus(Stream stream) const;
+    size_t m_frameCount;
+    std::array<bool, size_t(Stream::Count)> m_requested;
+    std::array<std::vector<Slot>, size_t(Stream::Count)> m_slots;
+    std::array<size_t, size_t(Stream::Count)> m_counts;
+    std::array<bool, size_t(Stream::Count)> m_complete;
+    std::array<std::string, size_t(Stream::Count)> m_errors;
+    int m_thermographyFormat;
+    size_t m_bytes;
+    // guards m_complete for waitCaptured()
+    mutable std::mutex m_mut;
+    std::condition_variable m_capturedCondition;
+};
@@ -0,0 +1,381 @@
+#include "Colorizer.h"
+#include "Isotherm.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define COLORIZER_HAS_AVX2 1
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define COLORIZER_HAS_NEON 1
+#endif
+
+namespace
+{
+    constexpr static inline auto const n_lutMax = uint32_t(Colorizer::n_lutSize - 1);
+    // rows colorized before the isotherm is blended into them, 16 rows of 320 ARGB pixels stay in L1
+    constexpr static inline auto const n_isothermStripRows = 16;
+
+    struct PalettePoint
+    {
+        double position;
+        uint8_t red;
+        uint8_t green;
+        uint8_t blue;
+    };
+
+    // approximations of the SDK palettes, indexed by seekcamera_color_palette_t
+    std::vector<PalettePoint> _getPalettePoints(int colorPalette)
+    {
+        switch (colorPalette)
+        {
+        case 1: // BLACK_HOT
+            return {{0.0, 255, 255, 255}, {1.0, 0, 0, 0}};
+        case 2: // SPECTRA
+            return {{0.0, 16, 0, 64}, {0.2, 0, 0, 255}, {0.4, 0, 255, 255}, {0.6, 0, 255, 0}, {0.8, 255, 255, 0}, {0.9, 255, 128, 0}, {1.0, 255, 0, 0}};
+        case 3: // PRISM
+            return {{0.0, 96, 0, 160}, {0.25, 0, 64, 255}, {0.5, 0, 220, 64}, {0.75, 255, 230, 0}, {1.0, 255, 0, 32}};
+        case 4: // TYRIAN
+            return {{0.0, 0, 0, 0}, {0.4, 102, 2, 60}, {0.75, 230, 40, 160}, {1.0, 255, 240, 250}};
+        case 5: // IRON
+            return {{0.0, 0, 0, 0}, {0.2, 32, 0, 140}, {0.45, 204, 0, 119}, {0.7, 255, 130, 0}, {0.9, 255, 220, 40}, {1.0, 255, 255, 255}};
+        case 6: // AMBER
+            return {{0.0, 0, 0, 0}, {0.7, 255, 170, 0}, {1.0, 255, 240, 180}};
+        case 7: // HI, white hot with the hottest values in red
+            return {{0.0, 0, 0, 0}, {0.95, 242, 242, 242}, {0.951, 255, 0, 0}, {1.0, 255, 0, 0}};
+        case 8: // GREEN
+            return {{0.0, 0, 0, 0}, {0.8, 40, 255, 40}, {1.0, 220, 255, 220}};
+        case 0: // WHITE_HOT
+        default:
+            return {{0.0, 0, 0, 0}, {1.0, 255, 255, 255}};
+        }
+    }
+
+    uint32_t _toBgra(uint8_t red, uint8_t green, uint8_t blue)
+    {
+        // little endian 0xAARRGGBB is B, G, R, A in memory
+        return 0xFF000000u | (uint32_t(red) << 16) | (uint32_t(green) << 8) | uint32_t(blue);
+    }
+
+    uint16_t _toIndex(uint16_t value, uint16_t low, uint16_t high, uint32_t scale)
+    {
+        value = std::min(std::max(value, low), high);
+        return uint16_t((uint32_t(value - low) * scale) >> 16);
+    }
+
+    void _computeIndicesScalar(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_indices)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            p_indices[x] = _toIndex(p_src[x], low, high, scale);
+        }
+    }
+
+#ifdef COLORIZER_HAS_AVX2
+    __attribute__((target("avx2"))) __m256i _toIndicesAvx2(uint16_t const *p_src, __m256i lowV, __m256i highV, __m256i scaleV)
+    {
+        auto value = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const *)p_src));
+        value = _mm256_min_epi32(_mm256_max_epi32(value, lowV), highV);
+        return _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(value, lowV), scaleV), 16);
+    }
+
+    __attribute__((target("avx2"))) void _computeIndicesAvx2(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_indices)
+    {
+        auto const lowV = _mm256_set1_epi32(low);
+        auto const highV = _mm256_set1_epi32(high);
+        auto const scaleV = _mm256_set1_epi32((int)scale);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            auto const first = _toIndicesAvx2(p_src + x, lowV, highV, scaleV);
+            auto const second = _toIndicesAvx2(p_src + x + 8, lowV, highV, scaleV);
+            // packing works per 128 bit lane, restore the pixel order afterwards
+            auto const packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(first, second), 0xD8);
+            _mm256_storeu_si256((__m256i *)(p_indices + x), packed);
+        }
+        _computeIndicesScalar(p_src + x, width - x, low, high, scale, p_indices + x);
+    }
+
+    __attribute__((target("avx2"))) void _colorizeRowAvx2(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint32_t const *p_lut, uint32_t *p_dst)
+    {
+        auto const lowV = _mm256_set1_epi32(low);
+        auto const highV = _mm256_set1_epi32(high);
+        auto const scaleV = _mm256_set1_epi32((int)scale);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            auto const indices = _toIndicesAvx2(p_src + x, lowV, highV, scaleV);
+            _mm256_storeu_si256((__m256i *)(p_dst + x), _mm256_i32gather_epi32((int const *)p_lut, indices, 4));
+        }
+        for (; x < width; ++x)
+        {
+            p_dst[x] = p_lut[_toIndex(p_src[x], low, high, scale)];
+        }
+    }
+#endif
+
+#ifdef COLORIZER_HAS_NEON
+    // NEON has no gather, so only the index arithmetic is vectorized
+    void _computeIndicesNeon(uint16_t const *p_src, int width, uint16_t low, uint16_t high, uint32_t scale, uint16_t *p_indices)
+    {
+        auto const lowV = vdupq_n_u16(low);
+        auto const highV = vdupq_n_u16(high);
+        auto const scaleV = vdupq_n_u32(scale);
+        int x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            auto const delta = vsubq_u16(vminq_u16(vmaxq_u16(vld1q_u16(p_src + x), lowV), highV), lowV);
+            auto const first = vshrq_n_u32(vmulq_u32(vmovl_u16(vget_low_u16(delta)), scaleV), 16);
+            auto const second = vshrq_n_u32(vmulq_u32(vmovl_u16(vget_high_u16(delta)), scaleV), 16);
+            vst1q_u16(p_indices + x, vcombine_u16(vmovn_u32(first), vmovn_u32(second)));
+        }
+        _computeIndicesScalar(p_src + x, width - x, low, high, scale, p_indices + x);
+    }
+#endif
+
+    bool _isSupported(Colorizer::Implementation implementation)
+    {
+        switch (implementation)
+        {
+        case Colorizer::Implementation::Avx2:
+#ifdef COLORIZER_HAS_AVX2
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        case Colorizer::Implementation::Neon:
+#ifdef COLORIZER_HAS_NEON
+            return true;
+#else
+            return false;
+#endif
+        case Colorizer::Implementation::Scalar:
+        default:
+            return true;
+        }
+    }
+}
+
+Colorizer::Colorizer()
+    : m_palette{0},
+      m_implementation{getBestImplementation()},
+      m_agc{},
+      mp_isotherm{nullptr},
+      m_lutTransferVersion{0},
+      m_paletteColors{},
+      m_argbLut{},
+      m_greyLut{},
+      m_indices{}
+{
+    m_agc.setVectorized(m_implementation != Implementation::Scalar);
+    _buildPalette();
+    _buildLut();
+}
+
+void Colorizer::setPalette(int colorPalette)
+{
+    if (colorPalette != m_palette)
+    {
+        m_palette = colorPalette;
+        _buildPalette();
+        _buildLut();
+    }
+}
+
+AgcEngine &Colorizer::getAgc()
+{
+    return m_agc;
+}
+
+AgcEngine const &Colorizer::getAgc() const
+{
+    return m_agc;
+}
+
+void Colorizer::colorizeArgb(uint16_t const *p_src, size_t srcStride, int width, int height, uint32_t *p_dst)
+{
+    _updateAgc(p_src, srcStride, width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        auto const *const p_row = (uint16_t const *)((uint8_t const *)p_src + y * srcStride);
+        auto *const p_dstRow = p_dst + size_t(y) * size_t(width);
+#ifdef COLORIZER_HAS_AVX2
+        if (m_implementation == Implementation::Avx2)
+        {
+            _colorizeRowAvx2(p_row, width, m_agc.getLow(), m_agc.getHigh(), m_agc.getScale(), m_argbLut.data(), p_dstRow);
+        }
+        else
+#endif
+        {
+            for (int x = 0; x < width; x += (int)m_indices.size())
+            {
+                auto const count = std::min(width - x, (int)m_indices.size());
+                _computeIndices(p_row + x, count, m_indices.data());
+                for (int i = 0; i < count; ++i)
+                {
+                    p_dstRow[x + i] = m_argbLut[m_indices[i]];
+                }
+            }
+        }
+        _applyIsotherm(p_src, srcStride, (uint8_t *)p_dst, width, height, y, 4);
+    }
+}
+
+void Colorizer::colorizeGrey(uint16_t const *p_src, size_t srcStride, int width, int height, uint8_t *p_dst)
+{
+    _updateAgc(p_src, srcStride, width, height);
+    for (int y = 0; y < height; ++y)
+    {
+        auto const *const p_row = (uint16_t const *)((uint8_t const *)p_src + y * srcStride);
+        auto *const p_dstRow = p_dst + size_t(y) * size_t(width);
+        for (int x = 0; x < width; x += (int)m_indices.size())
+        {
+            auto const count = std::min(width - x, (int)m_indices.size());
+            _computeIndices(p_row + x, count, m_indices.data());
+            for (int i = 0; i < count; ++i)
+            {
+                p_dstRow[x + i] = m_greyLut[m_indices[i]];
+            }
+        }
+        _applyIsotherm(p_src, srcStride, p_dst, width, height, y, 1);
+    }
+}
+
+void Colorizer::setIsotherm(Isotherm *p_isotherm)
+{
+    mp_isotherm = p_isotherm;
+}
+
+void Colorizer::_applyIsotherm(uint16_t const *p_src, size_t srcStride, uint8_t *p_dst, int width, int height, int lastRow, int channels)
+{
+    if (!mp_isotherm || !mp_isotherm->isEnabled() || ((lastRow + 1) % n_isothermStripRows != 0 && lastRow + 1 != height))
+    {
+        return;
+    }
+    auto const firstRow = lastRow - lastRow % n_isothermStripRows;
+    auto const dstStride = size_t(width) * size_t(channels);
+    auto *const p_dstStrip = p_dst + size_t(firstRow) * dstStride;
+    mp_isotherm->apply((uint16_t const *)((uint8_t const *)p_src + size_t(firstRow) * srcStride), srcStride,
+                       p_dstStrip, dstStride, p_dstStrip, dstStride, width, lastRow + 1 - firstRow, channels);
+    if (lastRow + 1 == height)
+    {
+        mp_isotherm->finishFrame();
+    }
+}
+
+void Colorizer::setImplementation(Implementation implementation)
+{
+    m_implementation = _isSupported(implementation) ? implementation : getBestImplementation();
+    m_agc.setVectorized(m_implementation != Implementation::Scalar);
+}
+
+Colorizer::Implementation Colorizer::getImplementation() const
+{
+    return m_implementation;
+}
+
+Colorizer::Implementation Colorizer::getBestImplementation()
+{
+    if (_isSupported(Implementation::Avx2))
+    {
+        return Implementation::Avx2;
+    }
+    if (_isSupported(Implementation::Neon))
+    {
+        return Implementation::Neon;
+    }
+    return Implementation::Scalar;
+}
+
+char const *Colorizer::getImplementationName(Implementation implementation)
+{
+    switch (implementation)
+    {
+    case Implementation::Avx2:
+        return "avx2";
+    case Implementation::Neon:
+        return "neon";
+    case Implementation::Scalar:
+    default:
+        return "scalar";
+    }
+}
+
+std::string Colorizer::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "palette=" << m_palette;
+    ss << ", agc=" << m_agc.getStatus();
+    ss << ", implementation=" << getImplementationName(m_implementation);
+    ss << "}";
+    return ss.str();
+}
+
+void Colorizer::_updateAgc(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    m_agc.update(p_src, srcStride, width, height);
+    if (m_agc.getTransferVersion() != m_lutTransferVersion)
+    {
+        _buildLut();
+    }
+}
+
+void Colorizer::_buildPalette()
+{
+    auto const points = _getPalettePoints(m_palette);
+    for (size_t i = 0; i < m_paletteColors.size(); ++i)
+    {
+        auto const position = double(i) / double(m_paletteColors.size() - 1);
+        size_t segment = 1;
+        while (segment + 1 < points.size() && points[segment].position < position)
+        {
+            ++segment;
+        }
+        auto const &from = points[segment - 1];
+        auto const &to = points[segment];
+        auto const t = std::clamp((position - from.position) / std::max(1e-9, to.position - from.position), 0.0, 1.0);
+        m_paletteColors[i] = _toBgra((uint8_t)std::lround(from.red + t * (to.red - from.red)),
+                                     (uint8_t)std::lround(from.green + t * (to.green - from.green)),
+                                     (uint8_t)std::lround(from.blue + t * (to.blue - from.blue)));
+    }
+}
+
+// compose the AGC transfer table with the palette
+void Colorizer::_buildLut()
+{
+    auto const &transfer = m_agc.getTransfer();
+    for (size_t i = 0; i < n_lutSize; ++i)
+    {
+        auto const color = m_paletteColors[transfer[i] * (m_paletteColors.size() - 1) / n_lutMax];
+        m_argbLut[i] = color;
+        m_greyLut[i] = (uint8_t)((((color >> 16) & 0xFF) * 77 + ((color >> 8) & 0xFF) * 150 + (color & 0xFF) * 29) >> 8);
+    }
+    m_lutTransferVersion = m_agc.getTransferVersion();
+}
+
+void Colorizer::_computeIndices(uint16_t const *p_src, int width, uint16_t *p_indices) const
+{
+    switch (m_implementation)
+    {
+#ifdef COLORIZER_HAS_AVX2
+    case Implementation::Avx2:
+        _computeIndicesAvx2(p_src, width, m_agc.getLow(), m_agc.getHigh(), m_agc.getScale(), p_indices);
+        break;
+#endif
+#ifdef COLORIZER_HAS_NEON
+    case Implementation::Neon:
+        _computeIndicesNeon(p_src, width, m_agc.getLow(), m_agc.getHigh(), m_agc.getScale(), p_indices);
+        break;
+#endif
+    default:
+        _computeIndicesScalar(p_src, width, m_agc.getLow(), m_agc.getHigh(), m_agc.getScale(), p_indices);
+        break;
+    }
+}
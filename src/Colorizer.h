@@ -0,0 +1,61 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "AgcEngine.h"
+
+class Isotherm;
+
+// Colorizes FIXED_10_6 thermography frames inside the daemon instead of the SDK.
+// The AgcEngine quantizes the raw values into 1024 bins and its transfer table is composed
+// with a 256 entry palette, so each pixel costs a clamp, a multiply and a single lookup.
+// The lookup uses AVX2 gathers or NEON index arithmetic when the CPU supports it.
+class Colorizer
+{
+public:
+    static constexpr size_t n_lutSize = AgcEngine::n_transferSize;
+    enum class Implementation
+    {
+        Scalar,
+        Avx2,
+        Neon
+    };
+    Colorizer();
+    // palette numbers follow seekcamera_color_palette_t, the user palettes fall back to white hot
+    void setPalette(int colorPalette);
+    // the AGC stage, its mapping is used from the next colorized frame
+    AgcEngine &getAgc();
+    AgcEngine const &getAgc() const;
+    // colorize a FIXED_10_6 frame into width*height BGRA pixels (V4L2 ARGB32 / CV_8UC4 byte order)
+    // srcStride is the distance between source rows in bytes
+    void colorizeArgb(uint16_t const *p_src, size_t srcStride, int width, int height, uint32_t *p_dst);
+    // colorize a FIXED_10_6 frame into width*height grey pixels (palette luminance)
+    void colorizeGrey(uint16_t const *p_src, size_t srcStride, int width, int height, uint8_t *p_dst);
+    // isotherm bands blended into the colorized frame in the same pass, nullptr = none
+    void setIsotherm(Isotherm *p_isotherm);
+    // select the implementation, one the CPU does not support falls back to the best supported one
+    void setImplementation(Implementation implementation);
+    Implementation getImplementation() const;
+    static Implementation getBestImplementation();
+    static char const *getImplementationName(Implementation implementation);
+    // Get a string representing the palette, AGC and implementation
+    std::string getStatus() const;
+
+private:
+    void _updateAgc(uint16_t const *p_src, size_t srcStride, int width, int height);
+    void _buildPalette();
+    void _buildLut();
+    void _computeIndices(uint16_t const *p_src, int width, uint16_t *p_indices) const;
+    // blend the isotherm into the strip of rows ending at lastRow once it is complete
+    void _applyIsotherm(uint16_t const *p_src, size_t srcStride, uint8_t *p_dst, int width, int height, int lastRow, int channels);
+    int m_palette;
+    Implementation m_implementation;
+    AgcEngine m_agc;
+    Isotherm *mp_isotherm;
+    uint64_t m_lutTransferVersion;
+    std::array<uint32_t, 256> m_paletteColors;
+    alignas(32) std::array<uint32_t, n_lutSize> m_argbLut;
+    alignas(32) std::array<uint8_t, n_lutSize> m_greyLut;
+    alignas(32) std::array<uint16_t, 4096> m_indices;
+};
@@ -1,4 +1,7 @@
 #include "EchoThermCamera.h"
+#include "Trace.h"
+#include "AsyncLog.h"
+#include "MemoryBudget.h"
 #include "seekcamera/seekcamera.h"
 #include "seekcamera/seekcamera_manager.h"
 #include <syslog.h>
@@ -6,7 +9,11 @@
 #include <linux/videodev2.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <strings.h>
+#include <algorithm>
 #include <cstring>
+#include <iomanip>
+#include <limits>
 #include <sstream>
 #include <iostream>
 #include <fstream> // Required for std::ofstream
@@ -23,6 +30,71 @@ namespace
     constexpr static inline auto const n_minZoom = 1.0;
     constexpr static inline auto const n_defaultMaxZoom = 16.0;
     constexpr static inline auto const n_frameRate = 27.0;
+    // a recording is refused unless the memory budget can hold this many queued frames
+    constexpr static inline auto const n_minRecordingQueueFrames = size_t(8);
+    constexpr static inline auto const n_radiometricFileBufferSize = size_t(64 * 1024);
+    // screenshots without an extension are written as JPEG
+    constexpr static inline auto const np_defaultScreenshotExtension = ".jpeg";
+    // a burst holds at most 10 s of frames
+    constexpr static inline auto const n_maxBurstFrames = size_t(270);
+    // a burst waits twice its duration at the nominal rate plus this margin for its frames
+    constexpr static inline auto const n_burstTimeoutMargin = std::chrono::seconds(2);
+    // the still encoders yield to the frame and recording threads, a burst is fed to them a few frames at a time
+    constexpr static inline auto const n_maxQueuedStillJobs = size_t(16);
+    constexpr static inline auto const n_stillEncoderNiceness = 5;
+    constexpr static inline auto const n_minIntervalSeconds = 1.0;
+    // rate of the primary output between the captures of a low power time-lapse
+    constexpr static inline auto const n_intervalIdleRateHz = 1.0;
+    // the full rate is restored this long before a tick, so that the frames around it are processed
+    constexpr static inline auto const n_intervalWakeLead = std::chrono::milliseconds(300);
+    // a tick waits this long for the first frame after it, and for any frame when none is published
+    constexpr static inline auto const n_intervalFrameTimeout = std::chrono::milliseconds(500);
+    constexpr static inline auto const n_intervalPollInterval = std::chrono::milliseconds(2);
+    // a radiometric screenshot waits this long for a thermography frame, e.g. after a session restart
+    constexpr static inline auto const n_thermographyFrameTimeout = std::chrono::seconds(1);
+    constexpr static inline auto const n_thermographyFramePollInterval = std::chrono::milliseconds(5);
+    // geometry of the supported cameras, the loopback device is configured for it before the camera connects
+    constexpr static inline auto const n_defaultFrameWidth = 320;
+    constexpr static inline auto const n_defaultFrameHeight = 240;
+
+    uint64_t _getUtcTimeNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // the latest frames of a time-lapse tick
+    struct IntervalFrame
+    {
+        cv::Mat image;
+        cv::Mat pixels;
+        std::vector<uint8_t> header;
+        LatestFrameBuffer::Info info;
+    };
+
+    // read the latest output and/or thermography frame, info is the one of the thermography frame when read
+    // both are published by the same frame callback, a read between the two is retried once
+    bool _readLatestFrames(LatestFrameBuffer const &outputFrame, LatestFrameBuffer const &thermographyFrame, bool image, bool radiometric,
+                           IntervalFrame *p_frame)
+    {
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            LatestFrameBuffer::Info imageInfo{};
+            if ((image && !outputFrame.read(p_frame->image, nullptr, &imageInfo)) ||
+                (radiometric && !thermographyFrame.read(p_frame->pixels, &p_frame->header, &p_frame->info)))
+            {
+                return false;
+            }
+            if (!radiometric)
+            {
+                p_frame->info = imageInfo;
+            }
+            if (!image || !radiometric || imageInfo.timestampUtcNs == p_frame->info.timestampUtcNs)
+            {
+                break;
+            }
+        }
+        return true;
+    }
 }
 
 std::string getHomePath()
@@ -78,8 +150,6 @@ EchoThermCamera::EchoThermCamera()
       m_chipId{},
       m_frameFormat{int(SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888)},
       m_radiometricFrameFormat{int(SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6)},
-      m_radiometricFrameCapture{0},
-      m_radiometricFrameCaptureBusy{0},
       m_colorPalette{int(SEEKCAMERA_COLOR_PALETTE_WHITE_HOT)},
       m_shutterMode{int(SEEKCAMERA_SHUTTER_MODE_AUTO)},
       m_sharpenFilterMode{int(SEEKCAMERA_FILTER_STATE_DISABLED)},
@@ -99,16 +169,42 @@ EchoThermCamera::EchoThermCamera()
       m_currentZoom{n_minZoom},
       m_maxZoom{n_defaultMaxZoom},
       m_lastZoomTime{},
+      m_panX{0.0},
+      m_panY{0.0},
+      m_panRateX{0.0},
+      m_panRateY{0.0},
+      m_roiOriginX{0.0},
+      m_roiOriginY{0.0},
+      m_requestedOutputWidth{0},
+      m_requestedOutputHeight{0},
+      m_outputInterpolation{cv::INTER_LINEAR},
+      m_outputWidth{0},
+      m_outputHeight{0},
+      m_contentX{0},
+      m_contentY{0},
+      m_contentWidth{0},
+      m_contentHeight{0},
+      m_lastPanTime{},
       m_mut{},
       m_shutterClickThread{},
       m_shutterClickCondition{},
       m_shutterClickThreadRunning{false},
-      m_screenshotFilePath{},
-      m_radiometricSreenshotFilePath{},
       m_videoFilePath{},
-      m_screenshotStatus{},
-      m_screenshotStatusReadyMut{},
-      m_screenshotStatusReadyCondition{},
+      m_latestOutputFrame{},
+      m_latestThermographyFrame{},
+      mp_burstCapture{nullptr},
+      m_burstThread{},
+      m_burstMut{},
+      m_burstRunning{false},
+      m_burstStatus{"No burst was taken"},
+      m_workerPool{{0, n_maxQueuedStillJobs, n_stillEncoderNiceness}},
+      mp_intervalCapture{},
+      m_intervalMut{},
+      m_intervalCondition{},
+      m_intervalThread{},
+      m_intervalThreadRunning{false},
+      m_intervalIdle{false},
+      m_intervalIdleDecimator{},
       m_recordingStatus{},
       m_recordingStatusReadyMut{},
       m_recordingStatusReadyCondition{},
@@ -117,46 +213,67 @@ EchoThermCamera::EchoThermCamera()
       m_recordingFramesReadyCondition{},
       m_recordingThread{},
       m_recordingThreadRunning{false},
-      mp_videoWriter{}
+      mp_videoWriter{},
+      m_recordingFramesWanted{false},
+      m_segmentSeconds{0.0},
+      m_segmentMegabytes{0.0},
+      mp_recordingCodec{nullptr},
+      m_recordingThreads{0},
+      m_preRollBuffer{},
+      m_frameCaptureTimeNs{0},
+      m_frameFpaCount{0},
+      m_lastRecordingFrameNs{0},
+      m_triggerStopTimeNs{0},
+      m_recordingStopRequested{false},
+      mp_zoomFrame{std::make_unique<cv::Mat>()},
+      mp_colorFrame{std::make_unique<cv::Mat>()},
+      mp_radiometricRecorder{},
+      m_radiometricCompressionThreads{0},
+      m_frameTimingMonitor{},
+      m_isotherm{},
+      m_colorizer{},
+      m_colorizerEnabled{false},
+      m_temporalFilter{},
+      m_overlay{},
+      m_hotspotDetector{},
+      m_outputs{},
+      m_colorStages{},
+      m_outputFrameNum{0}
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::EchoThermCamera()");
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::EchoThermCamera()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::EchoThermCamera");
+    m_colorizer.setIsotherm(&m_isotherm);
 }
 
 EchoThermCamera::~EchoThermCamera()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::~EchoThermCamera()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::~EchoThermCamera");
+    stopInterval();
     stop();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::~EchoThermCamera()");
-#endif
+    // without frames a running burst times out, then writes what it captured
+    if (m_burstThread.joinable())
+    {
+        m_burstThread.join();
+    }
+    MemoryBudget::release(MemoryBudget::Category::FramePool, mp_zoomFrame->total() * mp_zoomFrame->elemSize());
+    MemoryBudget::release(MemoryBudget::Category::FramePool, mp_colorFrame->total() * mp_colorFrame->elemSize());
 }
 
 void EchoThermCamera::setLoopbackDeviceName(std::string loopbackDeviceName)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setLoopbackDeviceName(%s)", loopbackDeviceName.c_str());
-#endif
+    TRACE_SCOPE("EchoThermCamera::setLoopbackDeviceName");
     if (loopbackDeviceName != m_loopbackDeviceName)
     {
         m_loopbackDeviceName = std::move(loopbackDeviceName);
+        // reopened with the next frame
+        _closeDevice();
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setLoopbackDeviceName(%s)", loopbackDeviceName.c_str());
-#endif
 }
 
 void EchoThermCamera::setFrameFormat(int frameFormat)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setFrameFormat(%d)", frameFormat);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setFrameFormat");
     if (frameFormat != m_frameFormat)
     {
         switch (frameFormat)
@@ -165,6 +282,8 @@ void EchoThermCamera::setFrameFormat(int frameFormat)
         case SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888:
         case SEEKCAMERA_FRAME_FORMAT_GRAYSCALE:
             m_frameFormat = frameFormat;
+            // the loopback pixel format changes, it is reopened with the next frame
+            _closeDevice();
             break;
         // TODO support these as well as bit-wise ORed frame formats
         case SEEKCAMERA_FRAME_FORMAT_COLOR_RGB565:
@@ -179,17 +298,12 @@ void EchoThermCamera::setFrameFormat(int frameFormat)
             break;
         }
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setFrameFormat(%d)", frameFormat);
-#endif
 }
 
 void EchoThermCamera::setRadiometricFrameFormat(int radiometricFrameFormat)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setRadiometricFrameFormat(%d)", radiometricFrameFormat);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setRadiometricFrameFormat");
     if (radiometricFrameFormat != m_radiometricFrameFormat)
     {
         switch (radiometricFrameFormat)
@@ -203,17 +317,12 @@ void EchoThermCamera::setRadiometricFrameFormat(int radiometricFrameFormat)
             break;
         }
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setRadiometricFormat(%d)", radiometricFrameFormat);
-#endif
 }
 
 void EchoThermCamera::setColorPalette(int colorPalette)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setColorPalette(%d)", colorPalette);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setColorPalette");
     if (colorPalette != m_colorPalette)
     {
         std::string colorPaletteName;
@@ -235,6 +344,7 @@ void EchoThermCamera::setColorPalette(int colorPalette)
         case SEEKCAMERA_COLOR_PALETTE_USER_4:
         {
             m_colorPalette = colorPalette;
+            m_colorizer.setPalette(m_colorPalette);
             auto result = SEEKCAMERA_SUCCESS;
             if (mp_camera)
             {
@@ -257,17 +367,12 @@ void EchoThermCamera::setColorPalette(int colorPalette)
         }
         }
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setColorPalette(%d)", colorPalette);
-#endif
 }
 
 void EchoThermCamera::setShutterMode(int shutterMode)
 {
     std::unique_lock<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setShutterMode(%d)", shutterMode);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setShutterMode");
     if (m_shutterMode != shutterMode)
     {
         auto const newShutterMode = m_shutterMode = shutterMode;
@@ -314,16 +419,11 @@ void EchoThermCamera::setShutterMode(int shutterMode)
             }
         }
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setShutterMode(%d)", shutterMode);
-#endif
 }
 
 void EchoThermCamera::_updateFilterHelper(int filterType, int filterState)
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_updateFilterHelper(%d, %d)", filterType, filterState);
-#endif
+    TRACE_SCOPE("EchoThermCamera::_updateFilterHelper");
     auto result = SEEKCAMERA_SUCCESS;
     if (mp_camera)
     {
@@ -337,17 +437,12 @@ void EchoThermCamera::_updateFilterHelper(int filterType, int filterState)
     {
         syslog(LOG_ERR, "Failed to update filter state to %s: %s.", seekcamera_get_filter_state_str((seekcamera_filter_t)filterType, (seekcamera_filter_state_t)filterState), seekcamera_error_get_str(result));
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_updateFilterHelper(%d, %d)", filterType, filterState);
-#endif
 }
 
 void EchoThermCamera::setSharpenFilter(int sharpenFilterMode)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setSharpenFilter(%d)", sharpenFilterMode);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setSharpenFilter");
     if (m_sharpenFilterMode != sharpenFilterMode)
     {
         if (sharpenFilterMode != (int)SEEKCAMERA_FILTER_STATE_DISABLED)
@@ -357,17 +452,12 @@ void EchoThermCamera::setSharpenFilter(int sharpenFilterMode)
         m_sharpenFilterMode = sharpenFilterMode;
         _updateFilterHelper(SEEKCAMERA_FILTER_SHARPEN_CORRECTION, m_sharpenFilterMode);
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setSharpenFilter(%d)", sharpenFilterMode);
-#endif
 }
 
 void EchoThermCamera::setFlatSceneFilter(int flatSceneFilterMode)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setFlatSceneFilter(%d)", flatSceneFilterMode);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setFlatSceneFilter");
     if (m_flatSceneFilterMode != flatSceneFilterMode)
     {
         if (flatSceneFilterMode != (int)SEEKCAMERA_FILTER_STATE_DISABLED)
@@ -377,17 +467,12 @@ void EchoThermCamera::setFlatSceneFilter(int flatSceneFilterMode)
         m_flatSceneFilterMode = flatSceneFilterMode;
         _updateFilterHelper(SEEKCAMERA_FILTER_FLAT_SCENE_CORRECTION, m_flatSceneFilterMode);
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setFlatSceneFilter(%d)", flatSceneFilterMode);
-#endif
 }
 
 void EchoThermCamera::setGradientFilter(int gradientFilterMode)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setGradientFilter(%d)", gradientFilterMode);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setGradientFilter");
     if (m_gradientFilterMode != gradientFilterMode)
     {
         if (gradientFilterMode != (int)SEEKCAMERA_FILTER_STATE_DISABLED)
@@ -397,17 +482,12 @@ void EchoThermCamera::setGradientFilter(int gradientFilterMode)
         m_gradientFilterMode = gradientFilterMode;
         _updateFilterHelper(SEEKCAMERA_FILTER_GRADIENT_CORRECTION, m_gradientFilterMode);
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setGradientFilter(%d)", gradientFilterMode);
-#endif
 }
 
 void EchoThermCamera::setPipelineMode(int pipelineMode)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setPipelineMode(%d)", pipelineMode);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setPipelineMode");
     if (m_pipelineMode != pipelineMode)
     {
         switch (pipelineMode)
@@ -493,17 +573,12 @@ void EchoThermCamera::setPipelineMode(int pipelineMode)
         }
         }
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setPipelineMode(%d)", pipelineMode);
-#endif
 }
 
 void EchoThermCamera::triggerShutter()
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::triggerShutter()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::triggerShutter");
     if (mp_camera)
     {
         auto const result = seekcamera_shutter_trigger((seekcamera_t *)mp_camera);
@@ -520,20 +595,20 @@ void EchoThermCamera::triggerShutter()
     {
         syslog(LOG_ERR, "Cannot trigger shutter because no capture session is active.");
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::triggerShutter()");
-#endif
 }
 
 bool EchoThermCamera::start()
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::start()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::start");
 
     stop();
     bool returnVal = true;
+    m_frameTimingMonitor.markStart(_getUtcTimeNs());
+    // open and configure the loopback device before the camera connects so that consumers can attach
+    // right away and the first frame is written without paying for the device setup
+    _openDevice(n_defaultFrameWidth, n_defaultFrameHeight);
+    _getZoomFrame(m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? CV_8U : CV_8UC4);
     auto status = seekcamera_manager_create((seekcamera_manager_t **)&mp_cameraManager, SEEKCAMERA_IO_TYPE_USB);
     if (status == SEEKCAMERA_SUCCESS)
     {
@@ -560,6 +635,10 @@ bool EchoThermCamera::start()
                                                                         break;
                                                                     case SEEKCAMERA_MANAGER_EVENT_DISCONNECT:
                                                                         syslog(LOG_INFO, "Disconnect: (CID: %s) %s.", chipId.c_str(), seekcamera_error_get_str(eventStatus));
+                                                                        {
+                                                                            std::lock_guard<decltype(p_this->m_mut)> lock{p_this->m_mut};
+                                                                            p_this->m_frameTimingMonitor.markDisconnect(_getUtcTimeNs());
+                                                                        }
                                                                         p_this->_closeSession();
                                                                         break;
                                                                     case SEEKCAMERA_MANAGER_EVENT_ERROR:
@@ -592,18 +671,13 @@ bool EchoThermCamera::start()
         syslog(LOG_ERR, "Failed to create camera manager: %s.", seekcamera_error_get_str(status));
     }
 
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::start()");
-#endif
     return returnVal;
 }
 
 void EchoThermCamera::stop()
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::stop()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::stop");
     _closeSession();
     if (mp_cameraManager)
     {
@@ -611,17 +685,13 @@ void EchoThermCamera::stop()
         mp_cameraManager = nullptr;
     }
     m_chipId.clear();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::stop()");
-#endif
+    _closeDevice();
 }
 
 std::string EchoThermCamera::getStatus() const
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::getStatus()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::getStatus");
     std::string statusStr;
     if (mp_camera && seekcamera_is_active((seekcamera_t *)mp_camera))
     {
@@ -631,18 +701,13 @@ std::string EchoThermCamera::getStatus() const
     {
         statusStr = "waiting for echotherm camera";
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::getStatus() with %s", statusStr.c_str());
-#endif
     return statusStr;
 }
 
 std::string EchoThermCamera::getZoom() const
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::getZoomRate()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::getZoom");
     std::stringstream ss;
     ss << "{";
     ss << "zoom=" << m_currentZoom;
@@ -650,36 +715,102 @@ std::string EchoThermCamera::getZoom() const
     ss << ", maxZoom=" << m_maxZoom;
     ss << ", roiSize={" << m_roiWidth << ", " << m_roiHeight << "}";
     ss << ", roiOffset={" << m_roiX << ", " << m_roiY << "}";
+    ss << ", pan={" << m_panX << ", " << m_panY << "}";
+    ss << ", panRate={" << m_panRateX << ", " << m_panRateY << "}";
+    ss << ", roiOrigin={" << m_roiOriginX << ", " << m_roiOriginY << "}";
     ss << "}";
     std::string zoomStatus = ss.str();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::getZoomRate() with %s", zoomStatus.c_str());
-#endif
     return zoomStatus;
 }
 
+std::string EchoThermCamera::setOutputRate(double rateHz, int decimation)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setOutputRate");
+    if (!std::isfinite(rateHz) || rateHz < 0.0 || decimation < 1)
+    {
+        return "Invalid output rate " + std::to_string(rateHz) + " Hz, decimation " + std::to_string(decimation);
+    }
+    if (mp_videoWriter && mp_videoWriter->isOpened())
+    {
+        // the frame rate of the recording is set when it starts
+        return "Unable to change the output rate while recording to " + m_videoFilePath.string();
+    }
+    m_frameDecimator.setDecimation(decimation);
+    m_frameDecimator.setRate(rateHz);
+    syslog(LOG_NOTICE, "Output rate set to %f Hz, decimation %d.", rateHz, decimation);
+    return "Output rate set to " + m_frameDecimator.getStatus();
+}
+
+std::string EchoThermCamera::getOutputRate() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getOutputRate");
+    return m_frameDecimator.getStatus();
+}
+
+std::string EchoThermCamera::setOutputGeometry(int width, int height, int interpolation)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setOutputGeometry");
+    if (width < 0 || height < 0 || (width == 0) != (height == 0))
+    {
+        return "Invalid output geometry " + std::to_string(width) + "x" + std::to_string(height);
+    }
+    if (interpolation != cv::INTER_NEAREST && interpolation != cv::INTER_LINEAR && interpolation != cv::INTER_CUBIC)
+    {
+        return "Invalid output interpolation " + std::to_string(interpolation);
+    }
+    auto const geometryChanged = width != m_requestedOutputWidth || height != m_requestedOutputHeight;
+    if (geometryChanged && mp_videoWriter && mp_videoWriter->isOpened())
+    {
+        return "Unable to change the output geometry while recording to " + m_videoFilePath.string();
+    }
+    m_outputInterpolation = interpolation;
+    if (geometryChanged)
+    {
+        m_requestedOutputWidth = width;
+        m_requestedOutputHeight = height;
+        if (m_loopbackDevice >= 0)
+        {
+            // consumers have to renegotiate the format
+            _closeDevice();
+            _openDevice(m_width, m_height);
+        }
+    }
+    syslog(LOG_NOTICE, "Output geometry set to %dx%d, interpolation %d.", width, height, interpolation);
+    return "Output geometry set to " + std::to_string(width) + "x" + std::to_string(height);
+}
+
+std::string EchoThermCamera::getOutputGeometry() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getOutputGeometry");
+    std::stringstream ss;
+    ss << "{";
+    ss << "sensor={" << m_width << ", " << m_height << "}";
+    ss << ", output={" << m_outputWidth << ", " << m_outputHeight << "}";
+    ss << ", content={" << m_contentX << ", " << m_contentY << ", " << m_contentWidth << ", " << m_contentHeight << "}";
+    ss << ", interpolation=" << (m_outputInterpolation == cv::INTER_NEAREST ? "nearest" : m_outputInterpolation == cv::INTER_CUBIC ? "cubic" : "linear");
+    ss << "}";
+    return ss.str();
+}
+
 void EchoThermCamera::setZoomRate(double zoomRate)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setZoomRate(%f)", zoomRate);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setZoomRate");
     if (zoomRate != zoomRate)
     {
         zoomRate = 0;
     }
     m_zoomRate = zoomRate;
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setZoomRate(%f)", zoomRate);
-#endif
 }
 
 void EchoThermCamera::setMaxZoom(double maxZoom)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setMaxZoom(%f)", maxZoom);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setMaxZoom");
     if (maxZoom != maxZoom || maxZoom < n_minZoom)
     {
         maxZoom = n_defaultMaxZoom;
@@ -691,35 +822,27 @@ void EchoThermCamera::setMaxZoom(double maxZoom)
         m_zoomRate = 0;
         m_roiWidth = std::min<int>(m_width, std::max<int>(1, (int)std::rint(m_width / m_currentZoom)));
         m_roiHeight = std::min<int>(m_height, std::max<int>(1, (int)std::rint(m_height / m_currentZoom)));
-        m_roiX = (m_width - m_roiWidth) >> 1;
-        m_roiY = (m_height - m_roiHeight) >> 1;
         if (m_roiWidth >= m_width || m_roiHeight >= m_height || m_currentZoom <= n_minZoom)
         {
             m_currentZoom = n_minZoom;
             m_roiWidth = m_width;
             m_roiHeight = m_height;
-            m_roiX = 0;
-            m_roiY = 0;
         }
         else if (m_roiWidth <= 1 || m_roiHeight <= 1 || m_currentZoom >= m_maxZoom)
         {
             m_currentZoom = m_maxZoom;
         }
+        _computeRoi();
 #ifdef DEBUG
         syslog(LOG_DEBUG, "setMaxZoom m_currentZoom=%f, m_zoomRate=%f, m_roiWidth=%d, m_roiHeight=%d, m_roiX=%d, m_roiY=%d", m_currentZoom, m_zoomRate, m_roiWidth, m_roiHeight, m_roiX, m_roiY);
 #endif
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setMaxZoom(%f)", maxZoom);
-#endif
 }
 
 void EchoThermCamera::setZoom(double zoom)
 {
     std::lock_guard<decltype(m_mut)> lock{m_mut};
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::setZoom(%f)", zoom);
-#endif
+    TRACE_SCOPE("EchoThermCamera::setZoom");
     if (zoom != zoom || zoom < n_minZoom)
     {
         zoom = n_minZoom;
@@ -732,217 +855,1171 @@ void EchoThermCamera::setZoom(double zoom)
     m_zoomRate = 0;
     m_roiWidth = std::min<int>(m_width, std::max<int>(1, (int)std::rint(m_width / m_currentZoom)));
     m_roiHeight = std::min<int>(m_height, std::max<int>(1, (int)std::rint(m_height / m_currentZoom)));
-    m_roiX = (m_width - m_roiWidth) >> 1;
-    m_roiY = (m_height - m_roiHeight) >> 1;
     if (m_roiWidth >= m_width || m_roiHeight >= m_height || m_currentZoom <= n_minZoom)
     {
         m_currentZoom = n_minZoom;
         m_roiWidth = m_width;
         m_roiHeight = m_height;
-        m_roiX = 0;
-        m_roiY = 0;
     }
     else if (m_roiWidth <= 1 || m_roiHeight <= 1 || m_currentZoom >= m_maxZoom)
     {
         m_currentZoom = m_maxZoom;
     }
+    _computeRoi();
 #ifdef DEBUG
     syslog(LOG_DEBUG, "setZoom m_currentZoom=%f, m_zoomRate=%f, m_roiWidth=%d, m_roiHeight=%d, m_roiX=%d, m_roiY=%d", m_currentZoom, m_zoomRate, m_roiWidth, m_roiHeight, m_roiX, m_roiY);
 #endif
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::setZoom(%f)", zoom);
-#endif
 }
 
-std::string EchoThermCamera::startRecording(std::filesystem::path const &filePath)
+void EchoThermCamera::setPan(double x, double y)
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::startRecording(%s)", filePath.string().c_str());
-#endif
-    std::string status;
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setPan");
+    if (x != x || y != y)
+    {
+        x = m_width / 2.0;
+        y = m_height / 2.0;
+    }
+    m_panX = x;
+    m_panY = y;
+    m_panRateX = 0;
+    m_panRateY = 0;
+    _computeRoi();
+}
 
-    if( !has_rw_access( filePath )){
-        status = "Unable to startRecorder: " + filePath.string() + " RW access not allowed, verify path";
-        syslog(LOG_ERR, "%s" , status.c_str() );
-        return status ;
+void EchoThermCamera::centerPan()
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    setPan(m_width / 2.0, m_height / 2.0);
+}
+
+void EchoThermCamera::setPanRate(double xRate, double yRate)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setPanRate");
+    if (xRate != xRate)
+    {
+        xRate = 0;
     }
-   
-    if (mp_videoWriter && mp_videoWriter->isOpened())
+    if (yRate != yRate)
     {
-        status = "Already recording to video file " + m_videoFilePath.string();
+        yRate = 0;
     }
-    else
+    m_panRateX = xRate;
+    m_panRateY = yRate;
+}
+
+void EchoThermCamera::setColorizer(bool enabled)
+{
+    TRACE_SCOPE("EchoThermCamera::setColorizer");
+    bool restart = false;
     {
-        if (!m_recordingStatus.empty())
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (enabled == m_colorizerEnabled)
         {
-            status = "Previous recording session stopped unexpectedly: " + m_recordingStatus + "; ";
-            m_recordingStatus.clear();
+            return;
         }
-        {
-            auto extension = filePath.extension().string();
-            std::transform(std::begin(extension), std::end(extension), std::begin(extension), [](auto const c)
-                        { return (char)std::tolower(c); });
-            if (extension == ".mp4" || filePath=="/dev/null")
-            {
-                std::unique_lock<std::mutex> recordingLock(m_recordingFrameQueueMut);
-                m_recordingFrameQueue.clear();
-                m_videoFilePath = filePath;
-                auto const fourcc = cv::VideoWriter::fourcc('m', 'p', '4', 'v');
-
-                double fps = n_frameRate; // 27 fps assumed
-                try
-                {
-                    mp_videoWriter = std::make_unique<cv::VideoWriter>(m_videoFilePath.string(), fourcc, fps, cv::Size(m_width, m_height), m_frameFormat != SEEKCAMERA_FRAME_FORMAT_GRAYSCALE);
-                    if ( mp_videoWriter->isOpened() || m_videoFilePath=="/dev/null" )
-                    {
-                        status += "Video file " + m_videoFilePath.string() + " opened for writing";
-                    }
-                    else
-                    {
-                        status += "Failed to open video file " + m_videoFilePath.string() + " for writing";
-                        syslog( LOG_INFO, "%s" ,status.c_str() );
-                        syslog( LOG_INFO, "File: %s" ,std::filesystem::absolute(m_videoFilePath).c_str() );
-                        syslog( LOG_INFO, "OpenCV version: %s" , CV_VERSION);
-                    }
-                }
-                catch (cv::Exception const &e)
-                {
-                    status += "Failed to open file " + m_videoFilePath.string() + " opened for writing : " + e.msg + "\n" + e.what();
-                }
-                recordingLock.unlock();
-                m_recordingFramesReadyCondition.notify_one();
-            }
-            else
-            {
-                status += "Video file extension must be '.mp4'";
-            }
-        } 
+        m_colorizerEnabled = enabled;
+        _reserveFrameBuffers();
+        syslog(LOG_NOTICE, "Colorization is now done by %s (%s).", m_colorizerEnabled ? "echothermd" : "the camera SDK",
+               Colorizer::getImplementationName(m_colorizer.getImplementation()));
+        // the SDK has to deliver the thermography frame instead of the color frame
+        restart = mp_camera != nullptr;
+    }
+    // not locked, stopping the session waits for the frame callback which takes the lock
+    if (restart)
+    {
+        _restartCaptureSession();
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::startRecording(%s) with %s", filePath.string().c_str(), status.c_str());
-#endif
-    return status;
 }
 
-std::string EchoThermCamera::takeScreenshot(std::filesystem::path const &filePath)
+void EchoThermCamera::setAgcLinear()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::takeScreenshot(%s)", filePath.string().c_str());
-#endif
-    std::string status;
-    if( !has_rw_access( filePath )){
-        status = "Unable to take screenshot to: " + filePath.string() + " RW access not allowed! verify path";
-        syslog(LOG_ERR, "%s" , status.c_str() );
-        return status ;
-    }
-    // set the path so that the next frame will see the path and write it
-    // then wait for the status to update
-    // when screenshot gets set to a path it will automatically capture and clear path
-    m_screenshotFilePath = filePath;
-    std::unique_lock<std::mutex> screenshotStatusLock(m_screenshotStatusReadyMut);
-    m_screenshotStatusReadyCondition.wait(screenshotStatusLock, [this]()
-                                          { return !m_screenshotStatus.empty() || !m_recordingThreadRunning; });
-    if (m_screenshotStatus.empty())
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setAgcLinear");
+    m_colorizer.getAgc().setLinear();
+}
+
+void EchoThermCamera::setAgcLinear(double minTemperature, double maxTemperature)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setAgcLinear");
+    m_colorizer.getAgc().setLinear(minTemperature, maxTemperature);
+}
+
+void EchoThermCamera::lockAgc()
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::lockAgc");
+    m_colorizer.getAgc().lock();
+}
+
+void EchoThermCamera::setAgcHistEq(double plateau)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setAgcHistEq");
+    m_colorizer.getAgc().setHistEq(plateau);
+}
+
+void EchoThermCamera::setAgcWindow(double centerTemperature, double widthTemperature)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setAgcWindow");
+    m_colorizer.getAgc().setWindow(centerTemperature, widthTemperature);
+}
+
+std::string EchoThermCamera::getAgcStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getAgcStatus");
+    return m_colorizer.getAgc().getStatus();
+}
+
+std::string EchoThermCamera::getColorizerStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getColorizerStatus");
+    std::string colorizerStatus = m_colorizer.getStatus();
+    colorizerStatus.insert(1, std::string("enabled=") + (m_colorizerEnabled ? "true" : "false") + ", ");
+    return colorizerStatus;
+}
+
+void EchoThermCamera::setDenoise(double strength)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setDenoise");
+    m_temporalFilter.setStrength(strength);
+    _reserveFrameBuffers();
+    syslog(LOG_NOTICE, "Temporal noise reduction strength %.3f.", m_temporalFilter.getStrength());
+}
+
+std::string EchoThermCamera::getDenoiseStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getDenoiseStatus");
+    return m_temporalFilter.getStatus();
+}
+
+void EchoThermCamera::setIsotherm(std::vector<Isotherm::Band> const &bands)
+{
+    TRACE_SCOPE("EchoThermCamera::setIsotherm");
+    bool restart = false;
     {
-        status = "Failed to take screenshot on file path " + filePath.string() + " because the screenshot thread was stopped";
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        m_isotherm.setBands(bands);
+        _reserveFrameBuffers();
+        restart = mp_camera && _getActiveFrameFormat() != m_activeFrameFormat;
     }
-    else
+    // only when the SDK does not deliver the thermography frame yet, changing the bands never restarts
+    // not locked, stopping the session waits for the frame callback which takes the lock
+    if (restart)
     {
-        status = std::move(m_screenshotStatus);
-        m_screenshotStatus.clear();
+        _restartCaptureSession();
     }
-    screenshotStatusLock.unlock();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::takeScreenshot(%s) with %s", filePath.string().c_str(), status.c_str());
-#endif
-    return status;
+    syslog(LOG_NOTICE, "Isotherm set to %zu bands.", bands.size());
 }
 
-std::string EchoThermCamera::takeRadiometricScreenshot(std::filesystem::path const &filePath)
+std::string EchoThermCamera::getIsothermStatus() const
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::takeRadiometricSreenshot(%s)", filePath.string().c_str());
-#endif
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getIsothermStatus");
+    return m_isotherm.getStatus();
+}
 
-    std::string status;
-    if (filePath.empty())
+void EchoThermCamera::setOverlay(int overlayItems)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setOverlay");
+    m_overlay.setItems(overlayItems);
+}
+
+std::string EchoThermCamera::getOverlayStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getOverlayStatus");
+    return m_overlay.getStatus();
+}
+
+void EchoThermCamera::startHotspotDetection(double thresholdTemperature, int minArea, HotspotDetector::EventCallback eventCallback)
+{
+    TRACE_SCOPE("EchoThermCamera::startHotspotDetection");
+    bool restart = false;
     {
-        syslog(LOG_WARNING, "Radiometric using default filename: /[Home]/Radiometric_[UTC].csv");
-        m_radiometricScreenshotFilePath.clear();
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        m_hotspotDetector.start(thresholdTemperature, minArea, std::move(eventCallback));
+        restart = mp_camera && _getActiveFrameFormat() != m_activeFrameFormat;
     }
-    else
+    // the SDK has to deliver the thermography frame
+    // not locked, stopping the session waits for the frame callback which takes the lock
+    if (restart)
     {
-        m_radiometricScreenshotFilePath = filePath;
+        _restartCaptureSession();
     }
-    switch (m_radiometricFrameFormat)
+    syslog(LOG_NOTICE, "Hotspot detection started above %.1f C, minimum area %d pixels.", thresholdTemperature, minArea);
+}
+
+void EchoThermCamera::stopHotspotDetection()
+{
+    TRACE_SCOPE("EchoThermCamera::stopHotspotDetection");
+    bool restart = false;
     {
-    case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT:
-    case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6:
-        break;
-    default:
-        m_radiometricFrameFormat = SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6;
-        syslog(LOG_INFO, "The radiometric format was invalid, defaulting to format %d.", m_radiometricFrameFormat);
-        break;
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        m_hotspotDetector.stop();
+        restart = mp_camera && _getActiveFrameFormat() != m_activeFrameFormat;
+    }
+    if (restart)
+    {
+        _restartCaptureSession();
+    }
+    syslog(LOG_NOTICE, "Hotspot detection stopped.");
+}
+
+std::string EchoThermCamera::getHotspotStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getHotspotStatus");
+    return m_hotspotDetector.getStatus();
+}
+
+std::string EchoThermCamera::setOutput(std::string const &profileStr)
+{
+    TRACE_SCOPE("EchoThermCamera::setOutput");
+    LoopbackOutput::Profile profile;
+    if (auto const errorStr = LoopbackOutput::parseProfile(profileStr, &profile); !errorStr.empty())
+    {
+        return "Could not set output: " + errorStr;
+    }
+    bool restart = false;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (profile.deviceName == m_loopbackDeviceName)
+        {
+            return "Could not set output " + profile.name + " because " + profile.deviceName + " is the primary loopback device";
+        }
+        for (auto const &p_output : m_outputs)
+        {
+            if (p_output->getProfile().name != profile.name && p_output->getProfile().deviceName == profile.deviceName)
+            {
+                return "Could not set output " + profile.name + " because " + profile.deviceName + " is used by output " + p_output->getProfile().name;
+            }
+        }
+        auto it = std::find_if(std::begin(m_outputs), std::end(m_outputs), [&profile](auto const &p_output)
+                               { return p_output->getProfile().name == profile.name; });
+        if (it != std::end(m_outputs))
+        {
+            *it = std::make_unique<LoopbackOutput>(profile);
+        }
+        else
+        {
+            m_outputs.push_back(std::make_unique<LoopbackOutput>(profile));
+        }
+        _updateColorStages();
+        _reserveFrameBuffers();
+        restart = mp_camera && _getActiveFrameFormat() != m_activeFrameFormat;
+    }
+    // not locked, stopping the session waits for the frame callback which takes the lock
+    if (restart)
+    {
+        _restartCaptureSession();
+    }
+    syslog(LOG_NOTICE, "Output %s set to %s.", profile.name.c_str(), profileStr.c_str());
+    return "Output " + profile.name + " set";
+}
+
+std::string EchoThermCamera::removeOutput(std::string const &name)
+{
+    TRACE_SCOPE("EchoThermCamera::removeOutput");
+    bool restart = false;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        auto it = std::find_if(std::begin(m_outputs), std::end(m_outputs), [&name](auto const &p_output)
+                               { return p_output->getProfile().name == name; });
+        if (it == std::end(m_outputs))
+        {
+            return "Could not remove output " + name + " because it does not exist";
+        }
+        m_outputs.erase(it);
+        _updateColorStages();
+        restart = mp_camera && _getActiveFrameFormat() != m_activeFrameFormat;
+    }
+    if (restart)
+    {
+        _restartCaptureSession();
+    }
+    syslog(LOG_NOTICE, "Output %s removed.", name.c_str());
+    return "Output " + name + " removed";
+}
+
+std::string EchoThermCamera::getOutputs() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getOutputs");
+    std::stringstream ss;
+    ss << "{primary=" << m_loopbackDeviceName;
+    ss << ", outputs=[";
+    for (size_t i = 0; i < m_outputs.size(); ++i)
+    {
+        ss << (i == 0 ? "" : ", ") << m_outputs[i]->getStats();
+    }
+    ss << "], colorStages=[";
+    for (size_t i = 0; i < m_colorStages.size(); ++i)
+    {
+        ss << (i == 0 ? "" : ", ") << m_colorStages[i]->getStats();
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+std::string EchoThermCamera::getFrameStats() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::getFrameStats");
+    std::string frameStats = m_frameTimingMonitor.getStats();
+    // include the frame path logger so dropped or coalesced messages are visible
+    frameStats.insert(frameStats.size() - 1, ", log=" + AsyncLog::getStatus());
+    return frameStats;
+}
+
+void EchoThermCamera::setFrameStatsAlarm(double thresholdMs)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setFrameStatsAlarm");
+    m_frameTimingMonitor.setAlarmThreshold(thresholdMs);
+    syslog(LOG_NOTICE, "Frame stall alarm threshold set to %.1f ms.", m_frameTimingMonitor.getAlarmThreshold());
+}
+
+std::string EchoThermCamera::startRecording(std::filesystem::path const &filePath)
+{
+    TRACE_SCOPE("EchoThermCamera::startRecording");
+    std::string status;
+
+    if( !has_rw_access( filePath )){
+        status = "Unable to startRecorder: " + filePath.string() + " RW access not allowed, verify path";
+        syslog(LOG_ERR, "%s" , status.c_str() );
+        return status ;
+    }
+   
+    if (mp_videoWriter && mp_videoWriter->isOpened())
+    {
+        status = "Already recording to video file " + m_videoFilePath.string();
+    }
+    else
+    {
+        if (!m_recordingStatus.empty())
+        {
+            status = "Previous recording session stopped unexpectedly: " + m_recordingStatus + "; ";
+            m_recordingStatus.clear();
+        }
+        int outputWidth = 0;
+        int outputHeight = 0;
+        int frameFormat = 0;
+        double fps = 0.0;
+        {
+            // the frame callback updates the decimator and the timing monitor under m_mut,
+            // setOutputGeometry and _openDevice the output geometry
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            outputWidth = m_outputWidth;
+            outputHeight = m_outputHeight;
+            frameFormat = m_frameFormat;
+            // the rate of the written frames from the measured capture timestamps, 27 fps until frames arrived
+            fps = m_frameDecimator.getOutputRate(m_frameTimingMonitor.getMeanIntervalNs());
+            if (fps <= 0.0)
+            {
+                fps = m_frameDecimator.getOutputRate(1e9 / n_frameRate);
+            }
+        }
+        auto const frameBytes = size_t(outputWidth) * size_t(outputHeight) * (frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? 1 : 4);
+        if (!MemoryBudget::hasRoomFor(n_minRecordingQueueFrames * frameBytes))
+        {
+            status += "Unable to start recording to " + filePath.string() + " because the memory budget is exhausted";
+            syslog(LOG_ERR, "%s", status.c_str());
+        }
+        else
+        {
+            auto const extension = filePath.extension().string();
+            VideoEncoder::Codec const *p_codec = nullptr;
+            int threads = 0;
+            double segmentSeconds = 0.0;
+            double segmentMegabytes = 0.0;
+            std::string codecError = "Video file extension must be '.mp4', '.avi' or '.mkv'";
+            {
+                std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+                p_codec = mp_recordingCodec;
+                threads = m_recordingThreads;
+                segmentSeconds = m_segmentSeconds;
+                segmentMegabytes = m_segmentMegabytes;
+            }
+            if (filePath == "/dev/null")
+            {
+                // encoder benchmark without a file
+                p_codec = p_codec ? p_codec : VideoEncoder::findByExtension(".mp4");
+            }
+            else if (!p_codec)
+            {
+                p_codec = VideoEncoder::findByExtension(extension);
+            }
+            else if (!VideoEncoder::supportsExtension(*p_codec, extension))
+            {
+                codecError = std::string("The codec ") + p_codec->p_name + " can not be written to a '" + extension + "' file";
+                p_codec = nullptr;
+            }
+            if (p_codec)
+            {
+                m_videoFilePath = filePath;
+                try
+                {
+                    auto const segmented = m_videoFilePath != "/dev/null" && (segmentSeconds > 0.0 || segmentMegabytes > 0.0);
+                    auto p_videoWriter = std::make_unique<SegmentedVideoWriter>(m_videoFilePath, *p_codec, threads, fps, outputWidth, outputHeight, frameFormat != SEEKCAMERA_FRAME_FORMAT_GRAYSCALE,
+                                                                                segmented ? segmentSeconds : 0.0, segmented ? segmentMegabytes : 0.0);
+                    auto const opened = p_videoWriter->isOpened();
+                    size_t preRollFrames = 0;
+                    bool geometryChanged = false;
+                    {
+                        // opened outside the locks, swapped in between two frames
+                        std::lock_guard<decltype(m_mut)> lock{m_mut};
+                        std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+                        // the frames would not match the writer, OUTPUTSIZE is refused once the writer is swapped in
+                        geometryChanged = m_outputWidth != outputWidth || m_outputHeight != outputHeight || m_frameFormat != frameFormat;
+                        _clearRecordingFrameQueue();
+                        if (geometryChanged)
+                        {
+                            // p_videoWriter is closed after the locks are released
+                            mp_videoWriter.reset();
+                        }
+                        else
+                        {
+                            mp_videoWriter = std::move(p_videoWriter);
+                        }
+                        _updateRecordingFramesWanted();
+                        m_triggerStopTimeNs = 0;
+                        m_recordingStopRequested = false;
+                        if (opened && !geometryChanged)
+                        {
+                            // ahead of the live frames
+                            preRollFrames = _flushPreRoll();
+                        }
+                    }
+                    if (geometryChanged)
+                    {
+                        status += "The output geometry changed while opening " + m_videoFilePath.string() + ", not recording";
+                        syslog(LOG_ERR, "%s", status.c_str());
+                    }
+                    else if ( opened || m_videoFilePath=="/dev/null" )
+                    {
+                        status += "Video file " + m_videoFilePath.string() + " opened for writing with " + p_codec->p_name;
+                        if (segmented)
+                        {
+                            status += " in segments";
+                        }
+                        if (preRollFrames > 0)
+                        {
+                            std::stringstream ss;
+                            ss << std::fixed << std::setprecision(1) << " with " << double(preRollFrames) / fps << " s of pre-roll (" << preRollFrames << " frames)";
+                            status += ss.str();
+                        }
+                    }
+                    else
+                    {
+                        status += "Failed to open video file " + m_videoFilePath.string() + " for writing";
+                        syslog( LOG_INFO, "%s" ,status.c_str() );
+                        syslog( LOG_INFO, "File: %s" ,std::filesystem::absolute(m_videoFilePath).c_str() );
+                        syslog( LOG_INFO, "OpenCV version: %s" , CV_VERSION);
+                    }
+                }
+                catch (cv::Exception const &e)
+                {
+                    status += "Failed to open file " + m_videoFilePath.string() + " opened for writing : " + e.msg + "\n" + e.what();
+                }
+                m_recordingFramesReadyCondition.notify_one();
+            }
+            else
+            {
+                status += codecError;
+            }
+        } 
+    }
+    return status;
+}
+
+void EchoThermCamera::setRecordingSegments(double seconds, double megabytes)
+{
+    TRACE_SCOPE("EchoThermCamera::setRecordingSegments");
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    m_segmentSeconds = std::max(0.0, seconds);
+    m_segmentMegabytes = std::max(0.0, megabytes);
+    syslog(LOG_NOTICE, "Recording segments set to %.1f s, %.1f MB.", m_segmentSeconds, m_segmentMegabytes);
+}
+
+std::string EchoThermCamera::setRecordingCodec(std::string const &codec, int threads)
+{
+    TRACE_SCOPE("EchoThermCamera::setRecordingCodec");
+    VideoEncoder::Codec const *p_codec = nullptr;
+    if (strcasecmp(codec.c_str(), "AUTO") != 0 && (p_codec = VideoEncoder::findByName(codec)) == nullptr)
+    {
+        return "Unknown recording codec " + codec + ", available: AUTO " + VideoEncoder::getCodecList();
+    }
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    mp_recordingCodec = p_codec;
+    m_recordingThreads = std::max(0, threads);
+    syslog(LOG_NOTICE, "Recording codec set to %s, %d threads.", p_codec ? p_codec->p_name : "AUTO", m_recordingThreads);
+    return std::string("Recording codec set to ") + (p_codec ? p_codec->p_name : "AUTO") + " with " +
+           (m_recordingThreads > 0 ? std::to_string(m_recordingThreads) : std::string("the default")) + " encoder threads, used by the next recording";
+}
+
+std::string EchoThermCamera::getRecordingCodec() const
+{
+    TRACE_SCOPE("EchoThermCamera::getRecordingCodec");
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    std::stringstream ss;
+    ss << "{codec=" << (mp_recordingCodec ? mp_recordingCodec->p_name : "AUTO");
+    ss << ", threads=" << m_recordingThreads;
+    ss << ", available=" << VideoEncoder::getCodecList();
+    ss << "}";
+    return ss.str();
+}
+
+std::string EchoThermCamera::getRecordingExtension() const
+{
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    return mp_recordingCodec ? mp_recordingCodec->extensions.front() : ".mp4";
+}
+
+std::string EchoThermCamera::getStillEncoderStatus() const
+{
+    // the pool has its own lock
+    return m_workerPool.getStatus();
+}
+
+std::string EchoThermCamera::getRecordingStatus() const
+{
+    TRACE_SCOPE("EchoThermCamera::getRecordingStatus");
+    // m_mut for the radiometric recorder, taken first like everywhere else
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    std::stringstream ss;
+    ss << "{recording=" << (mp_videoWriter && mp_videoWriter->isOpened() && !m_recordingStopRequested ? "true" : "false");
+    if (m_triggerStopTimeNs != 0)
+    {
+        ss << ", postRollS=" << double(m_triggerStopTimeNs - std::min(m_triggerStopTimeNs, m_lastRecordingFrameNs)) * 1e-9;
+    }
+    if (m_preRollBuffer.isEnabled())
+    {
+        ss << ", preRoll=" << m_preRollBuffer.getStatus();
     }
+    if (!mp_videoWriter)
+    {
+        ss << ", segmentS=" << m_segmentSeconds << ", segmentMB=" << m_segmentMegabytes;
+        ss << ", codec=" << (mp_recordingCodec ? mp_recordingCodec->p_name : "AUTO") << ", threads=" << m_recordingThreads;
+    }
+    else
+    {
+        ss << ", file=" << mp_videoWriter->getStatus();
+    }
+    if (mp_radiometricRecorder)
+    {
+        ss << ", radiometric=" << mp_radiometricRecorder->getStatus();
+    }
+    else
+    {
+        ss << ", radiometricCompressionThreads=" << m_radiometricCompressionThreads;
+    }
+    ss << "}";
+    return ss.str();
+}
 
-    if (m_radiometricFrameCaptureBusy)
+std::string EchoThermCamera::setPreRoll(double seconds, double maxMegabytes)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setPreRoll");
+    if (!std::isfinite(seconds) || seconds < 0.0 || !std::isfinite(maxMegabytes) || maxMegabytes < 0.0)
     {
-        status = "Unable to take radiometric screenshot, status is busy";
+        return "Invalid pre-roll " + std::to_string(seconds) + " s, " + std::to_string(maxMegabytes) + " MB";
+    }
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    m_preRollBuffer.setDuration(seconds, maxMegabytes);
+    _updateRecordingFramesWanted();
+    syslog(LOG_NOTICE, "Pre-roll set to %.1f s, %.1f MB.", seconds, maxMegabytes);
+    return "Pre-roll set to " + m_preRollBuffer.getStatus();
+}
+
+std::string EchoThermCamera::getPreRoll() const
+{
+    TRACE_SCOPE("EchoThermCamera::getPreRoll");
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    return m_preRollBuffer.getStatus();
+}
+
+// not under m_mut, like startRecording, so that opening the file does not hold up the frames
+std::string EchoThermCamera::trigger(std::filesystem::path const &filePath, double postRollSeconds)
+{
+    TRACE_SCOPE("EchoThermCamera::trigger");
+    if (!std::isfinite(postRollSeconds) || postRollSeconds < 0.0)
+    {
+        return "Invalid post-roll " + std::to_string(postRollSeconds) + " s";
+    }
+    auto const postRollNs = uint64_t(postRollSeconds * 1e9);
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    {
+        std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+        if (mp_videoWriter && mp_videoWriter->isOpened())
+        {
+            if (m_triggerStopTimeNs == 0 && !m_recordingStopRequested)
+            {
+                return "Already recording to video file " + m_videoFilePath.string();
+            }
+            if (m_recordingStopRequested)
+            {
+                // the file is not finished yet, the frames since the end of the post-roll are in the pre-roll
+                _flushPreRoll();
+                m_recordingStopRequested = false;
+            }
+            m_triggerStopTimeNs = std::max(m_triggerStopTimeNs, m_lastRecordingFrameNs + postRollNs);
+            ss << "Triggered recording to " << m_videoFilePath.string() << " extended, "
+               << double(m_triggerStopTimeNs - std::min(m_triggerStopTimeNs, m_lastRecordingFrameNs)) * 1e-9 << " s of post-roll left";
+            syslog(LOG_NOTICE, "%s", ss.str().c_str());
+            return ss.str();
+        }
+    }
+    auto status = startRecording(filePath);
+    std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+    if (mp_videoWriter && mp_videoWriter->isOpened())
+    {
+        m_triggerStopTimeNs = (m_lastRecordingFrameNs != 0 ? m_lastRecordingFrameNs : _getUtcTimeNs()) + postRollNs;
+        ss << ", finished after " << postRollSeconds << " s of post-roll";
+        status += ss.str();
+        syslog(LOG_NOTICE, "Triggered recording: %s", status.c_str());
+    }
+    return status;
+}
+
+std::string EchoThermCamera::takeScreenshot(std::filesystem::path const &filePath)
+{
+    TRACE_SCOPE("EchoThermCamera::takeScreenshot");
+    std::string status;
+    if( !has_rw_access( filePath )){
+        status = "Unable to take screenshot to: " + filePath.string() + " RW access not allowed! verify path";
+        syslog(LOG_ERR, "%s" , status.c_str() );
+        return status ;
+    }
+    auto screenshotFilePath = filePath;
+    if (!screenshotFilePath.has_extension())
+    {
+        screenshotFilePath += np_defaultScreenshotExtension;
+    }
+    // rejected here rather than after the frame is copied
+    if (!cv::haveImageWriter(screenshotFilePath.string()))
+    {
+        status = "Unable to take screenshot to: " + screenshotFilePath.string() + " because no image encoder supports the extension";
+        syslog(LOG_ERR, "%s", status.c_str());
         return status;
     }
-    if (m_radiometricFrameCapture)
+    return _requestScreenshot({screenshotFilePath, false, 0, 0, std::chrono::steady_clock::now()});
+}
+
+std::string EchoThermCamera::takeRadiometricScreenshot(std::filesystem::path const &filePath)
+{
+    TRACE_SCOPE("EchoThermCamera::takeRadiometricScreenshot");
+    ScreenshotRequest request{filePath, true, 0, 0, std::chrono::steady_clock::now()};
+    bool restart = false;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (filePath.empty())
+        {
+            syslog(LOG_WARNING, "Radiometric using default filename: /[Home]/Radiometric_[UTC].csv");
+        }
+        switch (m_radiometricFrameFormat)
+        {
+        case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT:
+        case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6:
+            break;
+        default:
+            m_radiometricFrameFormat = SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6;
+            syslog(LOG_INFO, "The radiometric format was invalid, defaulting to format %d.", m_radiometricFrameFormat);
+            break;
+        }
+
+        // get the current active frame mode, if it is not thermograph mode yet, set mode
+        // currently we are setting activeFrame to include the Thermography so this should not trigger
+        if (mp_camera && (m_activeFrameFormat & m_radiometricFrameFormat) == 0)
+        {
+            syslog(LOG_WARNING, "Currently not in thermograpy mode or mode not correct mode, restart required");
+            restart = true;
+            // no frame of another format is served
+            m_latestThermographyFrame.clear();
+        }
+        request.frameFormat = m_radiometricFrameFormat;
+        request.compressionThreads = std::min(m_radiometricCompressionThreads, 1);
+    }
+    // not locked, stopping the session waits for the frame callback which takes the lock
+    // the restart adds the radiometric format to the active format, the screenshot waits for its first frame
+    if (restart)
     {
-        status = "Unable to take radiomentric screenshot, last capture not complete";
+        _restartCaptureSession();
+    }
+    // m_mut is released, the frame callback keeps publishing while the screenshot is written
+    return _requestScreenshot(request);
+}
+
+std::string EchoThermCamera::burst(size_t frameCount, std::string const &imageExtension, std::string const &radiometricExtension,
+                                   std::filesystem::path const &directory)
+{
+    TRACE_SCOPE("EchoThermCamera::burst");
+    if (frameCount == 0 || frameCount > n_maxBurstFrames)
+    {
+        return "Unable to take a burst of " + std::to_string(frameCount) + " frames, the count must be 1 to " + std::to_string(n_maxBurstFrames);
+    }
+    if (imageExtension.empty() && radiometricExtension.empty())
+    {
+        return "Unable to take a burst without an image or radiometric format";
+    }
+    if (!imageExtension.empty() && !cv::haveImageWriter("burst" + imageExtension))
+    {
+        return "Unable to take a burst, no image encoder supports " + imageExtension;
+    }
+    if (!radiometricExtension.empty() && radiometricExtension != ".csv" && radiometricExtension != ".etr")
+    {
+        return "Unable to take a burst, radiometric frames are written as .csv or .etr, not " + radiometricExtension;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error || !has_rw_access(directory / "burst"))
+    {
+        auto const status = "Unable to take a burst to: " + directory.string() + " RW access not allowed! verify path";
+        syslog(LOG_ERR, "%s", status.c_str());
+        return status;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_burstMut);
+        if (m_burstRunning)
+        {
+            return "Unable to take a burst, another burst is being captured or written";
+        }
+        m_burstRunning = true;
+    }
+    // the previous burst thread has finished
+    if (m_burstThread.joinable())
+    {
+        m_burstThread.join();
+    }
+    auto p_burstCapture = std::make_unique<BurstCapture>(frameCount, !imageExtension.empty(), !radiometricExtension.empty());
+    int compressionThreads = 0;
+    std::string status;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (!mp_camera || m_width == 0 || m_height == 0)
+        {
+            status = "Unable to take a burst, the camera is not streaming";
+        }
+        else if (!imageExtension.empty() && m_frameFormat != SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888 && m_frameFormat != SEEKCAMERA_FRAME_FORMAT_GRAYSCALE)
+        {
+            status = "Unable to take a burst, the output format has no images";
+        }
+        else
+        {
+            // allocated before the frame callback sees the burst, it only copies into the slots
+            auto error = p_burstCapture->allocate(BurstCapture::Stream::Output, m_outputHeight, m_outputWidth,
+                                                  m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? CV_8U : CV_8UC4, 0);
+            if (error.empty())
+            {
+                error = p_burstCapture->allocate(BurstCapture::Stream::Thermography, m_height, m_width,
+                                                 m_radiometricFrameFormat == SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT ? CV_32F : CV_16U,
+                                                 sizeof(seekcamera_frame_header_t));
+            }
+            if (!error.empty())
+            {
+                status = "Unable to take a burst, " + error;
+            }
+            else
+            {
+                mp_burstCapture = p_burstCapture.get();
+                compressionThreads = std::min(m_radiometricCompressionThreads, 1);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_burstMut);
+    if (!status.empty())
+    {
+        m_burstRunning = false;
         return status;
     }
+    std::stringstream ss;
+    ss << "Burst of " << frameCount << " frames to " << directory.string() << " started";
+    m_burstStatus = ss.str();
+    auto const timeout = std::chrono::milliseconds(int64_t(2000.0 * double(frameCount) / n_frameRate)) + n_burstTimeoutMargin;
+    m_burstThread = std::thread(&EchoThermCamera::_runBurst, this, std::move(p_burstCapture), timeout, imageExtension, radiometricExtension, directory, compressionThreads);
+    syslog(LOG_NOTICE, "%s", m_burstStatus.c_str());
+    return m_burstStatus;
+}
+
+std::string EchoThermCamera::getBurstStatus() const
+{
+    TRACE_SCOPE("EchoThermCamera::getBurstStatus");
+    std::lock_guard<std::mutex> lock(m_burstMut);
+    return m_burstStatus;
+}
 
-    // get the current active frame mode, if it is not thermograph mode yet, set mode
-    // currently we are setting activeFrame to include the Thermography so this should not trigger
-    if ((m_activeFrameFormat & m_radiometricFrameFormat) == 0)
+// waits for the frames of the burst, then writes them, not on the daemon thread so that its clients are served meanwhile
+void EchoThermCamera::_runBurst(std::unique_ptr<BurstCapture> p_burstCapture, std::chrono::milliseconds timeout, std::string const &imageExtension,
+                                std::string const &radiometricExtension, std::filesystem::path const &directory, int compressionThreads)
+{
+    TRACE_SCOPE("EchoThermCamera::_runBurst");
+    auto const captureStartTime = std::chrono::steady_clock::now();
+    auto const captured = p_burstCapture->waitCaptured(timeout);
     {
-        syslog(LOG_WARNING, "Currently not in thermograpy mode or mode not correct mode, restart required");
-        auto estatus = SEEKCAMERA_SUCCESS;
-        // we have to stop and restart to activate mode
-        estatus = seekcamera_capture_session_stop((seekcamera_t *)mp_camera);
-        if (estatus != SEEKCAMERA_SUCCESS)
+        // after this the frame callback no longer touches the burst
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        mp_burstCapture = nullptr;
+    }
+    auto const captureTime = std::chrono::steady_clock::now();
+    auto const writeStatus = _writeBurst(*p_burstCapture, imageExtension, radiometricExtension, directory, compressionThreads);
+    auto const writtenTime = std::chrono::steady_clock::now();
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "Burst to " << directory.string() << (captured ? "" : " (timed out)") << " "
+       << p_burstCapture->getStatus() << ", " << writeStatus
+       << ", captureMs=" << std::chrono::duration<double, std::milli>(captureTime - captureStartTime).count()
+       << ", writeMs=" << std::chrono::duration<double, std::milli>(writtenTime - captureTime).count();
+    syslog(LOG_NOTICE, "%s", ss.str().c_str());
+    std::lock_guard<std::mutex> lock(m_burstMut);
+    m_burstStatus = ss.str();
+    m_burstRunning = false;
+}
+
+// every frame is one job, the pool writes them in parallel
+std::string EchoThermCamera::_writeBurst(BurstCapture const &burstCapture, std::string const &imageExtension, std::string const &radiometricExtension,
+                                         std::filesystem::path const &directory, int compressionThreads)
+{
+    TRACE_SCOPE("EchoThermCamera::_writeBurst");
+    std::atomic<size_t> failedCount{0};
+    std::vector<std::future<void>> jobs;
+    auto const getFilePath = [&directory](char const *p_prefix, size_t index, uint32_t fpaFrameCount, std::string const &extension)
+    {
+        std::stringstream ss;
+        ss << p_prefix << std::setw(4) << std::setfill('0') << index << "_" << fpaFrameCount << extension;
+        return directory / ss.str();
+    };
+    for (size_t i = 0; i < burstCapture.getFrameCount(BurstCapture::Stream::Output); ++i)
+    {
+        auto const filePath = getFilePath("Frame_", i, burstCapture.getFpaFrameCount(BurstCapture::Stream::Output, i), imageExtension);
+        jobs.push_back(m_workerPool.submit([&burstCapture, &failedCount, i, filePath]()
+                                           {
+            try
+            {
+                if (!cv::imwrite(filePath.string(), burstCapture.getImage(BurstCapture::Stream::Output, i)))
+                {
+                    AsyncLog::log(LOG_ERR, "Failed to write burst frame %s.", filePath.c_str());
+                    ++failedCount;
+                }
+            }
+            catch (cv::Exception const &e)
+            {
+                AsyncLog::log(LOG_ERR, "Exception occurred while writing burst frame %s : %s", filePath.c_str(), e.msg.c_str());
+                ++failedCount;
+            } },
+                                           WorkerPool::Priority::Normal));
+    }
+    for (size_t i = 0; i < burstCapture.getFrameCount(BurstCapture::Stream::Thermography); ++i)
+    {
+        auto const filePath = getFilePath("Radiometric_", i, burstCapture.getFpaFrameCount(BurstCapture::Stream::Thermography, i), radiometricExtension);
+        jobs.push_back(m_workerPool.submit([this, &burstCapture, &failedCount, i, filePath, compressionThreads]()
+                                           {
+            auto const &header = burstCapture.getHeader(i);
+            if (radiometricWrite(header.data(), header.size(), burstCapture.getImage(BurstCapture::Stream::Thermography, i),
+                                 burstCapture.getThermographyFormat(), compressionThreads, filePath, nullptr) != EXIT_SUCCESS)
+            {
+                ++failedCount;
+            } },
+                                           WorkerPool::Priority::Normal));
+    }
+    for (auto &job : jobs)
+    {
+        job.wait();
+    }
+    std::stringstream ss;
+    ss << "written=" << jobs.size() - failedCount.load() << ", failed=" << failedCount.load() << ", writeThreads=" << m_workerPool.getThreadCount();
+    return ss.str();
+}
+
+std::string EchoThermCamera::startInterval(double intervalSeconds, bool lowPower, std::string const &imageExtension,
+                                          std::string const &radiometricExtension, std::filesystem::path const &directory)
+{
+    TRACE_SCOPE("EchoThermCamera::startInterval");
+    if (!std::isfinite(intervalSeconds) || intervalSeconds < n_minIntervalSeconds)
+    {
+        return "Unable to start an interval capture every " + std::to_string(intervalSeconds) + " s, the interval must be at least " + std::to_string(n_minIntervalSeconds) + " s";
+    }
+    if (imageExtension.empty() && radiometricExtension.empty())
+    {
+        return "Unable to start an interval capture without an image or radiometric format";
+    }
+    if (!imageExtension.empty() && !cv::haveImageWriter("interval" + imageExtension))
+    {
+        return "Unable to start an interval capture, no image encoder supports " + imageExtension;
+    }
+    if (!radiometricExtension.empty() && radiometricExtension != ".csv" && radiometricExtension != ".etr")
+    {
+        return "Unable to start an interval capture, radiometric frames are written as .csv or .etr, not " + radiometricExtension;
+    }
+    std::string status;
+    {
+        std::lock_guard<std::mutex> lock(m_intervalMut);
+        if (mp_intervalCapture)
         {
-            syslog(LOG_ERR, "Thermography mode change, stop error");
-            return seekcamera_error_get_str(estatus);
+            status = ", replaced " + mp_intervalCapture->getStatus();
         }
-        // Add the radiometric format to the active format and restart
-        // note: this will cause a slight pause in the stream
-        m_activeFrameFormat = m_frameFormat | m_radiometricFrameFormat;
-        // RESTART
-        estatus = seekcamera_capture_session_start((seekcamera_t *)mp_camera, m_activeFrameFormat);
-        if (estatus == SEEKCAMERA_SUCCESS)
+    }
+    stopInterval();
+    IntervalCapture::Options options{intervalSeconds, imageExtension, radiometricExtension, directory, lowPower, 0};
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        options.compressionThreads = std::min(m_radiometricCompressionThreads, 1);
+        m_intervalIdleDecimator.setRate(n_intervalIdleRateHz);
+        m_intervalIdleDecimator.reset();
+    }
+    auto p_intervalCapture = std::make_unique<IntervalCapture>(options);
+    if (!p_intervalCapture->isOpened() || !has_rw_access(directory / "interval"))
+    {
+        status = "Unable to start an interval capture to: " + directory.string() + " RW access not allowed! verify path";
+        syslog(LOG_ERR, "%s", status.c_str());
+        return status;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_intervalMut);
+        mp_intervalCapture = std::move(p_intervalCapture);
+        m_intervalThreadRunning = true;
+    }
+    m_intervalThread = std::thread(&EchoThermCamera::_runInterval, this);
+    syslog(LOG_NOTICE, "Interval capture every %f s to %s.", intervalSeconds, directory.c_str());
+    std::stringstream ss;
+    ss << "Capturing every " << intervalSeconds << " s to " << directory.string() << (lowPower ? ", low power between captures" : "") << status;
+    return ss.str();
+}
+
+std::string EchoThermCamera::stopInterval()
+{
+    TRACE_SCOPE("EchoThermCamera::stopInterval");
+    {
+        std::lock_guard<std::mutex> lock(m_intervalMut);
+        if (!mp_intervalCapture)
         {
-            syslog(LOG_INFO, "Thermograph mode restart was successful");
+            return "No interval capture is running";
+        }
+        m_intervalThreadRunning = false;
+    }
+    m_intervalCondition.notify_all();
+    // a capture being written is finished first
+    if (m_intervalThread.joinable())
+    {
+        m_intervalThread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_intervalMut);
+    auto const status = "Interval capture stopped " + mp_intervalCapture->getStatus();
+    mp_intervalCapture.reset();
+    syslog(LOG_NOTICE, "%s", status.c_str());
+    return status;
+}
+
+std::string EchoThermCamera::getIntervalStatus() const
+{
+    TRACE_SCOPE("EchoThermCamera::getIntervalStatus");
+    std::lock_guard<std::mutex> lock(m_intervalMut);
+    return mp_intervalCapture ? mp_intervalCapture->getStatus() : "{interval=false}";
+}
+
+// the timer of the time-lapse, the ticks are on the steady clock so that a clock change does not shift them
+void EchoThermCamera::_runInterval()
+{
+    std::unique_lock<std::mutex> lock(m_intervalMut);
+    auto const options = mp_intervalCapture->getOptions();
+    auto const interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(options.intervalSeconds));
+    auto const stopped = [this]()
+    { return !m_intervalThreadRunning; };
+    // the first capture is taken at once
+    auto tickTime = std::chrono::steady_clock::now();
+    while (m_intervalThreadRunning)
+    {
+        if (m_intervalCondition.wait_until(lock, tickTime - n_intervalWakeLead, stopped))
+        {
+            break;
+        }
+        m_intervalIdle = false;
+        if (m_intervalCondition.wait_until(lock, tickTime, stopped))
+        {
+            break;
+        }
+        auto const tickUtcNs = _getUtcTimeNs();
+        auto const directory = mp_intervalCapture->getCaptureDirectory(tickUtcNs);
+        auto const tickUtcTime = time_t(tickUtcNs / 1000000000);
+        std::tm tickUtcTm{};
+        gmtime_r(&tickUtcTime, &tickUtcTm);
+        std::stringstream ss;
+        ss << "Interval_" << std::setw(6) << std::setfill('0') << mp_intervalCapture->getCaptureIndex() << "_"
+           << std::put_time(&tickUtcTm, "%Y_%m_%d_%H_%M_%S");
+        IntervalCapture::Capture capture{};
+        lock.unlock();
+        auto const captured = !directory.empty() && _captureInterval(options, directory / ss.str(), tickTime, tickUtcNs, &capture);
+        lock.lock();
+        if (captured)
+        {
+            mp_intervalCapture->addCapture(capture);
         }
         else
         {
-            syslog(LOG_ERR, "Thermography mode restart failed!");
-            return seekcamera_error_get_str(estatus);
+            mp_intervalCapture->addMissedTick();
+        }
+        m_intervalIdle = options.lowPower;
+        // ticks that passed while capturing are skipped, the next one stays in phase
+        tickTime += interval;
+        for (auto const now = std::chrono::steady_clock::now(); tickTime <= now; tickTime += interval)
+        {
+            mp_intervalCapture->addMissedTick();
         }
     }
+    m_intervalIdle = false;
+}
 
-    // set to capture next frame, this is handled in the frame call back mechanism
-    m_radiometricFrameCapture = 1;
-    if (filePath.empty())
+// select the frame closest to the tick: the latest one before it or the first one after it
+bool EchoThermCamera::_captureInterval(IntervalCapture::Options const &options, std::filesystem::path const &filePathStem,
+                                       std::chrono::steady_clock::time_point tickTime, uint64_t tickUtcNs, IntervalCapture::Capture *p_capture)
+{
+    TRACE_SCOPE("EchoThermCamera::_captureInterval");
+    auto const image = !options.imageExtension.empty();
+    auto const radiometric = !options.radiometricExtension.empty();
+    auto const &primaryFrame = radiometric ? m_latestThermographyFrame : m_latestOutputFrame;
+    IntervalFrame frames[2];
+    auto const hasBefore = _readLatestFrames(m_latestOutputFrame, m_latestThermographyFrame, image, radiometric, &frames[0]);
+    auto const sequence = primaryFrame.getSequence();
+    auto hasAfter = false;
+    auto const timeoutTime = std::chrono::steady_clock::now() + n_intervalFrameTimeout;
+    while (!hasAfter && std::chrono::steady_clock::now() < timeoutTime)
+    {
+        std::this_thread::sleep_for(n_intervalPollInterval);
+        hasAfter = primaryFrame.getSequence() != sequence && _readLatestFrames(m_latestOutputFrame, m_latestThermographyFrame, image, radiometric, &frames[1]) &&
+                   (!hasBefore || frames[1].info.sequence != frames[0].info.sequence);
+    }
+    auto const selectedTime = std::chrono::steady_clock::now();
+    if (!hasBefore && !hasAfter)
+    {
+        AsyncLog::log(LOG_WARNING, "Interval capture tick missed, no frame is available.");
+        return false;
+    }
+    auto const distance = [tickTime](IntervalFrame const &frame)
+    { return frame.info.publishTime > tickTime ? frame.info.publishTime - tickTime : tickTime - frame.info.publishTime; };
+    auto const &frame = !hasAfter || (hasBefore && distance(frames[0]) <= distance(frames[1])) ? frames[0] : frames[1];
+
+    p_capture->tickUtcNs = tickUtcNs;
+    p_capture->frameUtcNs = frame.info.timestampUtcNs;
+    p_capture->offsetMs = std::chrono::duration<double, std::milli>(frame.info.publishTime - tickTime).count();
+    p_capture->fpaFrameCount = 0;
+    p_capture->minTemperature = std::numeric_limits<float>::quiet_NaN();
+    p_capture->maxTemperature = std::numeric_limits<float>::quiet_NaN();
+    if (radiometric && frame.header.size() >= sizeof(seekcamera_frame_header_t))
     {
-        status = "Capture radiometric data on next frame, file: RadiometricData_[UTC].csv";
+        auto const *const p_header = (seekcamera_frame_header_t const *)frame.header.data();
+        p_capture->fpaFrameCount = p_header->fpa_frame_count;
+        p_capture->minTemperature = p_header->thermography_min_value;
+        p_capture->maxTemperature = p_header->thermography_max_value;
     }
-    else
+    p_capture->selectMs = std::chrono::duration<double, std::milli>(selectedTime - tickTime).count();
+    if (image)
     {
-        status = "Capture radiometric data on next frame, file: " + filePath.string();
+        p_capture->imagePath = filePathStem.string() + options.imageExtension;
+    }
+    if (radiometric)
+    {
+        p_capture->radiometricPath = filePathStem.string() + options.radiometricExtension;
+    }
+    // on the still encoder threads like the bursts, waited for so that the manifest stays in order
+    m_workerPool.submit([this, &options, &frame, p_capture]()
+                        {
+        auto const startCpuMs = IntervalCapture::getThreadCpuMs();
+        if (!p_capture->imagePath.empty())
+        {
+            try
+            {
+                p_capture->failed = !cv::imwrite(p_capture->imagePath.string(), frame.image);
+            }
+            catch (cv::Exception const &e)
+            {
+                AsyncLog::log(LOG_ERR, "Exception occurred while writing interval capture %s : %s", p_capture->imagePath.c_str(), e.msg.c_str());
+                p_capture->failed = true;
+            }
+        }
+        if (!p_capture->radiometricPath.empty() &&
+            radiometricWrite(frame.header.data(), frame.header.size(), frame.pixels, frame.info.frameFormat, options.compressionThreads,
+                             p_capture->radiometricPath, nullptr) != EXIT_SUCCESS)
+        {
+            p_capture->failed = true;
+        }
+        p_capture->cpuMs = IntervalCapture::getThreadCpuMs() - startCpuMs; },
+                        WorkerPool::Priority::Normal)
+        .wait();
+    p_capture->writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - selectedTime).count();
+    return true;
+}
+
+std::string EchoThermCamera::startRadiometricRecording(std::filesystem::path const &filePath, size_t framesPerChunk, bool direct)
+{
+    TRACE_SCOPE("EchoThermCamera::startRadiometricRecording");
+    int compressionThreads = 0;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        compressionThreads = m_radiometricCompressionThreads;
+    }
+    // opened outside m_mut so that the frames are not blocked by the file system
+    auto p_radiometricRecorder = std::make_unique<RadiometricRecorder>(filePath, framesPerChunk, direct, compressionThreads);
+    if (!p_radiometricRecorder->isOpened())
+    {
+        return p_radiometricRecorder->finish();
+    }
+    std::unique_ptr<RadiometricRecorder> p_previousRecorder;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        p_previousRecorder = std::move(mp_radiometricRecorder);
+        mp_radiometricRecorder = std::move(p_radiometricRecorder);
+    }
+    std::string status = "Recording radiometric data to " + filePath.string();
+    if (p_previousRecorder)
+    {
+        status += ", " + p_previousRecorder->finish();
     }
     return status;
 }
 
+std::string EchoThermCamera::setRadiometricCompression(bool enabled, int threads)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    TRACE_SCOPE("EchoThermCamera::setRadiometricCompression");
+    // the frames are independent, the threads compress consecutive frames in parallel
+    auto const defaultThreads = std::max(1, int(std::thread::hardware_concurrency()) / 2);
+    m_radiometricCompressionThreads = enabled ? (threads > 0 ? threads : defaultThreads) : 0;
+    syslog(LOG_NOTICE, "Radiometric compression set to %d threads.", m_radiometricCompressionThreads);
+    if (m_radiometricCompressionThreads == 0)
+    {
+        return "Radiometric compression off, used by the next radiometric recording";
+    }
+    return "Radiometric compression on with " + std::to_string(m_radiometricCompressionThreads) + " threads, used by the next radiometric recording";
+}
+
+std::string EchoThermCamera::stopRadiometricRecording()
+{
+    TRACE_SCOPE("EchoThermCamera::stopRadiometricRecording");
+    std::unique_ptr<RadiometricRecorder> p_radiometricRecorder;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        p_radiometricRecorder = std::move(mp_radiometricRecorder);
+    }
+    if (!p_radiometricRecorder)
+    {
+        return "Radiometric recording was not in progress";
+    }
+    // the last chunk and the index are written outside m_mut
+    return p_radiometricRecorder->finish();
+}
+
 std::string EchoThermCamera::stopRecording()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::stopRecording()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::stopRecording");
     std::string status;
     if (mp_videoWriter && (mp_videoWriter->isOpened() || m_videoFilePath=="/dev/null"))
     {
@@ -952,8 +2029,7 @@ std::string EchoThermCamera::stopRecording()
             // flush the frames
             while (!m_recordingFrameQueue.empty())
             {
-                cv::Mat queueFrame = std::move(m_recordingFrameQueue.front());
-                m_recordingFrameQueue.pop_front();
+                cv::Mat queueFrame = _popRecordingFrame();
                 cv::Mat frameToWrite;
                 if (queueFrame.channels() == 4)
                 {
@@ -968,6 +2044,10 @@ std::string EchoThermCamera::stopRecording()
             }
             mp_videoWriter->release();
             status = "Successfully finished writing video file " + m_videoFilePath.string();
+            if (auto const segmentCount = mp_videoWriter->getSegmentCount(); segmentCount > 1)
+            {
+                status += " in " + std::to_string(segmentCount) + " segments";
+            }
         }
         catch (cv::Exception const &e)
         {
@@ -989,32 +2069,30 @@ std::string EchoThermCamera::stopRecording()
             m_recordingStatus.clear();
         }
     }
-    mp_videoWriter.release();
+    {
+        // the frame callback checks the writer under m_mut, the recording thread under the queue lock
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        std::lock_guard<std::mutex> recordingLock(m_recordingFrameQueueMut);
+        mp_videoWriter.reset();
+        _updateRecordingFramesWanted();
+        m_triggerStopTimeNs = 0;
+        m_recordingStopRequested = false;
+    }
     m_videoFilePath.clear();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::stopRecording() with %s", status.c_str());
-#endif
     return status;
 }
 
 void EchoThermCamera::_connect(void *p_camera)
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_connect()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_connect");
     _closeSession();
     mp_camera = p_camera;
     _openSession(false);
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_connect()");
-#endif
 }
 
 void EchoThermCamera::_handleReadyToPair(void *p_camera)
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_handleReadyToPair()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_handleReadyToPair");
     // Attempt to pair the camera automatically.
     // Pairing refers to the process by which the sensor is associated with the host and the embedded processor.
     auto const status = seekcamera_store_calibration_data((seekcamera_t *)p_camera, nullptr, nullptr, nullptr);
@@ -1024,16 +2102,11 @@ void EchoThermCamera::_handleReadyToPair(void *p_camera)
     }
     // Start imaging.
     _connect(p_camera);
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_handleReadyToPair()");
-#endif
 }
 
 void EchoThermCamera::_closeSession()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_closeSession()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_closeSession");
     _stopShutterClickThread();
     _stopRecordingThread();
     seekcamera_error_t status = SEEKCAMERA_SUCCESS;
@@ -1047,108 +2120,122 @@ void EchoThermCamera::_closeSession()
         }
         mp_camera = nullptr;
     }
-    if (m_loopbackDevice >= 0)
-    {
-        syslog(LOG_NOTICE, "Closing loopback device %d", m_loopbackDevice);
-        close(m_loopbackDevice);
-        m_loopbackDevice = -1;
-    }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_closeSession()");
-#endif
+    // the loopback device stays open across reconnects so that consumers keep their pipelines
 }
 
 void EchoThermCamera::_openSession(bool reconnect)
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_openSession(%d)", reconnect);
-#endif
+    TRACE_SCOPE("EchoThermCamera::_openSession");
     // Register a frame available callback function.
     auto status = SEEKCAMERA_SUCCESS;
-    m_screenshotFilePath.clear();
-    m_screenshotStatus.clear();
+    // no frame of the previous session is served to a screenshot
+    m_latestOutputFrame.clear();
+    m_latestThermographyFrame.clear();
 
     m_videoFilePath.clear();
     m_recordingStatus.clear();
-    m_recordingFrameQueue.clear();
+    _clearRecordingFrameQueue();
+    m_preRollBuffer.clear();
+    m_lastRecordingFrameNs = 0;
+    m_frameTimingMonitor.reset();
+    m_frameTimingMonitor.markSessionStart(_getUtcTimeNs());
+    m_frameDecimator.reset();
 
     if (!reconnect)
     {
         status = seekcamera_register_frame_available_callback((seekcamera_t *)mp_camera,
                                                               [](seekcamera_t *, seekcamera_frame_t *p_cameraFrame, void *p_userData)
                                                               {
+                                                                  // taken before the lock so that lock contention shows up as processing time
+                                                                  auto const arrivalTime = std::chrono::system_clock::now();
+                                                                  TRACE_SCOPE("EchoThermCamera::frameCallback");
                                                                   auto *p_this = (EchoThermCamera *)p_userData;
                                                                   std::lock_guard<decltype(p_this->m_mut)> lock{p_this->m_mut};
                                                                   seekframe_t *p_frame = nullptr;
+                                                                  seekcamera_frame_header_t const *p_header = nullptr;
 
             // TODO: support the ability to capture multiple formats
             // For example, you can pull YUY2 data AND thermography data, themograph data is now handled
             // You'd write the YUY2 data to the frame and you'd write the thermography data to a CSV
-                                                                  auto const status = seekcamera_frame_get_frame_by_format(p_cameraFrame, (seekcamera_frame_format_t)p_this->m_frameFormat, &p_frame);
+                                                                  auto const frameFormat = p_this->m_colorizerEnabled ? SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6 : (seekcamera_frame_format_t)p_this->m_frameFormat;
+                                                                  auto const status = seekcamera_frame_get_frame_by_format(p_cameraFrame, frameFormat, &p_frame);
                                                                   if (status == SEEKCAMERA_SUCCESS)
                                                                   {
-                                                                      if (p_this->m_loopbackDevice < 0)
+                                                                      p_header = (seekcamera_frame_header_t const *)seekframe_get_header(p_frame);
+                                                                      int const frameWidth = (int)seekframe_get_width(p_frame);
+                                                                      int const frameHeight = (int)seekframe_get_height(p_frame);
+                                                                      if (p_this->m_loopbackDevice < 0 || frameWidth != p_this->m_width || frameHeight != p_this->m_height)
                                                                       {
-                                                                          int const frameWidth = (int)seekframe_get_width(p_frame);
-                                                                          int const frameHeight = (int)seekframe_get_height(p_frame);
+                                                                          // not pre-opened, or the camera geometry differs from the default
+                                                                          p_this->_closeDevice();
                                                                           p_this->_openDevice(frameWidth, frameHeight);
                                                                       }
                                                                       if (p_this->m_loopbackDevice >= 0)
                                                                       {
-                                                                          void *const p_frameData = seekframe_get_data(p_frame);
-                                                                          size_t const frameDataSize = seekframe_get_data_size(p_frame);
-                                                                          ssize_t const written = p_this->_writeBytes(p_frameData, frameDataSize);
-                                                                          if (written < 0)
+                                                                          // frames dropped by the output rate cost nothing but the zoom and pan steps,
+                                                                          // between the captures of a low power time-lapse only a frame per second is processed
+                                                                          // unless a recording or the pre-roll needs every output frame
+                                                                          auto const idle = p_this->m_intervalIdle && !p_this->m_recordingFramesWanted;
+                                                                          auto const output = p_this->m_frameDecimator.select(p_header->timestamp_utc_ns) &&
+                                                                                              (!idle || p_this->m_intervalIdleDecimator.select(p_header->timestamp_utc_ns));
+                                                                          // a burst takes every frame, also the ones dropped from the output
+                                                                          auto const burst = p_this->mp_burstCapture && p_this->mp_burstCapture->wantsFrame(BurstCapture::Stream::Output);
+                                                                          if (output || burst)
                                                                           {
-                                                                              syslog(LOG_ERR, "Error writing %zu bytes to v4l2 device %s: %m", frameDataSize, p_this->m_loopbackDeviceName.c_str());
+                                                                              if (p_this->m_overlay.isEnabled())
+                                                                              {
+                                                                                  p_this->_updateOverlay(p_cameraFrame);
+                                                                              }
+                                                                              size_t frameDataSize = seekframe_get_data_size(p_frame);
+                                                                              // before the colorizer and the zoom, so that the noise is neither stretched nor magnified
+                                                                              void *p_frameData = p_this->m_temporalFilter.isEnabled() ? p_this->_denoise(p_frame, &frameDataSize) : seekframe_get_data(p_frame);
+                                                                              if (p_this->m_colorizerEnabled)
+                                                                              {
+                                                                                  // the isotherm is blended in the colorize pass
+                                                                                  p_frameData = p_this->_colorize(p_frameData, frameDataSize, &frameDataSize);
+                                                                              }
+                                                                              else if (p_this->m_isotherm.isEnabled())
+                                                                              {
+                                                                                  p_frameData = p_this->_highlightIsotherm(p_cameraFrame, p_frameData);
+                                                                              }
+                                                                              p_this->m_frameCaptureTimeNs = p_header->timestamp_utc_ns;
+                                                                              p_this->m_frameFpaCount = p_header->fpa_frame_count;
+                                                                              ssize_t const written = p_this->_writeBytes(p_frameData, frameDataSize, output);
+                                                                              if (written < 0)
+                                                                              {
+                                                                                  AsyncLog::log(LOG_ERR, "Error writing %zu bytes to v4l2 device %s: %m", frameDataSize, p_this->m_loopbackDeviceName.c_str());
+                                                                              }
                                                                           }
                                                                           p_this->_doContinuousZoom();
+                                                                          p_this->_doContinuousPan();
                                                                       }
                                                                   }
                                                                   else
                                                                   {
-                                                                      syslog(LOG_ERR, "Failed to get frame: %s.", seekcamera_error_get_str(status));
+                                                                      AsyncLog::log(LOG_ERR, "Failed to get frame: %s.", seekcamera_error_get_str(status));
                                                                   }
-                                                                  //-------------------------------------------------------------------------------------
-                                                                  // Capture one frame of radiometric data
-                                                                  // capture flag is set to true, will be cleared when complete
-                                                                  //        busy prevents subsequent calls while processing
-                                                                  // note: the running mode must be set to include one of the 2 thermography modes
-                                                                  //       this was verified when RadiometricFrameCapture set
-                                                                  if (p_this->m_radiometricFrameCapture == 1 &&
-                                                                      p_this->m_radiometricFrameCaptureBusy == 0)
+                                                                  auto const arrivalTimeNs = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(arrivalTime.time_since_epoch()).count();
+                                                                  p_this->_writeOutputs(p_cameraFrame, p_header ? p_header->timestamp_utc_ns : arrivalTimeNs, arrivalTime);
+                                                                  // after every write, the analysis itself runs on the detector thread
+                                                                  if (p_this->m_hotspotDetector.isRunning())
                                                                   {
-                                                                      seekframe_t *p_rframe = nullptr;
-                                                                      p_this->m_radiometricFrameCapture = 0;     // reset the capture flag for next request
-                                                                      p_this->m_radiometricFrameCaptureBusy = 1; // busy until were are done copy or error, prevent stacking calls
-
-                                                                      // get data, note: seek cameras have seperate pipeline buffers in hardware for this
-                                                                      auto const radiometricStatus = seekcamera_frame_get_frame_by_format(
-                                                                          p_cameraFrame,
-                                                                          (seekcamera_frame_format_t)p_this->m_radiometricFrameFormat,
-                                                                          &p_rframe);
-
-                                                                      if (radiometricStatus == SEEKCAMERA_SUCCESS)
-                                                                      {
-                                                                          // get data from camera in ptr in p_rframe
-                                                                          // busy flag set to prevent next request from writing until this frame is complete
-                                                                          // cleared when finished
-                                                                          if (p_this->radiometricWrite(p_rframe) == EXIT_SUCCESS)
-                                                                          {
-                                                                              syslog(LOG_INFO, "radiometric frame captured to file");
-                                                                          }
-                                                                          else
-                                                                          {
-                                                                              syslog(LOG_ERR, "radiometric frame failed to save to file");
-                                                                          }
-                                                                      }
-                                                                      else
-                                                                      {
-                                                                          syslog(LOG_ERR, "*radiometric frame capture triggered: format %d", p_this->m_radiometricFrameFormat);
-                                                                          syslog(LOG_ERR, "Failed to get radiometic frame: %s.", seekcamera_error_get_str(radiometricStatus));
-                                                                      }
-                                                                      p_this->m_radiometricFrameCaptureBusy = 0; // clear when done with task success or error
-                                                                  } // end if write radiomentric frame capture
+                                                                      p_this->_submitHotspotFrame(p_cameraFrame);
+                                                                  }
+                                                                  // every captured frame, independent of the output rate
+                                                                  if (p_this->mp_radiometricRecorder)
+                                                                  {
+                                                                      p_this->_recordRadiometricFrame(p_cameraFrame);
+                                                                  }
+                                                                  // kept for radiometric screenshots and bursts
+                                                                  p_this->_publishThermographyFrame(p_cameraFrame);
+                                                                  if (p_header)
+                                                                  {
+                                                                      auto const doneTime = std::chrono::system_clock::now();
+                                                                      p_this->m_frameTimingMonitor.addFrame(p_header->timestamp_utc_ns,
+                                                                                                            p_header->fpa_frame_count,
+                                                                                                            arrivalTimeNs,
+                                                                                                            (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(doneTime - arrivalTime).count());
+                                                                  }
                                                               },
                                                               (void *)this);
     }
@@ -1162,7 +2249,7 @@ void EchoThermCamera::_openSession(bool reconnect)
             // if not the first call to capture a radiometricData will detect and then restart with it on
             // this will cause a slign pause in the stream during restart, the radiometric mode is left on after this
             // TODO evaluate to see if this adds any additional latency but the thinking is that 320x240 data should not be problem
-            m_activeFrameFormat = m_frameFormat | m_radiometricFrameFormat;
+            m_activeFrameFormat = _getActiveFrameFormat();
             status = seekcamera_capture_session_start((seekcamera_t *)mp_camera, m_activeFrameFormat);
 
             if (status == SEEKCAMERA_SUCCESS)
@@ -1208,21 +2295,53 @@ void EchoThermCamera::_openSession(bool reconnect)
     }
     _startShutterClickThread();
     _startRecordingThread();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_openSession(%d)", reconnect);
-#endif
+}
+
+int EchoThermCamera::_getActiveFrameFormat() const
+{
+    // the radiometric format is always included, see _openSession
+    auto frameFormat = (m_colorizerEnabled ? int(SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6) : m_frameFormat) | m_radiometricFrameFormat;
+    if (m_hotspotDetector.isRunning() || m_isotherm.isEnabled())
+    {
+        frameFormat |= SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6;
+    }
+    // additional outputs take the SDK frame in their own format, or the thermography frame to colorize
+    for (auto const &p_output : m_outputs)
+    {
+        auto const &profile = p_output->getProfile();
+        frameFormat |= profile.colorPalette < 0 ? profile.frameFormat : int(SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6);
+    }
+    return frameFormat;
+}
+
+void EchoThermCamera::_restartCaptureSession()
+{
+    TRACE_SCOPE("EchoThermCamera::_restartCaptureSession");
+    // note: this will cause a slight pause in the stream
+    auto status = seekcamera_capture_session_stop((seekcamera_t *)mp_camera);
+    if (status != SEEKCAMERA_SUCCESS)
+    {
+        syslog(LOG_ERR, "Failed to stop capture session: %s.", seekcamera_error_get_str(status));
+    }
+    m_activeFrameFormat = _getActiveFrameFormat();
+    status = seekcamera_capture_session_start((seekcamera_t *)mp_camera, m_activeFrameFormat);
+    if (status != SEEKCAMERA_SUCCESS)
+    {
+        syslog(LOG_ERR, "Failed to restart capture session: %s.", seekcamera_error_get_str(status));
+    }
 }
 
 void EchoThermCamera::_openDevice(int width, int height)
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_openDevice(%d, %d)", width, height);
-#endif
+    TRACE_SCOPE("EchoThermCamera::_openDevice");
+    m_width = width;
+    m_height = height;
+    _computeOutputGeometry();
     // TODO find a way to detect the format automatically
     m_loopbackDevice = open(m_loopbackDeviceName.c_str(), O_RDWR);
     if (m_loopbackDevice < 0)
     {
-        syslog(LOG_ERR, "Error opening loopback device %s: %m", m_loopbackDeviceName.c_str());
+        AsyncLog::log(LOG_ERR, "Error opening loopback device %s: %m", m_loopbackDeviceName.c_str());
     }
     else
     {
@@ -1231,21 +2350,21 @@ void EchoThermCamera::_openDevice(int width, int height)
         auto deviceOpenResult = ioctl(m_loopbackDevice, VIDIOC_G_FMT, &v);
         if (deviceOpenResult < 0)
         {
-            syslog(LOG_ERR, "VIDIOC_G_FMT error on device %s: %m", m_loopbackDeviceName.c_str());
+            AsyncLog::log(LOG_ERR, "VIDIOC_G_FMT error on device %s: %m", m_loopbackDeviceName.c_str());
         }
         else
         {
-            v.fmt.pix.width = width;
-            v.fmt.pix.height = height;
+            v.fmt.pix.width = m_outputWidth;
+            v.fmt.pix.height = m_outputHeight;
             switch (m_frameFormat)
             {
             case SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888:
                 v.fmt.pix.pixelformat = V4L2_PIX_FMT_ARGB32;
-                v.fmt.pix.sizeimage = width * height * 4;
+                v.fmt.pix.sizeimage = m_outputWidth * m_outputHeight * 4;
                 break;
             case SEEKCAMERA_FRAME_FORMAT_GRAYSCALE:
                 v.fmt.pix.pixelformat = V4L2_PIX_FMT_GREY;
-                v.fmt.pix.sizeimage = width * height;
+                v.fmt.pix.sizeimage = m_outputWidth * m_outputHeight;
                 break;
             case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6:
             case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT:
@@ -1265,7 +2384,7 @@ void EchoThermCamera::_openDevice(int width, int height)
                 // v.fmt.pix.sizeimage = width * height * 4;
                 // break;
             default:
-                syslog(LOG_ERR, "Unsupported frame format %d.", m_frameFormat);
+                AsyncLog::log(LOG_ERR, "Unsupported frame format %d.", m_frameFormat);
                 deviceOpenResult = -1;
                 break;
             }
@@ -1274,34 +2393,58 @@ void EchoThermCamera::_openDevice(int width, int height)
                 deviceOpenResult = ioctl(m_loopbackDevice, VIDIOC_S_FMT, &v);
                 if (deviceOpenResult < 0)
                 {
-                    syslog(LOG_ERR, "VIDIOC_S_FMT error on device %s: %m", m_loopbackDeviceName.c_str());
+                    AsyncLog::log(LOG_ERR, "VIDIOC_S_FMT error on device %s: %m", m_loopbackDeviceName.c_str());
                 }
                 else
                 {
-                    syslog(LOG_NOTICE, "Opened loopback device with path %s.", m_loopbackDeviceName.c_str());
+                    AsyncLog::log(LOG_NOTICE, "Opened loopback device with path %s.", m_loopbackDeviceName.c_str());
                 }
             }
         }
     }
     m_zoomRate = 0.0;
     m_currentZoom = n_minZoom;
-    m_width = width;
-    m_height = height;
-    m_roiX = 0;
-    m_roiY = 0;
     m_roiWidth = width;
     m_roiHeight = height;
     m_lastZoomTime = std::chrono::system_clock::time_point();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_openDevice(%d, %d)", width, height);
-#endif
+    m_panX = width / 2.0;
+    m_panY = height / 2.0;
+    m_panRateX = 0.0;
+    m_panRateY = 0.0;
+    m_lastPanTime = std::chrono::system_clock::time_point();
+    _computeRoi();
+    _reserveFrameBuffers();
+}
+// the largest rectangle with the sensor aspect ratio, centered in the requested output
+void EchoThermCamera::_computeOutputGeometry()
+{
+    m_outputWidth = m_requestedOutputWidth > 0 ? m_requestedOutputWidth : m_width;
+    m_outputHeight = m_requestedOutputHeight > 0 ? m_requestedOutputHeight : m_height;
+    m_contentWidth = std::min(m_outputWidth, (int)std::lround(double(m_outputHeight) * m_width / m_height));
+    m_contentHeight = std::min(m_outputHeight, (int)std::lround(double(m_outputWidth) * m_height / m_width));
+    m_contentX = (m_outputWidth - m_contentWidth) / 2;
+    m_contentY = (m_outputHeight - m_contentHeight) / 2;
+}
+
+cv::Mat EchoThermCamera::_getOutputContent(cv::Mat &outputFrame) const
+{
+    return outputFrame(cv::Rect(m_contentX, m_contentY, m_contentWidth, m_contentHeight));
+}
+
+void EchoThermCamera::_closeDevice()
+{
+    TRACE_SCOPE("EchoThermCamera::_closeDevice");
+    if (m_loopbackDevice >= 0)
+    {
+        syslog(LOG_NOTICE, "Closing loopback device %d", m_loopbackDevice);
+        close(m_loopbackDevice);
+        m_loopbackDevice = -1;
+    }
 }
 
 void EchoThermCamera::_startShutterClickThread()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_startShutterClickThread()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_startShutterClickThread");
     if (m_shutterMode > 0)
     {
         m_shutterClickThreadRunning = true;
@@ -1326,71 +2469,53 @@ void EchoThermCamera::_startShutterClickThread()
                                                    }
                                                } });
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_startShutterClickThread()");
-#endif
 }
 
 void EchoThermCamera::_stopShutterClickThread()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_stopShutterClickThread()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_stopShutterClickThread");
     m_shutterClickThreadRunning = false;
     m_shutterClickCondition.notify_one();
     if (m_shutterClickThread.joinable())
     {
         m_shutterClickThread.join();
     }
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_stopShutterClickThread()");
-#endif
 }
 
 void EchoThermCamera::_startRecordingThread()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_startRecordingThread()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_startRecordingThread");
     m_recordingThreadRunning = true;
     m_recordingThread = std::thread([this]()
                                     {
         for (;;)
         {
             std::unique_lock<decltype(m_recordingFrameQueueMut)> lock(m_recordingFrameQueueMut);
-            m_recordingFramesReadyCondition.wait(lock,[this](){return (!m_recordingFrameQueue.empty() && (!m_screenshotFilePath.empty()||(mp_videoWriter && mp_videoWriter->isOpened()))) || !m_recordingThreadRunning.load();});
+            m_recordingFramesReadyCondition.wait(lock,[this](){return (!m_recordingFrameQueue.empty() && mp_videoWriter && mp_videoWriter->isOpened()) || (m_recordingStopRequested && m_recordingFrameQueue.empty()) || !m_recordingThreadRunning.load();});
             if (!m_recordingThreadRunning)
             {
                 if(mp_videoWriter)
                 {
                     mp_videoWriter->release();
-                    mp_videoWriter.release();
+                    mp_videoWriter.reset();
+                    _updateRecordingFramesWanted();
                 }
                 break;
             }
-            assert(!m_recordingFrameQueue.empty());
-            cv::Mat queueFrame=std::move(m_recordingFrameQueue.front());
-            m_recordingFrameQueue.pop_front();
-            if(!m_screenshotFilePath.empty())
+            if(m_recordingStopRequested && m_recordingFrameQueue.empty())
             {
-                try
-                {                   
-                    if(cv::imwrite(m_screenshotFilePath.string(),queueFrame))
-                    {
-                        m_screenshotStatus = "Wrote screenshot to "+m_screenshotFilePath.string();
-                    }
-                    else
-                    {
-                        m_screenshotStatus = "Failed to write screenshot to "+m_screenshotFilePath.string()+" because of an unspecified error";
-                    }
-                }
-                catch( cv::Exception const & e)
+                // the post-roll of a triggered recording is written, the writer is kept for the status
+                m_recordingStopRequested = false;
+                if(mp_videoWriter && mp_videoWriter->isOpened())
                 {
-                    m_screenshotStatus = "Exception occurred while writing screenshot to "+m_screenshotFilePath.string()+" : "+e.msg;
+                    mp_videoWriter->release();
+                    AsyncLog::log(LOG_NOTICE, "Triggered recording %s finished.", m_videoFilePath.c_str());
                 }
-                m_screenshotFilePath.clear();
-                m_screenshotStatusReadyCondition.notify_one();
+                continue;
             }
+            assert(!m_recordingFrameQueue.empty());
+            cv::Mat queueFrame=_popRecordingFrame();
+            TRACE_SCOPE("EchoThermCamera::recordingThread");
             if(mp_videoWriter && mp_videoWriter->isOpened())
             {
                 cv::Mat frameToWrite;
@@ -1410,8 +2535,8 @@ void EchoThermCamera::_startRecordingThread()
                 catch(cv::Exception const& e)
                 {
                     m_recordingStatus = "Exception occurred while writing video frame to "+m_videoFilePath.string()+" : "+e.msg;
+                    // released but kept, the frame callback may be checking it; stopRecording deletes it
                     mp_videoWriter->release();
-                    mp_videoWriter.release();
                     m_recordingStatusReadyCondition.notify_one();
                 }
             }
@@ -1419,35 +2544,103 @@ void EchoThermCamera::_startRecordingThread()
             
         } });
 
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_startScreenshotThread()");
-#endif
 }
 
 void EchoThermCamera::_stopRecordingThread()
 {
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "ENTER EchoThermCamera::_stopRecordingThread()");
-#endif
+    TRACE_SCOPE("EchoThermCamera::_stopRecordingThread");
     m_recordingThreadRunning = false;
     m_recordingFramesReadyCondition.notify_one();
     if (m_recordingThread.joinable())
     {
         m_recordingThread.join();
     }
-    m_recordingFrameQueue.clear();
-    m_screenshotFilePath.clear();
+    _clearRecordingFrameQueue();
     m_videoFilePath.clear();
     m_recordingStatus.clear();
-    m_screenshotStatus.clear();
-#ifdef DEBUG
-    syslog(LOG_DEBUG, "EXIT  EchoThermCamera::_stopRecordingThread()");
-#endif
+    m_triggerStopTimeNs = 0;
+    m_recordingStopRequested = false;
+}
+
+std::string EchoThermCamera::_requestScreenshot(ScreenshotRequest const &request)
+{
+    TRACE_SCOPE("EchoThermCamera::_requestScreenshot");
+    std::string status;
+    // a client is waiting, the job is taken before the queued frames of a burst
+    m_workerPool.submit([this, &request, &status]()
+                        { status = request.radiometric ? _writeRadiometricScreenshot(request) : _writeScreenshot(request); },
+                        WorkerPool::Priority::High)
+        .wait();
+    return status;
+}
+
+std::string EchoThermCamera::_writeScreenshot(ScreenshotRequest const &request)
+{
+    TRACE_SCOPE("EchoThermCamera::_writeScreenshot");
+    cv::Mat frame;
+    LatestFrameBuffer::Info info{};
+    if (!m_latestOutputFrame.read(frame, nullptr, &info))
+    {
+        return "Could not write screenshot to " + request.filePath.string() + " because no output frame is available in the frame format";
+    }
+    auto const readTime = std::chrono::steady_clock::now();
+    try
+    {
+        if (!cv::imwrite(request.filePath.string(), frame))
+        {
+            return "Failed to write screenshot to " + request.filePath.string() + " because of an unspecified error";
+        }
+    }
+    catch (cv::Exception const &e)
+    {
+        return "Exception occurred while writing screenshot to " + request.filePath.string() + " : " + e.msg;
+    }
+    auto const writtenTime = std::chrono::steady_clock::now();
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "Wrote screenshot to " << request.filePath.string()
+       << " {latencyMs=" << std::chrono::duration<double, std::milli>(writtenTime - request.requestTime).count()
+       << ", encodeMs=" << std::chrono::duration<double, std::milli>(writtenTime - readTime).count()
+       << ", frameAgeMs=" << std::chrono::duration<double, std::milli>(readTime - info.publishTime).count() << "}";
+    return ss.str();
+}
+
+std::string EchoThermCamera::_writeRadiometricScreenshot(ScreenshotRequest const &request)
+{
+    TRACE_SCOPE("EchoThermCamera::_writeRadiometricScreenshot");
+    cv::Mat pixels;
+    std::vector<uint8_t> header;
+    LatestFrameBuffer::Info info{};
+    // the thermography frame is published unless the session was just (re)started for the format
+    auto const timeoutTime = request.requestTime + n_thermographyFrameTimeout;
+    while (!m_latestThermographyFrame.read(pixels, &header, &info) || info.frameFormat != request.frameFormat)
+    {
+        if (std::chrono::steady_clock::now() >= timeoutTime)
+        {
+            return "Unable to take radiometric screenshot, no thermography frame in format " + std::to_string(request.frameFormat) + " is available";
+        }
+        std::this_thread::sleep_for(n_thermographyFramePollInterval);
+    }
+    auto const readTime = std::chrono::steady_clock::now();
+    std::string filePath;
+    if (radiometricWrite(header.data(), header.size(), pixels, info.frameFormat, request.compressionThreads, request.filePath, &filePath) != EXIT_SUCCESS)
+    {
+        AsyncLog::log(LOG_ERR, "radiometric frame failed to save to file");
+        return "Unable to take radiometric screenshot to: " + (filePath.empty() ? request.filePath.string() : filePath) + ", see the log";
+    }
+    auto const writtenTime = std::chrono::steady_clock::now();
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "Captured radiometric data to " << filePath
+       << " {latencyMs=" << std::chrono::duration<double, std::milli>(writtenTime - request.requestTime).count()
+       << ", writeMs=" << std::chrono::duration<double, std::milli>(writtenTime - readTime).count()
+       << ", frameAgeMs=" << std::chrono::duration<double, std::milli>(readTime - info.publishTime).count() << "}";
+    return ss.str();
 }
 
 void EchoThermCamera::_doContinuousZoom()
 {
+    TRACE_SCOPE("EchoThermCamera::_doContinuousZoom");
     auto const currentTime = std::chrono::system_clock::now();
+    bool const zooming = m_zoomRate != 0;
     if (m_zoomRate > 0)
     {
         // zooming in
@@ -1460,10 +2653,8 @@ void EchoThermCamera::_doContinuousZoom()
                 m_currentZoom = std::min(m_maxZoom, m_currentZoom + deltaZoom);
                 m_roiWidth = std::max<int>(1, (int)std::rint(m_width / m_currentZoom));
                 m_roiHeight = std::max<int>(1, (int)std::rint(m_height / m_currentZoom));
-                m_roiX = (m_width - m_roiWidth) >> 1;
-                m_roiY = (m_height - m_roiHeight) >> 1;
 #ifdef DEBUG
-                syslog(LOG_DEBUG, "zooming in  m_currentZoom=%f, m_zoomRate=%f, m_roiWidth=%d, m_roiHeight=%d, m_roiX=%d, m_roiY=%d, elapsedTime(ms) = %d, deltaZoom=%f", m_currentZoom, m_zoomRate, m_roiWidth, m_roiHeight, m_roiX, m_roiY, (int)elapsedTimeMs, deltaZoom);
+                AsyncLog::log(LOG_DEBUG, "zooming in  m_currentZoom=%f, m_zoomRate=%f, m_roiWidth=%d, m_roiHeight=%d, m_roiX=%d, m_roiY=%d, elapsedTime(ms) = %d, deltaZoom=%f", m_currentZoom, m_zoomRate, m_roiWidth, m_roiHeight, m_roiX, m_roiY, (int)elapsedTimeMs, deltaZoom);
 #endif
             }
         }
@@ -1485,10 +2676,8 @@ void EchoThermCamera::_doContinuousZoom()
                 m_currentZoom = std::max(n_minZoom, m_currentZoom - deltaZoom);
                 m_roiWidth = std::min<int>(m_width, (int)std::rint(m_width / m_currentZoom));
                 m_roiHeight = std::min<int>(m_height, (int)std::rint(m_height / m_currentZoom));
-                m_roiX = (m_width - m_roiWidth) >> 1;
-                m_roiY = (m_height - m_roiHeight) >> 1;
 #ifdef DEBUG
-                syslog(LOG_DEBUG, "zooming out m_currentZoom=%f, m_zoomRate=%f, m_roiWidth=%d, m_roiHeight=%d, m_roiX=%d, m_roiY=%d, elapsedTime(ms) = %d, deltaZoom=%f", m_currentZoom, m_zoomRate, m_roiWidth, m_roiHeight, m_roiX, m_roiY, (int)elapsedTimeMs, deltaZoom);
+                AsyncLog::log(LOG_DEBUG, "zooming out m_currentZoom=%f, m_zoomRate=%f, m_roiWidth=%d, m_roiHeight=%d, m_roiX=%d, m_roiY=%d, elapsedTime(ms) = %d, deltaZoom=%f", m_currentZoom, m_zoomRate, m_roiWidth, m_roiHeight, m_roiX, m_roiY, (int)elapsedTimeMs, deltaZoom);
 #endif
             }
         }
@@ -1497,65 +2686,465 @@ void EchoThermCamera::_doContinuousZoom()
             // stop zooming out
             m_zoomRate = 0;
             m_currentZoom = n_minZoom;
-            m_roiX = 0;
-            m_roiY = 0;
             m_roiWidth = m_width;
             m_roiHeight = m_height;
         }
     }
+    if (zooming)
+    {
+        _computeRoi();
+    }
     m_lastZoomTime = currentTime;
 }
 
-void EchoThermCamera::_pushFrame(int cvFrameType, void *p_frameData)
+void EchoThermCamera::_doContinuousPan()
+{
+    TRACE_SCOPE("EchoThermCamera::_doContinuousPan");
+    auto const currentTime = std::chrono::system_clock::now();
+    if ((m_panRateX != 0 || m_panRateY != 0) && m_lastPanTime != std::chrono::system_clock::time_point())
+    {
+        auto const elapsedTimeS = std::chrono::duration<double>(currentTime - m_lastPanTime).count();
+        // the rate is in displayed pixels, convert to sensor pixels at the current zoom
+        m_panX += m_panRateX * elapsedTimeS / m_currentZoom;
+        m_panY += m_panRateY * elapsedTimeS / m_currentZoom;
+        _computeRoi();
+    }
+    m_lastPanTime = currentTime;
+}
+
+// size the ROI from the zoom and position it around the pan center
+// the center is clamped so that the ROI never leaves the sensor
+void EchoThermCamera::_computeRoi()
+{
+    auto const roiWidth = m_width / m_currentZoom;
+    auto const roiHeight = m_height / m_currentZoom;
+    m_panX = std::clamp(m_panX, roiWidth / 2.0, m_width - roiWidth / 2.0);
+    m_panY = std::clamp(m_panY, roiHeight / 2.0, m_height - roiHeight / 2.0);
+    m_roiOriginX = m_panX - roiWidth / 2.0;
+    m_roiOriginY = m_panY - roiHeight / 2.0;
+    m_roiX = std::clamp((int)std::rint(m_roiOriginX), 0, std::max(0, m_width - m_roiWidth));
+    m_roiY = std::clamp((int)std::rint(m_roiOriginY), 0, std::max(0, m_height - m_roiHeight));
+}
+
+// scale the subpixel ROI up to the output in a single bilinear pass
+// the zoom and the output scaling in one warp, dstMat is the content part of the output frame
+void EchoThermCamera::_warpRoi(cv::Mat const &srcMat, cv::Mat &dstMat) const
+{
+    LoopbackOutput::warpRoi(srcMat, dstMat, 1.0 / _getDisplayScale(), m_roiOriginX, m_roiOriginY, m_outputInterpolation);
+}
+
+// output pixels per sensor pixel
+double EchoThermCamera::_getDisplayScale() const
+{
+    return m_currentZoom * double(m_contentWidth) / double(m_width);
+}
+
+void EchoThermCamera::_pushFrame(int cvFrameType, void *p_frameData, bool output)
 {
-    ;
-    if (!m_screenshotFilePath.empty() || (mp_videoWriter && mp_videoWriter->isOpened()))
+    TRACE_SCOPE("EchoThermCamera::_pushFrame");
+    cv::Mat const frame(m_outputHeight, m_outputWidth, cvFrameType, p_frameData);
+    if (mp_burstCapture)
+    {
+        mp_burstCapture->addOutputFrame(frame, m_frameFpaCount, m_frameCaptureTimeNs);
+    }
+    if (!output)
+    {
+        // only for the burst, dropped by the output rate
+        return;
+    }
+    m_latestOutputFrame.write(frame, nullptr, 0, m_frameFormat, m_frameCaptureTimeNs);
+    if (!m_recordingFramesWanted)
+    {
+        // neither a recording nor the pre-roll, the queue lock is not taken
+        return;
+    }
+    bool recording = false;
     {
+        // decided under the queue lock so that a starting recording takes every frame from the pre-roll or the queue
+        std::lock_guard lock(m_recordingFrameQueueMut);
+        if (m_triggerStopTimeNs != 0 && m_frameCaptureTimeNs >= m_triggerStopTimeNs)
+        {
+            m_triggerStopTimeNs = 0;
+            m_recordingStopRequested = true;
+            m_recordingFramesReadyCondition.notify_one();
+        }
+        recording = mp_videoWriter && mp_videoWriter->isOpened() && !m_recordingStopRequested;
+        if (!recording && m_preRollBuffer.isEnabled())
+        {
+            // the pre-roll holds the frames a recording would have written
+            m_preRollBuffer.push(frame, m_frameCaptureTimeNs, m_frameDecimator.getOutputRate(1e9 / n_frameRate));
+        }
+        m_lastRecordingFrameNs = m_frameCaptureTimeNs;
+    }
+    if (recording)
+    {
+        if (!MemoryBudget::tryAcquire(MemoryBudget::Category::RecordingQueue, frame.total() * frame.elemSize()))
+        {
+            // shed load rather than grow, the frame is not recorded
+            AsyncLog::log(LOG_WARNING, "Recording frame dropped because the memory budget is exhausted.");
+            return;
+        }
         {
             std::lock_guard lock(m_recordingFrameQueueMut);
-            m_recordingFrameQueue.push_back(cv::Mat(m_height, m_width, cvFrameType, p_frameData).clone());
+            m_recordingFrameQueue.push_back(frame.clone());
         }
         m_recordingFramesReadyCondition.notify_one();
     }
 }
 
-ssize_t EchoThermCamera::_writeBytes(void *p_frameData, size_t frameDataSize)
+// the caller must hold m_recordingFrameQueueMut
+void EchoThermCamera::_updateRecordingFramesWanted()
 {
-    ssize_t bytesWritten = -1;
-    cv::Mat cvFrame;
-    if (m_roiX == 0 && m_roiY == 0 && m_roiWidth == m_width && m_roiHeight == m_height)
+    m_recordingFramesWanted = mp_videoWriter || m_preRollBuffer.isEnabled();
+}
+
+// the caller must hold m_recordingFrameQueueMut
+// moves the pre-roll frames to the end of the queue, returns their number
+size_t EchoThermCamera::_flushPreRoll()
+{
+    auto frames = m_preRollBuffer.takeFrames();
+    for (auto &frame : frames)
+    {
+        // the frames are committed to the recording, they are queued regardless of the budget
+        MemoryBudget::acquire(MemoryBudget::Category::RecordingQueue, frame.total() * frame.elemSize());
+        m_recordingFrameQueue.push_back(std::move(frame));
+    }
+    return frames.size();
+}
+
+// the caller must hold m_recordingFrameQueueMut (or the recording thread must be stopped)
+cv::Mat EchoThermCamera::_popRecordingFrame()
+{
+    cv::Mat frame = std::move(m_recordingFrameQueue.front());
+    m_recordingFrameQueue.pop_front();
+    MemoryBudget::release(MemoryBudget::Category::RecordingQueue, frame.total() * frame.elemSize());
+    return frame;
+}
+
+void EchoThermCamera::_clearRecordingFrameQueue()
+{
+    while (!m_recordingFrameQueue.empty())
+    {
+        _popRecordingFrame();
+    }
+}
+
+// pipeline frames are reused between frames instead of allocating a new one for each
+cv::Mat &EchoThermCamera::_reserveFrame(cv::Mat &frame, int cvFrameType, int width, int height)
+{
+    if (frame.rows != height || frame.cols != width || frame.type() != cvFrameType)
+    {
+        MemoryBudget::release(MemoryBudget::Category::FramePool, frame.total() * frame.elemSize());
+        frame.create(height, width, cvFrameType);
+        MemoryBudget::acquire(MemoryBudget::Category::FramePool, frame.total() * frame.elemSize());
+    }
+    return frame;
+}
+
+// output geometry, the letterbox bars are cleared once and never written by the warp
+cv::Mat &EchoThermCamera::_getZoomFrame(int cvFrameType)
+{
+    auto const reallocate = mp_zoomFrame->rows != m_outputHeight || mp_zoomFrame->cols != m_outputWidth || mp_zoomFrame->type() != cvFrameType;
+    auto &frame = _reserveFrame(*mp_zoomFrame, cvFrameType, m_outputWidth, m_outputHeight);
+    if (reallocate && (m_contentWidth != m_outputWidth || m_contentHeight != m_outputHeight))
+    {
+        frame.setTo(cvFrameType == CV_8UC4 ? cv::Scalar(0, 0, 0, 255) : cv::Scalar(0));
+    }
+    return frame;
+}
+
+// allocate the buffers of the enabled frame stages for the sensor geometry, at start (default geometry),
+// on a geometry change and when a stage is enabled, so that the frame path does not allocate
+void EchoThermCamera::_reserveFrameBuffers()
+{
+    if (m_width <= 0 || m_height <= 0)
+    {
+        return;
+    }
+    auto const channels = m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? 1 : 4;
+    if (m_colorizerEnabled || m_isotherm.isEnabled())
+    {
+        _reserveFrame(*mp_colorFrame, channels == 1 ? CV_8U : CV_8UC4, m_width, m_height);
+    }
+    // same choice of frame as _denoise
+    if (m_temporalFilter.isEnabled() && m_colorizerEnabled)
+    {
+        m_temporalFilter.reserve16(m_width, m_height);
+    }
+    else if (m_temporalFilter.isEnabled() && (m_frameFormat == SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888 || m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE))
+    {
+        m_temporalFilter.reserve8(m_width, m_height, channels);
+    }
+    for (auto const &p_output : m_outputs)
+    {
+        p_output->reserve(m_width, m_height);
+    }
+    for (auto const &p_colorStage : m_colorStages)
+    {
+        p_colorStage->reserve(m_width, m_height);
+    }
+}
+
+// the thermography frame header carries the min, max and spot pixels
+// (the radiometric format is always part of the session, see _openSession)
+void EchoThermCamera::_updateOverlay(void *p_cameraFrame)
+{
+    seekframe_t *p_frame = nullptr;
+    auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, (seekcamera_frame_format_t)m_radiometricFrameFormat, &p_frame);
+    if (status != SEEKCAMERA_SUCCESS)
     {
-        bytesWritten = write(m_loopbackDevice, p_frameData, frameDataSize);
-        if (!m_screenshotFilePath.empty() || (mp_videoWriter && mp_videoWriter->isOpened()))
+        AsyncLog::log(LOG_ERR, "Failed to get the thermography frame for the overlay: %s.", seekcamera_error_get_str(status));
+        return;
+    }
+    auto const *const p_header = (seekcamera_frame_header_t const *)seekframe_get_header(p_frame);
+    m_overlay.setMeasurements({p_header->thermography_min_x, p_header->thermography_min_y, p_header->thermography_min_value},
+                              {p_header->thermography_max_x, p_header->thermography_max_y, p_header->thermography_max_value},
+                              {p_header->thermography_spot_x, p_header->thermography_spot_y, p_header->thermography_spot_value});
+    if (m_overlay.getItems() & Overlay::Hotspots)
+    {
+        // the hotspots of the last analyzed frame, at most a frame or two behind
+        std::vector<Overlay::Box> boxes;
+        for (auto const &hotspot : m_hotspotDetector.getHotspots())
         {
-            switch (m_frameFormat)
-            {
-            case SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888:
+            boxes.push_back({hotspot.id, hotspot.left, hotspot.top, hotspot.width, hotspot.height, hotspot.maxTemperature});
+        }
+        m_overlay.setHotspots(std::move(boxes));
+    }
+}
+
+void EchoThermCamera::_submitHotspotFrame(void *p_cameraFrame)
+{
+    seekframe_t *p_frame = nullptr;
+    auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6, &p_frame);
+    if (status != SEEKCAMERA_SUCCESS)
+    {
+        AsyncLog::log(LOG_ERR, "Failed to get the thermography frame for hotspot detection: %s.", seekcamera_error_get_str(status));
+        return;
+    }
+    int const height = (int)seekframe_get_height(p_frame);
+    m_hotspotDetector.submit((uint16_t const *)seekframe_get_data(p_frame), seekframe_get_data_size(p_frame) / size_t(height),
+                             (int)seekframe_get_width(p_frame), height);
+}
+
+// the pixels are copied into the chunk of the recorder, the write happens on its thread
+void EchoThermCamera::_recordRadiometricFrame(void *p_cameraFrame)
+{
+    seekframe_t *p_frame = nullptr;
+    auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, (seekcamera_frame_format_t)m_radiometricFrameFormat, &p_frame);
+    if (status != SEEKCAMERA_SUCCESS)
+    {
+        AsyncLog::log(LOG_ERR, "Failed to get the thermography frame for the radiometric recording: %s.", seekcamera_error_get_str(status));
+        return;
+    }
+    auto const *const p_header = (seekcamera_frame_header_t const *)seekframe_get_header(p_frame);
+    auto const bytesPerPixel = m_radiometricFrameFormat == SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT ? sizeof(float) : sizeof(uint16_t);
+    mp_radiometricRecorder->addFrame(p_header, seekframe_get_header_size(p_frame), p_header->timestamp_utc_ns, p_header->chipid,
+                                     m_radiometricFrameFormat, seekframe_get_data(p_frame), (int)seekframe_get_width(p_frame),
+                                     (int)seekframe_get_height(p_frame), bytesPerPixel, seekframe_get_line_stride(p_frame));
+}
+
+// the thermography frame and its header are copied into the latest frame buffer, the radiometric screenshots read it
+void EchoThermCamera::_publishThermographyFrame(void *p_cameraFrame)
+{
+    seekframe_t *p_frame = nullptr;
+    auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, (seekcamera_frame_format_t)m_radiometricFrameFormat, &p_frame);
+    if (status != SEEKCAMERA_SUCCESS)
+    {
+        return;
+    }
+    auto const *const p_header = (seekcamera_frame_header_t const *)seekframe_get_header(p_frame);
+    auto const cvFrameType = m_radiometricFrameFormat == SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT ? CV_32F : CV_16U;
+    cv::Mat const pixels((int)seekframe_get_height(p_frame), (int)seekframe_get_width(p_frame), cvFrameType, seekframe_get_data(p_frame),
+                         seekframe_get_line_stride(p_frame));
+    m_latestThermographyFrame.write(pixels, p_header, seekframe_get_header_size(p_frame), m_radiometricFrameFormat, p_header->timestamp_utc_ns);
+    if (mp_burstCapture)
+    {
+        mp_burstCapture->addThermographyFrame(pixels, p_header, seekframe_get_header_size(p_frame), m_radiometricFrameFormat,
+                                              p_header->fpa_frame_count, p_header->timestamp_utc_ns);
+    }
+}
+
+// keep one color stage per distinct palette, range and format used by the additional outputs
+void EchoThermCamera::_updateColorStages()
+{
+    std::vector<std::unique_ptr<ColorStage>> colorStages;
+    for (auto const &p_output : m_outputs)
+    {
+        auto const &profile = p_output->getProfile();
+        auto const matches = [&profile](auto const &p_colorStage)
+        { return p_colorStage->matches(profile); };
+        if (profile.colorPalette < 0 || std::any_of(std::begin(colorStages), std::end(colorStages), matches))
+        {
+            continue;
+        }
+        if (auto it = std::find_if(std::begin(m_colorStages), std::end(m_colorStages), matches); it != std::end(m_colorStages))
+        {
+            // keep the smoothed AGC range
+            colorStages.push_back(std::move(*it));
+        }
+        else
+        {
+            colorStages.push_back(std::make_unique<ColorStage>(profile.frameFormat, profile.colorPalette, profile.minTemperature, profile.maxTemperature));
+        }
+    }
+    m_colorStages = std::move(colorStages);
+}
+
+// feed the additional outputs, each SDK frame and color stage is fetched or computed once per frame
+// and only if an output that is not decimated on this frame uses it
+void EchoThermCamera::_writeOutputs(void *p_cameraFrame, uint64_t captureTimeNs, std::chrono::system_clock::time_point arrivalTime)
+{
+    if (m_outputs.empty())
+    {
+        return;
+    }
+    TRACE_SCOPE("EchoThermCamera::_writeOutputs");
+    ++m_outputFrameNum;
+    seekframe_t *p_thermographyFrame = nullptr;
+    for (auto const &p_output : m_outputs)
+    {
+        if (!p_output->wantsFrame(captureTimeNs))
+        {
+            continue;
+        }
+        auto const &profile = p_output->getProfile();
+        if (profile.colorPalette < 0)
+        {
+            seekframe_t *p_frame = nullptr;
+            auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, (seekcamera_frame_format_t)profile.frameFormat, &p_frame);
+            if (status != SEEKCAMERA_SUCCESS)
             {
-                _pushFrame(CV_8UC4, p_frameData);
-                break;
+                AsyncLog::log(LOG_ERR, "Failed to get frame for output %s: %s.", profile.name.c_str(), seekcamera_error_get_str(status));
+                continue;
             }
-            case SEEKCAMERA_FRAME_FORMAT_GRAYSCALE:
+            cv::Mat const srcFrame((int)seekframe_get_height(p_frame), (int)seekframe_get_width(p_frame),
+                                   profile.frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? CV_8U : CV_8UC4, seekframe_get_data(p_frame));
+            p_output->write(srcFrame, arrivalTime);
+        }
+        else
+        {
+            if (!p_thermographyFrame)
             {
-                _pushFrame(CV_8U, p_frameData);
-                break;
+                auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6, &p_thermographyFrame);
+                if (status != SEEKCAMERA_SUCCESS)
+                {
+                    AsyncLog::log(LOG_ERR, "Failed to get thermography frame for output %s: %s.", profile.name.c_str(), seekcamera_error_get_str(status));
+                    p_thermographyFrame = nullptr;
+                    continue;
+                }
             }
-            case SEEKCAMERA_FRAME_FORMAT_COLOR_RGB565:
-            case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6:
-            case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT:
-            case SEEKCAMERA_FRAME_FORMAT_PRE_AGC:
-            case SEEKCAMERA_FRAME_FORMAT_CORRECTED:
-            case SEEKCAMERA_FRAME_FORMAT_COLOR_AYUV:
-            case SEEKCAMERA_FRAME_FORMAT_COLOR_YUY2:
-            default:
+            auto it = std::find_if(std::begin(m_colorStages), std::end(m_colorStages), [&profile](auto const &p_colorStage)
+                                   { return p_colorStage->matches(profile); });
+            if (it != std::end(m_colorStages))
             {
-                std::lock_guard screenshotLock(m_screenshotStatusReadyMut);
-                m_screenshotStatus = "Could not write screenshot to " + m_screenshotFilePath.string() + " because the frame format is not supported";
-                m_screenshotFilePath.clear();
+                int const width = (int)seekframe_get_width(p_thermographyFrame);
+                int const height = (int)seekframe_get_height(p_thermographyFrame);
+                auto const srcStride = seekframe_get_data_size(p_thermographyFrame) / size_t(height);
+                p_output->write((*it)->getFrame(m_outputFrameNum, (uint16_t const *)seekframe_get_data(p_thermographyFrame), srcStride, width, height), arrivalTime);
             }
-                m_screenshotStatusReadyCondition.notify_one();
-                break;
+        }
+    }
+}
+
+// blend the isotherm into the SDK frame, the result goes to the color frame so the SDK frame is not modified
+void *EchoThermCamera::_highlightIsotherm(void *p_cameraFrame, void *p_frameData)
+{
+    TRACE_SCOPE("EchoThermCamera::_highlightIsotherm");
+    seekframe_t *p_thermographyFrame = nullptr;
+    auto const status = seekcamera_frame_get_frame_by_format((seekcamera_frame_t *)p_cameraFrame, SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6, &p_thermographyFrame);
+    if (status != SEEKCAMERA_SUCCESS || (int)seekframe_get_width(p_thermographyFrame) != m_width || (int)seekframe_get_height(p_thermographyFrame) != m_height)
+    {
+        // e.g. the first frames before the capture session was restarted with the thermography frame
+        return p_frameData;
+    }
+    auto const channels = m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? 1 : 4;
+    auto &colorFrame = _reserveFrame(*mp_colorFrame, channels == 1 ? CV_8U : CV_8UC4, m_width, m_height);
+    auto const rowBytes = size_t(m_width) * size_t(channels);
+    m_isotherm.apply((uint16_t const *)seekframe_get_data(p_thermographyFrame), seekframe_get_data_size(p_thermographyFrame) / size_t(m_height),
+                     (uint8_t const *)p_frameData, rowBytes, colorFrame.data, rowBytes, m_width, m_height, channels);
+    m_isotherm.finishFrame();
+    return colorFrame.data;
+}
+
+// filter the frame of the primary output, returns the filtered frame owned by the temporal filter
+void *EchoThermCamera::_denoise(seekframe_t *p_frame, size_t *p_frameDataSize)
+{
+    TRACE_SCOPE("EchoThermCamera::_denoise");
+    auto const *const p_src = (uint8_t const *)seekframe_get_data(p_frame);
+    auto const srcStride = seekframe_get_data_size(p_frame) / size_t(m_height);
+    if (m_colorizerEnabled)
+    {
+        // the FIXED_10_6 thermography frame
+        *p_frameDataSize = size_t(m_width) * size_t(m_height) * sizeof(uint16_t);
+        return (void *)m_temporalFilter.filter16((uint16_t const *)p_src, srcStride, m_width, m_height);
+    }
+    if (m_frameFormat == SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888 || m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE)
+    {
+        int const channels = m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? 1 : 4;
+        *p_frameDataSize = size_t(m_width) * size_t(m_height) * size_t(channels);
+        return (void *)m_temporalFilter.filter8(p_src, srcStride, m_width, m_height, channels);
+    }
+    // other SDK formats are written unfiltered
+    return (void *)p_src;
+}
+
+// colorize the FIXED_10_6 frame into the color frame using the output frame format
+void *EchoThermCamera::_colorize(void const *p_thermographyData, size_t thermographyDataSize, size_t *p_frameDataSize)
+{
+    TRACE_SCOPE("EchoThermCamera::_colorize");
+    auto const *const p_src = (uint16_t const *)p_thermographyData;
+    auto const srcStride = thermographyDataSize / size_t(m_height);
+    if (m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE)
+    {
+        auto &colorFrame = _reserveFrame(*mp_colorFrame, CV_8U, m_width, m_height);
+        m_colorizer.colorizeGrey(p_src, srcStride, m_width, m_height, colorFrame.data);
+    }
+    else
+    {
+        auto &colorFrame = _reserveFrame(*mp_colorFrame, CV_8UC4, m_width, m_height);
+        m_colorizer.colorizeArgb(p_src, srcStride, m_width, m_height, (uint32_t *)colorFrame.data);
+    }
+    *p_frameDataSize = mp_colorFrame->total() * mp_colorFrame->elemSize();
+    return mp_colorFrame->data;
+}
+
+ssize_t EchoThermCamera::_writeBytes(void *p_frameData, size_t frameDataSize, bool output)
+{
+    TRACE_SCOPE("EchoThermCamera::_writeBytes");
+    ssize_t bytesWritten = -1;
+    cv::Mat cvFrame;
+    if (m_roiX == 0 && m_roiY == 0 && m_roiWidth == m_width && m_roiHeight == m_height && m_outputWidth == m_width && m_outputHeight == m_height)
+    {
+        if (m_overlay.isEnabled() && (m_frameFormat == SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888 || m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE))
+        {
+            // the colorizer frame is ours, the SDK frame is drawn on a copy
+            int const cvFrameType = m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? CV_8U : CV_8UC4;
+            cv::Mat &dstMat = p_frameData == mp_colorFrame->data ? *mp_colorFrame : _getZoomFrame(cvFrameType);
+            if (p_frameData != dstMat.data)
+            {
+                std::memcpy(dstMat.data, p_frameData, std::min(frameDataSize, dstMat.total() * dstMat.elemSize()));
             }
+            m_overlay.draw(dstMat, m_roiOriginX, m_roiOriginY, m_currentZoom);
+            p_frameData = dstMat.data;
+            frameDataSize = dstMat.total() * dstMat.elemSize();
+        }
+        bytesWritten = output ? write(m_loopbackDevice, p_frameData, frameDataSize) : 0;
+        // every frame, the latest one is kept for screenshots
+        switch (m_frameFormat)
+        {
+        case SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888:
+        {
+            _pushFrame(CV_8UC4, p_frameData, output);
+            break;
+        }
+        case SEEKCAMERA_FRAME_FORMAT_GRAYSCALE:
+        {
+            _pushFrame(CV_8U, p_frameData, output);
+            break;
+        }
+        default:
+            // not recorded, screenshots report that no output frame is available
+            break;
         }
     }
     else
@@ -1565,21 +3154,23 @@ ssize_t EchoThermCamera::_writeBytes(void *p_frameData, size_t frameDataSize)
         case SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888:
         {
             cv::Mat srcMat(m_height, m_width, CV_8UC4, p_frameData);
-            cv::Mat srcROI(srcMat, cv::Rect(m_roiX, m_roiY, m_roiWidth, m_roiHeight));
-            cv::Mat dstMat;
-            cv::resize(srcROI, dstMat, cv::Size(m_width, m_height), 0, 0, cv::INTER_LINEAR);
-            bytesWritten = write(m_loopbackDevice, dstMat.data, dstMat.total() * dstMat.elemSize());
-            _pushFrame(dstMat.type(), dstMat.data);
+            cv::Mat &dstMat = _getZoomFrame(CV_8UC4);
+            cv::Mat contentMat = _getOutputContent(dstMat);
+            _warpRoi(srcMat, contentMat);
+            m_overlay.draw(contentMat, m_roiOriginX, m_roiOriginY, _getDisplayScale());
+            bytesWritten = output ? write(m_loopbackDevice, dstMat.data, dstMat.total() * dstMat.elemSize()) : 0;
+            _pushFrame(dstMat.type(), dstMat.data, output);
             break;
         }
         case SEEKCAMERA_FRAME_FORMAT_GRAYSCALE:
         {
             cv::Mat srcMat(m_height, m_width, CV_8U, p_frameData);
-            cv::Mat srcROI(srcMat, cv::Rect(m_roiX, m_roiY, m_roiWidth, m_roiHeight));
-            cv::Mat dstMat;
-            cv::resize(srcROI, dstMat, cv::Size(m_width, m_height), 0, 0, cv::INTER_LINEAR);
-            bytesWritten = write(m_loopbackDevice, dstMat.data, dstMat.total() * dstMat.elemSize());
-            _pushFrame(dstMat.type(), dstMat.data);
+            cv::Mat &dstMat = _getZoomFrame(CV_8U);
+            cv::Mat contentMat = _getOutputContent(dstMat);
+            _warpRoi(srcMat, contentMat);
+            m_overlay.draw(contentMat, m_roiOriginX, m_roiOriginY, _getDisplayScale());
+            bytesWritten = output ? write(m_loopbackDevice, dstMat.data, dstMat.total() * dstMat.elemSize()) : 0;
+            _pushFrame(dstMat.type(), dstMat.data, output);
             break;
         }
         case SEEKCAMERA_FRAME_FORMAT_COLOR_RGB565:
@@ -1589,28 +3180,20 @@ ssize_t EchoThermCamera::_writeBytes(void *p_frameData, size_t frameDataSize)
         case SEEKCAMERA_FRAME_FORMAT_CORRECTED:
         case SEEKCAMERA_FRAME_FORMAT_COLOR_AYUV:
         default:
-        {
-            if (!m_screenshotFilePath.empty())
-            {
-                {
-                    std::lock_guard screenshotLock(m_screenshotStatusReadyMut);
-                    m_screenshotStatus = "Could not write screenshot to " + m_screenshotFilePath.string() + " because the frame format is not supported";
-                    m_screenshotFilePath.clear();
-                }
-                m_screenshotStatusReadyCondition.notify_one();
-                break;
-            }
-        }
+            // not recorded, screenshots report that no output frame is available
+            break;
         }
     }
     return bytesWritten;
 }
 
-int EchoThermCamera::radiometricWrite(seekframe_t *frame)
+int EchoThermCamera::radiometricWrite(void const *p_header, size_t headerSize, cv::Mat const &pixels, int frameFormat, int compressionThreads,
+                                      std::filesystem::path const &requestedFilePath, std::string *p_filePath)
 {
+    TRACE_SCOPE("EchoThermCamera::radiometricWrite");
     // Log each header value to the CSV file, see the documentation for a description of the header.
-    seekcamera_frame_header_t *header = (seekcamera_frame_header_t *)seekframe_get_header(frame);
-    if (header == nullptr)
+    auto const *const header = (seekcamera_frame_header_t const *)p_header;
+    if (header == nullptr || headerSize < sizeof(seekcamera_frame_header_t))
     {
         return EXIT_FAILURE;
     }
@@ -1619,7 +3202,9 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
     int hundredths = (header->timestamp_utc_ns % 1000000000) / 10000000; // Hundredths
     // Create a timestamp string in the format YYYY_MM_DD_HH_MM_SS
     std::ostringstream oss;
-    struct tm *utc_time = gmtime(&timestamp_sec);
+    // the pool writes radiometric files in parallel, gmtime would share its result between them
+    struct tm utc_time_storage{};
+    struct tm *utc_time = gmtime_r(&timestamp_sec, &utc_time_storage);
     if (utc_time)
     {
         // filenames will have a bit more resolution to prevent overwritting files if call made within 1 sec
@@ -1627,14 +3212,14 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
     }
     else
     {
-        syslog(LOG_ERR, "Error: Unable to convert utc time for radiometic.");
+        AsyncLog::log(LOG_ERR, "Error: Unable to convert utc time for radiometic.");
         return EXIT_FAILURE;
     }
     std::string timeStr = oss.str();
     // Declare  the default fileName in a broader scope
     std::string fileName = "RadiometricData_" + timeStr + ".csv";
     // File path handling
-    std::string filePath = m_radiometricScreenshotFilePath;
+    std::string filePath = requestedFilePath.string();
 
     std::string home = getHomePath(); // we need the Home path.. incase no path specified
 
@@ -1643,7 +3228,7 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
         // Get the HOME directory
         if (home.empty())
         {
-            syslog(LOG_ERR, "HOME path environment variable is not set");
+            AsyncLog::log(LOG_ERR, "HOME path environment variable is not set");
             return EXIT_FAILURE;
         }
         // Construct the full file path using std::filesystem::path
@@ -1662,7 +3247,7 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
             // HOME directory
             if (home.empty())
             {
-                syslog(LOG_ERR, "HOME environment variable is not set");
+                AsyncLog::log(LOG_ERR, "HOME environment variable is not set");
                 return EXIT_FAILURE;
             }
             // Construct the full file path using std::filesystem::path
@@ -1671,20 +3256,44 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
         }
     }
 
+    if (p_filePath)
+    {
+        *p_filePath = filePath;
+    }
     // before trying to save, can we test this location to see if it is valid
     if( !has_rw_access( filePath )){
         std::string status = "Unable to take radiometric screenshot to: " + filePath + " RW access not allowed!, verify path";
-        syslog(LOG_ERR, "%s" , status.c_str() );
+        AsyncLog::log(LOG_ERR, "%s" , status.c_str() );
+        return EXIT_FAILURE;
+    }
+
+    // an .etr screenshot is a radiometric recording of one frame, compressed like the recordings, read it with echotherm-extract
+    if (std::filesystem::path(filePath).extension() == ".etr")
+    {
+        RadiometricRecorder recorder(filePath, 1, false, compressionThreads);
+        recorder.addFrame(header, headerSize, header->timestamp_utc_ns, header->chipid, frameFormat,
+                          pixels.data, pixels.cols, pixels.rows, pixels.elemSize(), pixels.step);
+        recorder.finish();
+        return recorder.getFrameCount() == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // the csv is formatted through a large stdio buffer, which counts against the memory budget
+    if (!MemoryBudget::tryAcquire(MemoryBudget::Category::RadiometricBuffers, n_radiometricFileBufferSize))
+    {
+        AsyncLog::log(LOG_ERR, "Unable to write radiometric file %s because the memory budget is exhausted", filePath.c_str());
         return EXIT_FAILURE;
     }
+    std::unique_ptr<char[]> p_fileBuffer(new char[n_radiometricFileBufferSize]);
 
     // Open the file and save data
     std::FILE *fp = std::fopen(filePath.c_str(), "w");
     if (fp == nullptr)
     {
-        syslog(LOG_ERR, "Error opening file: %s", filePath.c_str());
+        AsyncLog::log(LOG_ERR, "Error opening file: %s", filePath.c_str());
+        MemoryBudget::release(MemoryBudget::Category::RadiometricBuffers, n_radiometricFileBufferSize);
         return EXIT_FAILURE;
     }
+    std::setvbuf(fp, p_fileBuffer.get(), _IOFBF, n_radiometricFileBufferSize);
 
     // write identifing information at top of file
     fprintf(fp, "File Info:\n");
@@ -1753,7 +3362,7 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
     fprintf(fp, "Frame Data:\n");
     fprintf(fp, "rows,%u\n", header->height);
     fprintf(fp, "cols,%u\n", header->width);
-    switch (m_radiometricFrameFormat)
+    switch (frameFormat)
     {
     case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6:
         fprintf(fp, "format,FIXED_10_6\n");
@@ -1769,13 +3378,13 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
 
     // Log each temperature value to the CSV file.
     // See the documentation for a description of the frame layout.
-    for (size_t y = 0; y < header->height; ++y)
+    for (int y = 0; y < pixels.rows; ++y)
     {
-        void *row = seekframe_get_row(frame, y);
-        for (size_t x = 0; x < header->width; ++x)
+        void const *row = pixels.ptr(y);
+        for (int x = 0; x < pixels.cols; ++x)
         {
             float temperature_degrees_c = 0.0;
-            switch (m_radiometricFrameFormat)
+            switch (frameFormat)
             {
             case SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FIXED_10_6:
                 // Interpret the row data as integers for FIXED_10_6 format
@@ -1798,5 +3407,6 @@ int EchoThermCamera::radiometricWrite(seekframe_t *frame)
         fputc('\n', fp);
     }
     fclose(fp);
+    MemoryBudget::release(MemoryBudget::Category::RadiometricBuffers, n_radiometricFileBufferSize);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
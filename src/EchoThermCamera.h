@@ -7,11 +7,27 @@
 #include <atomic>
 #include <filesystem>
 #include <deque>
+#include <vector>
+#include <chrono>
+#include "FrameTimingMonitor.h"
+#include "Colorizer.h"
+#include "LoopbackOutput.h"
+#include "Overlay.h"
+#include "HotspotDetector.h"
+#include "TemporalFilter.h"
+#include "FrameDecimator.h"
+#include "Isotherm.h"
+#include "SegmentedVideoWriter.h"
+#include "PreRollBuffer.h"
+#include "RadiometricRecorder.h"
+#include "LatestFrameBuffer.h"
+#include "BurstCapture.h"
+#include "WorkerPool.h"
+#include "IntervalCapture.h"
 
 namespace cv
 {
     class Mat;
-    class VideoWriter;
 }
 
 // forward reference
@@ -106,18 +122,155 @@ public:
     void setZoom(double zoom);
     //set the maximum zoom
     void setMaxZoom(double maxZoom);
+    // Instantly move the center of the zoomed view to sensor pixel coordinates (subpixel)
+    // the center is clamped so that the view stays on the sensor, stops any pan motion
+    void setPan(double x, double y);
+    // move the center of the zoomed view back to the center of the sensor
+    void centerPan();
+    // Set the pan rate in displayed pixels per second (the apparent speed is the same at any zoom)
+    // 0 = stopped
+    void setPanRate(double xRate, double yRate);
+    // Set the geometry of the primary loopback output and of the recordings, 0x0 = sensor geometry
+    // the sensor aspect ratio is kept (black bars), the scaling is done by the zoom warp in the same pass
+    // interpolation: 0 = nearest (cv::INTER_NEAREST), 1 = bilinear (cv::INTER_LINEAR), 2 = bicubic (cv::INTER_CUBIC)
+    // the loopback device is reopened when the geometry changes, refused while recording
+    // return a string indicating success or failure
+    std::string setOutputGeometry(int width, int height, int interpolation);
+    // Get a string representing the sensor and output geometry and the interpolation
+    std::string getOutputGeometry() const;
+    // Set the frame rate of the primary loopback output and of the recordings
+    // one frame out of every decimation frames is kept, then frames at rateHz (0 = no limit) from the capture timestamps
+    // dropped frames are neither denoised, colorized, zoomed nor written; refused while recording
+    // return a string indicating success or failure
+    std::string setOutputRate(double rateHz, int decimation);
+    // Get a string representing the output rate settings and the kept and dropped frames
+    std::string getOutputRate() const;
     //start recording to the file path
     //return a string indicating success or failure
     std::string startRecording(std::filesystem::path const& filePath);
-    //take a screenshot of the current frame to the file path
+    // split the next recordings into segments of at most seconds and megabytes, 0 = no limit
+    // each finished segment is a playable mp4, so a power cut only loses the segment being written
+    void setRecordingSegments(double seconds, double megabytes);
+    // encode the next recordings with codec (MP4V, MJPG, FFV1, H264 or AUTO = from the file extension)
+    // on threads encoder threads, 0 = the encoder default
+    //return a string indicating success or failure
+    std::string setRecordingCodec(std::string const& codec, int threads);
+    // Get a string representing the recording codec and the available codecs with their containers
+    std::string getRecordingCodec() const;
+    // the extension of the default file names, the container of the recording codec
+    std::string getRecordingExtension() const;
+    // Get a string representing the current recording and its segments
+    std::string getRecordingStatus() const;
+    // Get a string representing the still encoder threads and the wait and run times of their jobs
+    std::string getStillEncoderStatus() const;
+    // keep the last seconds of output frames (at most maxMegabytes, 0 = no size limit) in memory while not recording,
+    // a recording starts with them; 0 seconds = disabled
+    std::string setPreRoll(double seconds, double maxMegabytes);
+    // Get a string representing the pre-roll settings, the frames held and their memory
+    std::string getPreRoll() const;
+    // record the pre-roll and postRollSeconds of live frames to the file path, then finish the file
+    // a trigger during a triggered recording extends it
     //return a string indicating success or failure
+    std::string trigger(std::filesystem::path const& filePath, double postRollSeconds);
+    //take a screenshot of the current frame to the file path (.jpeg appended without an extension)
+    //the latest output frame is encoded on the screenshot thread, the call does not wait for the next frame
+    //return a string indicating success or failure with the latency
     std::string takeScreenshot(std::filesystem::path const& filePath);
     //stop recording
     //return a string indicating success or failure
     std::string stopRecording();
     //take a thermometic data screenshot of the current frame to the file path
-    //return a string indicating success or failure
+    //the latest thermography frame is written on the screenshot thread
+    //return a string indicating success or failure with the latency
     std::string takeRadiometricScreenshot(std::filesystem::path const& filePath);
+    // capture frameCount consecutive frames at the full frame rate into memory, then write them to the directory
+    // in parallel: output frames as images (imageExtension, e.g. .png, empty = none) and thermography frames
+    // as radiometric files (radiometricExtension .csv or .etr, empty = none)
+    // the burst runs on its own thread, the result is reported by getBurstStatus()
+    //return a string indicating whether the burst started
+    std::string burst(size_t frameCount, std::string const& imageExtension, std::string const& radiometricExtension,
+                      std::filesystem::path const& directory);
+    // Get a string representing the running burst or the result of the last one, with the gaps in the fpa frame count
+    std::string getBurstStatus() const;
+    // time-lapse: capture the frame closest to a tick every intervalSeconds, to one directory per UTC hour below
+    // the directory with a manifest.csv; lowPower decimates the primary output to 1 Hz between captures
+    // unless a recording or the pre-roll is active
+    // a running time-lapse is replaced
+    //return a string indicating success or failure
+    std::string startInterval(double intervalSeconds, bool lowPower, std::string const& imageExtension,
+                              std::string const& radiometricExtension, std::filesystem::path const& directory);
+    std::string stopInterval();
+    // Get a string representing the time-lapse, the cost of its captures and the CPU usage of the daemon
+    std::string getIntervalStatus() const;
+    // record every thermography frame with its frame header losslessly to the file path (.etr),
+    // framesPerChunk frames are written at once by a background thread, read the file with echotherm-extract
+    // direct bypasses the page cache (O_DIRECT) where the file system supports it
+    //return a string indicating success or failure
+    std::string startRadiometricRecording(std::filesystem::path const& filePath, size_t framesPerChunk, bool direct);
+    // compress the next radiometric recordings and .etr radiometric screenshots losslessly (delta prediction + deflate)
+    // on threads compression threads, 0 = half the cores
+    //return a string indicating success or failure
+    std::string setRadiometricCompression(bool enabled, int threads);
+    //finish the radiometric recording
+    //return a string indicating success or failure
+    std::string stopRadiometricRecording();
+    // colorize the FIXED_10_6 thermography frame in the daemon instead of using the SDK color frame
+    // the output keeps the frame format (ARGB or GREY) and uses the color palette
+    // (will cause the capture session to restart)
+    void setColorizer(bool enabled);
+    // the AGC of the colorizer, used while the colorizer is enabled
+    // linear, the range follows the frame minimum and maximum
+    void setAgcLinear();
+    // linear, the range is locked at the temperatures (degrees C)
+    void setAgcLinear(double minTemperature, double maxTemperature);
+    // linear, lock the range currently in use
+    void lockAgc();
+    // histogram equalization, plateau = largest fraction of the pixels counted in one bin (0-1]
+    void setAgcHistEq(double plateau);
+    // fixed temperature window (degrees C), the temperature to color mapping never changes
+    void setAgcWindow(double centerTemperature, double widthTemperature);
+    // Get a string representing the AGC mode, range and cost
+    std::string getAgcStatus() const;
+    // Get a string representing the colorizer state
+    std::string getColorizerStatus() const;
+    // motion-adaptive temporal noise reduction of the primary output before the zoom, 0 = disabled
+    // strength is the fraction of the history kept in static areas (up to TemporalFilter::n_maxStrength)
+    void setDenoise(double strength);
+    // Get a string representing the noise reduction strength and cost
+    std::string getDenoiseStatus() const;
+    // highlight the pixels inside the temperature bands in the primary output (before the zoom), empty = disabled
+    // the bands are evaluated on the thermography frame, in the colorize pass when COLORIZER is ON
+    // with the SDK colorizer enabling or disabling the bands restarts the capture session to add the thermography frame
+    void setIsotherm(std::vector<Isotherm::Band> const &bands);
+    // Get a string representing the bands, the highlighted pixels and the cost
+    std::string getIsothermStatus() const;
+    // burn crosshairs and temperatures of the min, max and spot pixels into the output (after zoom)
+    // bitwise OR of Overlay::Item, zero = disabled
+    void setOverlay(int overlayItems);
+    // Get a string representing the overlay items and drawing cost
+    std::string getOverlayStatus() const;
+    // find and track blobs above the temperature (degrees C) in the thermography frame on a separate thread
+    // blobs with less than minArea pixels are ignored, eventCallback gets one line per analyzed frame with hotspots
+    // (may cause the capture session to restart)
+    void startHotspotDetection(double thresholdTemperature, int minArea, HotspotDetector::EventCallback eventCallback);
+    void stopHotspotDetection();
+    // Get a string representing the hotspot detection settings, the current hotspots and the analysis cost
+    std::string getHotspotStatus() const;
+    // add an additional loopback output fed from the same capture session, or replace the one with the same name
+    // name:device=/dev/videoN,format=ARGB|GREY,palette=SDK|0-8,min=C,max=C,zoom=Z,panx=X,pany=Y,decimate=N,rate=Hz
+    // (may cause the capture session to restart)
+    // return a string indicating success or failure
+    std::string setOutput(std::string const &profileStr);
+    // remove an additional loopback output by name
+    // return a string indicating success or failure
+    std::string removeOutput(std::string const &name);
+    // Get a string representing the additional outputs, their shared stages and per-output cost
+    std::string getOutputs() const;
+    // Get a string representing the frame timing statistics (jitter, missed frames, latency)
+    std::string getFrameStats() const;
+    // set the inter-frame interval in milliseconds above which a stall alarm is raised
+    // zero or negative disables the alarm
+    void setFrameStatsAlarm(double thresholdMs);
 
     void _closeSession();
     
@@ -127,14 +280,46 @@ private:
     void _handleReadyToPair(void *p_camera);
     //void _closeSession();
     void _openSession(bool reconnect);
+    int _getActiveFrameFormat() const;
+    void _restartCaptureSession();
     void _openDevice(int width, int height);
+    void _computeOutputGeometry();
+    cv::Mat _getOutputContent(cv::Mat &outputFrame) const;
+    void _closeDevice();
     void _startShutterClickThread();
     void _stopShutterClickThread();
     void _startRecordingThread();
     void _stopRecordingThread();
-    ssize_t _writeBytes(void* p_frameData, size_t frameDataSize);
+    ssize_t _writeBytes(void* p_frameData, size_t frameDataSize, bool output);
     void _doContinuousZoom();
-    void _pushFrame(int cvFrameType, void* p_frameData);
+    void _doContinuousPan();
+    void _computeRoi();
+    void _warpRoi(cv::Mat const &srcMat, cv::Mat &dstMat) const;
+    double _getDisplayScale() const;
+    void _pushFrame(int cvFrameType, void* p_frameData, bool output);
+    cv::Mat _popRecordingFrame();
+    void _clearRecordingFrameQueue();
+    void _updateRecordingFramesWanted();
+    size_t _flushPreRoll();
+    cv::Mat &_reserveFrame(cv::Mat &frame, int cvFrameType, int width, int height);
+    cv::Mat &_getZoomFrame(int cvFrameType);
+    void _reserveFrameBuffers();
+    void *_denoise(seekframe_t *p_frame, size_t *p_frameDataSize);
+    void *_highlightIsotherm(void *p_cameraFrame, void *p_frameData);
+    void *_colorize(void const *p_thermographyData, size_t thermographyDataSize, size_t *p_frameDataSize);
+    void _updateOverlay(void *p_cameraFrame);
+    void _submitHotspotFrame(void *p_cameraFrame);
+    void _recordRadiometricFrame(void *p_cameraFrame);
+    void _publishThermographyFrame(void *p_cameraFrame);
+    void _runInterval();
+    bool _captureInterval(IntervalCapture::Options const &options, std::filesystem::path const &filePathStem,
+                          std::chrono::steady_clock::time_point tickTime, uint64_t tickUtcNs, IntervalCapture::Capture *p_capture);
+    void _runBurst(std::unique_ptr<BurstCapture> p_burstCapture, std::chrono::milliseconds timeout, std::string const &imageExtension,
+                   std::string const &radiometricExtension, std::filesystem::path const &directory, int compressionThreads);
+    std::string _writeBurst(BurstCapture const &burstCapture, std::string const &imageExtension, std::string const &radiometricExtension,
+                            std::filesystem::path const &directory, int compressionThreads);
+    void _updateColorStages();
+    void _writeOutputs(void *p_cameraFrame, uint64_t captureTimeNs, std::chrono::system_clock::time_point arrivalTime);
     std::string m_loopbackDeviceName;
     std::string m_chipId;
     int m_activeFrameFormat;
@@ -158,16 +343,64 @@ private:
     double m_currentZoom;
     double m_maxZoom;
     std::chrono::system_clock::time_point m_lastZoomTime;
+    double m_panX;
+    double m_panY;
+    double m_panRateX;
+    double m_panRateY;
+    double m_roiOriginX;
+    double m_roiOriginY;
+    // requested output geometry, 0 = sensor geometry
+    int m_requestedOutputWidth;
+    int m_requestedOutputHeight;
+    int m_outputInterpolation;
+    // output frame and the part of it showing the sensor (the rest are black bars)
+    int m_outputWidth;
+    int m_outputHeight;
+    int m_contentX;
+    int m_contentY;
+    int m_contentWidth;
+    int m_contentHeight;
+    std::chrono::system_clock::time_point m_lastPanTime;
     mutable std::recursive_mutex m_mut;
     std::thread m_shutterClickThread;
     std::condition_variable_any m_shutterClickCondition;
     std::atomic_bool m_shutterClickThreadRunning;
-    std::filesystem::path m_screenshotFilePath;
-    std::filesystem::path m_radiometricSreenshotFilePath;
+    struct ScreenshotRequest
+    {
+        // empty for the default radiometric file name
+        std::filesystem::path filePath;
+        bool radiometric;
+        // the thermography format of a radiometric screenshot
+        int frameFormat;
+        // compression threads of an .etr radiometric screenshot
+        int compressionThreads;
+        std::chrono::steady_clock::time_point requestTime;
+    };
+    std::string _requestScreenshot(ScreenshotRequest const &request);
+    std::string _writeScreenshot(ScreenshotRequest const &request);
+    std::string _writeRadiometricScreenshot(ScreenshotRequest const &request);
     std::filesystem::path m_videoFilePath;
-    std::string m_screenshotStatus;
-    mutable std::mutex m_screenshotStatusReadyMut;
-    std::condition_variable m_screenshotStatusReadyCondition;
+    // the latest output frame and thermography frame with its header, written by the frame callback
+    LatestFrameBuffer m_latestOutputFrame;
+    LatestFrameBuffer m_latestThermographyFrame;
+    // the burst being captured, owned by the burst thread, guarded by m_mut
+    BurstCapture *mp_burstCapture;
+    // the burst thread and the burst status, guarded by m_burstMut
+    std::thread m_burstThread;
+    mutable std::mutex m_burstMut;
+    bool m_burstRunning;
+    std::string m_burstStatus;
+    // encodes and writes the screenshots and the frames of a burst
+    WorkerPool m_workerPool;
+    // the time-lapse and its timer thread, guarded by m_intervalMut
+    std::unique_ptr<IntervalCapture> mp_intervalCapture;
+    mutable std::mutex m_intervalMut;
+    std::condition_variable m_intervalCondition;
+    std::thread m_intervalThread;
+    bool m_intervalThreadRunning;
+    // between the captures of a low power time-lapse, the primary output keeps the frames of m_intervalIdleDecimator
+    std::atomic_bool m_intervalIdle;
+    FrameDecimator m_intervalIdleDecimator;
     std::string m_recordingStatus;
     mutable std::mutex m_recordingStatusReadyMut;
     std::condition_variable m_recordingStatusReadyCondition;
@@ -176,12 +409,48 @@ private:
     std::condition_variable m_recordingFramesReadyCondition;
     std::thread m_recordingThread;
     std::atomic_bool m_recordingThreadRunning;
-    std::unique_ptr<cv::VideoWriter> mp_videoWriter;
+    std::unique_ptr<SegmentedVideoWriter> mp_videoWriter;
+    // a recording writer exists or the pre-roll is enabled, checked by the frame callback before it takes the queue lock
+    std::atomic_bool m_recordingFramesWanted;
+    // limits of the recording segments, 0 = no limit
+    double m_segmentSeconds;
+    double m_segmentMegabytes;
+    // codec of the recordings, nullptr = from the file extension, and the encoder threads (0 = encoder default)
+    VideoEncoder::Codec const *mp_recordingCodec;
+    int m_recordingThreads;
+    // guarded by m_recordingFrameQueueMut like the queue it feeds
+    PreRollBuffer m_preRollBuffer;
+    // capture time of the frame being written and of the last frame recorded or kept for pre-roll
+    uint64_t m_frameCaptureTimeNs;
+    uint32_t m_frameFpaCount;
+    uint64_t m_lastRecordingFrameNs;
+    // capture time that ends a triggered recording, 0 = not triggered
+    uint64_t m_triggerStopTimeNs;
+    // the post-roll is complete, the recording thread finishes the file once the queue is written
+    bool m_recordingStopRequested;
+    std::unique_ptr<cv::Mat> mp_zoomFrame;
+    std::unique_ptr<cv::Mat> mp_colorFrame;
 
     int m_frameNum;
     int m_radiometricFrameFormat;
-    int m_radiometricFrameCapture;  
-    int m_radiometricFrameCaptureBusy;
-    std::filesystem::path m_radiometricScreenshotFilePath;
-    int radiometricWrite(seekframe_t* frame);
+    // guarded by m_mut, fed by the frame callback
+    std::unique_ptr<RadiometricRecorder> mp_radiometricRecorder;
+    // compression threads of the radiometric files, 0 = uncompressed, guarded by m_mut
+    int m_radiometricCompressionThreads;
+    // write a thermography frame with its camera frame header as csv, or as a one frame radiometric recording (.etr)
+    // the file path defaults to RadiometricData_[UTC].csv in the home directory, p_filePath receives the path written
+    int radiometricWrite(void const* p_header, size_t headerSize, cv::Mat const& pixels, int frameFormat, int compressionThreads,
+                         std::filesystem::path const& requestedFilePath, std::string* p_filePath);
+    FrameTimingMonitor m_frameTimingMonitor;
+    Isotherm m_isotherm;
+    Colorizer m_colorizer;
+    bool m_colorizerEnabled;
+    TemporalFilter m_temporalFilter;
+    // frame selection of the primary output
+    FrameDecimator m_frameDecimator;
+    Overlay m_overlay;
+    HotspotDetector m_hotspotDetector;
+    std::vector<std::unique_ptr<LoopbackOutput>> m_outputs;
+    std::vector<std::unique_ptr<ColorStage>> m_colorStages;
+    uint64_t m_outputFrameNum;
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "FrameDecimator.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // weight of a new interval in the smoothed source interval
+    constexpr static inline auto const n_intervalSmoothing = 1.0 / 16.0;
+}
+
+FrameDecimator::FrameDecimator()
+    : m_decimation{1},
+      m_rate{0.0},
+      m_periodNs{0},
+      m_frameCount{0},
+      m_started{false},
+      m_nextKeepNs{0},
+      m_lastCaptureTimeNs{0},
+      m_sourceIntervalNs{0.0},
+      m_keptCount{0},
+      m_droppedCount{0}
+{
+}
+
+void FrameDecimator::setDecimation(int decimation)
+{
+    m_decimation = std::max(1, decimation);
+    reset();
+}
+
+int FrameDecimator::getDecimation() const
+{
+    return m_decimation;
+}
+
+void FrameDecimator::setRate(double rateHz)
+{
+    m_rate = std::isfinite(rateHz) && rateHz > 0.0 ? rateHz : 0.0;
+    m_periodNs = m_rate > 0.0 ? uint64_t(std::llround(1e9 / m_rate)) : 0;
+    reset();
+}
+
+double FrameDecimator::getRate() const
+{
+    return m_rate;
+}
+
+void FrameDecimator::reset()
+{
+    m_frameCount = 0;
+    m_started = false;
+    m_nextKeepNs = 0;
+    m_lastCaptureTimeNs = 0;
+    m_sourceIntervalNs = 0.0;
+}
+
+bool FrameDecimator::select(uint64_t captureTimeNs)
+{
+    if (m_lastCaptureTimeNs != 0 && captureTimeNs > m_lastCaptureTimeNs)
+    {
+        auto const intervalNs = double(captureTimeNs - m_lastCaptureTimeNs);
+        m_sourceIntervalNs = m_sourceIntervalNs > 0.0 ? m_sourceIntervalNs + (intervalNs - m_sourceIntervalNs) * n_intervalSmoothing : intervalNs;
+    }
+    m_lastCaptureTimeNs = captureTimeNs;
+    bool keep = m_frameCount++ % uint64_t(m_decimation) == 0;
+    if (keep && m_periodNs > 0)
+    {
+        auto const toleranceNs = uint64_t(m_sourceIntervalNs / 2.0);
+        if (!m_started)
+        {
+            m_started = true;
+            m_nextKeepNs = captureTimeNs + m_periodNs;
+        }
+        else if (captureTimeNs + toleranceNs < m_nextKeepNs)
+        {
+            keep = false;
+        }
+        else
+        {
+            m_nextKeepNs += m_periodNs;
+            if (m_nextKeepNs + toleranceNs <= captureTimeNs)
+            {
+                // a stall, or the source is slower than the rate: restart the phase from this frame
+                m_nextKeepNs = captureTimeNs + m_periodNs;
+            }
+        }
+    }
+    ++(keep ? m_keptCount : m_droppedCount);
+    return keep;
+}
+
+double FrameDecimator::getOutputRate(double sourceIntervalNs) const
+{
+    if (sourceIntervalNs <= 0.0)
+    {
+        return 0.0;
+    }
+    auto const rate = 1e9 / sourceIntervalNs / m_decimation;
+    return m_rate > 0.0 ? std::min(rate, m_rate) : rate;
+}
+
+std::string FrameDecimator::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "decimate=" << m_decimation;
+    ss << ", rateHz=";
+    if (m_rate > 0.0)
+    {
+        ss << m_rate;
+    }
+    else
+    {
+        ss << "all";
+    }
+    ss << ", sourceHz=" << (m_sourceIntervalNs > 0.0 ? 1e9 / m_sourceIntervalNs : 0.0);
+    ss << ", kept=" << m_keptCount;
+    ss << ", dropped=" << m_droppedCount;
+    ss << "}";
+    return ss.str();
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Selects the frames an output processes, so that dropped frames cost nothing downstream.
+// Decimation keeps one frame out of every N, the rate limit keeps frames from the capture
+// timestamps: a frame is kept when its timestamp reaches the next deadline and the deadline then
+// advances by exactly one output period, so the kept frames stay in phase with the capture clock
+// (27 Hz to 10 Hz keeps 3,3,2 frame steps that average exactly 10 Hz) instead of drifting.
+// Half of the measured source interval is allowed as jitter so a late frame is not dropped.
+class FrameDecimator
+{
+public:
+    FrameDecimator();
+    // keep one frame out of every decimation frames, 1 = every frame
+    void setDecimation(int decimation);
+    int getDecimation() const;
+    // keep frames at rateHz (after the decimation), 0 = no rate limit
+    void setRate(double rateHz);
+    double getRate() const;
+    // restart the frame selection, the next frame is kept
+    void reset();
+    // capture timestamp of the frame in nanoseconds, returns false for the frames to be dropped
+    bool select(uint64_t captureTimeNs);
+    // rate of the kept frames from the mean source frame interval, zero if the interval is unknown
+    double getOutputRate(double sourceIntervalNs) const;
+    // Get a string representing the settings and the kept and dropped frames
+    std::string getStatus() const;
+
+private:
+    int m_decimation;
+    double m_rate;
+    uint64_t m_periodNs;
+    uint64_t m_frameCount;
+    bool m_started;
+    uint64_t m_nextKeepNs;
+    uint64_t m_lastCaptureTimeNs;
+    // smoothed source frame interval, the jitter allowance
+    double m_sourceIntervalNs;
+    uint64_t m_keptCount;
+    uint64_t m_droppedCount;
+};
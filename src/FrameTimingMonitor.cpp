@@ -0,0 +1,233 @@
+#include "FrameTimingMonitor.h"
+#include "AsyncLog.h"
+#include <syslog.h>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+    constexpr static inline auto const n_defaultAlarmThresholdMs = 100.0;
+    // an alarm is reported as active for this long after the last stall
+    constexpr static inline auto const n_alarmHoldNs = uint64_t(10'000'000'000);
+    // stalls closer together than this are logged only once
+    constexpr static inline auto const n_alarmLogIntervalNs = uint64_t(1'000'000'000);
+}
+
+FrameTimingMonitor::FrameTimingMonitor()
+    : m_samples{},
+      m_sampleCount{0},
+      m_nextSample{0},
+      m_intervalSum{0.0},
+      m_intervalSumSq{0.0},
+      m_latencySum{0.0},
+      m_processingSum{0.0},
+      m_windowMissedFrames{0},
+      m_lastCaptureTimeNs{0},
+      m_lastFpaFrameCount{0},
+      m_fpaFrameStep{0},
+      m_hasLastFrame{false},
+      m_totalFrames{0},
+      m_totalMissedFrames{0},
+      m_alarmThresholdMs{n_defaultAlarmThresholdMs},
+      m_alarmCount{0},
+      m_lastAlarmTimeNs{0},
+      m_startTimeNs{0},
+      m_sessionStartTimeNs{0},
+      m_disconnectTimeNs{0},
+      m_awaitingFirstFrame{false},
+      m_timeToFirstFrameNs{0},
+      m_sessionToFirstFrameNs{0},
+      m_lastReconnectNs{0},
+      m_reconnectCount{0}
+{
+}
+
+void FrameTimingMonitor::reset()
+{
+    m_sampleCount = 0;
+    m_nextSample = 0;
+    m_intervalSum = 0.0;
+    m_intervalSumSq = 0.0;
+    m_latencySum = 0.0;
+    m_processingSum = 0.0;
+    m_windowMissedFrames = 0;
+    m_lastCaptureTimeNs = 0;
+    m_lastFpaFrameCount = 0;
+    m_fpaFrameStep = 0;
+    m_hasLastFrame = false;
+}
+
+void FrameTimingMonitor::markStart(uint64_t timeNs)
+{
+    m_startTimeNs = timeNs;
+    m_sessionStartTimeNs = 0;
+    m_disconnectTimeNs = 0;
+    m_awaitingFirstFrame = false;
+    m_timeToFirstFrameNs = 0;
+    m_sessionToFirstFrameNs = 0;
+    m_lastReconnectNs = 0;
+    m_reconnectCount = 0;
+}
+
+void FrameTimingMonitor::markSessionStart(uint64_t timeNs)
+{
+    m_sessionStartTimeNs = timeNs;
+    m_awaitingFirstFrame = true;
+}
+
+void FrameTimingMonitor::markDisconnect(uint64_t timeNs)
+{
+    m_disconnectTimeNs = timeNs;
+    m_awaitingFirstFrame = false;
+}
+
+void FrameTimingMonitor::addFrame(uint64_t captureTimeNs, uint32_t fpaFrameCount, uint64_t arrivalTimeNs, uint64_t processingTimeNs)
+{
+    ++m_totalFrames;
+    if (m_awaitingFirstFrame)
+    {
+        // the frame has reached the loopback device once processing is done
+        auto const deliveredTimeNs = arrivalTimeNs + processingTimeNs;
+        m_awaitingFirstFrame = false;
+        m_sessionToFirstFrameNs = deliveredTimeNs - m_sessionStartTimeNs;
+        if (m_timeToFirstFrameNs == 0 && m_startTimeNs != 0)
+        {
+            m_timeToFirstFrameNs = deliveredTimeNs - m_startTimeNs;
+            AsyncLog::log(LOG_NOTICE, "First frame delivered %.1f ms after start (%.1f ms after the capture session opened).",
+                          double(m_timeToFirstFrameNs) / 1e6, double(m_sessionToFirstFrameNs) / 1e6);
+        }
+        else if (m_disconnectTimeNs != 0)
+        {
+            m_lastReconnectNs = deliveredTimeNs - m_disconnectTimeNs;
+            m_disconnectTimeNs = 0;
+            ++m_reconnectCount;
+            AsyncLog::log(LOG_NOTICE, "First frame delivered %.1f ms after the camera disconnected (%.1f ms after the capture session opened).",
+                          double(m_lastReconnectNs) / 1e6, double(m_sessionToFirstFrameNs) / 1e6);
+        }
+    }
+    if (!m_hasLastFrame)
+    {
+        // the first frame has no interval to measure
+        m_hasLastFrame = true;
+        m_lastCaptureTimeNs = captureTimeNs;
+        m_lastFpaFrameCount = fpaFrameCount;
+        return;
+    }
+    Sample sample{};
+    sample.intervalNs = int64_t(captureTimeNs - m_lastCaptureTimeNs);
+    sample.latencyNs = int64_t(arrivalTimeNs - captureTimeNs);
+    sample.processingNs = int64_t(processingTimeNs);
+    // the FPA may run faster than the delivered frame rate, so learn the nominal step
+    // from the smallest increment seen and count anything larger as missed frames
+    uint32_t const fpaDelta = fpaFrameCount - m_lastFpaFrameCount;
+    if (fpaDelta > 0 && (m_fpaFrameStep == 0 || fpaDelta < m_fpaFrameStep))
+    {
+        m_fpaFrameStep = fpaDelta;
+    }
+    if (m_fpaFrameStep > 0 && fpaDelta > m_fpaFrameStep)
+    {
+        sample.missedFrames = fpaDelta / m_fpaFrameStep - 1;
+    }
+    m_lastCaptureTimeNs = captureTimeNs;
+    m_lastFpaFrameCount = fpaFrameCount;
+
+    // evict the oldest sample once the window is full
+    if (m_sampleCount == n_windowSize)
+    {
+        auto const &oldest = m_samples[m_nextSample];
+        m_intervalSum -= double(oldest.intervalNs);
+        m_intervalSumSq -= double(oldest.intervalNs) * double(oldest.intervalNs);
+        m_latencySum -= double(oldest.latencyNs);
+        m_processingSum -= double(oldest.processingNs);
+        m_windowMissedFrames -= oldest.missedFrames;
+    }
+    else
+    {
+        ++m_sampleCount;
+    }
+    m_samples[m_nextSample] = sample;
+    m_nextSample = (m_nextSample + 1) % n_windowSize;
+    m_intervalSum += double(sample.intervalNs);
+    m_intervalSumSq += double(sample.intervalNs) * double(sample.intervalNs);
+    m_latencySum += double(sample.latencyNs);
+    m_processingSum += double(sample.processingNs);
+    m_windowMissedFrames += sample.missedFrames;
+    m_totalMissedFrames += sample.missedFrames;
+
+    if (m_alarmThresholdMs > 0 && double(sample.intervalNs) > m_alarmThresholdMs * 1e6)
+    {
+        ++m_alarmCount;
+        if (m_lastAlarmTimeNs == 0 || captureTimeNs - m_lastAlarmTimeNs > n_alarmLogIntervalNs)
+        {
+            AsyncLog::log(LOG_WARNING, "Frame stall: %.1f ms between frames (%u missed), processing took %.1f ms.",
+                          double(sample.intervalNs) / 1e6, sample.missedFrames, double(sample.processingNs) / 1e6);
+        }
+        m_lastAlarmTimeNs = captureTimeNs;
+    }
+}
+
+void FrameTimingMonitor::setAlarmThreshold(double thresholdMs)
+{
+    if (thresholdMs != thresholdMs)
+    {
+        thresholdMs = n_defaultAlarmThresholdMs;
+    }
+    m_alarmThresholdMs = thresholdMs;
+}
+
+double FrameTimingMonitor::getAlarmThreshold() const
+{
+    return m_alarmThresholdMs;
+}
+
+double FrameTimingMonitor::getMeanIntervalNs() const
+{
+    return m_sampleCount > 0 ? m_intervalSum / double(m_sampleCount) : 0.0;
+}
+
+std::string FrameTimingMonitor::getStats() const
+{
+    double meanIntervalMs = 0.0;
+    double jitterMs = 0.0;
+    double maxIntervalMs = 0.0;
+    double meanLatencyMs = 0.0;
+    double maxLatencyMs = 0.0;
+    double meanProcessingMs = 0.0;
+    double maxProcessingMs = 0.0;
+    if (m_sampleCount > 0)
+    {
+        auto const count = double(m_sampleCount);
+        auto const meanIntervalNs = m_intervalSum / count;
+        meanIntervalMs = meanIntervalNs / 1e6;
+        jitterMs = std::sqrt(std::max(0.0, m_intervalSumSq / count - meanIntervalNs * meanIntervalNs)) / 1e6;
+        meanLatencyMs = m_latencySum / count / 1e6;
+        meanProcessingMs = m_processingSum / count / 1e6;
+        for (size_t i = 0; i < m_sampleCount; ++i)
+        {
+            maxIntervalMs = std::max(maxIntervalMs, double(m_samples[i].intervalNs) / 1e6);
+            maxLatencyMs = std::max(maxLatencyMs, double(m_samples[i].latencyNs) / 1e6);
+            maxProcessingMs = std::max(maxProcessingMs, double(m_samples[i].processingNs) / 1e6);
+        }
+    }
+    bool const alarmActive = m_lastAlarmTimeNs != 0 && m_lastCaptureTimeNs - m_lastAlarmTimeNs < n_alarmHoldNs;
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "frames=" << m_totalFrames;
+    ss << ", missedFrames=" << m_totalMissedFrames;
+    ss << ", window={frames=" << m_sampleCount;
+    ss << ", missedFrames=" << m_windowMissedFrames;
+    ss << ", intervalMs={mean=" << meanIntervalMs << ", jitter=" << jitterMs << ", max=" << maxIntervalMs << "}";
+    ss << ", latencyMs={mean=" << meanLatencyMs << ", max=" << maxLatencyMs << "}";
+    ss << ", processingMs={mean=" << meanProcessingMs << ", max=" << maxProcessingMs << "}";
+    ss << "}";
+    ss << ", alarm={thresholdMs=" << m_alarmThresholdMs << ", count=" << m_alarmCount << ", active=" << (alarmActive ? "true" : "false") << "}";
+    ss << ", startup={timeToFirstFrameMs=" << double(m_timeToFirstFrameNs) / 1e6;
+    ss << ", sessionToFirstFrameMs=" << double(m_sessionToFirstFrameNs) / 1e6;
+    ss << ", reconnects=" << m_reconnectCount;
+    ss << ", lastReconnectMs=" << double(m_lastReconnectNs) / 1e6 << "}";
+    ss << "}";
+    return ss.str();
+}
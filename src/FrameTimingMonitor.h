@@ -0,0 +1,74 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Rolling statistics on frame delivery built from the seekcamera frame header.
+// Inter-frame interval jitter and fpa_frame_count gaps point at the USB bus,
+// while the callback processing time points at our own pipeline.
+// EchoThermCamera updates and reads it under m_mut (frame callback, disconnect event, FRAMESTATS).
+class FrameTimingMonitor
+{
+public:
+    FrameTimingMonitor();
+    // forget the previous frame, e.g. when a new capture session starts
+    void reset();
+    // record one frame
+    // captureTimeNs = timestamp_utc_ns from the frame header
+    // fpaFrameCount = fpa_frame_count from the frame header
+    // arrivalTimeNs = UTC time at which the frame callback was entered
+    // processingTimeNs = time spent in the frame callback
+    void addFrame(uint64_t captureTimeNs, uint32_t fpaFrameCount, uint64_t arrivalTimeNs, uint64_t processingTimeNs);
+    // inter-frame interval (in milliseconds) above which the stall alarm is raised
+    // zero or negative disables the alarm
+    void setAlarmThreshold(double thresholdMs);
+    double getAlarmThreshold() const;
+    // mean inter-frame interval over the window in nanoseconds, zero if unknown
+    double getMeanIntervalNs() const;
+    // startup and reconnect latency, these are kept across reset()
+    // times are UTC nanoseconds, the same clock as arrivalTimeNs
+    // the camera manager was started, the next frame measures time-to-first-frame
+    void markStart(uint64_t timeNs);
+    // a capture session was opened, the next frame measures session-to-first-frame
+    void markSessionStart(uint64_t timeNs);
+    // the camera disconnected, the first frame after the next session measures time-to-reconnect
+    void markDisconnect(uint64_t timeNs);
+    // Get a string representing the current statistics
+    std::string getStats() const;
+
+private:
+    struct Sample
+    {
+        int64_t intervalNs;
+        int64_t latencyNs;
+        int64_t processingNs;
+        uint32_t missedFrames;
+    };
+    // 10 seconds at 27 Hz
+    static constexpr size_t n_windowSize = 270;
+    std::array<Sample, n_windowSize> m_samples;
+    size_t m_sampleCount;
+    size_t m_nextSample;
+    double m_intervalSum;
+    double m_intervalSumSq;
+    double m_latencySum;
+    double m_processingSum;
+    uint64_t m_windowMissedFrames;
+    uint64_t m_lastCaptureTimeNs;
+    uint32_t m_lastFpaFrameCount;
+    uint32_t m_fpaFrameStep;
+    bool m_hasLastFrame;
+    uint64_t m_totalFrames;
+    uint64_t m_totalMissedFrames;
+    double m_alarmThresholdMs;
+    uint64_t m_alarmCount;
+    uint64_t m_lastAlarmTimeNs;
+    uint64_t m_startTimeNs;
+    uint64_t m_sessionStartTimeNs;
+    uint64_t m_disconnectTimeNs;
+    bool m_awaitingFirstFrame;
+    uint64_t m_timeToFirstFrameNs;
+    uint64_t m_sessionToFirstFrameNs;
+    uint64_t m_lastReconnectNs;
+    uint64_t m_reconnectCount;
+};
@@ -0,0 +1,499 @@
+#include "HotspotDetector.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOTSPOT_HAS_AVX2 1
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define HOTSPOT_HAS_NEON 1
+#endif
+
+namespace
+{
+    // FIXED_10_6: degrees C = value / 64 - 40
+    constexpr static inline auto const n_fixedScale = 64.0;
+    constexpr static inline auto const n_fixedOffset = 40.0;
+    // a hotspot is matched to a blob whose centroid is within this many pixels,
+    // or within half the size of the hotspot when it is larger
+    constexpr static inline auto const n_minTrackDistance = 8.0;
+    // a hotspot that is not found in this many consecutive frames is reported as lost
+    constexpr static inline auto const n_maxMissedFrames = 3;
+
+    double _toTemperature(double raw)
+    {
+        return raw / n_fixedScale - n_fixedOffset;
+    }
+
+    uint16_t _toRaw(double temperature)
+    {
+        return (uint16_t)std::lround(std::clamp((temperature + n_fixedOffset) * n_fixedScale, 0.0, 65535.0));
+    }
+
+    void _thresholdScalar(uint16_t const *p_src, int width, uint16_t threshold, uint8_t *p_mask)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            p_mask[x] = p_src[x] >= threshold ? 255 : 0;
+        }
+    }
+
+#ifdef HOTSPOT_HAS_AVX2
+    __attribute__((target("avx2"))) void _thresholdAvx2(uint16_t const *p_src, int width, uint16_t threshold, uint8_t *p_mask)
+    {
+        auto const thresholdV = _mm256_set1_epi16((short)threshold);
+        int x = 0;
+        for (; x + 32 <= width; x += 32)
+        {
+            auto const first = _mm256_loadu_si256((__m256i const *)(p_src + x));
+            auto const second = _mm256_loadu_si256((__m256i const *)(p_src + x + 16));
+            // unsigned value >= threshold <=> max(value, threshold) == value
+            auto const firstMask = _mm256_cmpeq_epi16(_mm256_max_epu16(first, thresholdV), first);
+            auto const secondMask = _mm256_cmpeq_epi16(_mm256_max_epu16(second, thresholdV), second);
+            // the pack works per 128 bit lane, put the quarters back in order
+            auto const packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(firstMask, secondMask), 0xD8);
+            _mm256_storeu_si256((__m256i *)(p_mask + x), packed);
+        }
+        _thresholdScalar(p_src + x, width - x, threshold, p_mask + x);
+    }
+#endif
+
+#ifdef HOTSPOT_HAS_NEON
+    void _thresholdNeon(uint16_t const *p_src, int width, uint16_t threshold, uint8_t *p_mask)
+    {
+        auto const thresholdV = vdupq_n_u16(threshold);
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            auto const first = vmovn_u16(vcgeq_u16(vld1q_u16(p_src + x), thresholdV));
+            auto const second = vmovn_u16(vcgeq_u16(vld1q_u16(p_src + x + 8), thresholdV));
+            vst1q_u8(p_mask + x, vcombine_u8(first, second));
+        }
+        _thresholdScalar(p_src + x, width - x, threshold, p_mask + x);
+    }
+#endif
+
+    bool _hasVectorSupport()
+    {
+#if defined(HOTSPOT_HAS_AVX2)
+        return __builtin_cpu_supports("avx2");
+#elif defined(HOTSPOT_HAS_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void _threshold(bool vectorized, uint16_t const *p_src, int width, uint16_t threshold, uint8_t *p_mask)
+    {
+#if defined(HOTSPOT_HAS_AVX2)
+        if (vectorized)
+        {
+            _thresholdAvx2(p_src, width, threshold, p_mask);
+            return;
+        }
+#elif defined(HOTSPOT_HAS_NEON)
+        if (vectorized)
+        {
+            _thresholdNeon(p_src, width, threshold, p_mask);
+            return;
+        }
+#endif
+        _thresholdScalar(p_src, width, threshold, p_mask);
+    }
+
+    void _formatHotspot(std::stringstream &ss, HotspotDetector::Hotspot const &hotspot)
+    {
+        ss << "{id=" << hotspot.id
+           << ", x=" << std::setprecision(1) << hotspot.x << ", y=" << hotspot.y
+           << ", area=" << hotspot.area
+           << ", maxC=" << hotspot.maxTemperature
+           << ", box={" << hotspot.left << "," << hotspot.top << "," << hotspot.width << "," << hotspot.height << "}"
+           << ", age=" << hotspot.age << "}";
+    }
+
+    void _formatIds(std::stringstream &ss, std::vector<int> const &ids)
+    {
+        ss << "[";
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            ss << (i > 0 ? "," : "") << ids[i];
+        }
+        ss << "]";
+    }
+}
+
+HotspotDetector::HotspotDetector()
+    : m_mut{},
+      m_frameReadyCondition{},
+      m_thread{},
+      m_running{false},
+      m_vectorized{_hasVectorSupport()},
+      m_threshold{0},
+      m_minArea{1},
+      m_eventCallback{},
+      m_pendingFrame{},
+      m_analysisFrame{},
+      m_framePending{false},
+      m_width{0},
+      m_height{0},
+      m_frameNum{0},
+      mp_mask{std::make_unique<cv::Mat>()},
+      mp_labels{std::make_unique<cv::Mat>()},
+      mp_stats{std::make_unique<cv::Mat>()},
+      mp_centroids{std::make_unique<cv::Mat>()},
+      m_hotspotsMut{},
+      m_hotspots{},
+      m_nextId{1},
+      m_submittedCount{0},
+      m_supersededCount{0},
+      m_analyzedCount{0},
+      m_eventCount{0},
+      m_analysisSumNs{0.0},
+      m_analysisMaxNs{0.0}
+{
+}
+
+HotspotDetector::~HotspotDetector()
+{
+    stop();
+}
+
+void HotspotDetector::start(double thresholdTemperature, int minArea, EventCallback eventCallback)
+{
+    stop();
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    m_threshold = _toRaw(thresholdTemperature);
+    m_minArea = std::max(1, minArea);
+    m_eventCallback = std::move(eventCallback);
+    m_framePending = false;
+    m_submittedCount = 0;
+    m_supersededCount = 0;
+    m_analyzedCount = 0;
+    m_eventCount = 0;
+    m_analysisSumNs = 0.0;
+    m_analysisMaxNs = 0.0;
+    m_nextId = 1;
+    m_running = true;
+    m_thread = std::thread(&HotspotDetector::_run, this);
+}
+
+void HotspotDetector::stop()
+{
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (!m_running)
+        {
+            return;
+        }
+        m_running = false;
+    }
+    m_frameReadyCondition.notify_all();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    MemoryBudget::release(MemoryBudget::Category::FramePool, (m_pendingFrame.capacity() + m_analysisFrame.capacity()) * sizeof(uint16_t));
+    m_pendingFrame = {};
+    m_analysisFrame = {};
+    m_framePending = false;
+    m_eventCallback = nullptr;
+    std::lock_guard<decltype(m_hotspotsMut)> hotspotsLock{m_hotspotsMut};
+    m_hotspots.clear();
+}
+
+bool HotspotDetector::isRunning() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    return m_running;
+}
+
+void HotspotDetector::setVectorized(bool vectorized)
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    m_vectorized = vectorized && _hasVectorSupport();
+}
+
+void HotspotDetector::submit(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    TRACE_SCOPE("HotspotDetector::submit");
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (!m_running)
+        {
+            return;
+        }
+        ++m_submittedCount;
+        if (m_framePending)
+        {
+            // the analysis did not keep up, only the latest frame is worth analyzing
+            ++m_supersededCount;
+        }
+        auto const capacity = m_pendingFrame.capacity();
+        m_pendingFrame.resize(size_t(width) * size_t(height));
+        if (m_pendingFrame.capacity() > capacity)
+        {
+            MemoryBudget::acquire(MemoryBudget::Category::FramePool, (m_pendingFrame.capacity() - capacity) * sizeof(uint16_t));
+        }
+        for (int y = 0; y < height; ++y)
+        {
+            std::memcpy(m_pendingFrame.data() + size_t(y) * size_t(width), (uint8_t const *)p_src + size_t(y) * srcStride, size_t(width) * sizeof(uint16_t));
+        }
+        m_width = width;
+        m_height = height;
+        m_frameNum = m_submittedCount;
+        m_framePending = true;
+    }
+    m_frameReadyCondition.notify_one();
+}
+
+std::vector<HotspotDetector::Hotspot> HotspotDetector::getHotspots() const
+{
+    std::lock_guard<decltype(m_hotspotsMut)> lock{m_hotspotsMut};
+    std::vector<Hotspot> hotspots;
+    std::copy_if(std::begin(m_hotspots), std::end(m_hotspots), std::back_inserter(hotspots), [](auto const &hotspot)
+                 { return hotspot.missed == 0; });
+    return hotspots;
+}
+
+std::vector<HotspotDetector::Hotspot> HotspotDetector::detect(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    TRACE_SCOPE("HotspotDetector::detect");
+    uint16_t threshold = 0;
+    int minArea = 1;
+    bool vectorized = false;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        threshold = m_threshold;
+        minArea = m_minArea;
+        vectorized = m_vectorized;
+    }
+    auto &mask = *mp_mask;
+    mask.create(height, width, CV_8U);
+    for (int y = 0; y < height; ++y)
+    {
+        _threshold(vectorized, (uint16_t const *)((uint8_t const *)p_src + size_t(y) * srcStride), width, threshold, mask.ptr<uint8_t>(y));
+    }
+    auto const labelCount = cv::connectedComponentsWithStats(mask, *mp_labels, *mp_stats, *mp_centroids, 8, CV_32S);
+    std::vector<Hotspot> hotspots;
+    // label 0 is the background
+    for (int label = 1; label < labelCount; ++label)
+    {
+        auto const area = mp_stats->at<int>(label, cv::CC_STAT_AREA);
+        if (area < minArea)
+        {
+            continue;
+        }
+        Hotspot hotspot{};
+        hotspot.x = mp_centroids->at<double>(label, 0);
+        hotspot.y = mp_centroids->at<double>(label, 1);
+        hotspot.area = area;
+        hotspot.left = mp_stats->at<int>(label, cv::CC_STAT_LEFT);
+        hotspot.top = mp_stats->at<int>(label, cv::CC_STAT_TOP);
+        hotspot.width = mp_stats->at<int>(label, cv::CC_STAT_WIDTH);
+        hotspot.height = mp_stats->at<int>(label, cv::CC_STAT_HEIGHT);
+        // the peak is searched in the bounding box only
+        uint16_t peak = 0;
+        for (int y = hotspot.top; y < hotspot.top + hotspot.height; ++y)
+        {
+            auto const *const p_labelRow = mp_labels->ptr<int>(y);
+            auto const *const p_srcRow = (uint16_t const *)((uint8_t const *)p_src + size_t(y) * srcStride);
+            for (int x = hotspot.left; x < hotspot.left + hotspot.width; ++x)
+            {
+                if (p_labelRow[x] == label)
+                {
+                    peak = std::max(peak, p_srcRow[x]);
+                }
+            }
+        }
+        hotspot.maxTemperature = (float)_toTemperature(peak);
+        hotspots.push_back(hotspot);
+    }
+    return hotspots;
+}
+
+std::string HotspotDetector::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        ss << "{enabled=" << (m_running ? "true" : "false");
+        ss << ", thresholdC=" << std::setprecision(1) << _toTemperature(m_threshold);
+        ss << ", minArea=" << m_minArea;
+        ss << ", vectorized=" << (m_vectorized ? "true" : "false");
+        ss << ", submitted=" << m_submittedCount;
+        ss << ", superseded=" << m_supersededCount;
+        ss << ", analyzed=" << m_analyzedCount;
+        ss << ", events=" << m_eventCount;
+        ss << ", analysisMs={mean=" << std::setprecision(3) << (m_analyzedCount > 0 ? m_analysisSumNs / double(m_analyzedCount) / 1e6 : 0.0)
+           << ", max=" << m_analysisMaxNs / 1e6 << "}";
+    }
+    ss << ", hotspots=[";
+    auto const hotspots = getHotspots();
+    for (size_t i = 0; i < hotspots.size(); ++i)
+    {
+        ss << (i > 0 ? ", " : "");
+        _formatHotspot(ss, hotspots[i]);
+    }
+    ss << "]}";
+    return ss.str();
+}
+
+void HotspotDetector::_run()
+{
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    while (true)
+    {
+        m_frameReadyCondition.wait(lock, [this]()
+                                   { return m_framePending || !m_running; });
+        if (!m_running)
+        {
+            break;
+        }
+        std::swap(m_pendingFrame, m_analysisFrame);
+        m_framePending = false;
+        auto const width = m_width;
+        auto const height = m_height;
+        auto const frameNum = m_frameNum;
+        lock.unlock();
+
+        TRACE_SCOPE("HotspotDetector::analyze");
+        auto const startTime = std::chrono::steady_clock::now();
+        std::vector<int> appeared;
+        auto const lost = _track(detect(m_analysisFrame.data(), size_t(width) * sizeof(uint16_t), width, height), &appeared);
+        auto const analysisNs = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+        std::string event;
+        if (!lost.empty() || !getHotspots().empty())
+        {
+            event = _formatEvent(frameNum, analysisNs, appeared, lost);
+        }
+
+        lock.lock();
+        ++m_analyzedCount;
+        m_analysisSumNs += analysisNs;
+        m_analysisMaxNs = std::max(m_analysisMaxNs, analysisNs);
+        if (!event.empty() && m_eventCallback)
+        {
+            ++m_eventCount;
+            auto const eventCallback = m_eventCallback;
+            // not locked, the callback may be slow (it writes to sockets)
+            lock.unlock();
+            eventCallback(event);
+            lock.lock();
+        }
+    }
+}
+
+std::vector<int> HotspotDetector::_track(std::vector<Hotspot> &&detections, std::vector<int> *p_appeared)
+{
+    TRACE_SCOPE("HotspotDetector::_track");
+    std::lock_guard<decltype(m_hotspotsMut)> lock{m_hotspotsMut};
+    // candidate pairs within reach, the closest pairs are matched first
+    struct Candidate
+    {
+        double distance;
+        size_t hotspotIndex;
+        size_t detectionIndex;
+    };
+    std::vector<Candidate> candidates;
+    for (size_t hotspotIndex = 0; hotspotIndex < m_hotspots.size(); ++hotspotIndex)
+    {
+        auto const &hotspot = m_hotspots[hotspotIndex];
+        auto const reach = std::max(n_minTrackDistance, 0.5 * std::max(hotspot.width, hotspot.height));
+        for (size_t detectionIndex = 0; detectionIndex < detections.size(); ++detectionIndex)
+        {
+            auto const distance = std::hypot(detections[detectionIndex].x - hotspot.x, detections[detectionIndex].y - hotspot.y);
+            if (distance <= reach)
+            {
+                candidates.push_back({distance, hotspotIndex, detectionIndex});
+            }
+        }
+    }
+    std::sort(std::begin(candidates), std::end(candidates), [](auto const &a, auto const &b)
+              { return a.distance < b.distance; });
+    std::vector<bool> hotspotMatched(m_hotspots.size(), false);
+    std::vector<bool> detectionMatched(detections.size(), false);
+    std::vector<Hotspot> hotspots;
+    for (auto const &candidate : candidates)
+    {
+        if (hotspotMatched[candidate.hotspotIndex] || detectionMatched[candidate.detectionIndex])
+        {
+            continue;
+        }
+        hotspotMatched[candidate.hotspotIndex] = true;
+        detectionMatched[candidate.detectionIndex] = true;
+        auto hotspot = detections[candidate.detectionIndex];
+        hotspot.id = m_hotspots[candidate.hotspotIndex].id;
+        hotspot.age = m_hotspots[candidate.hotspotIndex].age + 1;
+        hotspot.missed = 0;
+        hotspots.push_back(hotspot);
+    }
+    std::vector<int> lost;
+    for (size_t hotspotIndex = 0; hotspotIndex < m_hotspots.size(); ++hotspotIndex)
+    {
+        if (hotspotMatched[hotspotIndex])
+        {
+            continue;
+        }
+        // keep the last position for a few frames, the blob may come back (noise at the threshold, occlusion)
+        auto hotspot = m_hotspots[hotspotIndex];
+        if (++hotspot.missed > n_maxMissedFrames)
+        {
+            lost.push_back(hotspot.id);
+        }
+        else
+        {
+            ++hotspot.age;
+            hotspots.push_back(hotspot);
+        }
+    }
+    for (size_t detectionIndex = 0; detectionIndex < detections.size(); ++detectionIndex)
+    {
+        if (!detectionMatched[detectionIndex])
+        {
+            auto hotspot = detections[detectionIndex];
+            hotspot.id = m_nextId++;
+            hotspot.age = 0;
+            hotspot.missed = 0;
+            p_appeared->push_back(hotspot.id);
+            hotspots.push_back(hotspot);
+        }
+    }
+    std::sort(std::begin(hotspots), std::end(hotspots), [](auto const &a, auto const &b)
+              { return a.id < b.id; });
+    m_hotspots = std::move(hotspots);
+    return lost;
+}
+
+std::string HotspotDetector::_formatEvent(uint64_t frameNum, double analysisNs, std::vector<int> const &appeared, std::vector<int> const &lost) const
+{
+    std::stringstream ss;
+    ss << std::fixed;
+    ss << "HOTSPOTS {frame=" << frameNum;
+    ss << ", analysisMs=" << std::setprecision(3) << analysisNs / 1e6;
+    ss << ", hotspots=[";
+    auto const hotspots = getHotspots();
+    for (size_t i = 0; i < hotspots.size(); ++i)
+    {
+        ss << (i > 0 ? ", " : "");
+        _formatHotspot(ss, hotspots[i]);
+    }
+    ss << "], appeared=";
+    _formatIds(ss, appeared);
+    ss << ", lost=";
+    _formatIds(ss, lost);
+    ss << "}\n";
+    return ss.str();
+}
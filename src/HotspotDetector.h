@@ -0,0 +1,105 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cv
+{
+    class Mat;
+}
+
+// Finds hot objects in FIXED_10_6 thermography frames and tracks them from frame to frame.
+// Pixels above a temperature threshold are grouped into 8-connected blobs, blobs smaller than
+// the minimum area are ignored and the others are matched to the previous hotspots by nearest centroid,
+// so a hotspot keeps its id while it moves.
+// The analysis runs on its own thread: submit() only copies the frame into a latest-wins slot,
+// a frame that arrives while the previous one is still being analyzed replaces it (counted as superseded),
+// so the frame callback is never delayed by the analysis.
+class HotspotDetector
+{
+public:
+    struct Hotspot
+    {
+        int id;
+        // centroid in sensor pixel coordinates
+        double x;
+        double y;
+        // pixels above the threshold
+        int area;
+        // bounding box in sensor pixel coordinates
+        int left;
+        int top;
+        int width;
+        int height;
+        // degrees C
+        float maxTemperature;
+        // frames since the hotspot appeared
+        uint64_t age;
+        // consecutive analyzed frames in which the hotspot was not found
+        int missed;
+    };
+    // called on the analysis thread with one event line per analyzed frame that has hotspots or lost some
+    using EventCallback = std::function<void(std::string const &)>;
+
+    HotspotDetector();
+    ~HotspotDetector();
+    // start the analysis thread, threshold in degrees C, blobs with less than minArea pixels are ignored
+    void start(double thresholdTemperature, int minArea, EventCallback eventCallback);
+    // stop the analysis thread and forget the hotspots
+    void stop();
+    bool isRunning() const;
+    // use AVX2/NEON for the threshold when the CPU supports them
+    void setVectorized(bool vectorized);
+    // copy a FIXED_10_6 frame for the analysis thread, never waits for the analysis
+    // frames are numbered from one in the order they are submitted
+    void submit(uint16_t const *p_src, size_t srcStride, int width, int height);
+    // the hotspots of the last analyzed frame
+    std::vector<Hotspot> getHotspots() const;
+    // blobs of one frame without tracking (ids are 0), runs on the calling thread
+    std::vector<Hotspot> detect(uint16_t const *p_src, size_t srcStride, int width, int height);
+    // Get a string representing the settings, the current hotspots and the analysis cost
+    std::string getStatus() const;
+
+private:
+    void _run();
+    // match the detections to the current hotspots, returns the ids of the hotspots that were lost
+    std::vector<int> _track(std::vector<Hotspot> &&detections, std::vector<int> *p_appeared);
+    std::string _formatEvent(uint64_t frameNum, double analysisNs, std::vector<int> const &appeared, std::vector<int> const &lost) const;
+    // guards the settings, the pending frame and the statistics
+    mutable std::mutex m_mut;
+    std::condition_variable m_frameReadyCondition;
+    std::thread m_thread;
+    bool m_running;
+    bool m_vectorized;
+    uint16_t m_threshold;
+    int m_minArea;
+    EventCallback m_eventCallback;
+    // latest-wins slot, swapped with the analysis frame so that neither is reallocated
+    std::vector<uint16_t> m_pendingFrame;
+    std::vector<uint16_t> m_analysisFrame;
+    bool m_framePending;
+    int m_width;
+    int m_height;
+    uint64_t m_frameNum;
+    // only touched by the analysis thread (and detect())
+    std::unique_ptr<cv::Mat> mp_mask;
+    std::unique_ptr<cv::Mat> mp_labels;
+    std::unique_ptr<cv::Mat> mp_stats;
+    std::unique_ptr<cv::Mat> mp_centroids;
+    // guards the tracked hotspots, the frame callback reads them for the overlay
+    mutable std::mutex m_hotspotsMut;
+    std::vector<Hotspot> m_hotspots;
+    int m_nextId;
+    uint64_t m_submittedCount;
+    uint64_t m_supersededCount;
+    uint64_t m_analyzedCount;
+    uint64_t m_eventCount;
+    double m_analysisSumNs;
+    double m_analysisMaxNs;
+};
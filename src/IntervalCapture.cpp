@@ -0,0 +1,167 @@
+#include "IntervalCapture.h"
+#include "Trace.h"
+#include <syslog.h>
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+    constexpr static inline auto const np_manifestFileName = "manifest.csv";
+
+    double _getCpuMs(struct rusage const &usage)
+    {
+        return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    }
+
+    std::string _formatUtc(uint64_t timestampUtcNs, char const *p_format)
+    {
+        auto const seconds = time_t(timestampUtcNs / 1000000000);
+        std::tm utcTime{};
+        gmtime_r(&seconds, &utcTime);
+        std::stringstream ss;
+        ss << std::put_time(&utcTime, p_format);
+        return ss.str();
+    }
+}
+
+double IntervalCapture::getThreadCpuMs()
+{
+    struct rusage usage
+    {
+    };
+    getrusage(RUSAGE_THREAD, &usage);
+    return _getCpuMs(usage);
+}
+
+IntervalCapture::IntervalCapture(Options const &options)
+    : m_options{options},
+      mp_manifest{nullptr},
+      m_firstIndex{0},
+      m_captureCount{0},
+      m_failedCount{0},
+      m_missedCount{0},
+      m_totalSelectMs{0.0},
+      m_totalWriteMs{0.0},
+      m_maxWriteMs{0.0},
+      m_totalCpuMs{0.0},
+      m_startTime{std::chrono::steady_clock::now()},
+      m_startUsage{}
+{
+    getrusage(RUSAGE_SELF, &m_startUsage);
+    std::error_code error;
+    std::filesystem::create_directories(m_options.directory, error);
+    auto const manifestPath = m_options.directory / np_manifestFileName;
+    auto const exists = std::filesystem::exists(manifestPath, error);
+    if (exists)
+    {
+        // appended to, a restarted time-lapse continues the index of the directory
+        std::ifstream manifest(manifestPath);
+        auto const lineCount = std::count(std::istreambuf_iterator<char>(manifest), std::istreambuf_iterator<char>(), '\n');
+        m_firstIndex = uint64_t(std::max<std::ptrdiff_t>(lineCount - 1, 0));
+    }
+    mp_manifest = std::fopen(manifestPath.c_str(), "a");
+    if (!mp_manifest)
+    {
+        syslog(LOG_ERR, "Unable to open the interval capture manifest %s: %m", manifestPath.c_str());
+        return;
+    }
+    if (!exists)
+    {
+        std::fprintf(mp_manifest, "index,tick_utc,frame_utc,offset_ms,fpa_frame_count,image,radiometric,min_c,max_c,select_ms,write_ms,cpu_ms\n");
+        std::fflush(mp_manifest);
+    }
+}
+
+IntervalCapture::~IntervalCapture()
+{
+    if (mp_manifest)
+    {
+        std::fclose(mp_manifest);
+    }
+}
+
+IntervalCapture::Options const &IntervalCapture::getOptions() const
+{
+    return m_options;
+}
+
+bool IntervalCapture::isOpened() const
+{
+    return mp_manifest != nullptr;
+}
+
+std::filesystem::path IntervalCapture::getCaptureDirectory(uint64_t timestampUtcNs)
+{
+    auto const directory = m_options.directory / _formatUtc(timestampUtcNs, "%Y_%m_%d_%H");
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        syslog(LOG_ERR, "Unable to create the interval capture directory %s: %s", directory.c_str(), error.message().c_str());
+        return {};
+    }
+    return directory;
+}
+
+uint64_t IntervalCapture::getCaptureIndex() const
+{
+    return m_firstIndex + m_captureCount + m_failedCount;
+}
+
+void IntervalCapture::addCapture(Capture const &capture)
+{
+    TRACE_SCOPE("IntervalCapture::addCapture");
+    if (mp_manifest)
+    {
+        auto const relativePath = [this](std::filesystem::path const &path)
+        {
+            return path.empty() ? std::string() : path.lexically_relative(m_options.directory).string();
+        };
+        std::fprintf(mp_manifest, "%llu,%s.%03llu,%s.%03llu,%.1f,%u,%s,%s,%.2f,%.2f,%.1f,%.1f,%.1f\n",
+                     (unsigned long long)getCaptureIndex(),
+                     _formatUtc(capture.tickUtcNs, "%Y-%m-%d %H:%M:%S").c_str(), (unsigned long long)(capture.tickUtcNs / 1000000 % 1000),
+                     _formatUtc(capture.frameUtcNs, "%Y-%m-%d %H:%M:%S").c_str(), (unsigned long long)(capture.frameUtcNs / 1000000 % 1000),
+                     capture.offsetMs, capture.fpaFrameCount, relativePath(capture.imagePath).c_str(), relativePath(capture.radiometricPath).c_str(),
+                     capture.minTemperature, capture.maxTemperature, capture.selectMs, capture.writeMs, capture.cpuMs);
+        std::fflush(mp_manifest);
+    }
+    if (capture.failed)
+    {
+        ++m_failedCount;
+        return;
+    }
+    ++m_captureCount;
+    m_totalSelectMs += capture.selectMs;
+    m_totalWriteMs += capture.writeMs;
+    m_maxWriteMs = std::max(m_maxWriteMs, capture.writeMs);
+    m_totalCpuMs += capture.cpuMs;
+}
+
+void IntervalCapture::addMissedTick()
+{
+    ++m_missedCount;
+}
+
+std::string IntervalCapture::getStatus() const
+{
+    struct rusage usage
+    {
+    };
+    getrusage(RUSAGE_SELF, &usage);
+    auto const elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+    auto const captureCount = double(std::max<uint64_t>(m_captureCount, 1));
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "{intervalS=" << m_options.intervalSeconds << ", directory=" << m_options.directory.string()
+       << ", formats=" << (m_options.imageExtension.empty() ? "" : m_options.imageExtension.substr(1))
+       << (m_options.imageExtension.empty() || m_options.radiometricExtension.empty() ? "" : "+")
+       << (m_options.radiometricExtension.empty() ? "" : m_options.radiometricExtension.substr(1))
+       << ", lowPower=" << (m_options.lowPower ? "true" : "false") << ", captures=" << m_captureCount << ", failed=" << m_failedCount
+       << ", missed=" << m_missedCount << ", avgSelectMs=" << m_totalSelectMs / captureCount << ", avgWriteMs=" << m_totalWriteMs / captureCount
+       << ", maxWriteMs=" << m_maxWriteMs << ", avgCpuMs=" << m_totalCpuMs / captureCount
+       << ", daemonCpuPercent=" << (elapsedMs > 0.0 ? 100.0 * (_getCpuMs(usage) - _getCpuMs(m_startUsage)) / elapsedMs : 0.0) << "}";
+    return ss.str();
+}
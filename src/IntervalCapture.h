@@ -0,0 +1,84 @@
+#pragma once
+#include <sys/resource.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// The bookkeeping of a time-lapse (interval capture): one frame every intervalSeconds for hours.
+// The files of a capture go to a directory per UTC hour below the base directory, so that no
+// directory grows without bound, and every capture is appended to manifest.csv in the base directory,
+// flushed at once so that a power cut loses at most the capture being written.
+// Keeps the cost of every capture (frame selection, encode and write, CPU time) and the CPU usage of
+// the whole daemon since the start, from getrusage.
+// Guarded by EchoThermCamera::m_intervalMut, shared by the command handlers and the interval timer thread.
+class IntervalCapture
+{
+public:
+    struct Options
+    {
+        double intervalSeconds;
+        // e.g. .jpeg, empty = no image
+        std::string imageExtension;
+        // .csv or .etr, empty = no radiometric file
+        std::string radiometricExtension;
+        std::filesystem::path directory;
+        // decimate the primary output between captures
+        bool lowPower;
+        // compression threads of .etr files
+        int compressionThreads;
+    };
+    struct Capture
+    {
+        uint64_t tickUtcNs;
+        uint64_t frameUtcNs;
+        // frame time - tick time
+        double offsetMs;
+        uint32_t fpaFrameCount;
+        // empty when not written
+        std::filesystem::path imagePath;
+        std::filesystem::path radiometricPath;
+        // degrees C from the thermography frame header, NaN without one
+        float minTemperature;
+        float maxTemperature;
+        // waiting for the frame closest to the tick
+        double selectMs;
+        double writeMs;
+        // CPU time of the encode and write
+        double cpuMs;
+        bool failed;
+    };
+    // CPU time of the calling thread in milliseconds
+    static double getThreadCpuMs();
+    explicit IntervalCapture(Options const &options);
+    ~IntervalCapture();
+    Options const &getOptions() const;
+    // the manifest could be created
+    bool isOpened() const;
+    // the directory for the files of a capture taken at a UTC time, created when missing; empty on error
+    std::filesystem::path getCaptureDirectory(uint64_t timestampUtcNs);
+    // the number of the next capture, from zero
+    uint64_t getCaptureIndex() const;
+    // append a capture to the manifest and to the statistics
+    void addCapture(Capture const &capture);
+    // a tick passed while a capture was still being written, or no frame was available
+    void addMissedTick();
+    // Get a string representing the settings, the captures, their cost and the CPU usage of the daemon
+    std::string getStatus() const;
+
+private:
+    Options m_options;
+    std::FILE *mp_manifest;
+    // captures already in the manifest of the directory
+    uint64_t m_firstIndex;
+    uint64_t m_captureCount;
+    uint64_t m_failedCount;
+    uint64_t m_missedCount;
+    double m_totalSelectMs;
+    double m_totalWriteMs;
+    double m_maxWriteMs;
+    double m_totalCpuMs;
+    std::chrono::steady_clock::time_point m_startTime;
+    struct rusage m_startUsage;
+};
@@ -0,0 +1,430 @@
+#include "Isotherm.h"
+#include "Trace.h"
+#include <strings.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ISOTHERM_HAS_AVX2 1
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ISOTHERM_HAS_NEON 1
+#endif
+
+namespace
+{
+    // FIXED_10_6: degrees C = value / 64 - 40
+    constexpr static inline auto const n_fixedScale = 64.0;
+    constexpr static inline auto const n_fixedOffset = 40.0;
+
+    struct NamedColor
+    {
+        char const *p_name;
+        uint32_t color;
+    };
+    constexpr static inline NamedColor const np_namedColors[]{
+        {"red", 0xFF0000},
+        {"green", 0x00FF00},
+        {"blue", 0x0000FF},
+        {"yellow", 0xFFFF00},
+        {"cyan", 0x00FFFF},
+        {"magenta", 0xFF00FF},
+        {"orange", 0xFF8000},
+        {"white", 0xFFFFFF},
+        {"black", 0x000000},
+    };
+
+    uint16_t _toRaw(double temperature)
+    {
+        return (uint16_t)std::lround(std::clamp((temperature + n_fixedOffset) * n_fixedScale, 0.0, 65535.0));
+    }
+
+    bool _parseNumber(std::string const &valueStr, double *p_value)
+    {
+        char *p_end = nullptr;
+        *p_value = std::strtod(valueStr.c_str(), &p_end);
+        return !valueStr.empty() && p_end != nullptr && *p_end == '\0' && std::isfinite(*p_value);
+    }
+
+    inline uint8_t _blend(uint32_t value, uint32_t bandValue, uint32_t weight)
+    {
+        return uint8_t((value * (256u - weight) + bandValue * weight + 128u) >> 8);
+    }
+
+    template <typename RawBand>
+    int _applyRowArgbScalar(uint16_t const *p_src, uint8_t const *p_color, uint8_t *p_dst, int count, RawBand const *p_bands, size_t bandCount)
+    {
+        int highlighted = 0;
+        for (int x = 0; x < count; ++x)
+        {
+            auto const value = p_src[x];
+            auto const *const p_band = std::find_if(p_bands, p_bands + bandCount, [value](auto const &band)
+                                                    { return value >= band.low && value <= band.high; });
+            if (p_band == p_bands + bandCount)
+            {
+                std::memmove(p_dst + 4 * x, p_color + 4 * x, 4);
+                continue;
+            }
+            for (int c = 0; c < 4; ++c)
+            {
+                p_dst[4 * x + c] = _blend(p_color[4 * x + c], (p_band->argb >> (8 * c)) & 0xFFu, p_band->weight);
+            }
+            ++highlighted;
+        }
+        return highlighted;
+    }
+
+    template <typename RawBand>
+    int _applyRowGreyScalar(uint16_t const *p_src, uint8_t const *p_color, uint8_t *p_dst, int count, RawBand const *p_bands, size_t bandCount)
+    {
+        int highlighted = 0;
+        for (int x = 0; x < count; ++x)
+        {
+            auto const value = p_src[x];
+            auto const *const p_band = std::find_if(p_bands, p_bands + bandCount, [value](auto const &band)
+                                                    { return value >= band.low && value <= band.high; });
+            if (p_band == p_bands + bandCount)
+            {
+                p_dst[x] = p_color[x];
+                continue;
+            }
+            p_dst[x] = _blend(p_color[x], p_band->grey, p_band->weight);
+            ++highlighted;
+        }
+        return highlighted;
+    }
+
+#ifdef ISOTHERM_HAS_AVX2
+    // (value * (256 - weight) + band * weight + 128) >> 8 on 16-bit lanes, weights = (256 - weight, weight) pairs
+    __attribute__((target("avx2"))) inline __m256i _blend16Avx2(__m256i values, __m256i bandValues, __m256i weights)
+    {
+        auto const round = _mm256_set1_epi32(128);
+        auto const low = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(values, bandValues), weights), round), 8);
+        auto const high = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(values, bandValues), weights), round), 8);
+        return _mm256_packus_epi32(low, high);
+    }
+
+    template <typename RawBand>
+    __attribute__((target("avx2"))) int _applyRowArgbAvx2(uint16_t const *p_src, uint8_t const *p_color, uint8_t *p_dst, int count, RawBand const *p_bands, size_t bandCount)
+    {
+        int highlighted = 0;
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            auto const values = _mm256_cvtepu16_epi32(_mm_loadu_si128((__m128i const *)(p_src + x)));
+            auto const colors = _mm256_loadu_si256((__m256i const *)(p_color + 4 * x));
+            auto result = colors;
+            auto matched = _mm256_setzero_si256();
+            for (size_t b = 0; b < bandCount; ++b)
+            {
+                auto const &band = p_bands[b];
+                auto const clamped = _mm256_min_epu32(_mm256_max_epu32(values, _mm256_set1_epi32(band.low)), _mm256_set1_epi32(band.high));
+                auto const mask = _mm256_andnot_si256(matched, _mm256_cmpeq_epi32(clamped, values));
+                if (_mm256_testz_si256(mask, mask))
+                {
+                    continue;
+                }
+                auto const bandValues = _mm256_cvtepu8_epi16(_mm_set1_epi32(int(band.argb)));
+                auto const weights = _mm256_set1_epi32(int((uint32_t(band.weight) << 16) | (256u - band.weight)));
+                auto const low = _blend16Avx2(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(colors)), bandValues, weights);
+                auto const high = _blend16Avx2(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(colors, 1)), bandValues, weights);
+                // packus interleaves the 128 bit lanes, pixels 0-1, 4-5, 2-3, 6-7
+                auto const blended = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+                result = _mm256_blendv_epi8(result, blended, mask);
+                matched = _mm256_or_si256(matched, mask);
+            }
+            highlighted += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(matched)));
+            _mm256_storeu_si256((__m256i *)(p_dst + 4 * x), result);
+        }
+        return highlighted + _applyRowArgbScalar(p_src + x, p_color + 4 * x, p_dst + 4 * x, count - x, p_bands, bandCount);
+    }
+
+    template <typename RawBand>
+    __attribute__((target("avx2"))) int _applyRowGreyAvx2(uint16_t const *p_src, uint8_t const *p_color, uint8_t *p_dst, int count, RawBand const *p_bands, size_t bandCount)
+    {
+        int highlighted = 0;
+        int x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            auto const values = _mm256_loadu_si256((__m256i const *)(p_src + x));
+            auto const colors = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)(p_color + x)));
+            auto result = colors;
+            auto matched = _mm256_setzero_si256();
+            for (size_t b = 0; b < bandCount; ++b)
+            {
+                auto const &band = p_bands[b];
+                auto const clamped = _mm256_min_epu16(_mm256_max_epu16(values, _mm256_set1_epi16(short(band.low))), _mm256_set1_epi16(short(band.high)));
+                auto const mask = _mm256_andnot_si256(matched, _mm256_cmpeq_epi16(clamped, values));
+                if (_mm256_testz_si256(mask, mask))
+                {
+                    continue;
+                }
+                auto const weights = _mm256_set1_epi32(int((uint32_t(band.weight) << 16) | (256u - band.weight)));
+                auto const blended = _blend16Avx2(colors, _mm256_set1_epi16(short(band.grey)), weights);
+                result = _mm256_blendv_epi8(result, blended, mask);
+                matched = _mm256_or_si256(matched, mask);
+            }
+            highlighted += __builtin_popcount(_mm256_movemask_epi8(matched)) / 2;
+            auto const packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(result, result), 0xD8);
+            _mm_storeu_si128((__m128i *)(p_dst + x), _mm256_castsi256_si128(packed));
+        }
+        return highlighted + _applyRowGreyScalar(p_src + x, p_color + x, p_dst + x, count - x, p_bands, bandCount);
+    }
+#endif
+
+#ifdef ISOTHERM_HAS_NEON
+    template <typename RawBand>
+    int _applyRowArgbNeon(uint16_t const *p_src, uint8_t const *p_color, uint8_t *p_dst, int count, RawBand const *p_bands, size_t bandCount)
+    {
+        int highlighted = 0;
+        int x = 0;
+        for (; x + 4 <= count; x += 4)
+        {
+            auto const values = vmovl_u16(vld1_u16(p_src + x));
+            auto const colors = vld1q_u8(p_color + 4 * x);
+            auto const low = vmovl_u8(vget_low_u8(colors));
+            auto const high = vmovl_u8(vget_high_u8(colors));
+            auto result = colors;
+            auto matched = vdupq_n_u32(0);
+            for (size_t b = 0; b < bandCount; ++b)
+            {
+                auto const &band = p_bands[b];
+                auto const mask = vbicq_u32(vandq_u32(vcgeq_u32(values, vdupq_n_u32(band.low)), vcleq_u32(values, vdupq_n_u32(band.high))), matched);
+                if (vmaxvq_u32(mask) == 0)
+                {
+                    continue;
+                }
+                // band * weight + 128 for the 4 bytes of one pixel
+                uint32_t const p_bandTerms[4]{((band.argb >> 0) & 0xFFu) * band.weight + 128u,
+                                              ((band.argb >> 8) & 0xFFu) * band.weight + 128u,
+                                              ((band.argb >> 16) & 0xFFu) * band.weight + 128u,
+                                              ((band.argb >> 24) & 0xFFu) * band.weight + 128u};
+                auto const bandTerms = vld1q_u32(p_bandTerms);
+                auto const inverse = uint16_t(256u - band.weight);
+                auto const blendedLow = vcombine_u16(vshrn_n_u32(vmlal_n_u16(bandTerms, vget_low_u16(low), inverse), 8),
+                                                     vshrn_n_u32(vmlal_n_u16(bandTerms, vget_high_u16(low), inverse), 8));
+                auto const blendedHigh = vcombine_u16(vshrn_n_u32(vmlal_n_u16(bandTerms, vget_low_u16(high), inverse), 8),
+                                                      vshrn_n_u32(vmlal_n_u16(bandTerms, vget_high_u16(high), inverse), 8));
+                result = vbslq_u8(vreinterpretq_u8_u32(mask), vcombine_u8(vmovn_u16(blendedLow), vmovn_u16(blendedHigh)), result);
+                matched = vorrq_u32(matched, mask);
+            }
+            highlighted += int(vaddvq_u32(vshrq_n_u32(matched, 31)));
+            vst1q_u8(p_dst + 4 * x, result);
+        }
+        return highlighted + _applyRowArgbScalar(p_src + x, p_color + 4 * x, p_dst + 4 * x, count - x, p_bands, bandCount);
+    }
+
+    template <typename RawBand>
+    int _applyRowGreyNeon(uint16_t const *p_src, uint8_t const *p_color, uint8_t *p_dst, int count, RawBand const *p_bands, size_t bandCount)
+    {
+        int highlighted = 0;
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            auto const values = vld1q_u16(p_src + x);
+            auto const colors = vmovl_u8(vld1_u8(p_color + x));
+            auto result = colors;
+            auto matched = vdupq_n_u16(0);
+            for (size_t b = 0; b < bandCount; ++b)
+            {
+                auto const &band = p_bands[b];
+                auto const mask = vbicq_u16(vandq_u16(vcgeq_u16(values, vdupq_n_u16(band.low)), vcleq_u16(values, vdupq_n_u16(band.high))), matched);
+                if (vmaxvq_u16(mask) == 0)
+                {
+                    continue;
+                }
+                auto const bandTerms = vdupq_n_u32(uint32_t(band.grey) * band.weight + 128u);
+                auto const inverse = uint16_t(256u - band.weight);
+                auto const blended = vcombine_u16(vshrn_n_u32(vmlal_n_u16(bandTerms, vget_low_u16(colors), inverse), 8),
+                                                  vshrn_n_u32(vmlal_n_u16(bandTerms, vget_high_u16(colors), inverse), 8));
+                result = vbslq_u16(mask, blended, result);
+                matched = vorrq_u16(matched, mask);
+            }
+            highlighted += int(vaddvq_u16(vshrq_n_u16(matched, 15)));
+            vst1_u8(p_dst + x, vmovn_u16(result));
+        }
+        return highlighted + _applyRowGreyScalar(p_src + x, p_color + x, p_dst + x, count - x, p_bands, bandCount);
+    }
+#endif
+
+    bool _hasVectorSupport()
+    {
+#if defined(ISOTHERM_HAS_AVX2)
+        return __builtin_cpu_supports("avx2");
+#elif defined(ISOTHERM_HAS_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+}
+
+std::string Isotherm::parseBand(std::string const &bandStr, Band *p_band)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss(bandStr);
+    std::string field;
+    while (std::getline(ss, field, ':'))
+    {
+        fields.push_back(field);
+    }
+    if (fields.size() < 3 || fields.size() > 4)
+    {
+        return "expected min:max:color[:opacity] instead of " + bandStr;
+    }
+    Band band{0.0, 0.0, 0, 1.0};
+    if (!_parseNumber(fields[0], &band.minTemperature) || !_parseNumber(fields[1], &band.maxTemperature) || band.minTemperature > band.maxTemperature)
+    {
+        return "invalid temperature band " + fields[0] + ":" + fields[1];
+    }
+    auto const *const p_namedColor = std::find_if(std::begin(np_namedColors), std::end(np_namedColors), [&fields](auto const &namedColor)
+                                                  { return strcasecmp(namedColor.p_name, fields[2].c_str()) == 0; });
+    if (p_namedColor != std::end(np_namedColors))
+    {
+        band.color = p_namedColor->color;
+    }
+    else
+    {
+        char *p_end = nullptr;
+        band.color = uint32_t(std::strtoul(fields[2].c_str(), &p_end, 16));
+        if (fields[2].size() != 6 || p_end == nullptr || *p_end != '\0')
+        {
+            return "invalid color " + fields[2] + " (a name or RRGGBB)";
+        }
+    }
+    if (fields.size() == 4 && (!_parseNumber(fields[3], &band.opacity) || band.opacity < 0.0 || band.opacity > 1.0))
+    {
+        return "the opacity must be between 0 and 1";
+    }
+    *p_band = band;
+    return std::string();
+}
+
+Isotherm::Isotherm()
+    : m_bands{},
+      m_rawBands{},
+      m_vectorized{_hasVectorSupport()},
+      m_frameHighlighted{0},
+      m_frameNs{0.0},
+      m_frameCount{0},
+      m_lastHighlighted{0},
+      m_sumNs{0.0},
+      m_maxNs{0.0}
+{
+}
+
+void Isotherm::setBands(std::vector<Band> const &bands)
+{
+    m_bands.assign(std::begin(bands), std::begin(bands) + std::min(bands.size(), n_maxBands));
+    m_rawBands.clear();
+    for (auto const &band : m_bands)
+    {
+        auto const red = (band.color >> 16) & 0xFFu;
+        auto const green = (band.color >> 8) & 0xFFu;
+        auto const blue = band.color & 0xFFu;
+        m_rawBands.push_back({_toRaw(band.minTemperature),
+                              _toRaw(band.maxTemperature),
+                              uint16_t(std::lround(std::clamp(band.opacity, 0.0, 1.0) * 256.0)),
+                              0xFF000000u | (band.color & 0xFFFFFFu),
+                              uint8_t((77u * red + 150u * green + 29u * blue + 128u) >> 8)});
+    }
+    m_frameHighlighted = 0;
+    m_frameNs = 0.0;
+    m_frameCount = 0;
+    m_lastHighlighted = 0;
+    m_sumNs = 0.0;
+    m_maxNs = 0.0;
+}
+
+std::vector<Isotherm::Band> const &Isotherm::getBands() const
+{
+    return m_bands;
+}
+
+bool Isotherm::isEnabled() const
+{
+    return !m_rawBands.empty();
+}
+
+void Isotherm::setVectorized(bool vectorized)
+{
+    m_vectorized = vectorized && _hasVectorSupport();
+}
+
+void Isotherm::apply(uint16_t const *p_src, size_t srcStride, uint8_t const *p_color, size_t colorStride,
+                     uint8_t *p_dst, size_t dstStride, int width, int height, int channels)
+{
+    TRACE_SCOPE("Isotherm::apply");
+    auto const startTime = std::chrono::steady_clock::now();
+    auto *const p_bands = m_rawBands.data();
+    auto const bandCount = m_rawBands.size();
+    for (int y = 0; y < height; ++y)
+    {
+        auto const *const p_srcRow = (uint16_t const *)((uint8_t const *)p_src + size_t(y) * srcStride);
+        auto const *const p_colorRow = p_color + size_t(y) * colorStride;
+        auto *const p_dstRow = p_dst + size_t(y) * dstStride;
+        int highlighted = 0;
+#if defined(ISOTHERM_HAS_AVX2)
+        if (m_vectorized)
+        {
+            highlighted = channels == 4 ? _applyRowArgbAvx2(p_srcRow, p_colorRow, p_dstRow, width, p_bands, bandCount)
+                                        : _applyRowGreyAvx2(p_srcRow, p_colorRow, p_dstRow, width, p_bands, bandCount);
+        }
+        else
+#elif defined(ISOTHERM_HAS_NEON)
+        if (m_vectorized)
+        {
+            highlighted = channels == 4 ? _applyRowArgbNeon(p_srcRow, p_colorRow, p_dstRow, width, p_bands, bandCount)
+                                        : _applyRowGreyNeon(p_srcRow, p_colorRow, p_dstRow, width, p_bands, bandCount);
+        }
+        else
+#endif
+        {
+            highlighted = channels == 4 ? _applyRowArgbScalar(p_srcRow, p_colorRow, p_dstRow, width, p_bands, bandCount)
+                                        : _applyRowGreyScalar(p_srcRow, p_colorRow, p_dstRow, width, p_bands, bandCount);
+        }
+        m_frameHighlighted += uint64_t(highlighted);
+    }
+    m_frameNs += double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+void Isotherm::finishFrame()
+{
+    ++m_frameCount;
+    m_lastHighlighted = m_frameHighlighted;
+    m_sumNs += m_frameNs;
+    m_maxNs = std::max(m_maxNs, m_frameNs);
+    m_frameHighlighted = 0;
+    m_frameNs = 0.0;
+}
+
+std::string Isotherm::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "enabled=" << (isEnabled() ? "true" : "false");
+    ss << ", bands=[";
+    for (size_t i = 0; i < m_bands.size(); ++i)
+    {
+        auto const &band = m_bands[i];
+        ss << (i ? ", " : "") << "{minC=" << band.minTemperature << ", maxC=" << band.maxTemperature
+           << ", color=" << std::hex << std::uppercase << std::setw(6) << std::setfill('0') << band.color
+           << std::dec << std::nouppercase << std::setfill(' ') << ", opacity=" << band.opacity << "}";
+    }
+    ss << "]";
+    ss << ", vectorized=" << (m_vectorized ? "true" : "false");
+    ss << ", frames=" << m_frameCount;
+    ss << ", highlighted=" << m_lastHighlighted;
+    ss << std::setprecision(3);
+    ss << ", costMs={mean=" << (m_frameCount ? m_sumNs / double(m_frameCount) / 1e6 : 0.0) << ", max=" << m_maxNs / 1e6 << "}";
+    ss << "}";
+    return ss.str();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Highlights the pixels inside temperature bands (isotherms / alarm bands) with a color.
+// The bands are compared against the FIXED_10_6 thermography frame and the band color is blended
+// into the output frame in the same pass (AVX2/NEON compare-and-blend, 8 bit blend weights),
+// the first band that contains a pixel wins. With the echothermd colorizer the blend runs on
+// strips of rows right after they are colorized, while they are still in the cache.
+class Isotherm
+{
+public:
+    static constexpr size_t n_maxBands = 8;
+    struct Band
+    {
+        // degrees C, inclusive
+        double minTemperature;
+        double maxTemperature;
+        // 0xRRGGBB
+        uint32_t color;
+        // 0 = invisible, 1 = the band color replaces the pixel
+        double opacity;
+    };
+    // parse min:max:color[:opacity], color is a name (red, green, blue, yellow, cyan, magenta,
+    // orange, white, black) or RRGGBB, opacity 0-1 (default 1)
+    // return an empty string on success else a description of the error
+    static std::string parseBand(std::string const &bandStr, Band *p_band);
+
+    Isotherm();
+    // replace the bands, an empty list disables the highlighting
+    void setBands(std::vector<Band> const &bands);
+    std::vector<Band> const &getBands() const;
+    bool isEnabled() const;
+    // use AVX2/NEON when the CPU supports them
+    void setVectorized(bool vectorized);
+    // blend the band colors into height rows of width pixels
+    // p_src is the FIXED_10_6 frame, p_color the frame to highlight (channels = 4 for BGRA, 1 for grey),
+    // the result goes to p_dst which may be p_color
+    void apply(uint16_t const *p_src, size_t srcStride, uint8_t const *p_color, size_t colorStride,
+               uint8_t *p_dst, size_t dstStride, int width, int height, int channels);
+    // close the statistics of the current frame, apply() may be called several times per frame
+    void finishFrame();
+    // Get a string representing the bands, the highlighted pixels and the cost
+    std::string getStatus() const;
+
+private:
+    // a band in the units of the kernels
+    struct RawBand
+    {
+        uint16_t low;
+        uint16_t high;
+        // blend weight of the band color, 0-256
+        uint16_t weight;
+        // BGRA byte order, as in the frame
+        uint32_t argb;
+        uint8_t grey;
+    };
+    std::vector<Band> m_bands;
+    std::vector<RawBand> m_rawBands;
+    bool m_vectorized;
+    uint64_t m_frameHighlighted;
+    double m_frameNs;
+    uint64_t m_frameCount;
+    uint64_t m_lastHighlighted;
+    double m_sumNs;
+    double m_maxNs;
+};
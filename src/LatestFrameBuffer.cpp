@@ -0,0 +1,104 @@
+#include "LatestFrameBuffer.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <sstream>
+
+#include <opencv2/core.hpp>
+
+struct LatestFrameBuffer::Slot
+{
+    cv::Mat image;
+    std::vector<uint8_t> header;
+    Info info{};
+    // readers copying the slot, the writer does not touch a pinned slot
+    std::atomic<int> readerCount{0};
+};
+
+LatestFrameBuffer::LatestFrameBuffer()
+    : m_slots(2),
+      m_published{-1},
+      m_sequence{0},
+      m_skippedCount{0}
+{
+}
+
+LatestFrameBuffer::~LatestFrameBuffer()
+{
+    for (auto &slot : m_slots)
+    {
+        MemoryBudget::release(MemoryBudget::Category::FramePool, slot.image.total() * slot.image.elemSize() + slot.header.capacity());
+    }
+}
+
+bool LatestFrameBuffer::write(cv::Mat const &image, void const *p_header, size_t headerSize, int frameFormat, uint64_t timestampUtcNs)
+{
+    TRACE_SCOPE("LatestFrameBuffer::write");
+    auto const next = m_published.load() == 0 ? 1 : 0;
+    auto &slot = m_slots[size_t(next)];
+    if (slot.readerCount.load() > 0)
+    {
+        ++m_skippedCount;
+        return false;
+    }
+    auto const previousBytes = slot.image.total() * slot.image.elemSize() + slot.header.capacity();
+    image.copyTo(slot.image);
+    slot.header.assign((uint8_t const *)p_header, (uint8_t const *)p_header + (p_header ? headerSize : 0));
+    auto const bytes = slot.image.total() * slot.image.elemSize() + slot.header.capacity();
+    if (bytes != previousBytes)
+    {
+        // only when the geometry changes, the slots are reused otherwise
+        MemoryBudget::release(MemoryBudget::Category::FramePool, previousBytes);
+        MemoryBudget::acquire(MemoryBudget::Category::FramePool, bytes);
+    }
+    slot.info = {frameFormat, timestampUtcNs, std::chrono::steady_clock::now(), ++m_sequence};
+    m_published = next;
+    return true;
+}
+
+bool LatestFrameBuffer::read(cv::Mat &image, std::vector<uint8_t> *p_header, Info *p_info) const
+{
+    TRACE_SCOPE("LatestFrameBuffer::read");
+    for (;;)
+    {
+        auto const published = m_published.load();
+        if (published < 0)
+        {
+            return false;
+        }
+        auto &slot = m_slots[size_t(published)];
+        ++slot.readerCount;
+        // the writer may have moved on to this slot between the load and the pin
+        if (m_published.load() == published)
+        {
+            slot.image.copyTo(image);
+            if (p_header)
+            {
+                *p_header = slot.header;
+            }
+            if (p_info)
+            {
+                *p_info = slot.info;
+            }
+            --slot.readerCount;
+            return true;
+        }
+        --slot.readerCount;
+    }
+}
+
+uint64_t LatestFrameBuffer::getSequence() const
+{
+    return m_sequence.load();
+}
+
+void LatestFrameBuffer::clear()
+{
+    m_published = -1;
+}
+
+std::string LatestFrameBuffer::getStatus() const
+{
+    std::stringstream ss;
+    ss << "{published=" << m_sequence.load() << ", skipped=" << m_skippedCount.load() << "}";
+    return ss.str();
+}
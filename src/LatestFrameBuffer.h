@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cv
+{
+    class Mat;
+}
+
+// The latest frame of a pipeline stage, kept for screenshots so that they neither wait for the next
+// frame nor go through the recording queue. Two slots: the frame callback copies each frame into the
+// slot that is not published and then publishes it; a reader pins the published slot while it copies
+// it out. Neither side takes a lock or waits: when the other slot is still pinned by a slow reader
+// the new frame is skipped and the previous one stays published.
+// The slots are accounted in MemoryBudget as frame pool. write() and clear() must be called from one
+// thread, read() from any thread.
+class LatestFrameBuffer
+{
+public:
+    struct Info
+    {
+        int frameFormat;
+        uint64_t timestampUtcNs;
+        // when the frame was published
+        std::chrono::steady_clock::time_point publishTime;
+        // frames published since the buffer was created
+        uint64_t sequence;
+    };
+    LatestFrameBuffer();
+    ~LatestFrameBuffer();
+    // copy and publish a frame with its camera frame header (nullptr when none)
+    // return false when the frame was skipped because a reader still holds the other slot
+    bool write(cv::Mat const &image, void const *p_header, size_t headerSize, int frameFormat, uint64_t timestampUtcNs);
+    // copy the latest frame, return false when none was published since clear()
+    bool read(cv::Mat &image, std::vector<uint8_t> *p_header, Info *p_info) const;
+    // the sequence of the last frame written, a cheap check for a new frame before read()
+    uint64_t getSequence() const;
+    // unpublish the frame, e.g. when the session restarts
+    void clear();
+    // Get a string representing the frames published and skipped
+    std::string getStatus() const;
+
+private:
+    struct Slot;
+    // mutable for the reader counts of read()
+    mutable std::vector<Slot> m_slots;
+    // index of the published slot, -1 = none
+    std::atomic<int> m_published;
+    std::atomic<uint64_t> m_sequence;
+    std::atomic<uint64_t> m_skippedCount;
+};
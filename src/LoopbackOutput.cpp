@@ -0,0 +1,460 @@
+#include "LoopbackOutput.h"
+#include "Trace.h"
+#include "AsyncLog.h"
+#include "MemoryBudget.h"
+#include "seekcamera/seekcamera.h"
+#include <syslog.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <opencv2/imgproc.hpp>
+
+namespace
+{
+    constexpr static inline auto const n_minZoom = 1.0;
+    constexpr static inline auto const n_maxZoom = 16.0;
+    constexpr static inline auto const n_maxDecimation = 1000;
+    constexpr static inline auto const n_maxRate = 1000.0;
+    constexpr static inline auto const n_reopenInterval = std::chrono::seconds(5);
+
+    uint64_t _getThreadCpuTimeNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    }
+
+    bool _parseNumber(std::string const &valueStr, double *p_value)
+    {
+        char *p_end = nullptr;
+        *p_value = std::strtod(valueStr.c_str(), &p_end);
+        return !valueStr.empty() && p_end != nullptr && *p_end == '\0' && std::isfinite(*p_value);
+    }
+
+    char const *_getFormatName(int frameFormat)
+    {
+        return frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? "GREY" : "ARGB";
+    }
+
+    int _getCvFrameType(int frameFormat)
+    {
+        return frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE ? CV_8U : CV_8UC4;
+    }
+
+    // same as EchoThermCamera::_reserveFrame, the frame is reused between frames
+    cv::Mat &_reserveFrame(cv::Mat &frame, int width, int height, int cvFrameType)
+    {
+        if (frame.rows != height || frame.cols != width || frame.type() != cvFrameType)
+        {
+            MemoryBudget::release(MemoryBudget::Category::FramePool, frame.total() * frame.elemSize());
+            frame.create(height, width, cvFrameType);
+            MemoryBudget::acquire(MemoryBudget::Category::FramePool, frame.total() * frame.elemSize());
+        }
+        return frame;
+    }
+}
+
+std::string LoopbackOutput::parseProfile(std::string const &profileStr, Profile *p_profile)
+{
+    auto const colon = profileStr.find(':');
+    if (colon == std::string::npos || colon == 0)
+    {
+        return "the output profile must start with a name followed by ':'";
+    }
+    Profile profile{profileStr.substr(0, colon),
+                    std::string(),
+                    int(SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888),
+                    -1,
+                    std::numeric_limits<double>::quiet_NaN(),
+                    std::numeric_limits<double>::quiet_NaN(),
+                    n_minZoom,
+                    std::numeric_limits<double>::quiet_NaN(),
+                    std::numeric_limits<double>::quiet_NaN(),
+                    1,
+                    0.0};
+    if (!std::all_of(std::begin(profile.name), std::end(profile.name), [](char c)
+                     { return std::isalnum((unsigned char)c) || c == '_' || c == '-'; }))
+    {
+        return "the output name may only contain letters, digits, '_' and '-'";
+    }
+    std::stringstream ss(profileStr.substr(colon + 1));
+    std::string setting;
+    while (std::getline(ss, setting, ','))
+    {
+        auto const equals = setting.find('=');
+        if (equals == std::string::npos)
+        {
+            return "expected key=value instead of " + setting;
+        }
+        auto const key = setting.substr(0, equals);
+        auto const valueStr = setting.substr(equals + 1);
+        double value = 0.0;
+        if (key == "device")
+        {
+            profile.deviceName = valueStr;
+        }
+        else if (key == "format")
+        {
+            if (strcasecmp(valueStr.c_str(), "ARGB") == 0 || valueStr == "0x80" || valueStr == "128")
+            {
+                profile.frameFormat = SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888;
+            }
+            else if (strcasecmp(valueStr.c_str(), "GREY") == 0 || strcasecmp(valueStr.c_str(), "GRAY") == 0 || valueStr == "0x40" || valueStr == "64")
+            {
+                profile.frameFormat = SEEKCAMERA_FRAME_FORMAT_GRAYSCALE;
+            }
+            else
+            {
+                return "unsupported output format " + valueStr + " (ARGB or GREY)";
+            }
+        }
+        else if (key == "palette")
+        {
+            if (strcasecmp(valueStr.c_str(), "SDK") == 0)
+            {
+                profile.colorPalette = -1;
+            }
+            else if (_parseNumber(valueStr, &value) && value >= SEEKCAMERA_COLOR_PALETTE_WHITE_HOT && value <= SEEKCAMERA_COLOR_PALETTE_GREEN)
+            {
+                profile.colorPalette = int(value);
+            }
+            else
+            {
+                return "unsupported palette " + valueStr + " (SDK or 0-8)";
+            }
+        }
+        else if (key == "min" || key == "max")
+        {
+            if (!_parseNumber(valueStr, &value))
+            {
+                return "invalid temperature " + valueStr;
+            }
+            (key == "min" ? profile.minTemperature : profile.maxTemperature) = value;
+        }
+        else if (key == "zoom")
+        {
+            if (!_parseNumber(valueStr, &value) || value < n_minZoom || value > n_maxZoom)
+            {
+                return "the zoom must be between 1 and 16";
+            }
+            profile.zoom = value;
+        }
+        else if (key == "panx" || key == "pany")
+        {
+            if (!_parseNumber(valueStr, &value))
+            {
+                return "invalid pan " + valueStr;
+            }
+            (key == "panx" ? profile.panX : profile.panY) = value;
+        }
+        else if (key == "decimate")
+        {
+            if (!_parseNumber(valueStr, &value) || value < 1 || value > n_maxDecimation)
+            {
+                return "decimate must be between 1 and 1000";
+            }
+            profile.decimation = int(value);
+        }
+        else if (key == "rate")
+        {
+            if (!_parseNumber(valueStr, &value) || value <= 0.0 || value > n_maxRate)
+            {
+                return "rate must be above 0 and at most 1000 Hz";
+            }
+            profile.rate = value;
+        }
+        else
+        {
+            return "unknown output setting " + key;
+        }
+    }
+    if (profile.deviceName.empty())
+    {
+        return "the output profile has no device";
+    }
+    if ((profile.minTemperature == profile.minTemperature) != (profile.maxTemperature == profile.maxTemperature))
+    {
+        return "min and max must be set together";
+    }
+    if (profile.colorPalette < 0 && profile.minTemperature == profile.minTemperature)
+    {
+        return "min and max require an echothermd palette (palette=0-8)";
+    }
+    *p_profile = profile;
+    return std::string();
+}
+
+void LoopbackOutput::warpRoi(cv::Mat const &srcMat, cv::Mat &dstMat, double scale, double originX, double originY, int interpolation)
+{
+    // maps the output pixel centers onto the source pixel centers
+    double p_transform[6]{scale, 0.0, originX + 0.5 * scale - 0.5,
+                          0.0, scale, originY + 0.5 * scale - 0.5};
+    cv::warpAffine(srcMat, dstMat, cv::Mat(2, 3, CV_64F, p_transform), dstMat.size(), interpolation | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+}
+
+LoopbackOutput::LoopbackOutput(Profile const &profile)
+    : m_profile{profile},
+      m_device{-1},
+      m_reopenTime{},
+      m_width{0},
+      m_height{0},
+      m_decimator{},
+      m_writtenCount{0},
+      m_errorCount{0},
+      m_cpuSumNs{0.0},
+      m_cpuMaxNs{0.0},
+      m_latencySumNs{0.0},
+      m_latencyMaxNs{0.0},
+      mp_zoomFrame{std::make_unique<cv::Mat>()}
+{
+    m_decimator.setDecimation(m_profile.decimation);
+    m_decimator.setRate(m_profile.rate);
+}
+
+LoopbackOutput::~LoopbackOutput()
+{
+    _closeDevice();
+    MemoryBudget::release(MemoryBudget::Category::FramePool, mp_zoomFrame->total() * mp_zoomFrame->elemSize());
+}
+
+LoopbackOutput::Profile const &LoopbackOutput::getProfile() const
+{
+    return m_profile;
+}
+
+void LoopbackOutput::reserve(int width, int height)
+{
+    if (m_profile.zoom > n_minZoom)
+    {
+        _reserveFrame(*mp_zoomFrame, width, height, _getCvFrameType(m_profile.frameFormat));
+    }
+}
+
+bool LoopbackOutput::wantsFrame(uint64_t captureTimeNs)
+{
+    return m_decimator.select(captureTimeNs);
+}
+
+void LoopbackOutput::write(cv::Mat const &srcFrame, std::chrono::system_clock::time_point arrivalTime)
+{
+    TRACE_SCOPE("LoopbackOutput::write");
+    auto const cpuStartNs = _getThreadCpuTimeNs();
+    if (srcFrame.cols != m_width || srcFrame.rows != m_height)
+    {
+        // consumers have to renegotiate the format
+        _closeDevice();
+        m_reopenTime = {};
+    }
+    if (m_device < 0 && std::chrono::steady_clock::now() >= m_reopenTime)
+    {
+        _openDevice(srcFrame.cols, srcFrame.rows);
+    }
+    if (m_device >= 0)
+    {
+        cv::Mat const *p_dstFrame = &srcFrame;
+        if (m_profile.zoom > n_minZoom)
+        {
+            // fixed zoom, the pan center is clamped so that the view stays on the sensor
+            auto const scale = 1.0 / m_profile.zoom;
+            auto const roiWidth = m_width * scale;
+            auto const roiHeight = m_height * scale;
+            auto const panX = m_profile.panX == m_profile.panX ? m_profile.panX : m_width / 2.0;
+            auto const panY = m_profile.panY == m_profile.panY ? m_profile.panY : m_height / 2.0;
+            auto const originX = std::clamp(panX, roiWidth / 2.0, m_width - roiWidth / 2.0) - roiWidth / 2.0;
+            auto const originY = std::clamp(panY, roiHeight / 2.0, m_height - roiHeight / 2.0) - roiHeight / 2.0;
+            auto &zoomFrame = _reserveFrame(*mp_zoomFrame, m_width, m_height, srcFrame.type());
+            warpRoi(srcFrame, zoomFrame, scale, originX, originY, cv::INTER_LINEAR);
+            p_dstFrame = &zoomFrame;
+        }
+        if (::write(m_device, p_dstFrame->data, p_dstFrame->total() * p_dstFrame->elemSize()) < 0)
+        {
+            ++m_errorCount;
+            AsyncLog::log(LOG_ERR, "Error writing to output %s device %s: %m", m_profile.name.c_str(), m_profile.deviceName.c_str());
+        }
+        else
+        {
+            ++m_writtenCount;
+        }
+    }
+    else
+    {
+        ++m_errorCount;
+    }
+    auto const cpuNs = double(_getThreadCpuTimeNs() - cpuStartNs);
+    auto const latencyNs = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - arrivalTime).count());
+    m_cpuSumNs += cpuNs;
+    m_cpuMaxNs = std::max(m_cpuMaxNs, cpuNs);
+    m_latencySumNs += latencyNs;
+    m_latencyMaxNs = std::max(m_latencyMaxNs, latencyNs);
+}
+
+std::string LoopbackOutput::getStats() const
+{
+    auto const count = double(std::max<uint64_t>(1, m_writtenCount + m_errorCount));
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "name=" << m_profile.name;
+    ss << ", device=" << m_profile.deviceName;
+    ss << ", format=" << _getFormatName(m_profile.frameFormat);
+    if (m_profile.colorPalette < 0)
+    {
+        ss << ", palette=SDK";
+    }
+    else
+    {
+        ss << ", palette=" << m_profile.colorPalette;
+        if (m_profile.minTemperature == m_profile.minTemperature)
+        {
+            ss << ", rangeC={" << m_profile.minTemperature << ", " << m_profile.maxTemperature << "}";
+        }
+        else
+        {
+            ss << ", range=auto";
+        }
+    }
+    ss << ", zoom=" << m_profile.zoom;
+    ss << ", frames=" << m_decimator.getStatus();
+    ss << ", written=" << m_writtenCount;
+    ss << ", errors=" << m_errorCount;
+    ss << ", cpuMs={mean=" << m_cpuSumNs / count / 1e6 << ", max=" << m_cpuMaxNs / 1e6 << "}";
+    ss << ", latencyMs={mean=" << m_latencySumNs / count / 1e6 << ", max=" << m_latencyMaxNs / 1e6 << "}";
+    ss << "}";
+    return ss.str();
+}
+
+void LoopbackOutput::_openDevice(int width, int height)
+{
+    TRACE_SCOPE("LoopbackOutput::_openDevice");
+    m_width = width;
+    m_height = height;
+    m_device = open(m_profile.deviceName.c_str(), O_RDWR);
+    if (m_device < 0)
+    {
+        AsyncLog::log(LOG_ERR, "Error opening output %s device %s: %m, retrying in %lld s", m_profile.name.c_str(), m_profile.deviceName.c_str(),
+                      (long long)n_reopenInterval.count());
+        m_reopenTime = std::chrono::steady_clock::now() + n_reopenInterval;
+        return;
+    }
+    struct v4l2_format v;
+    v.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    if (ioctl(m_device, VIDIOC_G_FMT, &v) < 0)
+    {
+        AsyncLog::log(LOG_ERR, "VIDIOC_G_FMT error on device %s: %m", m_profile.deviceName.c_str());
+    }
+    else
+    {
+        v.fmt.pix.width = width;
+        v.fmt.pix.height = height;
+        if (m_profile.frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE)
+        {
+            v.fmt.pix.pixelformat = V4L2_PIX_FMT_GREY;
+            v.fmt.pix.sizeimage = width * height;
+        }
+        else
+        {
+            v.fmt.pix.pixelformat = V4L2_PIX_FMT_ARGB32;
+            v.fmt.pix.sizeimage = width * height * 4;
+        }
+        if (ioctl(m_device, VIDIOC_S_FMT, &v) < 0)
+        {
+            AsyncLog::log(LOG_ERR, "VIDIOC_S_FMT error on device %s: %m", m_profile.deviceName.c_str());
+        }
+        else
+        {
+            AsyncLog::log(LOG_NOTICE, "Opened output %s with path %s.", m_profile.name.c_str(), m_profile.deviceName.c_str());
+        }
+    }
+}
+
+void LoopbackOutput::_closeDevice()
+{
+    if (m_device >= 0)
+    {
+        syslog(LOG_NOTICE, "Closing output %s device %d", m_profile.name.c_str(), m_device);
+        close(m_device);
+        m_device = -1;
+    }
+}
+
+ColorStage::ColorStage(int frameFormat, int colorPalette, double minTemperature, double maxTemperature)
+    : m_frameFormat{frameFormat},
+      m_colorPalette{colorPalette},
+      m_minTemperature{minTemperature},
+      m_maxTemperature{maxTemperature},
+      m_colorizer{},
+      m_frameNum{std::numeric_limits<uint64_t>::max()},
+      m_computeCount{0},
+      m_cpuSumNs{0.0},
+      mp_frame{std::make_unique<cv::Mat>()}
+{
+    m_colorizer.setPalette(colorPalette);
+    if (minTemperature == minTemperature)
+    {
+        m_colorizer.getAgc().setLinear(minTemperature, maxTemperature);
+    }
+}
+
+ColorStage::~ColorStage()
+{
+    MemoryBudget::release(MemoryBudget::Category::FramePool, mp_frame->total() * mp_frame->elemSize());
+}
+
+bool ColorStage::matches(LoopbackOutput::Profile const &profile) const
+{
+    auto const sameTemperature = [](double a, double b)
+    { return a == b || (a != a && b != b); };
+    return profile.frameFormat == m_frameFormat && profile.colorPalette == m_colorPalette &&
+           sameTemperature(profile.minTemperature, m_minTemperature) && sameTemperature(profile.maxTemperature, m_maxTemperature);
+}
+
+void ColorStage::reserve(int width, int height)
+{
+    _reserveFrame(*mp_frame, width, height, _getCvFrameType(m_frameFormat));
+}
+
+cv::Mat const &ColorStage::getFrame(uint64_t frameNum, uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    if (frameNum != m_frameNum)
+    {
+        TRACE_SCOPE("ColorStage::getFrame");
+        auto const cpuStartNs = _getThreadCpuTimeNs();
+        auto &frame = _reserveFrame(*mp_frame, width, height, _getCvFrameType(m_frameFormat));
+        if (m_frameFormat == SEEKCAMERA_FRAME_FORMAT_GRAYSCALE)
+        {
+            m_colorizer.colorizeGrey(p_src, srcStride, width, height, frame.data);
+        }
+        else
+        {
+            m_colorizer.colorizeArgb(p_src, srcStride, width, height, (uint32_t *)frame.data);
+        }
+        m_frameNum = frameNum;
+        ++m_computeCount;
+        m_cpuSumNs += double(_getThreadCpuTimeNs() - cpuStartNs);
+    }
+    return *mp_frame;
+}
+
+std::string ColorStage::getStats() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "format=" << _getFormatName(m_frameFormat);
+    ss << ", colorizer=" << m_colorizer.getStatus();
+    ss << ", computed=" << m_computeCount;
+    ss << ", cpuMs={mean=" << m_cpuSumNs / double(std::max<uint64_t>(1, m_computeCount)) / 1e6 << "}";
+    ss << "}";
+    return ss.str();
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Colorizer.h"
+#include "FrameDecimator.h"
+
+namespace cv
+{
+    class Mat;
+}
+
+// An additional loopback device fed from the same capture session as the primary one.
+// Each output has its own format, palette/AGC, fixed zoom/pan and frame decimation or rate.
+// Outputs that use the camera SDK frame share it with the primary output, outputs that
+// are colorized by echothermd share a ColorStage when their palette, range and format match.
+class LoopbackOutput
+{
+public:
+    struct Profile
+    {
+        std::string name;
+        std::string deviceName;
+        // SEEKCAMERA_FRAME_FORMAT_COLOR_ARGB8888 or SEEKCAMERA_FRAME_FORMAT_GRAYSCALE
+        int frameFormat;
+        // negative = use the camera SDK frame (SDK palette), else colorize in echothermd
+        int colorPalette;
+        // the colorizer range is automatic unless both temperatures are set (degrees C)
+        double minTemperature;
+        double maxTemperature;
+        double zoom;
+        // sensor pixel at the center of the zoomed view, NaN = center of the sensor
+        double panX;
+        double panY;
+        // write one frame out of every decimation frames
+        int decimation;
+        // write frames at this rate from the capture timestamps (after the decimation), 0 = every frame
+        double rate;
+    };
+    // parse name:key=value,key=value,...
+    // keys: device, format (ARGB|GREY), palette (SDK|0-8), min, max, zoom, panx, pany, decimate, rate
+    // return an empty string on success else a description of the error
+    static std::string parseProfile(std::string const &profileStr, Profile *p_profile);
+
+    // warp the source region with its top left corner at originX/originY onto dstMat (already sized),
+    // scale = source pixels per output pixel, used by the primary output and the profiles
+    static void warpRoi(cv::Mat const &srcMat, cv::Mat &dstMat, double scale, double originX, double originY, int interpolation);
+
+    explicit LoopbackOutput(Profile const &profile);
+    ~LoopbackOutput();
+    Profile const &getProfile() const;
+    // allocate the zoom frame for the source geometry ahead of the first frame
+    void reserve(int width, int height);
+    // decimation and rate, returns false for the frames that are not written (no work is to be done for them)
+    // captureTimeNs is the capture timestamp of the frame
+    bool wantsFrame(uint64_t captureTimeNs);
+    // write a source frame (camera geometry, output format) to the device
+    // arrivalTime is when the frame callback was entered and is used for the latency statistics
+    void write(cv::Mat const &srcFrame, std::chrono::system_clock::time_point arrivalTime);
+    // Get a string representing the output and its statistics
+    std::string getStats() const;
+
+private:
+    void _openDevice(int width, int height);
+    void _closeDevice();
+    Profile m_profile;
+    int m_device;
+    // a failed open is retried once this time is reached, not on every frame
+    std::chrono::steady_clock::time_point m_reopenTime;
+    int m_width;
+    int m_height;
+    FrameDecimator m_decimator;
+    uint64_t m_writtenCount;
+    uint64_t m_errorCount;
+    double m_cpuSumNs;
+    double m_cpuMaxNs;
+    double m_latencySumNs;
+    double m_latencyMaxNs;
+    std::unique_ptr<cv::Mat> mp_zoomFrame;
+};
+
+// A frame colorized by echothermd, computed at most once per camera frame and shared by the outputs using it.
+class ColorStage
+{
+public:
+    ColorStage(int frameFormat, int colorPalette, double minTemperature, double maxTemperature);
+    ~ColorStage();
+    bool matches(LoopbackOutput::Profile const &profile) const;
+    // allocate the color frame for the camera geometry ahead of the first frame
+    void reserve(int width, int height);
+    // colorize the FIXED_10_6 frame unless it was already done for this frame number
+    cv::Mat const &getFrame(uint64_t frameNum, uint16_t const *p_src, size_t srcStride, int width, int height);
+    // Get a string representing the stage and its cost
+    std::string getStats() const;
+
+private:
+    int m_frameFormat;
+    int m_colorPalette;
+    double m_minTemperature;
+    double m_maxTemperature;
+    Colorizer m_colorizer;
+    uint64_t m_frameNum;
+    uint64_t m_computeCount;
+    double m_cpuSumNs;
+    std::unique_ptr<cv::Mat> mp_frame;
+};
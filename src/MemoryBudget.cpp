@@ -0,0 +1,142 @@
+#include "MemoryBudget.h"
+#include <unistd.h>
+#include <array>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    constexpr static inline auto const n_categoryCount = size_t(MemoryBudget::Category::Count);
+    constexpr static inline char const *np_categoryNames[n_categoryCount]{
+        "recordingQueue",
+        "framePool",
+        "radiometricBuffers",
+        "connectionBuffers",
+        "preRoll",
+        "burst",
+    };
+    constexpr static inline auto const n_bytesPerKB = 1024.0;
+
+    struct CategoryUsage
+    {
+        std::atomic<size_t> current{0};
+        std::atomic<size_t> peak{0};
+        std::atomic<uint64_t> rejected{0};
+    };
+
+    std::array<CategoryUsage, n_categoryCount> n_usage;
+    std::atomic<size_t> n_total{0};
+    std::atomic<size_t> n_totalPeak{0};
+    std::atomic<size_t> n_budget{0};
+
+    void _updatePeak(std::atomic<size_t> &peak, size_t value)
+    {
+        auto previous = peak.load(std::memory_order_relaxed);
+        while (value > previous && !peak.compare_exchange_weak(previous, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void _add(MemoryBudget::Category category, size_t bytes)
+    {
+        auto &usage = n_usage[size_t(category)];
+        _updatePeak(usage.peak, usage.current.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    }
+
+    // resident set size of the whole process, for comparison with the tracked buffers
+    size_t _getResidentBytes()
+    {
+        size_t residentBytes = 0;
+        if (std::FILE *p_statm = std::fopen("/proc/self/statm", "r"))
+        {
+            unsigned long totalPages = 0;
+            unsigned long residentPages = 0;
+            if (std::fscanf(p_statm, "%lu %lu", &totalPages, &residentPages) == 2)
+            {
+                residentBytes = size_t(residentPages) * size_t(sysconf(_SC_PAGESIZE));
+            }
+            std::fclose(p_statm);
+        }
+        return residentBytes;
+    }
+
+    std::string _toKB(size_t bytes)
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1) << double(bytes) / n_bytesPerKB;
+        return ss.str();
+    }
+}
+
+bool MemoryBudget::tryAcquire(Category category, size_t bytes)
+{
+    auto const budget = n_budget.load(std::memory_order_relaxed);
+    auto total = n_total.load(std::memory_order_relaxed);
+    do
+    {
+        if (budget != 0 && total + bytes > budget)
+        {
+            n_usage[size_t(category)].rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!n_total.compare_exchange_weak(total, total + bytes, std::memory_order_relaxed));
+    _updatePeak(n_totalPeak, total + bytes);
+    _add(category, bytes);
+    return true;
+}
+
+void MemoryBudget::acquire(Category category, size_t bytes)
+{
+    _updatePeak(n_totalPeak, n_total.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    _add(category, bytes);
+}
+
+void MemoryBudget::release(Category category, size_t bytes)
+{
+    n_usage[size_t(category)].current.fetch_sub(bytes, std::memory_order_relaxed);
+    n_total.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool MemoryBudget::hasRoomFor(size_t bytes)
+{
+    auto const budget = n_budget.load(std::memory_order_relaxed);
+    return budget == 0 || n_total.load(std::memory_order_relaxed) + bytes <= budget;
+}
+
+void MemoryBudget::setBudget(size_t budgetBytes)
+{
+    n_budget.store(budgetBytes, std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::getBudget()
+{
+    return n_budget.load(std::memory_order_relaxed);
+}
+
+size_t MemoryBudget::getUsage()
+{
+    return n_total.load(std::memory_order_relaxed);
+}
+
+std::string MemoryBudget::getStatus()
+{
+    auto const budget = n_budget.load(std::memory_order_relaxed);
+    std::stringstream ss;
+    ss << "{";
+    ss << "budgetKB=" << (budget ? _toKB(budget) : std::string("unlimited"));
+    ss << ", usedKB=" << _toKB(n_total.load(std::memory_order_relaxed));
+    ss << ", peakKB=" << _toKB(n_totalPeak.load(std::memory_order_relaxed));
+    ss << ", residentKB=" << _toKB(_getResidentBytes());
+    for (size_t i = 0; i < n_categoryCount; ++i)
+    {
+        auto const &usage = n_usage[i];
+        ss << ", " << np_categoryNames[i] << "={";
+        ss << "usedKB=" << _toKB(usage.current.load(std::memory_order_relaxed));
+        ss << ", peakKB=" << _toKB(usage.peak.load(std::memory_order_relaxed));
+        ss << ", rejected=" << usage.rejected.load(std::memory_order_relaxed);
+        ss << "}";
+    }
+    ss << "}";
+    return ss.str();
+}
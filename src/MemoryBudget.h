@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// Accounting of the bytes held by the daemon's buffers and queues.
+// Every category tracks its current and peak usage, a global budget (zero means unlimited)
+// lets the frame path shed load (drop frames, refuse new recordings) instead of growing.
+class MemoryBudget
+{
+public:
+    enum class Category
+    {
+        RecordingQueue = 0,
+        FramePool,
+        RadiometricBuffers,
+        ConnectionBuffers,
+        PreRoll,
+        Burst,
+        Count
+    };
+    // reserve bytes for a category if the budget allows it, otherwise count a rejection and return false
+    static bool tryAcquire(Category category, size_t bytes);
+    // reserve bytes for a category regardless of the budget
+    static void acquire(Category category, size_t bytes);
+    // give back bytes previously reserved for a category
+    static void release(Category category, size_t bytes);
+    // check whether bytes could currently be reserved without exceeding the budget
+    static bool hasRoomFor(size_t bytes);
+    // set the global budget in bytes, zero = unlimited
+    static void setBudget(size_t budgetBytes);
+    static size_t getBudget();
+    // total bytes currently reserved in all categories
+    static size_t getUsage();
+    // Get a string representing current and peak usage per category
+    static std::string getStatus();
+};
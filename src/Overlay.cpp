@@ -0,0 +1,324 @@
+#include "Overlay.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/imgproc.hpp>
+
+namespace
+{
+    constexpr static inline auto const n_firstGlyph = ' ';
+    constexpr static inline auto const n_lastGlyph = '~';
+    constexpr static inline auto const n_glyphCount = n_lastGlyph - n_firstGlyph + 1;
+    constexpr static inline auto const n_font = cv::FONT_HERSHEY_PLAIN;
+    constexpr static inline auto const n_fontScale = 0.8;
+    // crosshair arms run from the gap to the length (pixels from the center)
+    constexpr static inline auto const n_crosshairGap = 2;
+    constexpr static inline auto const n_crosshairLength = 6;
+    // BGRA (V4L2 ARGB32 / CV_8UC4 byte order)
+    constexpr static inline auto const n_textColor = 0xFFFFFFFFu;
+    constexpr static inline auto const n_outlineColor = 0xFF000000u;
+    constexpr static inline auto const n_minColor = 0xFF40A0FFu;
+    constexpr static inline auto const n_maxColor = 0xFFFF4040u;
+    constexpr static inline auto const n_spotColor = 0xFF40FF40u;
+    constexpr static inline auto const n_hotspotColor = 0xFF40FFFFu;
+
+    uint8_t _toGrey(uint32_t color)
+    {
+        return (uint8_t)((((color >> 16) & 0xFF) * 77 + ((color >> 8) & 0xFF) * 150 + (color & 0xFF) * 29) >> 8);
+    }
+
+    void _setPixel(cv::Mat &frame, int x, int y, uint32_t color)
+    {
+        if (x < 0 || y < 0 || x >= frame.cols || y >= frame.rows)
+        {
+            return;
+        }
+        if (frame.type() == CV_8UC4)
+        {
+            frame.ptr<uint32_t>(y)[x] = color;
+        }
+        else
+        {
+            frame.ptr<uint8_t>(y)[x] = _toGrey(color);
+        }
+    }
+}
+
+Overlay::Overlay()
+    : m_items{None},
+      m_min{},
+      m_max{},
+      m_spot{},
+      m_hotspots{},
+      m_hasMeasurements{false},
+      m_glyphWidth{0},
+      m_glyphHeight{0},
+      m_fillMask{},
+      m_outlineMask{},
+      m_drawCount{0},
+      m_drawSumNs{0.0},
+      m_drawMaxNs{0.0}
+{
+}
+
+void Overlay::setItems(int items)
+{
+    m_items = items & All;
+    if (m_items != None && m_fillMask.empty())
+    {
+        _buildAtlas();
+    }
+    m_drawCount = 0;
+    m_drawSumNs = 0.0;
+    m_drawMaxNs = 0.0;
+}
+
+int Overlay::getItems() const
+{
+    return m_items;
+}
+
+bool Overlay::isEnabled() const
+{
+    return m_items != None;
+}
+
+void Overlay::setMeasurements(Measurement const &min, Measurement const &max, Measurement const &spot)
+{
+    m_min = min;
+    m_max = max;
+    m_spot = spot;
+    m_hasMeasurements = true;
+}
+
+void Overlay::setHotspots(std::vector<Box> &&hotspots)
+{
+    m_hotspots = std::move(hotspots);
+}
+
+void Overlay::draw(cv::Mat &frame, double roiOriginX, double roiOriginY, double zoom)
+{
+    if (m_items == None || !m_hasMeasurements || (frame.type() != CV_8UC4 && frame.type() != CV_8U))
+    {
+        return;
+    }
+    TRACE_SCOPE("Overlay::draw");
+    auto const startTime = std::chrono::steady_clock::now();
+    if (m_items & Min)
+    {
+        _drawMarker(frame, m_min, "min", n_minColor, roiOriginX, roiOriginY, zoom);
+    }
+    if (m_items & Max)
+    {
+        _drawMarker(frame, m_max, "max", n_maxColor, roiOriginX, roiOriginY, zoom);
+    }
+    if (m_items & Spot)
+    {
+        _drawMarker(frame, m_spot, "spot", n_spotColor, roiOriginX, roiOriginY, zoom);
+    }
+    if (m_items & Hotspots)
+    {
+        for (auto const &box : m_hotspots)
+        {
+            _drawBox(frame, box, roiOriginX, roiOriginY, zoom);
+        }
+    }
+    auto const drawNs = double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+    ++m_drawCount;
+    m_drawSumNs += drawNs;
+    m_drawMaxNs = std::max(m_drawMaxNs, drawNs);
+}
+
+std::string Overlay::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "{";
+    ss << "enabled=" << (m_items != None ? "true" : "false");
+    ss << ", items={min=" << ((m_items & Min) ? "true" : "false");
+    ss << ", max=" << ((m_items & Max) ? "true" : "false");
+    ss << ", spot=" << ((m_items & Spot) ? "true" : "false");
+    ss << ", hotspots=" << ((m_items & Hotspots) ? "true" : "false") << "}";
+    ss << ", frames=" << m_drawCount;
+    ss << ", drawMs={mean=" << (m_drawCount > 0 ? m_drawSumNs / double(m_drawCount) / 1e6 : 0.0) << ", max=" << m_drawMaxNs / 1e6 << "}";
+    ss << "}";
+    return ss.str();
+}
+
+// render every printable character once, the outline is the fill grown by one pixel
+void Overlay::_buildAtlas()
+{
+    TRACE_SCOPE("Overlay::_buildAtlas");
+    int glyphAscent = 0;
+    int glyphDescent = 0;
+    int glyphAdvance = 0;
+    for (char c = n_firstGlyph; c <= n_lastGlyph; ++c)
+    {
+        int baseline = 0;
+        auto const size = cv::getTextSize(std::string(1, c), n_font, n_fontScale, 1, &baseline);
+        glyphAdvance = std::max(glyphAdvance, size.width);
+        glyphAscent = std::max(glyphAscent, size.height);
+        glyphDescent = std::max(glyphDescent, baseline);
+    }
+    // one pixel of outline on every side
+    m_glyphWidth = glyphAdvance + 2;
+    m_glyphHeight = glyphAscent + glyphDescent + 2;
+    auto const cellSize = size_t(m_glyphWidth) * size_t(m_glyphHeight);
+    m_fillMask.assign(cellSize * n_glyphCount, 0);
+    m_outlineMask.assign(cellSize * n_glyphCount, 0);
+    for (char c = n_firstGlyph; c <= n_lastGlyph; ++c)
+    {
+        cv::Mat cell(m_glyphHeight, m_glyphWidth, CV_8U, cv::Scalar(0));
+        cv::putText(cell, std::string(1, c), cv::Point(1, 1 + glyphAscent), n_font, n_fontScale, cv::Scalar(255), 1, cv::LINE_8);
+        auto *const p_fill = m_fillMask.data() + size_t(c - n_firstGlyph) * cellSize;
+        auto *const p_outline = m_outlineMask.data() + size_t(c - n_firstGlyph) * cellSize;
+        for (int y = 0; y < m_glyphHeight; ++y)
+        {
+            for (int x = 0; x < m_glyphWidth; ++x)
+            {
+                p_fill[y * m_glyphWidth + x] = cell.ptr<uint8_t>(y)[x] > 127 ? 1 : 0;
+            }
+        }
+        for (int y = 0; y < m_glyphHeight; ++y)
+        {
+            for (int x = 0; x < m_glyphWidth; ++x)
+            {
+                if (p_fill[y * m_glyphWidth + x])
+                {
+                    continue;
+                }
+                for (int dy = -1; dy <= 1 && !p_outline[y * m_glyphWidth + x]; ++dy)
+                {
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        auto const nx = x + dx;
+                        auto const ny = y + dy;
+                        if (nx >= 0 && ny >= 0 && nx < m_glyphWidth && ny < m_glyphHeight && p_fill[ny * m_glyphWidth + nx])
+                        {
+                            p_outline[y * m_glyphWidth + x] = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Overlay::_drawMarker(cv::Mat &frame, Measurement const &measurement, char const *p_name, uint32_t color,
+                          double roiOriginX, double roiOriginY, double zoom)
+{
+    // sensor pixel center to output pixel, the same mapping as the zoom warp
+    auto const x = (int)std::lround((measurement.x + 0.5 - roiOriginX) * zoom - 0.5);
+    auto const y = (int)std::lround((measurement.y + 0.5 - roiOriginY) * zoom - 0.5);
+    if (x < 0 || y < 0 || x >= frame.cols || y >= frame.rows)
+    {
+        // panned or zoomed out of view
+        return;
+    }
+    _drawCrosshair(frame, x, y, color);
+    char p_text[32];
+    std::snprintf(p_text, sizeof(p_text), "%s %.1fC", p_name, measurement.value);
+    auto const textWidth = int(std::strlen(p_text)) * (m_glyphWidth - 2) + 2;
+    // above right of the crosshair, flipped to stay inside the frame
+    auto labelX = x + n_crosshairLength + 1;
+    auto labelY = y - n_crosshairLength - m_glyphHeight;
+    if (labelX + textWidth > frame.cols)
+    {
+        labelX = x - n_crosshairLength - 1 - textWidth;
+    }
+    if (labelY < 0)
+    {
+        labelY = y + n_crosshairLength + 1;
+    }
+    _drawLabel(frame, std::max(0, labelX), std::min(labelY, frame.rows - m_glyphHeight), p_text);
+}
+
+void Overlay::_drawBox(cv::Mat &frame, Box const &box, double roiOriginX, double roiOriginY, double zoom)
+{
+    // outer edges of the sensor pixels, the same mapping as the zoom warp
+    auto const left = (int)std::lround((box.left - roiOriginX) * zoom);
+    auto const top = (int)std::lround((box.top - roiOriginY) * zoom);
+    auto const right = (int)std::lround((box.left + box.width - roiOriginX) * zoom) - 1;
+    auto const bottom = (int)std::lround((box.top + box.height - roiOriginY) * zoom) - 1;
+    if (right < 0 || bottom < 0 || left >= frame.cols || top >= frame.rows)
+    {
+        return;
+    }
+    // the box in the hotspot color between a one pixel outline inside and outside
+    for (auto const &[grow, color] : {std::make_pair(-1, n_outlineColor), std::make_pair(1, n_outlineColor), std::make_pair(0, n_hotspotColor)})
+    {
+        for (int x = left - grow; x <= right + grow; ++x)
+        {
+            _setPixel(frame, x, top - grow, color);
+            _setPixel(frame, x, bottom + grow, color);
+        }
+        for (int y = top - grow; y <= bottom + grow; ++y)
+        {
+            _setPixel(frame, left - grow, y, color);
+            _setPixel(frame, right + grow, y, color);
+        }
+    }
+    char p_text[32];
+    std::snprintf(p_text, sizeof(p_text), "#%d %.1fC", box.id, box.value);
+    auto labelY = top - 2 - m_glyphHeight;
+    if (labelY < 0)
+    {
+        labelY = bottom + 2;
+    }
+    auto const textWidth = int(std::strlen(p_text)) * (m_glyphWidth - 2) + 2;
+    _drawLabel(frame, std::clamp(left, 0, std::max(0, frame.cols - textWidth)), std::min(labelY, frame.rows - m_glyphHeight), p_text);
+}
+
+void Overlay::_drawCrosshair(cv::Mat &frame, int x, int y, uint32_t color)
+{
+    // outline first so that the arms stay visible on any palette
+    for (int r = n_crosshairGap - 1; r <= n_crosshairLength + 1; ++r)
+    {
+        for (int w = -1; w <= 1; ++w)
+        {
+            _setPixel(frame, x + r, y + w, n_outlineColor);
+            _setPixel(frame, x - r, y + w, n_outlineColor);
+            _setPixel(frame, x + w, y + r, n_outlineColor);
+            _setPixel(frame, x + w, y - r, n_outlineColor);
+        }
+    }
+    for (int r = n_crosshairGap; r <= n_crosshairLength; ++r)
+    {
+        _setPixel(frame, x + r, y, color);
+        _setPixel(frame, x - r, y, color);
+        _setPixel(frame, x, y + r, color);
+        _setPixel(frame, x, y - r, color);
+    }
+}
+
+void Overlay::_drawLabel(cv::Mat &frame, int x, int y, char const *p_text)
+{
+    auto const cellSize = size_t(m_glyphWidth) * size_t(m_glyphHeight);
+    // the cells of neighboring glyphs overlap by the outline, so every outline goes down before any fill
+    for (auto const *p_mask : {m_outlineMask.data(), m_fillMask.data()})
+    {
+        auto const color = p_mask == m_fillMask.data() ? n_textColor : n_outlineColor;
+        auto glyphX = x;
+        for (auto const *p_char = p_text; *p_char; ++p_char, glyphX += m_glyphWidth - 2)
+        {
+            auto const c = (*p_char < n_firstGlyph || *p_char > n_lastGlyph) ? '?' : *p_char;
+            auto const *const p_glyph = p_mask + size_t(c - n_firstGlyph) * cellSize;
+            for (int gy = 0; gy < m_glyphHeight; ++gy)
+            {
+                for (int gx = 0; gx < m_glyphWidth; ++gx)
+                {
+                    if (p_glyph[gy * m_glyphWidth + gx])
+                    {
+                        _setPixel(frame, glyphX + gx, y + gy, color);
+                    }
+                }
+            }
+        }
+    }
+}
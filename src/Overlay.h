@@ -0,0 +1,82 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cv
+{
+    class Mat;
+}
+
+// Burns crosshairs and temperature labels for the min, max and spot pixels into an output frame,
+// and outlines the tracked hotspots with their id and peak temperature.
+// The glyphs are rendered once with cv::putText into an atlas (fill and outline masks),
+// each frame only blits them, so the cost does not depend on the font rasterizer.
+class Overlay
+{
+public:
+    enum Item
+    {
+        None = 0,
+        Min = 1,
+        Max = 2,
+        Spot = 4,
+        Hotspots = 8,
+        All = Min | Max | Spot | Hotspots
+    };
+    struct Measurement
+    {
+        // sensor pixel coordinates
+        int x;
+        int y;
+        // degrees C
+        float value;
+    };
+    struct Box
+    {
+        int id;
+        // bounding box in sensor pixel coordinates
+        int left;
+        int top;
+        int width;
+        int height;
+        // degrees C
+        float value;
+    };
+    Overlay();
+    // bitwise OR of Item, None disables the overlay
+    void setItems(int items);
+    int getItems() const;
+    bool isEnabled() const;
+    // measurements of the current frame, from the seekcamera frame header
+    void setMeasurements(Measurement const &min, Measurement const &max, Measurement const &spot);
+    // tracked hotspots to outline, from the HotspotDetector
+    void setHotspots(std::vector<Box> &&hotspots);
+    // draw into a CV_8UC4 or CV_8U frame that shows the sensor from roiOrigin at the zoom
+    void draw(cv::Mat &frame, double roiOriginX, double roiOriginY, double zoom);
+    // Get a string representing the items and the drawing cost
+    std::string getStatus() const;
+
+private:
+    void _buildAtlas();
+    void _drawMarker(cv::Mat &frame, Measurement const &measurement, char const *p_name, uint32_t color,
+                     double roiOriginX, double roiOriginY, double zoom);
+    void _drawBox(cv::Mat &frame, Box const &box, double roiOriginX, double roiOriginY, double zoom);
+    void _drawCrosshair(cv::Mat &frame, int x, int y, uint32_t color);
+    void _drawLabel(cv::Mat &frame, int x, int y, char const *p_text);
+    int m_items;
+    Measurement m_min;
+    Measurement m_max;
+    Measurement m_spot;
+    std::vector<Box> m_hotspots;
+    bool m_hasMeasurements;
+    int m_glyphWidth;
+    int m_glyphHeight;
+    // one glyph cell per printable ASCII character, 1 = set
+    std::vector<uint8_t> m_fillMask;
+    std::vector<uint8_t> m_outlineMask;
+    uint64_t m_drawCount;
+    double m_drawSumNs;
+    double m_drawMaxNs;
+};
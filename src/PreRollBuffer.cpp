@@ -0,0 +1,208 @@
+#include "PreRollBuffer.h"
+#include "AsyncLog.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <syslog.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+
+namespace
+{
+    constexpr static inline auto const n_bytesPerMegabyte = 1024.0 * 1024.0;
+}
+
+struct PreRollBuffer::Slot
+{
+    cv::Mat frame;
+    uint64_t captureTimeNs;
+};
+
+PreRollBuffer::PreRollBuffer()
+    : m_seconds{0.0},
+      m_maxMegabytes{0.0},
+      m_slots{},
+      m_slotBytes{0},
+      m_next{0},
+      m_count{0},
+      m_fps{0.0},
+      m_allocationFailed{false},
+      m_overwrittenCount{0},
+      m_flushedCount{0}
+{
+}
+
+PreRollBuffer::~PreRollBuffer()
+{
+    _free();
+}
+
+void PreRollBuffer::setDuration(double seconds, double maxMegabytes)
+{
+    TRACE_SCOPE("PreRollBuffer::setDuration");
+    m_seconds = std::isfinite(seconds) && seconds > 0.0 ? seconds : 0.0;
+    m_maxMegabytes = std::isfinite(maxMegabytes) && maxMegabytes > 0.0 ? maxMegabytes : 0.0;
+    m_allocationFailed = false;
+    _free();
+}
+
+double PreRollBuffer::getDuration() const
+{
+    return m_seconds;
+}
+
+bool PreRollBuffer::isEnabled() const
+{
+    return m_seconds > 0.0;
+}
+
+void PreRollBuffer::push(cv::Mat const &frame, uint64_t captureTimeNs, double fps)
+{
+    if (!isEnabled() || fps <= 0.0)
+    {
+        return;
+    }
+    auto const frameBytes = frame.total() * frame.elemSize();
+    if (m_slots.empty() || m_slots.front().frame.rows != frame.rows || m_slots.front().frame.cols != frame.cols || m_slots.front().frame.type() != frame.type() || fps != m_fps)
+    {
+        if (m_allocationFailed && frameBytes == m_slotBytes && fps == m_fps)
+        {
+            return;
+        }
+        _allocate(frame, fps);
+        if (m_slots.empty())
+        {
+            return;
+        }
+    }
+    TRACE_SCOPE("PreRollBuffer::push");
+    auto &slot = m_slots[m_next];
+    if (frame.isContinuous() && slot.frame.isContinuous())
+    {
+        std::memcpy(slot.frame.data, frame.data, frameBytes);
+    }
+    else
+    {
+        frame.copyTo(slot.frame);
+    }
+    slot.captureTimeNs = captureTimeNs;
+    m_next = (m_next + 1) % m_slots.size();
+    if (m_count < m_slots.size())
+    {
+        ++m_count;
+    }
+    else
+    {
+        ++m_overwrittenCount;
+    }
+}
+
+std::vector<cv::Mat> PreRollBuffer::takeFrames()
+{
+    TRACE_SCOPE("PreRollBuffer::takeFrames");
+    std::vector<cv::Mat> frames;
+    if (m_count > 0)
+    {
+        auto const first = (m_next + m_slots.size() - m_count) % m_slots.size();
+        auto const newestNs = m_slots[(m_next + m_slots.size() - 1) % m_slots.size()].captureTimeNs;
+        // the ring is sized for the nominal rate, at a lower rate it spans more than the pre-roll
+        auto const oldestNs = newestNs - std::min(newestNs, uint64_t(m_seconds * 1e9));
+        frames.reserve(m_count);
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            auto &slot = m_slots[(first + i) % m_slots.size()];
+            if (slot.captureTimeNs >= oldestNs)
+            {
+                auto const rows = slot.frame.rows;
+                auto const cols = slot.frame.cols;
+                auto const type = slot.frame.type();
+                frames.push_back(std::move(slot.frame));
+                // on the caller's thread, the frame callback keeps copying into allocated slots
+                slot.frame.create(rows, cols, type);
+            }
+        }
+        m_flushedCount += frames.size();
+    }
+    m_next = 0;
+    m_count = 0;
+    return frames;
+}
+
+void PreRollBuffer::clear()
+{
+    _free();
+}
+
+std::string PreRollBuffer::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "seconds=" << m_seconds;
+    ss << ", maxMB=" << m_maxMegabytes;
+    if (m_allocationFailed)
+    {
+        ss << ", state=budgetExhausted";
+    }
+    ss << ", slots=" << m_slots.size();
+    ss << ", frames=" << m_count;
+    double heldSeconds = 0.0;
+    if (m_count > 1)
+    {
+        auto const &oldest = m_slots[(m_next + m_slots.size() - m_count) % m_slots.size()];
+        auto const &newest = m_slots[(m_next + m_slots.size() - 1) % m_slots.size()];
+        heldSeconds = double(newest.captureTimeNs - oldest.captureTimeNs) * 1e-9;
+    }
+    ss << ", heldS=" << heldSeconds;
+    ss << ", MB=" << double(m_slots.size() * m_slotBytes) / n_bytesPerMegabyte;
+    ss << ", overwritten=" << m_overwrittenCount;
+    ss << ", flushed=" << m_flushedCount;
+    ss << "}";
+    return ss.str();
+}
+
+void PreRollBuffer::_allocate(cv::Mat const &frame, double fps)
+{
+    TRACE_SCOPE("PreRollBuffer::_allocate");
+    _free();
+    m_slotBytes = frame.total() * frame.elemSize();
+    m_fps = fps;
+    auto slotCount = size_t(std::ceil(m_seconds * fps));
+    if (m_maxMegabytes > 0.0)
+    {
+        slotCount = std::min(slotCount, size_t(m_maxMegabytes * n_bytesPerMegabyte) / m_slotBytes);
+    }
+    slotCount = std::max(slotCount, size_t(1));
+    if (!MemoryBudget::tryAcquire(MemoryBudget::Category::PreRoll, slotCount * m_slotBytes))
+    {
+        AsyncLog::log(LOG_WARNING, "Pre-roll of %zu frames (%.1f MB) not allocated because the memory budget is exhausted.",
+                      slotCount, double(slotCount * m_slotBytes) / n_bytesPerMegabyte);
+        m_allocationFailed = true;
+        return;
+    }
+    m_allocationFailed = false;
+    m_slots.resize(slotCount);
+    for (auto &slot : m_slots)
+    {
+        slot.frame.create(frame.rows, frame.cols, frame.type());
+        slot.captureTimeNs = 0;
+    }
+    AsyncLog::log(LOG_NOTICE, "Pre-roll of %zu frames (%.1f s, %.1f MB) allocated.",
+                  slotCount, double(slotCount) / fps, double(slotCount * m_slotBytes) / n_bytesPerMegabyte);
+}
+
+void PreRollBuffer::_free()
+{
+    if (!m_slots.empty())
+    {
+        MemoryBudget::release(MemoryBudget::Category::PreRoll, m_slots.size() * m_slotBytes);
+    }
+    m_slots.clear();
+    m_slots.shrink_to_fit();
+    m_next = 0;
+    m_count = 0;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cv
+{
+    class Mat;
+}
+
+// Keeps the last seconds of the recorded frames in memory (pre-event / pre-roll recording), so that
+// a recording started after an event still contains the seconds before it.
+// The ring is a pool of frame slots allocated once for the frame geometry and the frame rate, a new
+// frame is copied over the oldest one, so the memory cost is fixed and nothing is allocated per frame.
+// The slots are accounted in MemoryBudget; a ring that does not fit the budget is not allocated.
+// EchoThermCamera guards it with m_recordingFrameQueueMut, the frame callback pushes and startRecording takes the frames.
+class PreRollBuffer
+{
+public:
+    PreRollBuffer();
+    ~PreRollBuffer();
+    // keep the last seconds of frames, in at most maxMegabytes (0 = no size limit), 0 seconds = disabled
+    // the ring is freed and allocated again on the next push
+    void setDuration(double seconds, double maxMegabytes);
+    double getDuration() const;
+    bool isEnabled() const;
+    // copy a frame into the ring, fps is the nominal rate of the pushed frames and sizes the ring
+    void push(cv::Mat const &frame, uint64_t captureTimeNs, double fps);
+    // move out the frames of the last seconds, oldest first, and empty the ring
+    // the moved slots get new memory, so the ring stays allocated; the frames are no longer accounted as pre-roll
+    std::vector<cv::Mat> takeFrames();
+    // drop the frames and free the ring
+    void clear();
+    // Get a string representing the settings, the frames held and the memory of the ring
+    std::string getStatus() const;
+
+private:
+    struct Slot;
+    void _allocate(cv::Mat const &frame, double fps);
+    void _free();
+    double m_seconds;
+    double m_maxMegabytes;
+    std::vector<Slot> m_slots;
+    size_t m_slotBytes;
+    // slot of the next frame and the number of slots holding a frame
+    size_t m_next;
+    size_t m_count;
+    double m_fps;
+    // set when the budget refused the ring, retried when the geometry or the rate changes
+    bool m_allocationFailed;
+    uint64_t m_overwrittenCount;
+    uint64_t m_flushedCount;
+};
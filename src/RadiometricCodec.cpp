@@ -0,0 +1,168 @@
+#include "RadiometricCodec.h"
+#include "Trace.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <zlib.h>
+
+namespace
+{
+    // fastest level, the prediction does most of the work
+    constexpr static inline auto const n_deflateLevel = 1;
+
+    template <typename Word>
+    Word _predict(Word left, Word up, Word upLeft)
+    {
+        // median edge detector: the left or upper neighbour across an edge, the gradient otherwise
+        if (upLeft >= std::max(left, up))
+        {
+            return std::min(left, up);
+        }
+        if (upLeft <= std::min(left, up))
+        {
+            return std::max(left, up);
+        }
+        return Word(left + up - upLeft);
+    }
+
+    template <typename Word>
+    Word _getPredicted(Word const *p_pixels, int width, int x, int y)
+    {
+        if (y == 0)
+        {
+            return x == 0 ? Word(0) : p_pixels[x - 1];
+        }
+        auto const *const p_up = p_pixels + size_t(y - 1) * size_t(width);
+        auto const *const p_row = p_up + width;
+        return x == 0 ? p_up[0] : _predict<Word>(p_row[x - 1], p_up[x], p_up[x - 1]);
+    }
+
+    // residuals near 0 in both directions become small unsigned values
+    template <typename Word>
+    Word _zigzag(Word residual)
+    {
+        using Signed = std::make_signed_t<Word>;
+        return Word((residual << 1) ^ Word(Signed(residual) >> (sizeof(Word) * 8 - 1)));
+    }
+
+    template <typename Word>
+    Word _unzigzag(Word value)
+    {
+        return Word((value >> 1) ^ Word(-(value & 1)));
+    }
+
+    // the pixel words follow the frame in the scratch buffer, aligned for the widest word
+    size_t _getWordsOffset(size_t frameSize)
+    {
+        return (frameSize + alignof(uint32_t) - 1) / alignof(uint32_t) * alignof(uint32_t);
+    }
+
+    // p_pixels = width x height words of scratch memory
+    template <typename Word>
+    void _encodePixels(uint8_t const *p_pixelBytes, int width, int height, uint8_t *p_planes, Word *p_pixels)
+    {
+        auto const pixelCount = size_t(width) * size_t(height);
+        std::memcpy(p_pixels, p_pixelBytes, pixelCount * sizeof(Word));
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                auto const i = size_t(y) * size_t(width) + size_t(x);
+                auto const residual = _zigzag<Word>(Word(p_pixels[i] - _getPredicted<Word>(p_pixels, width, x, y)));
+                for (size_t plane = 0; plane < sizeof(Word); ++plane)
+                {
+                    p_planes[plane * pixelCount + i] = uint8_t(residual >> (plane * 8));
+                }
+            }
+        }
+    }
+
+    // p_pixels = width x height words of scratch memory
+    template <typename Word>
+    void _decodePixels(uint8_t const *p_planes, int width, int height, uint8_t *p_pixelBytes, Word *p_pixels)
+    {
+        auto const pixelCount = size_t(width) * size_t(height);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                auto const i = size_t(y) * size_t(width) + size_t(x);
+                Word residual = 0;
+                for (size_t plane = 0; plane < sizeof(Word); ++plane)
+                {
+                    residual |= Word(Word(p_planes[plane * pixelCount + i]) << (plane * 8));
+                }
+                p_pixels[i] = Word(_unzigzag<Word>(residual) + _getPredicted<Word>(p_pixels, width, x, y));
+            }
+        }
+        std::memcpy(p_pixelBytes, p_pixels, pixelCount * sizeof(Word));
+    }
+}
+
+size_t RadiometricCodec::getMaxEncodedSize(size_t frameHeaderSize, int width, int height, size_t bytesPerPixel)
+{
+    return compressBound(uLong(frameHeaderSize + size_t(width) * size_t(height) * bytesPerPixel));
+}
+
+size_t RadiometricCodec::getScratchSize(size_t frameHeaderSize, int width, int height, size_t bytesPerPixel)
+{
+    auto const pixelBytes = size_t(width) * size_t(height) * bytesPerPixel;
+    return _getWordsOffset(frameHeaderSize + pixelBytes) + pixelBytes;
+}
+
+size_t RadiometricCodec::encode(uint8_t const *p_frame, size_t frameHeaderSize, int width, int height, size_t bytesPerPixel,
+                                std::vector<uint8_t> &scratch, uint8_t *p_encoded, size_t encodedCapacity)
+{
+    TRACE_SCOPE("RadiometricCodec::encode");
+    if (bytesPerPixel != sizeof(uint16_t) && bytesPerPixel != sizeof(uint32_t))
+    {
+        return 0;
+    }
+    auto const frameSize = frameHeaderSize + size_t(width) * size_t(height) * bytesPerPixel;
+    // no reallocation once the scratch buffer has grown to the frame size
+    scratch.resize(getScratchSize(frameHeaderSize, width, height, bytesPerPixel));
+    auto *const p_words = scratch.data() + _getWordsOffset(frameSize);
+    std::memcpy(scratch.data(), p_frame, frameHeaderSize);
+    if (bytesPerPixel == sizeof(uint16_t))
+    {
+        _encodePixels<uint16_t>(p_frame + frameHeaderSize, width, height, scratch.data() + frameHeaderSize, (uint16_t *)p_words);
+    }
+    else
+    {
+        _encodePixels<uint32_t>(p_frame + frameHeaderSize, width, height, scratch.data() + frameHeaderSize, (uint32_t *)p_words);
+    }
+    auto encodedSize = uLongf(encodedCapacity);
+    if (compress2(p_encoded, &encodedSize, scratch.data(), uLong(frameSize), n_deflateLevel) != Z_OK)
+    {
+        return 0;
+    }
+    return size_t(encodedSize);
+}
+
+bool RadiometricCodec::decode(uint8_t const *p_encoded, size_t encodedSize, size_t frameHeaderSize, int width, int height, size_t bytesPerPixel,
+                              std::vector<uint8_t> &scratch, uint8_t *p_frame)
+{
+    TRACE_SCOPE("RadiometricCodec::decode");
+    if (bytesPerPixel != sizeof(uint16_t) && bytesPerPixel != sizeof(uint32_t))
+    {
+        return false;
+    }
+    auto const frameSize = frameHeaderSize + size_t(width) * size_t(height) * bytesPerPixel;
+    scratch.resize(getScratchSize(frameHeaderSize, width, height, bytesPerPixel));
+    auto *const p_words = scratch.data() + _getWordsOffset(frameSize);
+    auto decodedSize = uLongf(frameSize);
+    if (uncompress(scratch.data(), &decodedSize, p_encoded, uLong(encodedSize)) != Z_OK || decodedSize != frameSize)
+    {
+        return false;
+    }
+    std::memcpy(p_frame, scratch.data(), frameHeaderSize);
+    if (bytesPerPixel == sizeof(uint16_t))
+    {
+        _decodePixels<uint16_t>(scratch.data() + frameHeaderSize, width, height, p_frame + frameHeaderSize, (uint16_t *)p_words);
+    }
+    else
+    {
+        _decodePixels<uint32_t>(scratch.data() + frameHeaderSize, width, height, p_frame + frameHeaderSize, (uint32_t *)p_words);
+    }
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless compression of the radiometric frames (FIXED_10_6 or FLOAT). Each pixel is predicted
+// from its left, upper and upper left neighbours (the median edge detector of JPEG-LS), so the
+// smooth thermal scene leaves small residuals; the residuals are zigzag mapped, split into byte
+// planes (all low bytes, then all high bytes) and deflated with zlib at its fastest level together
+// with the camera frame header. FLOAT pixels are predicted on their bit patterns, which keeps the
+// round trip exact. A frame only depends on itself, so any frame can be decoded on its own.
+class RadiometricCodec
+{
+public:
+    enum class Method : uint32_t
+    {
+        None = 0,
+        DeltaDeflate = 1,
+    };
+    // bytes of the encoded frame at most
+    static size_t getMaxEncodedSize(size_t frameHeaderSize, int width, int height, size_t bytesPerPixel);
+    // bytes of the scratch buffer used by encode() and decode(), the residual planes and the pixel words
+    static size_t getScratchSize(size_t frameHeaderSize, int width, int height, size_t bytesPerPixel);
+    // p_frame = frame header followed by the pixel rows without padding, scratch is reused between calls
+    // return the encoded size, 0 on failure
+    static size_t encode(uint8_t const *p_frame, size_t frameHeaderSize, int width, int height, size_t bytesPerPixel,
+                         std::vector<uint8_t> &scratch, uint8_t *p_encoded, size_t encodedCapacity);
+    // decode into p_frame (frame header followed by the pixel rows), return false when the data is corrupt
+    static bool decode(uint8_t const *p_encoded, size_t encodedSize, size_t frameHeaderSize, int width, int height, size_t bytesPerPixel,
+                       std::vector<uint8_t> &scratch, uint8_t *p_frame);
+};
@@ -0,0 +1,414 @@
+#include "RadiometricRecorder.h"
+#include "AsyncLog.h"
+#include "Trace.h"
+#include <syslog.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // one chunk being filled, one being written and one spare for a slow write
+    constexpr static inline auto const n_chunkBuffers = size_t(3);
+    // index entries reserved up front, about ten minutes at 27 fps
+    constexpr static inline auto const n_reservedIndexEntries = size_t(16384);
+    // allocated ahead of the writes, about 10 s at 320x240 and 27 fps
+    constexpr static inline auto const n_preallocateBytes = uint64_t(64) * 1024 * 1024;
+    // writeback started every interval, keeps the dirty pages of an SD card below a second of writes
+    constexpr static inline auto const n_syncIntervalBytes = uint64_t(4) * 1024 * 1024;
+    constexpr static inline auto const n_bytesPerMegabyte = 1024.0 * 1024.0;
+    constexpr static inline char const np_fileMagic[8]{'E', 'T', 'R', 'A', 'D', 'I', 'O', '\0'};
+    // frames waiting for or being compressed per compression thread
+    constexpr static inline auto const n_slotsPerThread = size_t(2);
+    constexpr static inline char const np_frameMagic[4]{'F', 'R', 'M', 'E'};
+    constexpr static inline char const np_encodedMagic[4]{'F', 'R', 'M', 'Z'};
+    constexpr static inline char const np_indexMagic[8]{'E', 'T', 'I', 'N', 'D', 'E', 'X', '\0'};
+}
+
+RadiometricRecorder::RadiometricRecorder(std::filesystem::path const &filePath, size_t framesPerChunk, bool direct, int compressionThreads)
+    : m_filePath{filePath},
+      m_framesPerChunk{std::max(framesPerChunk, size_t(1))},
+      m_direct{direct},
+      m_opened{false},
+      m_fileHeader{},
+      mp_file{},
+      m_index{},
+      m_frameCount{0},
+      m_droppedCount{0},
+      m_compressionThreads{std::max(compressionThreads, 0)},
+      m_slots{},
+      m_slotBytes{0},
+      m_nextSequence{0},
+      m_mut{},
+      m_slotCondition{},
+      m_freeSlots{},
+      m_pendingSlots{},
+      m_nextWrite{0},
+      m_compressorsRunning{false},
+      m_rawBytes{0},
+      m_encodedBytes{0},
+      m_encodeSeconds{0.0},
+      m_error{},
+      m_compressorThreads{}
+{
+    TRACE_SCOPE("RadiometricRecorder::RadiometricRecorder");
+    std::memcpy(m_fileHeader.magic, np_fileMagic, sizeof(m_fileHeader.magic));
+    // version 1 readers can still read the uncompressed files
+    m_fileHeader.version = m_compressionThreads > 0 ? n_version : 1;
+    // the file is written once the frame geometry is known, fail now if it can not be created
+    auto const fd = open(m_filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        m_error = std::strerror(errno);
+        return;
+    }
+    close(fd);
+    m_opened = true;
+}
+
+RadiometricRecorder::~RadiometricRecorder()
+{
+    finish();
+}
+
+bool RadiometricRecorder::isOpened() const
+{
+    return m_opened;
+}
+
+bool RadiometricRecorder::addFrame(void const *p_frameHeader, size_t frameHeaderSize, uint64_t timestampUtcNs, char const *p_chipId,
+                                   int frameFormat, void const *p_pixels, int width, int height, size_t bytesPerPixel, size_t lineStride)
+{
+    if (!m_opened)
+    {
+        return false;
+    }
+    TRACE_SCOPE("RadiometricRecorder::addFrame");
+    if (!mp_file)
+    {
+        {
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            m_fileHeader.frameFormat = uint32_t(frameFormat);
+            m_fileHeader.width = uint32_t(width);
+            m_fileHeader.height = uint32_t(height);
+            m_fileHeader.bytesPerPixel = uint32_t(bytesPerPixel);
+            m_fileHeader.frameHeaderSize = uint32_t(frameHeaderSize);
+            m_fileHeader.recordSize = sizeof(FrameRecord) + frameHeaderSize + size_t(width) * size_t(height) * bytesPerPixel;
+            if (p_chipId)
+            {
+                std::strncpy(m_fileHeader.chipId, p_chipId, sizeof(m_fileHeader.chipId));
+            }
+        }
+        if (!_open())
+        {
+            ++m_droppedCount;
+            return false;
+        }
+        m_index.reserve(n_reservedIndexEntries);
+    }
+    else if (m_fileHeader.frameFormat != uint32_t(frameFormat) || m_fileHeader.width != uint32_t(width) || m_fileHeader.height != uint32_t(height))
+    {
+        ++m_droppedCount;
+        return false;
+    }
+    auto const rowBytes = size_t(width) * bytesPerPixel;
+    if (m_compressionThreads > 0)
+    {
+        Slot *p_slot = nullptr;
+        {
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            if (m_freeSlots.empty() || !m_error.empty())
+            {
+                _dropFrame();
+                return false;
+            }
+            p_slot = m_freeSlots.front();
+            m_freeSlots.pop_front();
+        }
+        auto *p_data = p_slot->frame.data();
+        std::memcpy(p_data, p_frameHeader, m_fileHeader.frameHeaderSize);
+        p_data += m_fileHeader.frameHeaderSize;
+        auto const *p_row = (uint8_t const *)p_pixels;
+        for (int y = 0; y < height; ++y, p_row += lineStride, p_data += rowBytes)
+        {
+            std::memcpy(p_data, p_row, rowBytes);
+        }
+        p_slot->timestampUtcNs = timestampUtcNs;
+        p_slot->sequence = m_nextSequence++;
+        {
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            m_pendingSlots.push_back(p_slot);
+        }
+        m_slotCondition.notify_all();
+        return true;
+    }
+    if (!mp_file->canWrite(m_fileHeader.recordSize))
+    {
+        _dropFrame();
+        return false;
+    }
+    FrameRecord record{};
+    std::memcpy(record.magic, np_frameMagic, sizeof(record.magic));
+    record.frameNumber = uint32_t(m_index.size());
+    m_index.push_back({mp_file->getSize(), timestampUtcNs});
+    mp_file->write(&record, sizeof(record));
+    mp_file->write(p_frameHeader, m_fileHeader.frameHeaderSize);
+    auto const *p_row = (uint8_t const *)p_pixels;
+    for (int y = 0; y < height; ++y, p_row += lineStride)
+    {
+        mp_file->write(p_row, rowBytes);
+    }
+    ++m_frameCount;
+    return true;
+}
+
+std::string RadiometricRecorder::finish()
+{
+    TRACE_SCOPE("RadiometricRecorder::finish");
+    if (!m_opened)
+    {
+        return "Radiometric file " + m_filePath.string() + " was not opened: " + m_error;
+    }
+    m_opened = false;
+    {
+        // the compression threads write the frames queued before they stop
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        m_compressorsRunning = false;
+    }
+    m_slotCondition.notify_all();
+    for (auto &thread : m_compressorThreads)
+    {
+        thread.join();
+    }
+    m_compressorThreads.clear();
+    if (!m_slots.empty())
+    {
+        MemoryBudget::release(MemoryBudget::Category::RadiometricBuffers, m_slots.size() * m_slotBytes);
+        m_freeSlots.clear();
+        m_slots.clear();
+    }
+    if (mp_file && mp_file->flush())
+    {
+        // the index follows the last record, the header then points at it
+        std::vector<uint8_t> index(sizeof(IndexHeader) + m_index.size() * sizeof(IndexEntry));
+        IndexHeader indexHeader{};
+        std::memcpy(indexHeader.magic, np_indexMagic, sizeof(indexHeader.magic));
+        indexHeader.entryCount = m_index.size();
+        std::memcpy(index.data(), &indexHeader, sizeof(indexHeader));
+        std::memcpy(index.data() + sizeof(indexHeader), m_index.data(), m_index.size() * sizeof(IndexEntry));
+        m_fileHeader.frameCount = m_index.size();
+        m_fileHeader.indexOffset = mp_file->getSize();
+        if (!mp_file->writeAt(index.data(), index.size(), m_fileHeader.indexOffset) || !mp_file->writeAt(&m_fileHeader, sizeof(m_fileHeader), 0))
+        {
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            _setError(std::string("index not written: ") + std::strerror(errno));
+        }
+    }
+    std::string status;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        if (mp_file)
+        {
+            if (auto const error = mp_file->close(); !error.empty())
+            {
+                _setError(error);
+            }
+        }
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        if (m_error.empty())
+        {
+            ss << "Successfully finished writing radiometric file " << m_filePath.string() << ": " << m_fileHeader.frameCount << " frames, ";
+        }
+        else
+        {
+            ss << "Radiometric file " << m_filePath.string() << " finished with error " << m_error << ": ";
+        }
+        ss << m_droppedCount << " dropped, " << double(mp_file ? mp_file->getSize() : 0) / n_bytesPerMegabyte << " MB";
+        if (m_compressionThreads > 0)
+        {
+            ss << ", compression ratio " << (m_encodedBytes > 0 ? double(m_rawBytes) / double(m_encodedBytes) : 0.0);
+            ss << " at " << (m_encodeSeconds > 0.0 ? double(m_rawBytes) / n_bytesPerMegabyte / m_encodeSeconds : 0.0) << " MB/s per thread";
+        }
+        if (mp_file)
+        {
+            ss << ", io=" << mp_file->getStatus();
+        }
+        status = ss.str();
+    }
+    AsyncLog::log(m_error.empty() ? LOG_NOTICE : LOG_ERR, "%s", status.c_str());
+    return status;
+}
+
+uint64_t RadiometricRecorder::getFrameCount() const
+{
+    return m_frameCount;
+}
+
+std::string RadiometricRecorder::getStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "file=" << m_filePath.string();
+    ss << ", format=" << (m_fileHeader.bytesPerPixel == 4 ? "FLOAT" : "FIXED_10_6");
+    ss << ", size=" << m_fileHeader.width << "x" << m_fileHeader.height;
+    ss << ", framesPerChunk=" << m_framesPerChunk;
+    ss << ", frames=" << m_frameCount.load();
+    ss << ", dropped=" << m_droppedCount.load();
+    if (m_compressionThreads > 0)
+    {
+        ss << ", compression={method=DELTA_DEFLATE";
+        ss << ", threads=" << m_compressionThreads;
+        ss << ", queued=" << m_pendingSlots.size();
+        ss << ", ratio=" << (m_encodedBytes > 0 ? double(m_rawBytes) / double(m_encodedBytes) : 0.0);
+        ss << ", MBps=" << (m_encodeSeconds > 0.0 ? double(m_rawBytes) / n_bytesPerMegabyte / m_encodeSeconds : 0.0);
+        ss << "}";
+    }
+    if (mp_file)
+    {
+        ss << ", io=" << mp_file->getStatus();
+    }
+    if (!m_error.empty())
+    {
+        ss << ", error=" << m_error;
+    }
+    ss << "}";
+    return ss.str();
+}
+
+// the file header is the start of the first chunk, a file that is never finished still has its format and geometry
+bool RadiometricRecorder::_open()
+{
+    TRACE_SCOPE("RadiometricRecorder::_open");
+    WriteBehindFile::Options const options{m_framesPerChunk * m_fileHeader.recordSize, n_chunkBuffers, n_preallocateBytes, n_syncIntervalBytes,
+                                           m_direct, MemoryBudget::Category::RadiometricBuffers};
+    auto p_file = std::make_unique<WriteBehindFile>(m_filePath, options);
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    if (!p_file->isOpened())
+    {
+        _setError(p_file->close());
+        m_opened = false;
+        return false;
+    }
+    p_file->write(&m_fileHeader, sizeof(m_fileHeader));
+    mp_file = std::move(p_file);
+    return m_compressionThreads == 0 || _startCompression();
+}
+
+// the caller must hold m_mut
+bool RadiometricRecorder::_startCompression()
+{
+    auto const frameBytes = m_fileHeader.recordSize - sizeof(FrameRecord);
+    auto const encodedBytes = RadiometricCodec::getMaxEncodedSize(m_fileHeader.frameHeaderSize, int(m_fileHeader.width), int(m_fileHeader.height),
+                                                                  m_fileHeader.bytesPerPixel);
+    auto const slotCount = size_t(m_compressionThreads) * n_slotsPerThread;
+    auto const scratchBytes = RadiometricCodec::getScratchSize(m_fileHeader.frameHeaderSize, int(m_fileHeader.width), int(m_fileHeader.height),
+                                                               m_fileHeader.bytesPerPixel);
+    // the frame, the encoded frame and the residuals with the pixel words
+    m_slotBytes = frameBytes + encodedBytes + scratchBytes;
+    if (!MemoryBudget::tryAcquire(MemoryBudget::Category::RadiometricBuffers, slotCount * m_slotBytes))
+    {
+        _setError("the compression buffers exceed the memory budget");
+        return false;
+    }
+    for (size_t i = 0; i < slotCount; ++i)
+    {
+        auto p_slot = std::make_unique<Slot>();
+        p_slot->frame.resize(frameBytes);
+        p_slot->encoded.resize(encodedBytes);
+        p_slot->scratch.reserve(scratchBytes);
+        m_freeSlots.push_back(p_slot.get());
+        m_slots.push_back(std::move(p_slot));
+    }
+    m_compressorsRunning = true;
+    for (int i = 0; i < m_compressionThreads; ++i)
+    {
+        m_compressorThreads.emplace_back(&RadiometricRecorder::_runCompressor, this);
+    }
+    return true;
+}
+
+void RadiometricRecorder::_runCompressor()
+{
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    for (;;)
+    {
+        m_slotCondition.wait(lock, [this]()
+                             { return !m_pendingSlots.empty() || !m_compressorsRunning; });
+        if (m_pendingSlots.empty())
+        {
+            break;
+        }
+        auto *const p_slot = m_pendingSlots.front();
+        m_pendingSlots.pop_front();
+        lock.unlock();
+        auto const startTime = std::chrono::steady_clock::now();
+        auto const encodedSize = RadiometricCodec::encode(p_slot->frame.data(), m_fileHeader.frameHeaderSize, int(m_fileHeader.width),
+                                                          int(m_fileHeader.height), m_fileHeader.bytesPerPixel, p_slot->scratch,
+                                                          p_slot->encoded.data(), p_slot->encoded.size());
+        auto const encodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        lock.lock();
+        // the slots were taken in capture order, the one to write next is always being encoded
+        m_slotCondition.wait(lock, [this, p_slot]()
+                             { return m_nextWrite == p_slot->sequence; });
+        m_encodeSeconds += encodeSeconds;
+        _writeEncoded(*p_slot, encodedSize);
+        ++m_nextWrite;
+        m_freeSlots.push_back(p_slot);
+        m_slotCondition.notify_all();
+    }
+}
+
+// the caller must hold m_mut
+void RadiometricRecorder::_writeEncoded(Slot const &slot, size_t encodedSize)
+{
+    if (encodedSize == 0)
+    {
+        _setError("frame compression failed");
+        ++m_droppedCount;
+        return;
+    }
+    EncodedRecord record{};
+    if (!m_error.empty() || !mp_file->canWrite(sizeof(record) + encodedSize))
+    {
+        _dropFrame();
+        return;
+    }
+    std::memcpy(record.magic, np_encodedMagic, sizeof(record.magic));
+    record.frameNumber = uint32_t(m_index.size());
+    record.method = uint32_t(RadiometricCodec::Method::DeltaDeflate);
+    record.encodedSize = uint32_t(encodedSize);
+    record.timestampUtcNs = slot.timestampUtcNs;
+    m_index.push_back({mp_file->getSize(), slot.timestampUtcNs});
+    mp_file->write(&record, sizeof(record));
+    mp_file->write(slot.encoded.data(), encodedSize);
+    m_rawBytes += m_fileHeader.recordSize;
+    m_encodedBytes += sizeof(record) + encodedSize;
+    ++m_frameCount;
+}
+
+void RadiometricRecorder::_dropFrame()
+{
+    // the disk or the compression does not keep up, shed load rather than queue without bound
+    if (m_droppedCount++ == 0)
+    {
+        AsyncLog::log(LOG_WARNING, "Radiometric frames dropped, the writes to %s do not keep up.", m_filePath.c_str());
+    }
+}
+
+// the caller must hold m_mut
+void RadiometricRecorder::_setError(std::string const &error)
+{
+    if (m_error.empty())
+    {
+        m_error = error;
+        AsyncLog::log(LOG_ERR, "Radiometric recording to %s failed: %s", m_filePath.c_str(), error.c_str());
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RadiometricCodec.h"
+#include "WriteBehindFile.h"
+
+// Records the thermography stream (FIXED_10_6 or FLOAT) losslessly into a chunked container (.etr).
+// The frame callback copies each frame with its camera frame header into the buffers of a
+// WriteBehindFile, which writes each full chunk with a single sequential write on its own thread,
+// so the capture path neither allocates nor waits for the disk. When no chunk buffer is free the
+// frame is dropped and counted rather than queued without bound.
+// With compression the frame callback only copies the frame into a free slot; compression threads
+// encode the slots in parallel (RadiometricCodec) and write them in capture order. When no slot is
+// free the frame is dropped the same way.
+//
+// File layout (little endian, packed):
+//   FileHeader                  written with the first chunk, final counts written by finish()
+//   frame records               FrameRecord + camera frame header (seekcamera_frame_header_t) + pixels (rows without padding)
+//                               or, compressed (version 2), EncodedRecord + the encoded frame header and pixels
+//   index                       IndexHeader + IndexEntry per frame, written by finish()
+// Each record starts with its magic and has a known size, a file that was not finished (power cut)
+// can still be read up to its last complete record; the index gives the offset and timestamp of any
+// frame without a scan.
+class RadiometricRecorder
+{
+public:
+#pragma pack(push, 1)
+    struct FileHeader
+    {
+        char magic[8];                // "ETRADIO\0"
+        uint32_t version;
+        uint32_t frameFormat;         // seekcamera_frame_format_t of the pixels
+        uint32_t width;
+        uint32_t height;
+        uint32_t bytesPerPixel;
+        uint32_t frameHeaderSize;     // bytes of camera frame header in each record
+        uint64_t recordSize;          // bytes of each uncompressed frame record
+        uint64_t frameCount;          // 0 until finished
+        uint64_t indexOffset;         // 0 until finished
+        char chipId[16];
+    };
+    struct FrameRecord
+    {
+        char magic[4];                // "FRME"
+        uint32_t frameNumber;         // in the file
+    };
+    struct EncodedRecord
+    {
+        char magic[4];                // "FRMZ"
+        uint32_t frameNumber;         // in the file
+        uint32_t method;              // RadiometricCodec::Method
+        uint32_t encodedSize;         // bytes following the record
+        uint64_t timestampUtcNs;
+    };
+    struct IndexHeader
+    {
+        char magic[8];                // "ETINDEX\0"
+        uint64_t entryCount;
+    };
+    struct IndexEntry
+    {
+        uint64_t offset;
+        uint64_t timestampUtcNs;
+    };
+#pragma pack(pop)
+    // uncompressed files are written as version 1, compressed ones as version 2
+    static constexpr uint32_t n_version = 2;
+
+    // framesPerChunk frames are collected before each write, direct = bypass the page cache (O_DIRECT)
+    // compressionThreads > 0 compresses the frames on that many threads, 0 = uncompressed
+    RadiometricRecorder(std::filesystem::path const &filePath, size_t framesPerChunk, bool direct, int compressionThreads);
+    ~RadiometricRecorder();
+    bool isOpened() const;
+    // copy a frame into the current chunk, the first frame sets the format and geometry of the file
+    // return false when the frame was dropped (no free chunk buffer, other geometry, write error)
+    bool addFrame(void const *p_frameHeader, size_t frameHeaderSize, uint64_t timestampUtcNs, char const *p_chipId,
+                  int frameFormat, void const *p_pixels, int width, int height, size_t bytesPerPixel, size_t lineStride);
+    // write the last chunk, the index and the final file header
+    // return a string indicating success or failure
+    std::string finish();
+    // frames written or queued for writing
+    uint64_t getFrameCount() const;
+    // Get a string representing the file, the frames written and dropped, the compression and the write throughput
+    std::string getStatus() const;
+
+private:
+    struct Slot
+    {
+        // frame header followed by the pixel rows
+        std::vector<uint8_t> frame;
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> scratch;
+        uint64_t timestampUtcNs;
+        // capture order, the slots are written in this order
+        uint64_t sequence;
+    };
+    bool _open();
+    bool _startCompression();
+    void _runCompressor();
+    // the caller must hold m_mut
+    void _writeEncoded(Slot const &slot, size_t encodedSize);
+    void _dropFrame();
+    void _setError(std::string const &error);
+    std::filesystem::path m_filePath;
+    size_t m_framesPerChunk;
+    bool m_direct;
+    bool m_opened;
+    FileHeader m_fileHeader;
+    // created with the first frame, once the record size is known
+    std::unique_ptr<WriteBehindFile> mp_file;
+    std::vector<IndexEntry> m_index;
+    std::atomic<uint64_t> m_frameCount;
+    std::atomic<uint64_t> m_droppedCount;
+    int m_compressionThreads;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    size_t m_slotBytes;
+    uint64_t m_nextSequence;
+    // guards the file header, the file, the slot queues, the statistics and the error
+    mutable std::mutex m_mut;
+    std::condition_variable m_slotCondition;
+    std::deque<Slot *> m_freeSlots;
+    std::deque<Slot *> m_pendingSlots;
+    uint64_t m_nextWrite;
+    bool m_compressorsRunning;
+    uint64_t m_rawBytes;
+    uint64_t m_encodedBytes;
+    double m_encodeSeconds;
+    std::string m_error;
+    std::vector<std::thread> m_compressorThreads;
+};
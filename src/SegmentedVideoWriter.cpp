@@ -0,0 +1,322 @@
+#include "SegmentedVideoWriter.h"
+#include "AsyncLog.h"
+#include "Trace.h"
+#include <syslog.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace
+{
+    constexpr static inline auto const n_bytesPerMegabyte = 1024.0 * 1024.0;
+    // a segment that could not be opened is retried after this long, the current segment grows meanwhile
+    constexpr static inline auto const n_openRetryInterval = std::chrono::seconds(1);
+    // segments listed by getStatus, the oldest are summarized in the count
+    constexpr static inline auto const n_statusSegments = size_t(8);
+    // writeback started every interval of the segment being written
+    constexpr static inline auto const n_syncIntervalBytes = uint64_t(4) * 1024 * 1024;
+
+    uint64_t _getFileSize(std::filesystem::path const &filePath)
+    {
+        std::error_code errorCode;
+        auto const size = std::filesystem::file_size(filePath, errorCode);
+        return errorCode ? 0 : uint64_t(size);
+    }
+}
+
+SegmentedVideoWriter::SegmentedVideoWriter(std::filesystem::path const &filePath, VideoEncoder::Codec const &codec, int threads, double fps,
+                                           int width, int height, bool isColor, double segmentSeconds, double segmentMegabytes)
+    : m_filePath{filePath},
+      m_codec{codec},
+      m_threads{threads},
+      m_fps{fps},
+      m_width{width},
+      m_height{height},
+      m_isColor{isColor},
+      m_segmentFrames{segmentSeconds > 0.0 ? uint64_t(std::max(1.0, std::round(segmentSeconds * fps))) : 0},
+      m_segmentBytes{segmentMegabytes > 0.0 ? uint64_t(segmentMegabytes * n_bytesPerMegabyte) : 0},
+      mp_writer{},
+      m_opened{false},
+      m_currentSegment{0},
+      m_nextRetryTime{},
+      m_writebackFd{-1},
+      m_writeback{n_syncIntervalBytes},
+      m_mut{},
+      m_finalizeCondition{},
+      m_segments{},
+      m_finalizeQueue{},
+      m_finalizerRunning{false},
+      m_finalizing{false},
+      m_finalizerThread{}
+{
+    TRACE_SCOPE("SegmentedVideoWriter::SegmentedVideoWriter");
+    m_segments.push_back({1, _getSegmentPath(1), 0, 0, 0, 0.0, 0.0, 0, 0.0, 0.0, false, std::string()});
+    mp_writer = _openSegment(1);
+    m_opened = mp_writer->isOpened();
+    if (m_opened)
+    {
+        _openWriteback(m_segments.front().filePath);
+    }
+    if (m_opened && (m_segmentFrames > 0 || m_segmentBytes > 0))
+    {
+        m_finalizerRunning = true;
+        m_finalizerThread = std::thread(&SegmentedVideoWriter::_runFinalizer, this);
+    }
+}
+
+SegmentedVideoWriter::~SegmentedVideoWriter()
+{
+    release();
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        m_finalizerRunning = false;
+    }
+    m_finalizeCondition.notify_all();
+    if (m_finalizerThread.joinable())
+    {
+        m_finalizerThread.join();
+    }
+}
+
+bool SegmentedVideoWriter::isOpened() const
+{
+    return m_opened;
+}
+
+void SegmentedVideoWriter::write(cv::Mat const &frame)
+{
+    if (!mp_writer)
+    {
+        return;
+    }
+    if ((m_segmentFrames > 0 || m_segmentBytes > 0) && _isSegmentFull() && std::chrono::steady_clock::now() >= m_nextRetryTime)
+    {
+        _rotate();
+    }
+    auto const startTime = std::chrono::steady_clock::now();
+    mp_writer->write(frame);
+    auto const writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    struct stat fileStat{};
+    if (m_writebackFd >= 0 && fstat(m_writebackFd, &fileStat) == 0)
+    {
+        m_writeback.update(m_writebackFd, uint64_t(fileStat.st_size));
+    }
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    auto &segment = m_segments[m_currentSegment];
+    ++segment.frameCount;
+    segment.writeSeconds += writeSeconds;
+    segment.maxWriteMs = std::max(segment.maxWriteMs, writeSeconds * 1e3);
+    segment.syncCount = m_writeback.getSyncCount();
+    segment.maxSyncWaitMs = m_writeback.getMaxWaitMs();
+}
+
+void SegmentedVideoWriter::release()
+{
+    TRACE_SCOPE("SegmentedVideoWriter::release");
+    if (mp_writer)
+    {
+        m_opened = false;
+        _openWriteback(std::filesystem::path());
+        _finalize(std::move(mp_writer), m_currentSegment);
+    }
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    m_finalizeCondition.wait(lock, [this]()
+                             { return m_finalizeQueue.empty() && !m_finalizing; });
+}
+
+int SegmentedVideoWriter::getSegmentCount() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    return int(m_segments.size());
+}
+
+std::string SegmentedVideoWriter::getStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "path=" << m_filePath.string();
+    ss << ", codec=" << m_codec.p_name;
+    ss << ", threads=" << m_threads;
+    ss << ", segmentS=" << (m_fps > 0.0 ? double(m_segmentFrames) / m_fps : 0.0);
+    ss << ", segmentMB=" << double(m_segmentBytes) / n_bytesPerMegabyte;
+    ss << ", fps=" << m_fps;
+    ss << ", segments=" << m_segments.size();
+    ss << ", recent=[";
+    auto const first = m_segments.size() - std::min(m_segments.size(), n_statusSegments);
+    for (size_t i = first; i < m_segments.size(); ++i)
+    {
+        auto const &segment = m_segments[i];
+        auto const byteCount = segment.finalized ? segment.byteCount : _getFileSize(segment.filePath);
+        ss << (i > first ? ", " : "") << "{index=" << segment.index;
+        ss << ", file=" << segment.filePath.filename().string();
+        ss << ", startS=" << double(segment.firstFrame) / m_fps;
+        ss << ", durationS=" << double(segment.frameCount) / m_fps;
+        ss << ", frames=" << segment.frameCount;
+        ss << ", MB=" << double(byteCount) / n_bytesPerMegabyte;
+        ss << ", writeMBps=" << (segment.writeSeconds > 0.0 ? double(byteCount) / n_bytesPerMegabyte / segment.writeSeconds : 0.0);
+        ss << ", encodeMs=" << (segment.frameCount > 0 ? segment.writeSeconds * 1e3 / double(segment.frameCount) : 0.0);
+        ss << ", maxWriteMs=" << segment.maxWriteMs;
+        ss << ", syncs=" << segment.syncCount;
+        ss << ", maxSyncWaitMs=" << segment.maxSyncWaitMs;
+        if (!segment.error.empty())
+        {
+            ss << ", state=failed, error=" << segment.error;
+        }
+        else if (segment.finalized)
+        {
+            ss << ", finalizeMs=" << segment.finalizeMs << ", state=finalized";
+        }
+        else
+        {
+            ss << ", state=" << (i == m_currentSegment && m_opened ? "recording" : "finalizing");
+        }
+        ss << "}";
+    }
+    ss << "]";
+    ss << "}";
+    return ss.str();
+}
+
+std::filesystem::path SegmentedVideoWriter::_getSegmentPath(int index) const
+{
+    if (m_segmentFrames == 0 && m_segmentBytes == 0)
+    {
+        return m_filePath;
+    }
+    char p_suffix[16];
+    std::snprintf(p_suffix, sizeof(p_suffix), "_%03d", index);
+    auto segmentPath = m_filePath;
+    segmentPath.replace_filename(m_filePath.stem().string() + p_suffix + m_filePath.extension().string());
+    return segmentPath;
+}
+
+std::unique_ptr<cv::VideoWriter> SegmentedVideoWriter::_openSegment(int index)
+{
+    TRACE_SCOPE("SegmentedVideoWriter::_openSegment");
+    return VideoEncoder::open(_getSegmentPath(index), m_codec, m_fps, m_width, m_height, m_isColor, m_threads);
+}
+
+bool SegmentedVideoWriter::_isSegmentFull()
+{
+    uint64_t frameCount = 0;
+    std::filesystem::path filePath;
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        frameCount = m_segments[m_currentSegment].frameCount;
+        filePath = m_segments[m_currentSegment].filePath;
+    }
+    if (frameCount == 0)
+    {
+        return false;
+    }
+    return (m_segmentFrames > 0 && frameCount >= m_segmentFrames) || (m_segmentBytes > 0 && _getFileSize(filePath) >= m_segmentBytes);
+}
+
+void SegmentedVideoWriter::_rotate()
+{
+    TRACE_SCOPE("SegmentedVideoWriter::_rotate");
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    auto const &current = m_segments[m_currentSegment];
+    Segment next{current.index + 1, _getSegmentPath(current.index + 1), current.firstFrame + current.frameCount, 0, 0, 0.0, 0.0, 0, 0.0, 0.0, false, std::string()};
+    lock.unlock();
+    // opened before the current one is handed off, the frame that crosses the limit starts the next segment
+    auto p_nextWriter = _openSegment(next.index);
+    if (!p_nextWriter->isOpened())
+    {
+        AsyncLog::log(LOG_ERR, "Failed to open recording segment %s, continuing in the current segment.", next.filePath.c_str());
+        m_nextRetryTime = std::chrono::steady_clock::now() + n_openRetryInterval;
+        return;
+    }
+    lock.lock();
+    auto const previous = m_currentSegment;
+    m_segments.push_back(std::move(next));
+    m_currentSegment = m_segments.size() - 1;
+    m_finalizeQueue.emplace_back(std::move(mp_writer), previous);
+    mp_writer = std::move(p_nextWriter);
+    AsyncLog::log(LOG_NOTICE, "Recording segment %s started at frame %llu.", m_segments.back().filePath.c_str(), (unsigned long long)m_segments.back().firstFrame);
+    auto const filePath = m_segments.back().filePath;
+    lock.unlock();
+    m_finalizeCondition.notify_all();
+    _openWriteback(filePath);
+}
+
+void SegmentedVideoWriter::_openWriteback(std::filesystem::path const &filePath)
+{
+    if (m_writebackFd >= 0)
+    {
+        close(m_writebackFd);
+        m_writebackFd = -1;
+    }
+    m_writeback = WriteBehindFile::Writeback(n_syncIntervalBytes);
+    if (!filePath.empty())
+    {
+        // without the descriptor the segment is written with the writeback of the kernel
+        m_writebackFd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+}
+
+// writes the mp4 index, the segment is playable afterwards
+void SegmentedVideoWriter::_finalize(std::unique_ptr<cv::VideoWriter> p_writer, size_t segment)
+{
+    TRACE_SCOPE("SegmentedVideoWriter::_finalize");
+    std::string error;
+    auto const startTime = std::chrono::steady_clock::now();
+    try
+    {
+        p_writer->release();
+    }
+    catch (cv::Exception const &e)
+    {
+        error = e.msg;
+    }
+    auto const finalizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    auto &info = m_segments[segment];
+    info.byteCount = _getFileSize(info.filePath);
+    info.finalizeMs = finalizeMs;
+    info.finalized = error.empty();
+    info.error = error;
+    if (error.empty())
+    {
+        AsyncLog::log(LOG_NOTICE, "Recording segment %s finalized: %llu frames, %.1f s, %.2f MB, %.1f MB/s, %.1f ms to finalize.",
+                      info.filePath.c_str(), (unsigned long long)info.frameCount, double(info.frameCount) / m_fps,
+                      double(info.byteCount) / n_bytesPerMegabyte,
+                      info.writeSeconds > 0.0 ? double(info.byteCount) / n_bytesPerMegabyte / info.writeSeconds : 0.0, finalizeMs);
+    }
+    else
+    {
+        AsyncLog::log(LOG_ERR, "Failed to finalize recording segment %s: %s", info.filePath.c_str(), error.c_str());
+    }
+}
+
+void SegmentedVideoWriter::_runFinalizer()
+{
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    for (;;)
+    {
+        m_finalizeCondition.wait(lock, [this]()
+                                 { return !m_finalizeQueue.empty() || !m_finalizerRunning; });
+        if (m_finalizeQueue.empty())
+        {
+            break;
+        }
+        auto item = std::move(m_finalizeQueue.front());
+        m_finalizeQueue.pop_front();
+        m_finalizing = true;
+        lock.unlock();
+        _finalize(std::move(item.first), item.second);
+        lock.lock();
+        m_finalizing = false;
+        m_finalizeCondition.notify_all();
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VideoEncoder.h"
+#include "WriteBehindFile.h"
+
+namespace cv
+{
+    class Mat;
+    class VideoWriter;
+}
+
+// A cv::VideoWriter that splits the recording into segments of a maximum duration or size.
+// An mp4 is only playable once its index (moov atom) is written when the writer is released,
+// so a power cut loses the whole file; with segments at most the segment being written is lost.
+// On rotation the writer of the next segment is opened before the frame that crosses the limit
+// is written, and the previous writer is released on a background thread, so no frame is dropped
+// and the recording thread does not wait for the index to be written.
+// Segments are named <stem>_001<extension>, <stem>_002<extension>, ...; without limits the file path
+// is used as is. write() and release() must be called from one thread at a time.
+// cv::VideoWriter does its own file I/O, so the segment being written is only paced: its writeback is
+// started every few megabytes, which keeps an SD card from stalling the recording thread with a flush
+// of everything written since the last one.
+class SegmentedVideoWriter
+{
+public:
+    struct Segment
+    {
+        int index;
+        std::filesystem::path filePath;
+        // frame number of the first frame in the recording, the boundary with the previous segment
+        uint64_t firstFrame;
+        uint64_t frameCount;
+        // file size once finalized
+        uint64_t byteCount;
+        // time spent in cv::VideoWriter::write (encoding and writing)
+        double writeSeconds;
+        // the slowest frame, encoding and writing
+        double maxWriteMs;
+        // writeback intervals pushed to the device and the longest wait for one of them
+        uint64_t syncCount;
+        double maxSyncWaitMs;
+        double finalizeMs;
+        bool finalized;
+        std::string error;
+    };
+    // segmentSeconds / segmentMegabytes = 0 for no limit, threads = encoder threads (0 = backend default)
+    SegmentedVideoWriter(std::filesystem::path const &filePath, VideoEncoder::Codec const &codec, int threads, double fps,
+                         int width, int height, bool isColor, double segmentSeconds, double segmentMegabytes);
+    ~SegmentedVideoWriter();
+    bool isOpened() const;
+    // write a frame, rotates first when the current segment reached a limit
+    // throws cv::Exception like cv::VideoWriter::write
+    void write(cv::Mat const &frame);
+    // finalize the current segment and wait for the segments being finalized in the background
+    void release();
+    int getSegmentCount() const;
+    // Get a string representing the limits and the segments with their boundaries and throughput
+    std::string getStatus() const;
+
+private:
+    std::filesystem::path _getSegmentPath(int index) const;
+    // open the writer of a segment, check isOpened() for failure
+    std::unique_ptr<cv::VideoWriter> _openSegment(int index);
+    bool _isSegmentFull();
+    void _rotate();
+    // pace the writeback of the segment file, an empty path stops the pacing
+    void _openWriteback(std::filesystem::path const &filePath);
+    void _finalize(std::unique_ptr<cv::VideoWriter> p_writer, size_t segment);
+    void _runFinalizer();
+    std::filesystem::path m_filePath;
+    VideoEncoder::Codec m_codec;
+    int m_threads;
+    double m_fps;
+    int m_width;
+    int m_height;
+    bool m_isColor;
+    uint64_t m_segmentFrames;
+    uint64_t m_segmentBytes;
+    std::unique_ptr<cv::VideoWriter> mp_writer;
+    std::atomic_bool m_opened;
+    // index in m_segments of the segment being written
+    size_t m_currentSegment;
+    std::chrono::steady_clock::time_point m_nextRetryTime;
+    // read only descriptor of the segment being written, for the writeback pacing
+    int m_writebackFd;
+    WriteBehindFile::Writeback m_writeback;
+    // guards the segments and the finalize queue
+    mutable std::mutex m_mut;
+    std::condition_variable m_finalizeCondition;
+    std::vector<Segment> m_segments;
+    std::deque<std::pair<std::unique_ptr<cv::VideoWriter>, size_t>> m_finalizeQueue;
+    bool m_finalizerRunning;
+    bool m_finalizing;
+    std::thread m_finalizerThread;
+};
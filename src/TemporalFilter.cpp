@@ -0,0 +1,356 @@
+#include "TemporalFilter.h"
+#include "MemoryBudget.h"
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TNR_HAS_AVX2 1
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TNR_HAS_NEON 1
+#endif
+
+namespace
+{
+    // changes up to the threshold are treated as noise, the weight reaches 1 at twice the threshold
+    // FIXED_10_6 raw units: 13 = 0.2 degrees C, about three times the NETD
+    constexpr static inline auto const n_thermographyMotionThreshold = 13u;
+    // 8-bit frames: grey levels (AGC applied), with the 8 fractional history bits
+    constexpr static inline auto const n_greyMotionThreshold = 6u << 8;
+
+    struct Weights
+    {
+        uint32_t staticWeight;
+        uint32_t threshold;
+        // excess * ramp >> 16 goes from 0 to 256 - staticWeight as the excess goes from 0 to threshold
+        uint32_t ramp;
+    };
+
+    Weights _makeWeights(uint32_t staticWeight, uint32_t threshold)
+    {
+        return {staticWeight, threshold, ((256u - staticWeight) << 16) / threshold};
+    }
+
+    // history and current value in the same fixed point units, returns the new history
+    inline uint32_t _blend(uint32_t current, uint32_t history, Weights const &weights)
+    {
+        auto const diff = int32_t(current) - int32_t(history);
+        auto const excess = std::min(uint32_t(std::max(std::abs(diff) - int32_t(weights.threshold), 0)), weights.threshold);
+        auto const weight = int32_t(weights.staticWeight + ((excess * weights.ramp) >> 16));
+        return uint32_t(int32_t(history) + ((diff * weight + 128) >> 8));
+    }
+
+    void _filterRow16Scalar(uint16_t const *p_src, uint16_t *p_history, int count, Weights const &weights)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            p_history[x] = uint16_t(_blend(p_src[x], p_history[x], weights));
+        }
+    }
+
+    void _filterRow8Scalar(uint8_t const *p_src, uint16_t *p_history, uint8_t *p_dst, int count, Weights const &weights)
+    {
+        for (int x = 0; x < count; ++x)
+        {
+            p_history[x] = uint16_t(_blend(uint32_t(p_src[x]) << 8, p_history[x], weights));
+            p_dst[x] = uint8_t(std::min((uint32_t(p_history[x]) + 128) >> 8, 255u));
+        }
+    }
+
+#ifdef TNR_HAS_AVX2
+    // 8 lanes of 32 bits, the same arithmetic as _blend
+    __attribute__((target("avx2"))) __m256i _blendAvx2(__m256i current, __m256i history, __m256i staticWeightV, __m256i thresholdV, __m256i rampV)
+    {
+        auto const diff = _mm256_sub_epi32(current, history);
+        auto const excess = _mm256_min_epi32(_mm256_max_epi32(_mm256_sub_epi32(_mm256_abs_epi32(diff), thresholdV), _mm256_setzero_si256()), thresholdV);
+        auto const weight = _mm256_add_epi32(staticWeightV, _mm256_srli_epi32(_mm256_mullo_epi32(excess, rampV), 16));
+        return _mm256_add_epi32(history, _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(diff, weight), _mm256_set1_epi32(128)), 8));
+    }
+
+    // 16 values, packed back to 16 bits in order
+    __attribute__((target("avx2"))) __m256i _blend16Avx2(__m256i current, __m256i history, __m256i staticWeightV, __m256i thresholdV, __m256i rampV)
+    {
+        auto const low = _blendAvx2(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(current)), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(history)),
+                                    staticWeightV, thresholdV, rampV);
+        auto const high = _blendAvx2(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(current, 1)), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(history, 1)),
+                                     staticWeightV, thresholdV, rampV);
+        // the pack works per 128 bit lane, put the quarters back in order
+        return _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+    }
+
+    __attribute__((target("avx2"))) void _filterRow16Avx2(uint16_t const *p_src, uint16_t *p_history, int count, Weights const &weights)
+    {
+        auto const staticWeightV = _mm256_set1_epi32((int)weights.staticWeight);
+        auto const thresholdV = _mm256_set1_epi32((int)weights.threshold);
+        auto const rampV = _mm256_set1_epi32((int)weights.ramp);
+        int x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            auto const current = _mm256_loadu_si256((__m256i const *)(p_src + x));
+            auto const history = _mm256_loadu_si256((__m256i const *)(p_history + x));
+            _mm256_storeu_si256((__m256i *)(p_history + x), _blend16Avx2(current, history, staticWeightV, thresholdV, rampV));
+        }
+        _filterRow16Scalar(p_src + x, p_history + x, count - x, weights);
+    }
+
+    __attribute__((target("avx2"))) void _filterRow8Avx2(uint8_t const *p_src, uint16_t *p_history, uint8_t *p_dst, int count, Weights const &weights)
+    {
+        auto const staticWeightV = _mm256_set1_epi32((int)weights.staticWeight);
+        auto const thresholdV = _mm256_set1_epi32((int)weights.threshold);
+        auto const rampV = _mm256_set1_epi32((int)weights.ramp);
+        auto const roundV = _mm256_set1_epi16(128);
+        int x = 0;
+        for (; x + 16 <= count; x += 16)
+        {
+            auto const current = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i const *)(p_src + x))), 8);
+            auto const history = _mm256_loadu_si256((__m256i const *)(p_history + x));
+            auto const updated = _blend16Avx2(current, history, staticWeightV, thresholdV, rampV);
+            _mm256_storeu_si256((__m256i *)(p_history + x), updated);
+            auto const rounded = _mm256_srli_epi16(_mm256_adds_epu16(updated, roundV), 8);
+            // pack per lane then take the low quadword of each lane
+            auto const packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(rounded, rounded), 0x08);
+            _mm_storeu_si128((__m128i *)(p_dst + x), _mm256_castsi256_si128(packed));
+        }
+        _filterRow8Scalar(p_src + x, p_history + x, p_dst + x, count - x, weights);
+    }
+#endif
+
+#ifdef TNR_HAS_NEON
+    int32x4_t _blendNeon(int32x4_t current, int32x4_t history, uint32x4_t staticWeightV, uint32x4_t thresholdV, uint32x4_t rampV)
+    {
+        auto const diff = vsubq_s32(current, history);
+        auto const excess = vminq_u32(vqsubq_u32(vreinterpretq_u32_s32(vabsq_s32(diff)), thresholdV), thresholdV);
+        auto const weight = vreinterpretq_s32_u32(vaddq_u32(staticWeightV, vshrq_n_u32(vmulq_u32(excess, rampV), 16)));
+        return vaddq_s32(history, vshrq_n_s32(vaddq_s32(vmulq_s32(diff, weight), vdupq_n_s32(128)), 8));
+    }
+
+    uint16x8_t _blend16Neon(uint16x8_t current, uint16x8_t history, uint32x4_t staticWeightV, uint32x4_t thresholdV, uint32x4_t rampV)
+    {
+        auto const low = _blendNeon(vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(current))), vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(history))),
+                                    staticWeightV, thresholdV, rampV);
+        auto const high = _blendNeon(vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(current))), vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(history))),
+                                     staticWeightV, thresholdV, rampV);
+        return vcombine_u16(vqmovun_s32(low), vqmovun_s32(high));
+    }
+
+    void _filterRow16Neon(uint16_t const *p_src, uint16_t *p_history, int count, Weights const &weights)
+    {
+        auto const staticWeightV = vdupq_n_u32(weights.staticWeight);
+        auto const thresholdV = vdupq_n_u32(weights.threshold);
+        auto const rampV = vdupq_n_u32(weights.ramp);
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            vst1q_u16(p_history + x, _blend16Neon(vld1q_u16(p_src + x), vld1q_u16(p_history + x), staticWeightV, thresholdV, rampV));
+        }
+        _filterRow16Scalar(p_src + x, p_history + x, count - x, weights);
+    }
+
+    void _filterRow8Neon(uint8_t const *p_src, uint16_t *p_history, uint8_t *p_dst, int count, Weights const &weights)
+    {
+        auto const staticWeightV = vdupq_n_u32(weights.staticWeight);
+        auto const thresholdV = vdupq_n_u32(weights.threshold);
+        auto const rampV = vdupq_n_u32(weights.ramp);
+        int x = 0;
+        for (; x + 8 <= count; x += 8)
+        {
+            auto const current = vshlq_n_u16(vmovl_u8(vld1_u8(p_src + x)), 8);
+            auto const updated = _blend16Neon(current, vld1q_u16(p_history + x), staticWeightV, thresholdV, rampV);
+            vst1q_u16(p_history + x, updated);
+            vst1_u8(p_dst + x, vqrshrn_n_u16(updated, 8));
+        }
+        _filterRow8Scalar(p_src + x, p_history + x, p_dst + x, count - x, weights);
+    }
+#endif
+
+    bool _hasVectorSupport()
+    {
+#if defined(TNR_HAS_AVX2)
+        return __builtin_cpu_supports("avx2");
+#elif defined(TNR_HAS_NEON)
+        return true;
+#else
+        return false;
+#endif
+    }
+}
+
+TemporalFilter::TemporalFilter()
+    : m_strength{0.0},
+      m_vectorized{_hasVectorSupport()},
+      m_staticWeight{256},
+      m_bits{0},
+      m_primed{false},
+      m_history{},
+      m_output{},
+      m_frameCount{0},
+      m_filterSumNs{0.0},
+      m_filterMaxNs{0.0}
+{
+}
+
+TemporalFilter::~TemporalFilter()
+{
+    MemoryBudget::release(MemoryBudget::Category::FramePool, m_history.capacity() * sizeof(uint16_t) + m_output.capacity());
+}
+
+void TemporalFilter::setStrength(double strength)
+{
+    m_strength = std::clamp(strength, 0.0, n_maxStrength);
+    m_staticWeight = uint32_t(std::lround((1.0 - m_strength) * 256.0));
+    m_frameCount = 0;
+    m_filterSumNs = 0.0;
+    m_filterMaxNs = 0.0;
+    reset();
+}
+
+double TemporalFilter::getStrength() const
+{
+    return m_strength;
+}
+
+bool TemporalFilter::isEnabled() const
+{
+    return m_strength > 0.0;
+}
+
+void TemporalFilter::setVectorized(bool vectorized)
+{
+    m_vectorized = vectorized && _hasVectorSupport();
+}
+
+void TemporalFilter::reset()
+{
+    m_primed = false;
+}
+
+void TemporalFilter::reserve16(int width, int height)
+{
+    _reserve(size_t(width) * size_t(height), 16);
+}
+
+void TemporalFilter::reserve8(int width, int height, int channels)
+{
+    _reserve(size_t(width) * size_t(channels) * size_t(height), 8);
+}
+
+uint16_t const *TemporalFilter::filter16(uint16_t const *p_src, size_t srcStride, int width, int height)
+{
+    TRACE_SCOPE("TemporalFilter::filter16");
+    auto const startTime = std::chrono::steady_clock::now();
+    _reserve(size_t(width) * size_t(height), 16);
+    auto const weights = _makeWeights(m_staticWeight, n_thermographyMotionThreshold);
+    for (int y = 0; y < height; ++y)
+    {
+        auto const *const p_srcRow = (uint16_t const *)((uint8_t const *)p_src + size_t(y) * srcStride);
+        auto *const p_historyRow = m_history.data() + size_t(y) * size_t(width);
+        if (!m_primed)
+        {
+            std::memcpy(p_historyRow, p_srcRow, size_t(width) * sizeof(uint16_t));
+        }
+#if defined(TNR_HAS_AVX2)
+        else if (m_vectorized)
+        {
+            _filterRow16Avx2(p_srcRow, p_historyRow, width, weights);
+        }
+#elif defined(TNR_HAS_NEON)
+        else if (m_vectorized)
+        {
+            _filterRow16Neon(p_srcRow, p_historyRow, width, weights);
+        }
+#endif
+        else
+        {
+            _filterRow16Scalar(p_srcRow, p_historyRow, width, weights);
+        }
+    }
+    m_primed = true;
+    _recordTime(double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count()));
+    return m_history.data();
+}
+
+uint8_t const *TemporalFilter::filter8(uint8_t const *p_src, size_t srcStride, int width, int height, int channels)
+{
+    TRACE_SCOPE("TemporalFilter::filter8");
+    auto const startTime = std::chrono::steady_clock::now();
+    auto const rowCount = width * channels;
+    _reserve(size_t(rowCount) * size_t(height), 8);
+    auto const weights = _makeWeights(m_staticWeight, n_greyMotionThreshold);
+    for (int y = 0; y < height; ++y)
+    {
+        auto const *const p_srcRow = p_src + size_t(y) * srcStride;
+        auto *const p_historyRow = m_history.data() + size_t(y) * size_t(rowCount);
+        auto *const p_dstRow = m_output.data() + size_t(y) * size_t(rowCount);
+        if (!m_primed)
+        {
+            for (int x = 0; x < rowCount; ++x)
+            {
+                p_historyRow[x] = uint16_t(p_srcRow[x] << 8);
+            }
+            std::memcpy(p_dstRow, p_srcRow, size_t(rowCount));
+        }
+#if defined(TNR_HAS_AVX2)
+        else if (m_vectorized)
+        {
+            _filterRow8Avx2(p_srcRow, p_historyRow, p_dstRow, rowCount, weights);
+        }
+#elif defined(TNR_HAS_NEON)
+        else if (m_vectorized)
+        {
+            _filterRow8Neon(p_srcRow, p_historyRow, p_dstRow, rowCount, weights);
+        }
+#endif
+        else
+        {
+            _filterRow8Scalar(p_srcRow, p_historyRow, p_dstRow, rowCount, weights);
+        }
+    }
+    m_primed = true;
+    _recordTime(double(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count()));
+    return m_output.data();
+}
+
+std::string TemporalFilter::getStatus() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "{";
+    ss << "enabled=" << (isEnabled() ? "true" : "false");
+    ss << ", strength=" << m_strength;
+    ss << ", frame=" << (m_bits == 16 ? "thermography" : m_bits == 8 ? "8bit" : "none");
+    ss << ", vectorized=" << (m_vectorized ? "true" : "false");
+    ss << ", frames=" << m_frameCount;
+    ss << ", filterMs={mean=" << (m_frameCount > 0 ? m_filterSumNs / double(m_frameCount) / 1e6 : 0.0) << ", max=" << m_filterMaxNs / 1e6 << "}";
+    ss << "}";
+    return ss.str();
+}
+
+void TemporalFilter::_reserve(size_t count, int bits)
+{
+    if (m_history.size() == count && m_bits == bits)
+    {
+        return;
+    }
+    MemoryBudget::release(MemoryBudget::Category::FramePool, m_history.capacity() * sizeof(uint16_t) + m_output.capacity());
+    m_history.assign(count, 0);
+    m_output.assign(bits == 8 ? count : 0, 0);
+    m_history.shrink_to_fit();
+    m_output.shrink_to_fit();
+    MemoryBudget::acquire(MemoryBudget::Category::FramePool, m_history.capacity() * sizeof(uint16_t) + m_output.capacity());
+    m_bits = bits;
+    m_primed = false;
+}
+
+void TemporalFilter::_recordTime(double filterNs)
+{
+    ++m_frameCount;
+    m_filterSumNs += filterNs;
+    m_filterMaxNs = std::max(m_filterMaxNs, filterNs);
+}
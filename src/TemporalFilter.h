@@ -0,0 +1,55 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Motion-adaptive recursive temporal noise reduction, applied to the frame before the zoom.
+// Every pixel is blended into a history: history += (current - history) * weight.
+// In static areas the weight is small (1 - strength) so sensor noise is averaged over several frames,
+// where the change exceeds the motion threshold the weight ramps up to 1 so moving objects do not smear.
+// Fixed point (8 bit weights, 8 fractional history bits for 8-bit frames) with AVX2/NEON kernels,
+// the history and the output are allocated once per geometry.
+class TemporalFilter
+{
+public:
+    // the largest strength, the history then averages about 30 frames
+    static constexpr double n_maxStrength = 0.9375;
+    TemporalFilter();
+    ~TemporalFilter();
+    // fraction of the history kept in static areas, 0 = disabled
+    void setStrength(double strength);
+    double getStrength() const;
+    bool isEnabled() const;
+    // use AVX2/NEON when the CPU supports them
+    void setVectorized(bool vectorized);
+    // forget the history, the next frame passes through unchanged
+    void reset();
+    // allocate the history of filter16()/filter8() ahead of the first frame of that geometry
+    void reserve16(int width, int height);
+    void reserve8(int width, int height, int channels);
+    // filter a FIXED_10_6 frame, the result (width x height, packed) is owned by the filter
+    uint16_t const *filter16(uint16_t const *p_src, size_t srcStride, int width, int height);
+    // filter an 8-bit frame with channels interleaved bytes per pixel (GRAYSCALE, ARGB8888)
+    // the result (packed) is owned by the filter
+    uint8_t const *filter8(uint8_t const *p_src, size_t srcStride, int width, int height, int channels);
+    // Get a string representing the strength, the frame type and the cost
+    std::string getStatus() const;
+
+private:
+    // (re)allocate the history for count values, the history restarts when the layout changes
+    void _reserve(size_t count, int bits);
+    void _recordTime(double filterNs);
+    double m_strength;
+    bool m_vectorized;
+    // weight of the current frame in static areas (of 256)
+    uint32_t m_staticWeight;
+    // history layout: 16 = thermography values, 8 = 8-bit values with 8 fractional bits, 0 = none
+    int m_bits;
+    bool m_primed;
+    std::vector<uint16_t> m_history;
+    std::vector<uint8_t> m_output;
+    uint64_t m_frameCount;
+    double m_filterSumNs;
+    double m_filterMaxNs;
+};
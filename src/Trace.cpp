@@ -0,0 +1,255 @@
+#include "Trace.h"
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // events per thread, a full ring drops new events rather than blocking the producer
+    constexpr static inline auto const n_ringSize = uint32_t(16384);
+    constexpr static inline auto const n_drainInterval = std::chrono::milliseconds(50);
+    constexpr static inline auto const n_fileBufferSize = size_t(1 << 20);
+
+    struct TraceEvent
+    {
+        uint64_t timestampNs;
+        char const *p_name;
+        char phase;
+    };
+
+    // single producer (the owning thread), single consumer (the drain thread)
+    struct ThreadRing
+    {
+        std::array<TraceEvent, n_ringSize> events;
+        std::atomic<uint32_t> head{0};
+        std::atomic<uint32_t> tail{0};
+        std::atomic<uint64_t> dropped{0};
+        int tid{0};
+        bool owned{false}; // guarded by n_ringsMut
+    };
+
+    std::mutex n_ringsMut;
+    std::vector<std::shared_ptr<ThreadRing>> n_rings;
+
+    // hands the ring back when its thread exits, the drain thread still writes its pending
+    // events and a later thread reuses it once they are written
+    struct RingOwner
+    {
+        ThreadRing *p_ring{nullptr};
+        ~RingOwner()
+        {
+            if (p_ring)
+            {
+                std::lock_guard<std::mutex> lock(n_ringsMut);
+                p_ring->owned = false;
+            }
+        }
+    };
+    thread_local RingOwner t_ringOwner;
+
+    std::mutex n_controlMut;
+    std::thread n_drainThread;
+    std::atomic_bool n_drainThreadRunning{false};
+    std::FILE *np_traceFile = nullptr;
+    std::filesystem::path n_traceFilePath;
+    std::atomic<uint64_t> n_eventsWritten{0};
+    bool n_firstEvent = true;
+
+    uint64_t _nowNs()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+    }
+
+    ThreadRing *_getRing()
+    {
+        if (!t_ringOwner.p_ring)
+        {
+            auto const tid = (int)syscall(SYS_gettid);
+            std::lock_guard<std::mutex> lock(n_ringsMut);
+            for (auto const &p_ring : n_rings)
+            {
+                if (!p_ring->owned && p_ring->tail.load(std::memory_order_acquire) == p_ring->head.load(std::memory_order_relaxed))
+                {
+                    t_ringOwner.p_ring = p_ring.get();
+                    break;
+                }
+            }
+            if (!t_ringOwner.p_ring)
+            {
+                auto p_ring = std::make_shared<ThreadRing>();
+                n_rings.push_back(p_ring);
+                t_ringOwner.p_ring = p_ring.get();
+            }
+            // published to the drain thread by the release store of the first event
+            t_ringOwner.p_ring->tid = tid;
+            t_ringOwner.p_ring->owned = true;
+        }
+        return t_ringOwner.p_ring;
+    }
+
+    void _record(char const *p_name, char phase)
+    {
+        auto *const p_ring = _getRing();
+        auto const head = p_ring->head.load(std::memory_order_relaxed);
+        if (head - p_ring->tail.load(std::memory_order_acquire) >= n_ringSize)
+        {
+            p_ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        p_ring->events[head % n_ringSize] = TraceEvent{_nowNs(), p_name, phase};
+        p_ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    // write every pending event to the trace file, called from the drain thread
+    // or from stop() once the drain thread has been joined
+    void _drain()
+    {
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(n_ringsMut);
+            rings = n_rings;
+        }
+        auto const pid = (int)getpid();
+        for (auto const &p_ring : rings)
+        {
+            auto tail = p_ring->tail.load(std::memory_order_relaxed);
+            auto const head = p_ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail)
+            {
+                auto const &event = p_ring->events[tail % n_ringSize];
+                std::fprintf(np_traceFile, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+                             n_firstEvent ? "" : ",\n", event.p_name, event.phase, double(event.timestampNs) / 1000.0, pid, p_ring->tid);
+                n_firstEvent = false;
+                ++n_eventsWritten;
+            }
+            p_ring->tail.store(tail, std::memory_order_release);
+        }
+    }
+}
+
+std::atomic_bool Trace::n_enabled{false};
+
+std::string Trace::start(std::filesystem::path const &filePath)
+{
+    std::lock_guard<std::mutex> lock(n_controlMut);
+    std::string status;
+    if (np_traceFile)
+    {
+        status = "Already tracing to " + n_traceFilePath.string();
+    }
+    else if ((np_traceFile = std::fopen(filePath.c_str(), "w")) == nullptr)
+    {
+        status = "Failed to open trace file " + filePath.string() + " for writing";
+        syslog(LOG_ERR, "%s", status.c_str());
+    }
+    else
+    {
+        std::setvbuf(np_traceFile, nullptr, _IOFBF, n_fileBufferSize);
+        // discard events left over from a previous session
+        {
+            std::lock_guard<std::mutex> ringsLock(n_ringsMut);
+            for (auto const &p_ring : n_rings)
+            {
+                p_ring->tail.store(p_ring->head.load(std::memory_order_acquire), std::memory_order_release);
+                p_ring->dropped.store(0, std::memory_order_relaxed);
+            }
+        }
+        n_traceFilePath = filePath;
+        n_eventsWritten = 0;
+        n_firstEvent = true;
+        std::fputs("[\n", np_traceFile);
+        n_drainThreadRunning = true;
+        n_drainThread = std::thread([]()
+                                    {
+            while (n_drainThreadRunning)
+            {
+                std::this_thread::sleep_for(n_drainInterval);
+                _drain();
+            } });
+        n_enabled.store(true, std::memory_order_relaxed);
+        status = "Tracing to " + n_traceFilePath.string();
+        syslog(LOG_NOTICE, "%s", status.c_str());
+    }
+    return status;
+}
+
+std::string Trace::stop()
+{
+    std::lock_guard<std::mutex> lock(n_controlMut);
+    std::string status;
+    if (!np_traceFile)
+    {
+        status = "Tracing was not in progress";
+    }
+    else
+    {
+        n_enabled.store(false, std::memory_order_relaxed);
+        n_drainThreadRunning = false;
+        if (n_drainThread.joinable())
+        {
+            n_drainThread.join();
+        }
+        _drain();
+        std::fputs("\n]\n", np_traceFile);
+        std::fclose(np_traceFile);
+        np_traceFile = nullptr;
+        uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> ringsLock(n_ringsMut);
+            for (auto const &p_ring : n_rings)
+            {
+                dropped += p_ring->dropped.load(std::memory_order_relaxed);
+            }
+        }
+        status = "Finished writing " + std::to_string(n_eventsWritten) + " trace events to " + n_traceFilePath.string();
+        if (dropped)
+        {
+            status += " (" + std::to_string(dropped) + " events dropped)";
+        }
+        syslog(LOG_NOTICE, "%s", status.c_str());
+        n_traceFilePath.clear();
+    }
+    return status;
+}
+
+std::string Trace::getStatus()
+{
+    std::lock_guard<std::mutex> lock(n_controlMut);
+    std::stringstream ss;
+    ss << "{";
+    ss << "enabled=" << (isEnabled() ? "true" : "false");
+    if (np_traceFile)
+    {
+        ss << ", file=" << n_traceFilePath.string();
+        ss << ", eventsWritten=" << n_eventsWritten;
+    }
+    {
+        std::lock_guard<std::mutex> ringsLock(n_ringsMut);
+        ss << ", threads=" << std::count_if(std::begin(n_rings), std::end(n_rings), [](auto const &p_ring)
+                                           { return p_ring->owned; });
+        ss << ", rings=" << n_rings.size();
+    }
+    ss << "}";
+    return ss.str();
+}
+
+void Trace::begin(char const *p_name)
+{
+    _record(p_name, 'B');
+}
+
+void Trace::end(char const *p_name)
+{
+    _record(p_name, 'E');
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <string>
+
+// Runtime switchable tracing with enter/exit events.
+// Each thread records into its own lock-free ring buffer, a background thread drains
+// the rings into a Chrome trace event JSON file (viewable in chrome://tracing or ui.perfetto.dev).
+// When tracing is disabled an event costs a single relaxed atomic load.
+class Trace
+{
+public:
+    // start recording trace events to the file path
+    // return a string indicating success or failure
+    static std::string start(std::filesystem::path const &filePath);
+    // stop recording and finish writing the trace file
+    // return a string indicating success or failure
+    static std::string stop();
+    // Get a string representing the current trace status
+    static std::string getStatus();
+    static bool isEnabled()
+    {
+        return n_enabled.load(std::memory_order_relaxed);
+    }
+    // p_name must have static storage duration (e.g. a string literal)
+    static void begin(char const *p_name);
+    static void end(char const *p_name);
+
+private:
+    static std::atomic_bool n_enabled;
+};
+
+// records a begin event on construction and the matching end event on destruction
+class TraceScope
+{
+public:
+    explicit TraceScope(char const *p_name)
+        : mp_name{Trace::isEnabled() ? p_name : nullptr}
+    {
+        if (mp_name)
+        {
+            Trace::begin(mp_name);
+        }
+    }
+    ~TraceScope()
+    {
+        if (mp_name)
+        {
+            Trace::end(mp_name);
+        }
+    }
+    TraceScope(TraceScope const &) = delete;
+    TraceScope &operator=(TraceScope const &) = delete;
+
+private:
+    char const *mp_name;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope const TRACE_CONCAT(traceScope, __LINE__)(name)
@@ -0,0 +1,113 @@
+#include "VideoEncoder.h"
+#include "Trace.h"
+#include <cstdlib>
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <sstream>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace
+{
+    constexpr static inline auto const np_ffmpegWriterOptions = "OPENCV_FFMPEG_WRITER_OPTIONS";
+    // the environment is read when a writer is opened, the recording and the benchmark may open writers concurrently,
+    // this serializes the opens only, a getenv() on another thread during an open can still race with setenv()
+    std::mutex n_environmentMut;
+
+    std::string _toLower(std::string str)
+    {
+        std::transform(std::begin(str), std::end(str), std::begin(str), [](auto const c)
+                       { return (char)std::tolower(c); });
+        return str;
+    }
+}
+
+std::vector<VideoEncoder::Codec> const &VideoEncoder::getCodecs()
+{
+    static std::vector<Codec> const codecs{
+        {"MP4V", cv::VideoWriter::fourcc('m', 'p', '4', 'v'), cv::CAP_FFMPEG, {".mp4", ".avi", ".mkv"}, false},
+        {"MJPG", cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), cv::CAP_OPENCV_MJPEG, {".avi"}, false},
+        {"FFV1", cv::VideoWriter::fourcc('F', 'F', 'V', '1'), cv::CAP_FFMPEG, {".mkv", ".avi"}, true},
+        {"H264", cv::VideoWriter::fourcc('a', 'v', 'c', '1'), cv::CAP_FFMPEG, {".mp4", ".mkv"}, false},
+    };
+    return codecs;
+}
+
+VideoEncoder::Codec const *VideoEncoder::findByName(std::string const &name)
+{
+    auto const lowerName = _toLower(name);
+    for (auto const &codec : getCodecs())
+    {
+        if (_toLower(codec.p_name) == lowerName)
+        {
+            return &codec;
+        }
+    }
+    return nullptr;
+}
+
+VideoEncoder::Codec const *VideoEncoder::findByExtension(std::string const &extension)
+{
+    auto const lowerExtension = _toLower(extension);
+    for (auto const &codec : getCodecs())
+    {
+        if (codec.extensions.front() == lowerExtension)
+        {
+            return &codec;
+        }
+    }
+    return nullptr;
+}
+
+bool VideoEncoder::supportsExtension(Codec const &codec, std::string const &extension)
+{
+    return std::find(std::begin(codec.extensions), std::end(codec.extensions), _toLower(extension)) != std::end(codec.extensions);
+}
+
+std::unique_ptr<cv::VideoWriter> VideoEncoder::open(std::filesystem::path const &filePath, Codec const &codec, double fps,
+                                                    int width, int height, bool isColor, int threads)
+{
+    TRACE_SCOPE("VideoEncoder::open");
+    std::vector<int> params{cv::VIDEOWRITER_PROP_IS_COLOR, isColor ? 1 : 0};
+    if (codec.apiPreference == cv::CAP_OPENCV_MJPEG && threads > 0)
+    {
+        params.insert(std::end(params), {cv::VIDEOWRITER_PROP_NSTRIPES, threads});
+    }
+    if (codec.apiPreference != cv::CAP_FFMPEG || threads <= 0)
+    {
+        return std::make_unique<cv::VideoWriter>(filePath.string(), codec.apiPreference, codec.fourcc, fps, cv::Size(width, height), params);
+    }
+    std::lock_guard<std::mutex> lock(n_environmentMut);
+    auto const *const p_previousOptions = std::getenv(np_ffmpegWriterOptions);
+    std::string const previousOptions = p_previousOptions ? p_previousOptions : "";
+    setenv(np_ffmpegWriterOptions, ("threads;" + std::to_string(threads) + (previousOptions.empty() ? "" : "|" + previousOptions)).c_str(), 1);
+    auto p_writer = std::make_unique<cv::VideoWriter>(filePath.string(), codec.apiPreference, codec.fourcc, fps, cv::Size(width, height), params);
+    if (p_previousOptions)
+    {
+        setenv(np_ffmpegWriterOptions, previousOptions.c_str(), 1);
+    }
+    else
+    {
+        unsetenv(np_ffmpegWriterOptions);
+    }
+    return p_writer;
+}
+
+std::string VideoEncoder::getCodecList()
+{
+    std::stringstream ss;
+    ss << "[";
+    for (auto const &codec : getCodecs())
+    {
+        ss << (&codec == &getCodecs().front() ? "" : ", ") << "{codec=" << codec.p_name << ", containers=";
+        for (auto const &extension : codec.extensions)
+        {
+            ss << (&extension == &codec.extensions.front() ? "" : "/") << extension;
+        }
+        ss << ", lossless=" << (codec.lossless ? "true" : "false") << "}";
+    }
+    ss << "]";
+    return ss.str();
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cv
+{
+    class VideoWriter;
+}
+
+// The codecs and containers of the recordings. Without an explicit codec the codec follows the
+// file extension: .mp4 = MP4V, .avi = MJPG, .mkv = FFV1 (lossless).
+// MJPG uses the JPEG encoder built into OpenCV, which splits each frame into stripes encoded in
+// parallel and is cheap on small ARM boards; the others use the FFmpeg backend of OpenCV, H264 only
+// where that FFmpeg build has an H.264 encoder.
+class VideoEncoder
+{
+public:
+    struct Codec
+    {
+        char const *p_name;
+        int fourcc;
+        int apiPreference;
+        // containers the codec can be written to, the first one is the one it is chosen for
+        std::vector<std::string> extensions;
+        bool lossless;
+    };
+    static std::vector<Codec> const &getCodecs();
+    // case insensitive, return nullptr when unknown
+    static Codec const *findByName(std::string const &name);
+    // the default codec of a container (extension with the dot), return nullptr when unknown
+    static Codec const *findByExtension(std::string const &extension);
+    static bool supportsExtension(Codec const &codec, std::string const &extension);
+    // open a writer, threads = encoder threads (0 = the backend default), check isOpened() for failure
+    // MJPG encodes threads stripes in parallel, the FFmpeg encoders get the thread count through the
+    // OPENCV_FFMPEG_WRITER_OPTIONS environment variable where the OpenCV build reads it (VideoWriter has no
+    // parameter for it), the opens are serialized under a static mutex but the variable is set process wide
+    // during an open, getenv() on other threads is not covered by the mutex
+    static std::unique_ptr<cv::VideoWriter> open(std::filesystem::path const &filePath, Codec const &codec, double fps,
+                                                 int width, int height, bool isColor, int threads);
+    // Get a string listing the codecs with their containers
+    static std::string getCodecList();
+};
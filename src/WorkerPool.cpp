@@ -0,0 +1,141 @@
+#include "WorkerPool.h"
+#include "AsyncLog.h"
+#include "Trace.h"
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    constexpr static inline char const *np_laneNames[]{"high", "normal"};
+}
+
+WorkerPool::WorkerPool(Options const &options)
+    : m_maxQueuedJobs{std::max<size_t>(options.maxQueuedJobs, 1)},
+      m_niceness{options.niceness},
+      m_mut{},
+      m_jobCondition{},
+      m_roomCondition{},
+      m_lanes{},
+      m_statistics{},
+      m_running{true},
+      m_threads{}
+{
+    auto threadCount = options.threadCount;
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+    }
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        m_threads.emplace_back(&WorkerPool::_run, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mut);
+        m_running = false;
+    }
+    m_jobCondition.notify_all();
+    for (auto &thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+std::future<void> WorkerPool::submit(std::function<void()> job, Priority priority)
+{
+    Job queuedJob{std::packaged_task<void()>(std::move(job)), {}};
+    auto future = queuedJob.task.get_future();
+    {
+        std::unique_lock<std::mutex> lock(m_mut);
+        auto &lane = m_lanes[size_t(priority)];
+        auto &statistics = m_statistics[size_t(priority)];
+        if (lane.size() >= m_maxQueuedJobs)
+        {
+            ++statistics.blockedCount;
+            m_roomCondition.wait(lock, [this, &lane]()
+                                 { return lane.size() < m_maxQueuedJobs; });
+        }
+        queuedJob.submitTime = std::chrono::steady_clock::now();
+        lane.push_back(std::move(queuedJob));
+        statistics.maxQueued = std::max(statistics.maxQueued, lane.size());
+    }
+    m_jobCondition.notify_one();
+    return future;
+}
+
+size_t WorkerPool::getThreadCount() const
+{
+    return m_threads.size();
+}
+
+void WorkerPool::_run()
+{
+    // setpriority on a thread id only changes that thread on Linux
+    if (m_niceness != 0 && setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), getpriority(PRIO_PROCESS, 0) + m_niceness) != 0)
+    {
+        AsyncLog::log(LOG_WARNING, "Unable to lower the priority of a worker thread: %s", strerror(errno));
+    }
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(m_mut);
+        m_jobCondition.wait(lock, [this]()
+                            { return std::any_of(std::begin(m_lanes), std::end(m_lanes), [](auto const &lane)
+                                                 { return !lane.empty(); }) ||
+                                     !m_running; });
+        // the first lane with a job, the queued jobs are run before the threads end, their futures are waited for
+        auto const it = std::find_if(std::begin(m_lanes), std::end(m_lanes), [](auto const &lane)
+                                     { return !lane.empty(); });
+        if (it == std::end(m_lanes))
+        {
+            break;
+        }
+        auto &statistics = m_statistics[size_t(it - std::begin(m_lanes))];
+        auto job = std::move(it->front());
+        it->pop_front();
+        lock.unlock();
+        m_roomCondition.notify_all();
+        auto const startTime = std::chrono::steady_clock::now();
+        {
+            TRACE_SCOPE("WorkerPool::job");
+            job.task();
+        }
+        auto const endTime = std::chrono::steady_clock::now();
+        auto const waitMs = std::chrono::duration<double, std::milli>(startTime - job.submitTime).count();
+        auto const runMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+        lock.lock();
+        ++statistics.completedCount;
+        statistics.totalWaitMs += waitMs;
+        statistics.maxWaitMs = std::max(statistics.maxWaitMs, waitMs);
+        statistics.totalRunMs += runMs;
+        statistics.maxRunMs = std::max(statistics.maxRunMs, runMs);
+    }
+}
+
+std::string WorkerPool::getStatus() const
+{
+    std::lock_guard<std::mutex> lock(m_mut);
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << "{threads=" << m_threads.size() << ", niceness=" << m_niceness
+       << ", maxQueuedJobs=" << m_maxQueuedJobs;
+    for (size_t i = 0; i < m_lanes.size(); ++i)
+    {
+        auto const &statistics = m_statistics[i];
+        auto const completedCount = double(std::max<uint64_t>(statistics.completedCount, 1));
+        ss << ", " << np_laneNames[i] << "={jobs=" << statistics.completedCount << ", queued=" << m_lanes[i].size()
+           << ", maxQueued=" << statistics.maxQueued << ", blocked=" << statistics.blockedCount
+           << ", avgWaitMs=" << statistics.totalWaitMs / completedCount << ", maxWaitMs=" << statistics.maxWaitMs
+           << ", avgRunMs=" << statistics.totalRunMs / completedCount << ", maxRunMs=" << statistics.maxRunMs << "}";
+    }
+    ss << "}";
+    return ss.str();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads running independent jobs (still image encodes, radiometric exports) so that
+// they neither run on the frame callback nor on the recording thread that feeds the video writer.
+// Two lanes: a waiting client's job (screenshot) is taken before any queued bulk job (burst frame).
+// Each lane holds at most maxQueuedJobs, submit() waits for room, so a large batch is fed to the
+// threads instead of being queued at once. The threads run at a lower priority (niceness) than the
+// rest of the process, so the video encoder is not starved by a batch of stills.
+// The time every job waited in the lane and ran is kept per lane.
+class WorkerPool
+{
+public:
+    enum class Priority
+    {
+        High = 0,
+        Normal,
+        Count
+    };
+    struct Options
+    {
+        // 0 = one thread per core except one, which is left to the frame and recording threads
+        size_t threadCount;
+        // per lane, at least 1
+        size_t maxQueuedJobs;
+        // added to the niceness of the threads, 0 = same priority as the process
+        int niceness;
+    };
+    explicit WorkerPool(Options const &options);
+    ~WorkerPool();
+    // queue a job, waits while the lane is full; the future is ready when the job has run
+    std::future<void> submit(std::function<void()> job, Priority priority);
+    size_t getThreadCount() const;
+    // Get a string representing the threads and, per lane, the jobs run, queued and their wait and run times
+    std::string getStatus() const;
+
+private:
+    struct Job
+    {
+        std::packaged_task<void()> task;
+        std::chrono::steady_clock::time_point submitTime;
+    };
+    struct LaneStatistics
+    {
+        uint64_t completedCount;
+        // submits that waited for room in the lane
+        uint64_t blockedCount;
+        size_t maxQueued;
+        double totalWaitMs;
+        double maxWaitMs;
+        double totalRunMs;
+        double maxRunMs;
+    };
+    void _run();
+    size_t m_maxQueuedJobs;
+    int m_niceness;
+    mutable std::mutex m_mut;
+    std::condition_variable m_jobCondition;
+    std::condition_variable m_roomCondition;
+    std::array<std::deque<Job>, size_t(Priority::Count)> m_lanes;
+    std::array<LaneStatistics, size_t(Priority::Count)> m_statistics;
+    bool m_running;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,433 @@
+#include "WriteBehindFile.h"
+#include "AsyncLog.h"
+#include "Trace.h"
+#include <syslog.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+    // O_DIRECT needs the buffers, offsets and sizes aligned to the logical block size, a page covers all devices
+    constexpr static inline auto const n_alignment = size_t(4096);
+    constexpr static inline auto const n_bytesPerMegabyte = 1024.0 * 1024.0;
+
+    size_t _alignUp(size_t size)
+    {
+        return std::max(n_alignment, (size + n_alignment - 1) / n_alignment * n_alignment);
+    }
+}
+
+WriteBehindFile::Writeback::Writeback(uint64_t intervalBytes)
+    : m_intervalBytes{intervalBytes},
+      m_startedEnd{0},
+      m_maxWaitMs{0.0},
+      m_syncCount{0}
+{
+}
+
+void WriteBehindFile::Writeback::update(int fd, uint64_t size)
+{
+    if (m_intervalBytes == 0 || fd < 0)
+    {
+        return;
+    }
+    while (size >= m_startedEnd + m_intervalBytes)
+    {
+        TRACE_SCOPE("WriteBehindFile::Writeback::update");
+        auto const startTime = std::chrono::steady_clock::now();
+        sync_file_range(fd, off64_t(m_startedEnd), off64_t(m_intervalBytes), SYNC_FILE_RANGE_WRITE);
+        if (m_startedEnd >= m_intervalBytes)
+        {
+            // started one interval ago, usually written by now
+            auto const previous = m_startedEnd - m_intervalBytes;
+            sync_file_range(fd, off64_t(previous), off64_t(m_intervalBytes), SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(fd, off_t(previous), off_t(m_intervalBytes), POSIX_FADV_DONTNEED);
+        }
+        m_startedEnd += m_intervalBytes;
+        ++m_syncCount;
+        m_maxWaitMs = std::max(m_maxWaitMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+    }
+}
+
+double WriteBehindFile::Writeback::getMaxWaitMs() const
+{
+    return m_maxWaitMs;
+}
+
+uint64_t WriteBehindFile::Writeback::getSyncCount() const
+{
+    return m_syncCount;
+}
+
+WriteBehindFile::WriteBehindFile(std::filesystem::path const &filePath, Options const &options)
+    : m_filePath{filePath},
+      m_options{options},
+      m_fd{-1},
+      m_direct{false},
+      mp_memory{nullptr, std::free},
+      m_currentBuffer{},
+      m_hasCurrentBuffer{false},
+      m_size{0},
+      m_flushed{false},
+      m_mut{},
+      m_bufferCondition{},
+      m_freeBuffers{},
+      m_fullBuffers{},
+      m_writing{false},
+      m_writerRunning{false},
+      m_error{},
+      m_allocatedEnd{0},
+      m_preallocationSupported{options.preallocateBytes > 0},
+      m_bytesWritten{0},
+      m_writeSeconds{0.0},
+      m_maxStallMs{0.0},
+      m_syncCount{0},
+      m_rejectedCount{0},
+      m_writeback{options.direct ? 0 : options.syncIntervalBytes},
+      m_writerThread{}
+{
+    TRACE_SCOPE("WriteBehindFile::WriteBehindFile");
+    m_options.bufferBytes = _alignUp(m_options.bufferBytes);
+    m_options.bufferCount = std::max(m_options.bufferCount, size_t(2));
+    auto const flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (!m_options.direct)
+    {
+        m_fd = open(m_filePath.c_str(), flags, 0644);
+    }
+    else if ((m_fd = open(m_filePath.c_str(), flags | O_DIRECT, 0644)) >= 0)
+    {
+        m_direct = true;
+    }
+    else if (errno == EINVAL)
+    {
+        AsyncLog::log(LOG_NOTICE, "%s does not support direct I/O, writing through the page cache.", m_filePath.c_str());
+        m_fd = open(m_filePath.c_str(), flags, 0644);
+        m_writeback = Writeback(m_options.syncIntervalBytes);
+    }
+    if (m_fd < 0)
+    {
+        m_error = std::strerror(errno);
+        return;
+    }
+    auto const memoryBytes = m_options.bufferCount * m_options.bufferBytes;
+    if (!MemoryBudget::tryAcquire(m_options.category, memoryBytes))
+    {
+        m_error = "the memory budget is exhausted";
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    mp_memory.reset(std::aligned_alloc(n_alignment, memoryBytes));
+    if (!mp_memory)
+    {
+        m_error = "unable to allocate the write buffers";
+        MemoryBudget::release(m_options.category, memoryBytes);
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+    for (size_t i = 0; i < m_options.bufferCount; ++i)
+    {
+        m_freeBuffers.push_back({(uint8_t *)mp_memory.get() + i * m_options.bufferBytes, 0, 0});
+    }
+    m_writerRunning = true;
+    m_writerThread = std::thread(&WriteBehindFile::_runWriter, this);
+}
+
+WriteBehindFile::~WriteBehindFile()
+{
+    close();
+}
+
+bool WriteBehindFile::isOpened() const
+{
+    return m_fd >= 0;
+}
+
+bool WriteBehindFile::canWrite(size_t size) const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    if (m_fd < 0 || m_flushed || !m_error.empty())
+    {
+        return false;
+    }
+    auto const room = (m_hasCurrentBuffer ? m_options.bufferBytes - m_currentBuffer.size : 0) + m_freeBuffers.size() * m_options.bufferBytes;
+    return room >= size;
+}
+
+bool WriteBehindFile::write(void const *p_data, size_t size)
+{
+    if (!canWrite(size))
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        ++m_rejectedCount;
+        return false;
+    }
+    auto const *p_bytes = (uint8_t const *)p_data;
+    while (size > 0)
+    {
+        if (!m_hasCurrentBuffer)
+        {
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            m_currentBuffer = m_freeBuffers.front();
+            m_freeBuffers.pop_front();
+            m_currentBuffer.size = 0;
+            m_currentBuffer.offset = m_size;
+            m_hasCurrentBuffer = true;
+        }
+        auto const count = std::min(size, m_options.bufferBytes - m_currentBuffer.size);
+        std::memcpy(m_currentBuffer.p_data + m_currentBuffer.size, p_bytes, count);
+        m_currentBuffer.size += count;
+        m_size += count;
+        p_bytes += count;
+        size -= count;
+        if (m_currentBuffer.size == m_options.bufferBytes)
+        {
+            _queueBuffer();
+        }
+    }
+    return true;
+}
+
+uint64_t WriteBehindFile::getSize() const
+{
+    return m_size;
+}
+
+bool WriteBehindFile::flush()
+{
+    TRACE_SCOPE("WriteBehindFile::flush");
+    if (m_fd < 0)
+    {
+        return false;
+    }
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    if (!m_flushed)
+    {
+        m_bufferCondition.wait(lock, [this]()
+                               { return m_fullBuffers.empty() && !m_writing; });
+        if (m_direct)
+        {
+            // the tail and the headers are not aligned, they go through the page cache
+            fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+        }
+        if (m_hasCurrentBuffer && m_currentBuffer.size > 0 && m_error.empty())
+        {
+            lock.unlock();
+            auto const written = _writeAll(m_currentBuffer.p_data, m_currentBuffer.size, off_t(m_currentBuffer.offset));
+            auto const error = errno;
+            lock.lock();
+            if (!written)
+            {
+                _setError(std::strerror(error));
+            }
+            else
+            {
+                m_bytesWritten += m_currentBuffer.size;
+            }
+        }
+        if (m_hasCurrentBuffer)
+        {
+            m_freeBuffers.push_back(m_currentBuffer);
+            m_hasCurrentBuffer = false;
+        }
+        m_flushed = true;
+    }
+    return m_error.empty();
+}
+
+bool WriteBehindFile::writeAt(void const *p_data, size_t size, uint64_t offset)
+{
+    if (m_fd < 0 || !m_flushed)
+    {
+        return false;
+    }
+    if (!_writeAll(p_data, size, off_t(offset)))
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        _setError(std::strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+std::string WriteBehindFile::close()
+{
+    TRACE_SCOPE("WriteBehindFile::close");
+    if (m_fd >= 0)
+    {
+        flush();
+        {
+            std::lock_guard<decltype(m_mut)> lock{m_mut};
+            m_writerRunning = false;
+        }
+        m_bufferCondition.notify_all();
+        if (m_writerThread.joinable())
+        {
+            m_writerThread.join();
+        }
+        // give back the preallocated blocks past the end of the file, writeAt() may have extended it
+        struct stat fileStat{};
+        if (fstat(m_fd, &fileStat) == 0 && m_allocatedEnd > uint64_t(fileStat.st_size))
+        {
+            fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, fileStat.st_size, off_t(m_allocatedEnd - uint64_t(fileStat.st_size)));
+        }
+        if (fdatasync(m_fd) != 0 && m_error.empty())
+        {
+            _setError(std::string("sync failed: ") + std::strerror(errno));
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        MemoryBudget::release(m_options.category, m_options.bufferCount * m_options.bufferBytes);
+        m_freeBuffers.clear();
+        mp_memory.reset();
+    }
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    return m_error;
+}
+
+std::string WriteBehindFile::getStatus() const
+{
+    std::lock_guard<decltype(m_mut)> lock{m_mut};
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "{";
+    ss << "io=" << (m_direct ? "direct" : "buffered");
+    ss << ", bufferKB=" << m_options.bufferBytes / 1024;
+    ss << ", buffers=" << m_options.bufferCount;
+    ss << ", queued=" << m_fullBuffers.size() + (m_writing ? 1 : 0);
+    ss << ", MB=" << double(m_bytesWritten) / n_bytesPerMegabyte;
+    ss << ", writeMBps=" << (m_writeSeconds > 0.0 ? double(m_bytesWritten) / n_bytesPerMegabyte / m_writeSeconds : 0.0);
+    ss << ", maxStallMs=" << m_maxStallMs;
+    ss << ", syncs=" << m_syncCount;
+    ss << ", rejected=" << m_rejectedCount;
+    if (!m_error.empty())
+    {
+        ss << ", error=" << m_error;
+    }
+    ss << "}";
+    return ss.str();
+}
+
+void WriteBehindFile::_queueBuffer()
+{
+    {
+        std::lock_guard<decltype(m_mut)> lock{m_mut};
+        m_fullBuffers.push_back(m_currentBuffer);
+        m_hasCurrentBuffer = false;
+    }
+    m_bufferCondition.notify_all();
+}
+
+void WriteBehindFile::_runWriter()
+{
+    std::unique_lock<decltype(m_mut)> lock{m_mut};
+    for (;;)
+    {
+        m_bufferCondition.wait(lock, [this]()
+                               { return !m_fullBuffers.empty() || !m_writerRunning; });
+        if (m_fullBuffers.empty())
+        {
+            break;
+        }
+        auto const buffer = m_fullBuffers.front();
+        m_fullBuffers.pop_front();
+        m_writing = true;
+        auto const failed = !m_error.empty();
+        lock.unlock();
+        TRACE_SCOPE("WriteBehindFile::write");
+        auto const startTime = std::chrono::steady_clock::now();
+        bool written = failed;
+        if (!failed)
+        {
+            _preallocate(buffer.offset + buffer.size);
+            written = _writeAll(buffer.p_data, buffer.size, off_t(buffer.offset));
+        }
+        auto const error = errno;
+        auto const writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        if (written && !failed)
+        {
+            m_writeback.update(m_fd, buffer.offset + buffer.size);
+        }
+        auto const stallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        lock.lock();
+        if (!written)
+        {
+            _setError(std::strerror(error));
+        }
+        else if (!failed)
+        {
+            m_bytesWritten += buffer.size;
+            m_writeSeconds += writeSeconds;
+            m_maxStallMs = std::max(m_maxStallMs, stallMs);
+            m_syncCount = m_writeback.getSyncCount();
+        }
+        m_freeBuffers.push_back(buffer);
+        m_writing = false;
+        m_bufferCondition.notify_all();
+    }
+}
+
+bool WriteBehindFile::_writeAll(void const *p_data, size_t size, off_t offset)
+{
+    auto const *p_bytes = (uint8_t const *)p_data;
+    while (size > 0)
+    {
+        auto const written = pwrite(m_fd, p_bytes, size, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        if (written == 0)
+        {
+            // no progress, e.g. a full device that does not report ENOSPC, do not spin
+            errno = EIO;
+            return false;
+        }
+        p_bytes += written;
+        size -= size_t(written);
+        offset += written;
+    }
+    return true;
+}
+
+// writer thread only: keep preallocateBytes allocated ahead of the write position
+void WriteBehindFile::_preallocate(uint64_t end)
+{
+    if (!m_preallocationSupported || end <= m_allocatedEnd)
+    {
+        return;
+    }
+    auto const allocatedEnd = end + m_options.preallocateBytes;
+    if (fallocate(m_fd, FALLOC_FL_KEEP_SIZE, off_t(m_allocatedEnd), off_t(allocatedEnd - m_allocatedEnd)) == 0)
+    {
+        m_allocatedEnd = allocatedEnd;
+    }
+    else if (errno == EOPNOTSUPP || errno == ENOSYS)
+    {
+        // FAT and exFAT cards, the file grows with the writes
+        m_preallocationSupported = false;
+    }
+}
+
+// the caller must hold m_mut, or the writer thread must be stopped
+void WriteBehindFile::_setError(std::string const &error)
+{
+    if (m_error.empty())
+    {
+        m_error = error;
+        AsyncLog::log(LOG_ERR, "Write to %s failed: %s", m_filePath.c_str(), error.c_str());
+    }
+}
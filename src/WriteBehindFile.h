@@ -0,0 +1,119 @@
+#pragma once
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "MemoryBudget.h"
+
+// A file written behind the producer for SD cards and eMMC: write() copies into one of a few large
+// aligned buffers and a background thread writes each full buffer with a single pwrite, so the
+// producer never waits for the card. The file is preallocated ahead of the write position with
+// fallocate, and the writeback of the written bytes is started every syncIntervalBytes and waited
+// for one interval later, so the dirty pages never pile up into a multi second stall when the kernel
+// flushes them all at once. With direct the page cache is bypassed (O_DIRECT, where the file system
+// supports it). When every buffer is queued canWrite() returns false: the producer is expected to
+// drop or defer its data (backpressure) instead of buffering without bound.
+// write(), flush(), writeAt() and close() must be called from one thread at a time.
+class WriteBehindFile
+{
+public:
+    struct Options
+    {
+        // rounded up to the alignment of direct I/O
+        size_t bufferBytes;
+        size_t bufferCount;
+        // fallocate step ahead of the write position, 0 = no preallocation
+        uint64_t preallocateBytes;
+        // writeback started every syncIntervalBytes, 0 = left to the kernel
+        uint64_t syncIntervalBytes;
+        bool direct;
+        // the category the buffers are accounted in
+        MemoryBudget::Category category;
+    };
+    // Paces the writeback of a file written through the page cache, also for files written by a library
+    // (cv::VideoWriter): every interval is pushed to the device as soon as it is complete and the one
+    // before it is waited for and dropped from the page cache.
+    class Writeback
+    {
+    public:
+        explicit Writeback(uint64_t intervalBytes);
+        // the first size bytes of the file were written
+        void update(int fd, uint64_t size);
+        double getMaxWaitMs() const;
+        uint64_t getSyncCount() const;
+
+    private:
+        uint64_t m_intervalBytes;
+        // end of the bytes whose writeback was started
+        uint64_t m_startedEnd;
+        double m_maxWaitMs;
+        uint64_t m_syncCount;
+    };
+
+    WriteBehindFile(std::filesystem::path const &filePath, Options const &options);
+    ~WriteBehindFile();
+    bool isOpened() const;
+    // check whether size bytes can be appended without waiting for the disk
+    bool canWrite(size_t size) const;
+    // append size bytes, return false (nothing appended) when they do not fit the free buffers or after a write error
+    bool write(void const *p_data, size_t size);
+    // bytes appended
+    uint64_t getSize() const;
+    // write all appended bytes and wait for them, appending ends
+    bool flush();
+    // after flush(), overwrite bytes at an offset (headers)
+    bool writeAt(void const *p_data, size_t size, uint64_t offset);
+    // flush, release the preallocation past the end, sync and close
+    // return an empty string on success, otherwise the first error
+    std::string close();
+    // Get a string representing the buffers, the throughput, the worst stall and the rejected writes
+    std::string getStatus() const;
+
+private:
+    struct Buffer
+    {
+        uint8_t *p_data;
+        size_t size;
+        uint64_t offset;
+    };
+    void _queueBuffer();
+    void _runWriter();
+    bool _writeAll(void const *p_data, size_t size, off_t offset);
+    void _preallocate(uint64_t end);
+    void _setError(std::string const &error);
+    std::filesystem::path m_filePath;
+    Options m_options;
+    int m_fd;
+    bool m_direct;
+    std::unique_ptr<void, void (*)(void *)> mp_memory;
+    // the buffer being filled, owned by the producer
+    Buffer m_currentBuffer;
+    bool m_hasCurrentBuffer;
+    std::atomic<uint64_t> m_size;
+    bool m_flushed;
+    // guards the buffer queues, the error and the statistics
+    mutable std::mutex m_mut;
+    std::condition_variable m_bufferCondition;
+    std::deque<Buffer> m_freeBuffers;
+    std::deque<Buffer> m_fullBuffers;
+    bool m_writing;
+    bool m_writerRunning;
+    std::string m_error;
+    uint64_t m_allocatedEnd;
+    bool m_preallocationSupported;
+    uint64_t m_bytesWritten;
+    double m_writeSeconds;
+    double m_maxStallMs;
+    uint64_t m_syncCount;
+    uint64_t m_rejectedCount;
+    // writer thread only
+    Writeback m_writeback;
+    std::thread m_writerThread;
+};
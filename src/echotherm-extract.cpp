@@ -0,0 +1,378 @@
+#include "RadiometricCodec.h"
+#include "RadiometricRecorder.h"
+#include "seekcamera/seekcamera_frame.h"
+#include <boost/program_options.hpp>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+// Reads the radiometric recordings (.etr) of echothermd on the ground: prints the file information
+// and exports frames as temperatures in degrees C to CSV or to 32 bit float TIFF.
+namespace
+{
+    struct RadiometricFile
+    {
+        std::FILE *p_file = nullptr;
+        RadiometricRecorder::FileHeader header{};
+        std::vector<RadiometricRecorder::IndexEntry> index;
+        // the file was not finished (power cut), the records were found by a scan
+        bool recovered = false;
+        // encoded bytes of the compressed frames, 0 when uncompressed
+        uint64_t encodedBytes = 0;
+    };
+
+    std::string _openFile(std::string const &filePath, RadiometricFile *p_radiometricFile)
+    {
+        auto &file = *p_radiometricFile;
+        file.p_file = std::fopen(filePath.c_str(), "rb");
+        if (file.p_file == nullptr)
+        {
+            return "Unable to open " + filePath + ": " + std::strerror(errno);
+        }
+        if (std::fread(&file.header, sizeof(file.header), 1, file.p_file) != 1 || std::memcmp(file.header.magic, "ETRADIO", 8) != 0)
+        {
+            return filePath + " is not a radiometric recording";
+        }
+        if (file.header.version == 0 || file.header.version > RadiometricRecorder::n_version)
+        {
+            return filePath + " has the unsupported version " + std::to_string(file.header.version);
+        }
+        if (file.header.recordSize == 0)
+        {
+            return filePath + " contains no frame";
+        }
+        fseeko(file.p_file, 0, SEEK_END);
+        auto const fileSize = uint64_t(ftello(file.p_file));
+        RadiometricRecorder::IndexHeader indexHeader{};
+        if (file.header.indexOffset != 0 && file.header.indexOffset < fileSize &&
+            fseeko(file.p_file, off_t(file.header.indexOffset), SEEK_SET) == 0 &&
+            std::fread(&indexHeader, sizeof(indexHeader), 1, file.p_file) == 1 &&
+            std::memcmp(indexHeader.magic, "ETINDEX", 8) == 0)
+        {
+            // the entry count comes from the file, it can not exceed what follows the index header
+            auto const maxEntryCount = (fileSize - file.header.indexOffset - sizeof(indexHeader)) / sizeof(RadiometricRecorder::IndexEntry);
+            if (indexHeader.entryCount > maxEntryCount)
+            {
+                return filePath + " has a corrupt index (" + std::to_string(indexHeader.entryCount) + " entries, at most " +
+                       std::to_string(maxEntryCount) + " fit in the file)";
+            }
+            file.index.resize(indexHeader.entryCount);
+            if (std::fread(file.index.data(), sizeof(RadiometricRecorder::IndexEntry), file.index.size(), file.p_file) == file.index.size())
+            {
+                return std::string();
+            }
+        }
+        // no index, the records follow the file header, each starts with its magic and has a known size
+        file.recovered = true;
+        file.index.clear();
+        for (uint64_t offset = sizeof(file.header); offset < fileSize;)
+        {
+            RadiometricRecorder::EncodedRecord record{};
+            if (fseeko(file.p_file, off_t(offset), SEEK_SET) != 0 || std::fread(&record, sizeof(RadiometricRecorder::FrameRecord), 1, file.p_file) != 1)
+            {
+                break;
+            }
+            if (std::memcmp(record.magic, "FRME", 4) == 0 && offset + file.header.recordSize <= fileSize)
+            {
+                seekcamera_frame_header_t frameHeader{};
+                if (std::fread(&frameHeader, std::min(sizeof(frameHeader), size_t(file.header.frameHeaderSize)), 1, file.p_file) != 1)
+                {
+                    break;
+                }
+                file.index.push_back({offset, frameHeader.timestamp_utc_ns});
+                offset += file.header.recordSize;
+            }
+            else if (std::memcmp(record.magic, "FRMZ", 4) == 0 &&
+                     std::fread((char *)&record + sizeof(RadiometricRecorder::FrameRecord), sizeof(record) - sizeof(RadiometricRecorder::FrameRecord), 1, file.p_file) == 1 &&
+                     offset + sizeof(record) + record.encodedSize <= fileSize)
+            {
+                file.index.push_back({offset, record.timestampUtcNs});
+                file.encodedBytes += sizeof(record) + record.encodedSize;
+                offset += sizeof(record) + record.encodedSize;
+            }
+            else
+            {
+                break;
+            }
+        }
+        return std::string();
+    }
+
+    // read a frame as temperatures in degrees C
+    std::string _readFrame(RadiometricFile &file, uint64_t frameNumber, seekcamera_frame_header_t *p_frameHeader, std::vector<float> *p_temperatures)
+    {
+        if (frameNumber >= file.index.size())
+        {
+            return "Frame " + std::to_string(frameNumber) + " is not in the file (" + std::to_string(file.index.size()) + " frames)";
+        }
+        RadiometricRecorder::EncodedRecord record{};
+        std::memset(p_frameHeader, 0, sizeof(*p_frameHeader));
+        auto const headerBytes = std::min(sizeof(*p_frameHeader), size_t(file.header.frameHeaderSize));
+        auto const pixelCount = size_t(file.header.width) * size_t(file.header.height);
+        // frame header followed by the pixels
+        std::vector<uint8_t> frame(file.header.frameHeaderSize + pixelCount * file.header.bytesPerPixel);
+        if (fseeko(file.p_file, off_t(file.index[frameNumber].offset), SEEK_SET) != 0 ||
+            std::fread(&record, sizeof(RadiometricRecorder::FrameRecord), 1, file.p_file) != 1)
+        {
+            return "Frame " + std::to_string(frameNumber) + " could not be read";
+        }
+        if (std::memcmp(record.magic, "FRME", 4) == 0)
+        {
+            if (std::fread(frame.data(), frame.size(), 1, file.p_file) != 1)
+            {
+                return "Frame " + std::to_string(frameNumber) + " could not be read";
+            }
+        }
+        else if (std::memcmp(record.magic, "FRMZ", 4) == 0)
+        {
+            std::vector<uint8_t> encoded;
+            std::vector<uint8_t> scratch;
+            if (std::fread((char *)&record + sizeof(RadiometricRecorder::FrameRecord), sizeof(record) - sizeof(RadiometricRecorder::FrameRecord), 1, file.p_file) != 1 ||
+                record.method != uint32_t(RadiometricCodec::Method::DeltaDeflate))
+            {
+                return "Frame " + std::to_string(frameNumber) + " has an unsupported compression";
+            }
+            encoded.resize(record.encodedSize);
+            if (std::fread(encoded.data(), encoded.size(), 1, file.p_file) != 1 ||
+                !RadiometricCodec::decode(encoded.data(), encoded.size(), file.header.frameHeaderSize, int(file.header.width), int(file.header.height),
+                                          file.header.bytesPerPixel, scratch, frame.data()))
+            {
+                return "Frame " + std::to_string(frameNumber) + " could not be decoded";
+            }
+        }
+        else
+        {
+            return "Frame " + std::to_string(frameNumber) + " could not be read";
+        }
+        std::memcpy(p_frameHeader, frame.data(), headerBytes);
+        auto const *const p_pixelBytes = frame.data() + file.header.frameHeaderSize;
+        p_temperatures->resize(pixelCount);
+        if (file.header.frameFormat == SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT)
+        {
+            std::memcpy(p_temperatures->data(), p_pixelBytes, pixelCount * sizeof(float));
+        }
+        else
+        {
+            auto const *p_pixels = (int16_t const *)p_pixelBytes;
+            for (size_t i = 0; i < pixelCount; ++i)
+            {
+                (*p_temperatures)[i] = float(p_pixels[i]) / 64.0f - 40.0f;
+            }
+        }
+        return std::string();
+    }
+
+    std::string _getFormatName(uint32_t frameFormat)
+    {
+        return frameFormat == SEEKCAMERA_FRAME_FORMAT_THERMOGRAPHY_FLOAT ? "FLOAT" : "FIXED_10_6";
+    }
+
+    std::string _getInfo(std::string const &filePath, RadiometricFile const &file)
+    {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "{";
+        ss << "file=" << filePath;
+        ss << ", version=" << file.header.version;
+        ss << ", format=" << _getFormatName(file.header.frameFormat);
+        ss << ", size=" << file.header.width << "x" << file.header.height;
+        ss << ", chipId=" << std::string(file.header.chipId, strnlen(file.header.chipId, sizeof(file.header.chipId)));
+        ss << ", frames=" << file.index.size();
+        if (file.header.version >= 2)
+        {
+            // the records of an indexed file end where the index starts
+            auto const encodedBytes = file.recovered ? file.encodedBytes : file.header.indexOffset - sizeof(file.header);
+            ss << ", compressionRatio=" << (encodedBytes > 0 ? double(file.index.size() * file.header.recordSize) / double(encodedBytes) : 0.0);
+        }
+        if (file.index.size() > 1)
+        {
+            auto const durationS = double(file.index.back().timestampUtcNs - file.index.front().timestampUtcNs) * 1e-9;
+            ss << ", firstUtcNs=" << file.index.front().timestampUtcNs;
+            ss << ", durationS=" << durationS;
+            ss << ", fps=" << (durationS > 0.0 ? double(file.index.size() - 1) / durationS : 0.0);
+        }
+        ss << ", indexed=" << (file.recovered ? "false (recovered from an unfinished file)" : "true");
+        ss << "}";
+        return ss.str();
+    }
+
+    std::string _writeCsv(std::string const &filePath, RadiometricFile const &file, uint64_t frameNumber,
+                          seekcamera_frame_header_t const &frameHeader, std::vector<float> const &temperatures)
+    {
+        std::FILE *p_file = std::fopen(filePath.c_str(), "w");
+        if (p_file == nullptr)
+        {
+            return "Unable to open " + filePath + ": " + std::strerror(errno);
+        }
+        // the layout of the radiometric screenshots of echothermd
+        std::fprintf(p_file, "File Info:\n");
+        std::fprintf(p_file, "frame,%llu\n", (unsigned long long)frameNumber);
+        std::fprintf(p_file, "timestamp_utc_ns,%llu\n", (unsigned long long)frameHeader.timestamp_utc_ns);
+        std::fputc('\n', p_file);
+        std::fprintf(p_file, "Header Data:\n");
+        std::fprintf(p_file, "chipid,%.16s\n", frameHeader.chipid);
+        std::fprintf(p_file, "serial_number,%.16s\n", frameHeader.serial_number);
+        std::fprintf(p_file, "fpa_frame_count,%u\n", frameHeader.fpa_frame_count);
+        std::fprintf(p_file, "environment_temperature,%f\n", frameHeader.environment_temperature);
+        std::fprintf(p_file, "thermography_min_x,%u\n", frameHeader.thermography_min_x);
+        std::fprintf(p_file, "thermography_min_y,%u\n", frameHeader.thermography_min_y);
+        std::fprintf(p_file, "thermography_min_value,%f\n", frameHeader.thermography_min_value);
+        std::fprintf(p_file, "thermography_max_x,%u\n", frameHeader.thermography_max_x);
+        std::fprintf(p_file, "thermography_max_y,%u\n", frameHeader.thermography_max_y);
+        std::fprintf(p_file, "thermography_max_value,%f\n", frameHeader.thermography_max_value);
+        std::fprintf(p_file, "thermography_spot_x,%u\n", frameHeader.thermography_spot_x);
+        std::fprintf(p_file, "thermography_spot_y,%u\n", frameHeader.thermography_spot_y);
+        std::fprintf(p_file, "thermography_spot_value,%f\n", frameHeader.thermography_spot_value);
+        std::fputc('\n', p_file);
+        std::fprintf(p_file, "Frame Data:\n");
+        std::fprintf(p_file, "rows,%u\n", file.header.height);
+        std::fprintf(p_file, "cols,%u\n", file.header.width);
+        std::fprintf(p_file, "format,%s\n", _getFormatName(file.header.frameFormat).c_str());
+        std::fprintf(p_file, "units,Deg C\n");
+        for (size_t y = 0; y < file.header.height; ++y)
+        {
+            for (size_t x = 0; x < file.header.width; ++x)
+            {
+                std::fprintf(p_file, "%10.6f,", temperatures[y * file.header.width + x]);
+            }
+            std::fputc('\n', p_file);
+        }
+        std::fclose(p_file);
+        return std::string();
+    }
+
+    std::string _writeTiff(std::string const &filePath, RadiometricFile const &file, std::vector<float> &temperatures)
+    {
+        cv::Mat const frame(int(file.header.height), int(file.header.width), CV_32F, temperatures.data());
+        try
+        {
+            if (!cv::imwrite(filePath, frame))
+            {
+                return "Failed to write " + filePath;
+            }
+        }
+        catch (cv::Exception const &e)
+        {
+            return "Exception occurred while writing " + filePath + " : " + e.msg;
+        }
+        return std::string();
+    }
+
+    // name_000042.ext when several frames are exported
+    std::string _getFramePath(std::string const &filePath, uint64_t frameNumber, bool numbered)
+    {
+        if (!numbered)
+        {
+            return filePath;
+        }
+        auto const dot = filePath.find_last_of('.');
+        auto const slash = filePath.find_last_of('/');
+        auto const extensionStart = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : filePath.size();
+        std::stringstream ss;
+        ss << filePath.substr(0, extensionStart) << '_' << std::setw(6) << std::setfill('0') << frameNumber << filePath.substr(extensionStart);
+        return ss.str();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int returnCode = EXIT_SUCCESS;
+    RadiometricFile file;
+    do
+    {
+        boost::program_options::options_description desc("Allowed options");
+        desc.add_options()("help", "Produce this message");
+        desc.add_options()("file", boost::program_options::value<std::string>(), "Radiometric recording (.etr) of echothermd");
+        desc.add_options()("info", "Print the format, geometry, frame count and duration of the recording");
+        desc.add_options()("frame", boost::program_options::value<std::string>()->default_value("0"),
+                           "Frame to export, N or first-last (files are then numbered name_000042.csv)");
+        desc.add_options()("csv", boost::program_options::value<std::string>(), "Export the frames as temperatures in degrees C to CSV");
+        desc.add_options()("tiff", boost::program_options::value<std::string>(), "Export the frames as temperatures in degrees C to 32 bit float TIFF");
+        boost::program_options::positional_options_description positional;
+        positional.add("file", 1);
+        boost::program_options::variables_map vm;
+        try
+        {
+            boost::program_options::store(boost::program_options::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+            boost::program_options::notify(vm);
+        }
+        catch (boost::program_options::error const &e)
+        {
+            std::cerr << e.what() << std::endl
+                      << "Usage: echotherm-extract file.etr [options]" << std::endl
+                      << desc << std::endl;
+            returnCode = EXIT_FAILURE;
+            break;
+        }
+        if (vm.count("help") || !vm.count("file"))
+        {
+            std::cout << "Usage: echotherm-extract file.etr [options]" << std::endl
+                      << desc << std::endl;
+            returnCode = vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+            break;
+        }
+        std::string const filePath = vm["file"].as<std::string>();
+        if (auto const error = _openFile(filePath, &file); !error.empty())
+        {
+            std::cerr << error << std::endl;
+            returnCode = EXIT_FAILURE;
+            break;
+        }
+        if (vm.count("info") || (!vm.count("csv") && !vm.count("tiff")))
+        {
+            std::cout << _getInfo(filePath, file) << std::endl;
+        }
+        if (!vm.count("csv") && !vm.count("tiff"))
+        {
+            break;
+        }
+        unsigned long long firstFrame = 0;
+        unsigned long long lastFrame = 0;
+        auto const frameStr = vm["frame"].as<std::string>();
+        auto const parsed = std::sscanf(frameStr.c_str(), "%llu-%llu", &firstFrame, &lastFrame);
+        if (parsed < 1 || (parsed == 2 && lastFrame < firstFrame))
+        {
+            std::cerr << "--frame expects N or first-last, not " << frameStr << std::endl;
+            returnCode = EXIT_FAILURE;
+            break;
+        }
+        if (parsed == 1)
+        {
+            lastFrame = firstFrame;
+        }
+        seekcamera_frame_header_t frameHeader{};
+        std::vector<float> temperatures;
+        for (auto frameNumber = uint64_t(firstFrame); frameNumber <= lastFrame && returnCode == EXIT_SUCCESS; ++frameNumber)
+        {
+            std::string error = _readFrame(file, frameNumber, &frameHeader, &temperatures);
+            if (error.empty() && vm.count("csv"))
+            {
+                error = _writeCsv(_getFramePath(vm["csv"].as<std::string>(), frameNumber, lastFrame > firstFrame), file, frameNumber, frameHeader, temperatures);
+            }
+            if (error.empty() && vm.count("tiff"))
+            {
+                error = _writeTiff(_getFramePath(vm["tiff"].as<std::string>(), frameNumber, lastFrame > firstFrame), file, temperatures);
+            }
+            if (!error.empty())
+            {
+                std::cerr << error << std::endl;
+                returnCode = EXIT_FAILURE;
+            }
+        }
+        if (returnCode == EXIT_SUCCESS)
+        {
+            std::cout << "Exported " << (lastFrame - firstFrame + 1) << " frame(s) from " << filePath << std::endl;
+        }
+    } while (false);
+    if (file.p_file != nullptr)
+    {
+        std::fclose(file.p_file);
+    }
+    return returnCode;
+}
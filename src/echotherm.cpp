@@ -29,6 +29,32 @@ namespace
 
   
 
+    // send a command and wait for the daemon's response
+    // the response buffer is larger than the other helpers because statistics replies can be long
+    std::string _sendRequest(int const socketFileDescriptor, std::string const &commandStr)
+    {
+        std::string responseStr;
+        auto const numSent = write(socketFileDescriptor, commandStr.c_str(), commandStr.length());
+        if (numSent < 0)
+        {
+            responseStr = "Error sending request";
+        }
+        else
+        {
+            char p_buffer[4096] = {0};
+            auto const numRead = read(socketFileDescriptor, p_buffer, sizeof(p_buffer) - 1);
+            if (numRead < 0)
+            {
+                responseStr = "Error receiving response";
+            }
+            else
+            {
+                responseStr = std::string(p_buffer);
+            }
+        }
+        return responseStr;
+    }
+
     std::string _getZoom(int const socketFileDescriptor)
     {
         std::string zoomRateStr;
@@ -278,10 +304,173 @@ namespace
             send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
             std::cout << "Sent command to set zoom to " << parameterStr << std::endl;
         }
+        if (vm.count("pan"))
+        {
+            std::string const parameterStr = vm["pan"].as<std::string>();
+            std::string const commandStr = "PAN " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set pan to " << parameterStr << std::endl;
+        }
+        if (vm.count("panRate"))
+        {
+            std::string const parameterStr = vm["panRate"].as<std::string>();
+            std::string const commandStr = "PANRATE " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set pan rate to " << parameterStr << std::endl;
+        }
         if (vm.count("getZoom"))
         {
             std::cout << _getZoom(socketFileDescriptor) << std::endl;
         }
+        if (vm.count("frameStatsAlarm"))
+        {
+            std::string const parameterStr = vm["frameStatsAlarm"].as<std::string>();
+            std::string const commandStr = "FRAMESTATSALARM " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set frame stall alarm threshold to " << parameterStr << std::endl;
+        }
+        if (vm.count("frameStats"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "FRAMESTATS|") << std::endl;
+        }
+        if (vm.count("output"))
+        {
+            for (auto const &parameterStr : vm["output"].as<std::vector<std::string>>())
+            {
+                std::string const commandStr = "OUTPUT " + _sanitizeString(parameterStr) + '|';
+                std::cout << "Sent command to set output : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+            }
+        }
+        if (vm.count("removeOutput"))
+        {
+            std::string const parameterStr = vm["removeOutput"].as<std::string>();
+            std::string const commandStr = "OUTPUT REMOVE " + _sanitizeString(parameterStr) + '|';
+            std::cout << "Sent command to remove output : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("outputs"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "OUTPUTS|") << std::endl;
+        }
+        if (vm.count("colorizer"))
+        {
+            std::string const parameterStr = vm["colorizer"].as<std::string>();
+            std::string const commandStr = "COLORIZER " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set colorizer to " << parameterStr << std::endl;
+        }
+        if (vm.count("colorizerRange"))
+        {
+            std::string const parameterStr = vm["colorizerRange"].as<std::string>();
+            std::string const commandStr = "COLORIZER RANGE " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set colorizer range to " << parameterStr << std::endl;
+        }
+        if (vm.count("denoise"))
+        {
+            std::string const parameterStr = vm["denoise"].as<std::string>();
+            std::string const commandStr = "DENOISE " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set noise reduction to " << parameterStr << std::endl;
+        }
+        if (vm.count("denoiseStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "DENOISE|") << std::endl;
+        }
+        if (vm.count("outputRate"))
+        {
+            std::string const parameterStr = vm["outputRate"].as<std::string>();
+            std::string const commandStr = "OUTPUTRATE " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set output rate to " << parameterStr << std::endl;
+        }
+        if (vm.count("outputRateStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "OUTPUTRATE|") << std::endl;
+        }
+        if (vm.count("outputSize"))
+        {
+            std::string const parameterStr = vm["outputSize"].as<std::string>();
+            std::string const commandStr = "OUTPUTSIZE " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set output geometry to " << parameterStr << std::endl;
+        }
+        if (vm.count("outputSizeStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "OUTPUTSIZE|") << std::endl;
+        }
+        if (vm.count("isotherm"))
+        {
+            std::string const parameterStr = vm["isotherm"].as<std::string>();
+            std::string const commandStr = "ISOTHERM " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set isotherm to " << parameterStr << std::endl;
+        }
+        if (vm.count("isothermStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "ISOTHERM|") << std::endl;
+        }
+        if (vm.count("hotspots"))
+        {
+            std::string const parameterStr = vm["hotspots"].as<std::string>();
+            std::string const commandStr = "HOTSPOTS " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set hotspot detection to " << parameterStr << std::endl;
+        }
+        if (vm.count("hotspotStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "HOTSPOTS|") << std::endl;
+        }
+        if (vm.count("overlay"))
+        {
+            std::string const parameterStr = vm["overlay"].as<std::string>();
+            std::string const commandStr = "OVERLAY " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set overlay to " << parameterStr << std::endl;
+        }
+        if (vm.count("overlayStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "OVERLAY|") << std::endl;
+        }
+        if (vm.count("agc"))
+        {
+            std::string const parameterStr = vm["agc"].as<std::string>();
+            std::string const commandStr = "AGC " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set AGC to " << parameterStr << std::endl;
+        }
+        if (vm.count("agcStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "AGC|") << std::endl;
+        }
+        if (vm.count("colorizerStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "COLORIZER|") << std::endl;
+        }
+        if (vm.count("memoryBudget"))
+        {
+            std::string const parameterStr = vm["memoryBudget"].as<std::string>();
+            std::string const commandStr = "MEMORYBUDGET " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set memory budget to " << parameterStr << " MB" << std::endl;
+        }
+        if (vm.count("memory"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "MEMORY|") << std::endl;
+        }
+        if (vm.count("traceStop"))
+        {
+            std::cout << "Sent command to stop tracing : " << _sendRequest(socketFileDescriptor, "TRACE OFF|") << std::endl;
+        }
+        else if (vm.count("traceStart"))
+        {
+            std::string const parameterStr = vm["traceStart"].as<std::string>();
+            std::string const commandStr = "TRACE ON " + _sanitizeString(parameterStr) + '|';
+            std::cout << "Sent command to start tracing : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("traceStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "TRACE|") << std::endl;
+        }
         if (vm.count("colorPalette"))
         {
             std::string const parameterStr = vm["colorPalette"].as<std::string>();
@@ -330,6 +519,23 @@ namespace
             send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
             std::cout << "Sent command to trigger shutter" << std::endl;
         }
+        if (vm.count("recordingSegments"))
+        {
+            std::string const parameterStr = vm["recordingSegments"].as<std::string>();
+            std::string const commandStr = "RECORDINGSEGMENTS " + parameterStr + '|';
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            std::cout << "Sent command to set recording segments to " << parameterStr << std::endl;
+        }
+        if (vm.count("recordingCodec"))
+        {
+            std::string const parameterStr = vm["recordingCodec"].as<std::string>();
+            std::string const commandStr = "RECORDINGCODEC " + parameterStr + '|';
+            std::cout << "Sent command to set the recording codec to " << parameterStr << " : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("recordingCodecStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "RECORDINGCODEC|") << std::endl;
+        }
         if (vm.count("stopRecording"))
         {
             std::string const commandStr = "STOPRECORDING|";
@@ -341,6 +547,47 @@ namespace
             std::string const parameterStr = vm["startRecording"].as<std::string>();
             std::cout << "Sent command to start recording to " << parameterStr << " : " << _startRecording(socketFileDescriptor, parameterStr) << std::endl;
         }
+        if (vm.count("preRoll"))
+        {
+            std::string const parameterStr = vm["preRoll"].as<std::string>();
+            std::string const commandStr = "PREROLL " + parameterStr + '|';
+            std::cout << "Sent command to set the pre-roll to " << parameterStr << " : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("preRollStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "PREROLL|") << std::endl;
+        }
+        if (vm.count("trigger"))
+        {
+            // [seconds][,filePath], a value that is not a number is a file path
+            std::string const parameterStr = vm["trigger"].as<std::string>();
+            auto const separator = parameterStr.find(',');
+            std::string postRollStr = parameterStr.substr(0, separator);
+            std::string filePathStr = separator == std::string::npos ? std::string() : parameterStr.substr(separator + 1);
+            if (separator == std::string::npos && !postRollStr.empty() && postRollStr.find_first_not_of("0123456789.") != std::string::npos)
+            {
+                std::swap(postRollStr, filePathStr);
+            }
+            std::string commandStr = "TRIGGER";
+            if (!postRollStr.empty())
+            {
+                commandStr += ' ' + postRollStr;
+            }
+            if (!filePathStr.empty())
+            {
+                commandStr += ' ' + _sanitizeString(filePathStr);
+            }
+            commandStr += '|';
+            std::cout << "Sent command to trigger a recording : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("stillEncoderStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "STILLENCODERSTATUS|") << std::endl;
+        }
+        if (vm.count("recordingStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "RECORDINGSTATUS|") << std::endl;
+        }
 
         if (vm.count("takeScreenshot"))
         {
@@ -359,6 +606,82 @@ namespace
             std::cout << "Sent command to capture radiometric data to file: " << parameterStr << std::endl << _takeRadiometricScreenshot(socketFileDescriptor, parameterStr) << std::endl;
         }
 
+        if (vm.count("burst"))
+        {
+            // count[,formats][,directory], a value that is not a list of formats is the directory
+            std::string const parameterStr = vm["burst"].as<std::string>();
+            std::stringstream ss(parameterStr);
+            std::string commandStr = "BURST";
+            std::string valueStr;
+            while (std::getline(ss, valueStr, ','))
+            {
+                commandStr += ' ' + _sanitizeString(valueStr);
+            }
+            commandStr += '|';
+            std::cout << "Sent command to take a burst : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("burstStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "BURST|") << std::endl;
+        }
+
+        if (vm.count("interval"))
+        {
+            // seconds[,LIVE][,formats][,directory] or OFF, a value that is not a list of formats is the directory
+            std::string const parameterStr = vm["interval"].as<std::string>();
+            std::stringstream ss(parameterStr);
+            std::string commandStr = "INTERVAL";
+            std::string valueStr;
+            while (std::getline(ss, valueStr, ','))
+            {
+                commandStr += ' ' + _sanitizeString(valueStr);
+            }
+            commandStr += '|';
+            std::cout << "Sent command to set the interval capture to " << parameterStr << " : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("intervalStatus"))
+        {
+            std::cout << _sendRequest(socketFileDescriptor, "INTERVAL|") << std::endl;
+        }
+
+        if (vm.count("radiometricCompression"))
+        {
+            std::string const parameterStr = vm["radiometricCompression"].as<std::string>();
+            std::string const commandStr = "RADIOMETRICCOMPRESSION " + parameterStr + '|';
+            std::cout << "Sent command to set the radiometric compression to " << parameterStr << " : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+        if (vm.count("stopRadiometricRecording"))
+        {
+            std::cout << "Sent command to stop radiometric recording : " << _sendRequest(socketFileDescriptor, "STOPRADIOMETRICRECORDING|") << std::endl;
+        } // stopRadiometricRecording takes priority like stopRecording
+        else if (vm.count("startRadiometricRecording"))
+        {
+            // [framesPerChunk][,filePath], a value that is not a number is a file path
+            std::string const parameterStr = vm["startRadiometricRecording"].as<std::string>();
+            auto const separator = parameterStr.find(',');
+            std::string framesPerChunkStr = parameterStr.substr(0, separator);
+            std::string filePathStr = separator == std::string::npos ? std::string() : parameterStr.substr(separator + 1);
+            if (separator == std::string::npos && !framesPerChunkStr.empty() && framesPerChunkStr.find_first_not_of("0123456789") != std::string::npos)
+            {
+                std::swap(framesPerChunkStr, filePathStr);
+            }
+            std::string commandStr = "STARTRADIOMETRICRECORDING";
+            if (vm.count("radiometricDirectIO"))
+            {
+                commandStr += " DIRECT";
+            }
+            if (!framesPerChunkStr.empty())
+            {
+                commandStr += ' ' + framesPerChunkStr;
+            }
+            if (!filePathStr.empty())
+            {
+                commandStr += ' ' + _sanitizeString(filePathStr);
+            }
+            commandStr += '|';
+            std::cout << "Sent command to start radiometric recording : " << _sendRequest(socketFileDescriptor, commandStr) << std::endl;
+        }
+
         if (vm.count("setRadiometricFrameFormat"))
         {
             std::string const parameterStr = vm["setRadiometricFrameFormat"].as<std::string>();
@@ -366,6 +689,19 @@ namespace
             send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);    
             std::cout << "Sent command to change set radiometric format " << parameterStr << std::endl;
         }
+        // last, it does not return until the daemon closes the connection or the program is interrupted
+        if (vm.count("watchHotspots"))
+        {
+            std::string const commandStr = "HOTSPOTS SUBSCRIBE|";
+            send(socketFileDescriptor, commandStr.c_str(), commandStr.length(), 0);
+            char p_buffer[4096];
+            ssize_t numRead = 0;
+            while ((numRead = read(socketFileDescriptor, p_buffer, sizeof(p_buffer))) > 0)
+            {
+                std::cout.write(p_buffer, numRead);
+                std::cout.flush();
+            }
+        }
     }
 }
 
@@ -381,14 +717,51 @@ int main(int argc, char *argv[])
         desc.add_options()("status", "Get the status of the camera");
         desc.add_options()("startRecording", 
                             boost::program_options::value<std::string>()->implicit_value(""),
-                           "Begin recording to a specified file (currently only .mp4)");
+                           "Begin recording to a specified file (.mp4, .avi or .mkv)");
         desc.add_options()("stopRecording", "Stop recording to a file");
+        desc.add_options()("recordingSegments", boost::program_options::value<std::string>(),
+                           "Split the next recordings into files of at most seconds and/or MB (name_001.mp4, ...)\n"
+                           "seconds[,MB] (0 = no limit), OFF = a single file");
+        desc.add_options()("recordingCodec", boost::program_options::value<std::string>(),
+                           "Codec of the next recordings and encoder threads (0 = encoder default)\n"
+                           "codec[,threads] = MP4V, MJPG (.avi), FFV1 (.mkv, lossless) or H264\n"
+                           "AUTO = from the file extension (default)");
+        desc.add_options()("recordingCodecStatus", "Get a string indicating the recording codec and the available codecs");
+        desc.add_options()("preRoll", boost::program_options::value<std::string>(),
+                           "Keep the last seconds of output frames in memory, recordings start with them\n"
+                           "seconds[,MB] (MB = memory limit, 0 = none), OFF = disabled");
+        desc.add_options()("preRollStatus", "Get a string indicating the pre-roll, the frames held and their memory");
+        desc.add_options()("trigger",
+                            boost::program_options::value<std::string>()->implicit_value(""),
+                           "Record the pre-roll and the next seconds (default 10) to a file, then finish it\n"
+                           "[seconds][,filePath] (name optional) else defaults to Event_[UTC].mp4");
+        desc.add_options()("recordingStatus", "Get a string indicating the recording segments with their boundaries and write throughput");
+        desc.add_options()("stillEncoderStatus", "Get a string indicating the screenshot and burst encoder threads and the wait and run times of their jobs");
         desc.add_options()("takeScreenshot", 
                             boost::program_options::value<std::string>()->implicit_value(""),
                            "Save a screenshot of the current frame to a file");
         desc.add_options()("takeRadiometricScreenshot",
                             boost::program_options::value<std::string>()->implicit_value(""),
                             "Save radiometric data to a file (name optional) else defaults to Radiometric_[UTC].csv)");
+        desc.add_options()("startRadiometricRecording",
+                            boost::program_options::value<std::string>()->implicit_value(""),
+                           "Record every thermography frame losslessly with its frame header, read it with echotherm-extract\n"
+                           "[framesPerChunk][,filePath] (default 16 frames per write) else defaults to RadiometricVideo_[UTC].etr");
+        desc.add_options()("burst", boost::program_options::value<std::string>(),
+                           "Capture consecutive frames at the full rate, then write them in parallel, reports fpa frame gaps\n"
+                           "count[,formats][,directory] (at most 270) formats = png, jpeg, tiff.. and/or csv, etr joined by +\n"
+                           "(default png+etr), directory defaults to Burst_[UTC]");
+        desc.add_options()("burstStatus", "Get a string indicating the running burst or the frames, fpa frame gaps and write times of the last one");
+        desc.add_options()("interval", boost::program_options::value<std::string>(),
+                           "Time-lapse: capture the frame closest to every tick into hourly directories with a manifest.csv\n"
+                           "seconds[,LIVE][,formats][,directory] (at least 1 s) formats as --burst (default jpeg+etr),\n"
+                           "LIVE keeps the full output rate between captures, directory defaults to Interval_[UTC], OFF stops it");
+        desc.add_options()("intervalStatus", "Get a string indicating the interval capture, its missed ticks, write times and daemon CPU usage");
+        desc.add_options()("radiometricCompression", boost::program_options::value<std::string>(),
+                           "Compress the next radiometric recordings and .etr radiometric screenshots losslessly\n"
+                           "ON[,threads] (0 = half the cores), OFF = uncompressed");
+        desc.add_options()("radiometricDirectIO", "With --startRadiometricRecording, write the file with O_DIRECT, bypassing the page cache");
+        desc.add_options()("stopRadiometricRecording", "Finish the radiometric recording");
         desc.add_options()("setRadiometricFrameFormat",
                             boost::program_options::value<std::string>(),
                             "Set radiometric data format\n"
@@ -403,7 +776,80 @@ int main(int argc, char *argv[])
                            "Instantly set the current zoom (a floating point number)");
         desc.add_options()("maxZoom", boost::program_options::value<std::string>(),
                            "Set the maximum zoom (a floating point number)");
-        desc.add_options()("getZoom", "Get a string indicating current zoom parameters");
+        desc.add_options()("pan", boost::program_options::value<std::string>(),
+                           "Center the zoomed view on a sensor pixel, x,y (floating point numbers)\n"
+                           "CENTER = center the zoomed view on the sensor");
+        desc.add_options()("panRate", boost::program_options::value<std::string>(),
+                           "Move the zoomed view at x,y displayed pixels per second\n"
+                           "0,0 = stopped");
+        desc.add_options()("getZoom", "Get a string indicating current zoom and pan parameters");
+        desc.add_options()("frameStats", "Get frame timing statistics (interval jitter, missed frames, latency, processing time)");
+        desc.add_options()("frameStatsAlarm", boost::program_options::value<std::string>(),
+                           "Set the frame stall alarm threshold in milliseconds between frames\n"
+                           "zero or negative = disabled");
+        desc.add_options()("output", boost::program_options::value<std::vector<std::string>>()->composing(),
+                           "Add or replace a loopback output fed from the same capture session (may be repeated)\n"
+                           "name:device=/dev/videoN[,format=ARGB|GREY][,palette=SDK|0-8]\n"
+                           "[,min=C,max=C][,zoom=Z][,panx=X,pany=Y][,decimate=N][,rate=Hz]");
+        desc.add_options()("removeOutput", boost::program_options::value<std::string>(),
+                           "Remove a loopback output by name");
+        desc.add_options()("outputs", "Get a string indicating the additional outputs with their CPU time and latency");
+        desc.add_options()("colorizer", boost::program_options::value<std::string>(),
+                           "Choose where the thermography frame is colorized\n"
+                           "ON  = in echothermd (FIXED_10_6 frame + palette lookup)\n"
+                           "OFF = in the camera SDK (default)");
+        desc.add_options()("colorizerRange", boost::program_options::value<std::string>(),
+                           "Set the echothermd colorizer AGC span\n"
+                           "AUTO    = follow the scene minimum and maximum (default)\n"
+                           "min,max = fixed span in degrees C");
+        desc.add_options()("overlay", boost::program_options::value<std::string>(),
+                           "Burn crosshairs and temperatures of the min, max and spot pixels (and hotspot boxes) into the output\n"
+                           "ON = all, \"ON max,spot,hotspots\" = selected items, OFF = disabled");
+        desc.add_options()("denoise", boost::program_options::value<std::string>(),
+                           "Set the temporal noise reduction of the output (before the zoom)\n"
+                           "strength 0-0.94 = fraction of the history kept in static areas, OFF = disabled");
+        desc.add_options()("denoiseStatus", "Get a string indicating the noise reduction strength and cost");
+        desc.add_options()("outputRate", boost::program_options::value<std::string>(),
+                           "Set the frame rate of the loopback output and of the recordings\n"
+                           "rate=Hz[,decimate=N] = one frame out of N, then at most Hz from the capture timestamps\n"
+                           "OFF = every frame");
+        desc.add_options()("outputRateStatus", "Get a string indicating the output rate and the kept and dropped frames");
+        desc.add_options()("outputSize", boost::program_options::value<std::string>(),
+                           "Set the geometry of the loopback output and of the recordings (quote the value)\n"
+                           "\"WxH [NEAREST|LINEAR|CUBIC]\" = scale to W x H keeping the aspect ratio (default LINEAR)\n"
+                           "SENSOR = sensor geometry");
+        desc.add_options()("outputSizeStatus", "Get a string indicating the sensor and output geometry");
+        desc.add_options()("isotherm", boost::program_options::value<std::string>(),
+                           "Highlight temperature bands in the output (quote the value)\n"
+                           "\"min:max:color[:opacity] ...\" = up to 8 bands in degrees C, the first match wins\n"
+                           "color = red, green, blue, yellow, cyan, magenta, orange, white, black or RRGGBB\n"
+                           "OFF = remove the bands");
+        desc.add_options()("isothermStatus", "Get a string indicating the isotherm bands, highlighted pixels and cost");
+        desc.add_options()("hotspots", boost::program_options::value<std::string>(),
+                           "Detect and track hot objects in the thermography frame (quote the value)\n"
+                           "\"ON threshold[,minArea]\" = above threshold degrees C, at least minArea pixels (default 4)\n"
+                           "OFF = stop the detection");
+        desc.add_options()("hotspotStatus", "Get a string indicating the hotspot detection state, current hotspots and analysis cost");
+        desc.add_options()("watchHotspots", "Print the hotspot events pushed by echothermd until interrupted");
+        desc.add_options()("overlayStatus", "Get a string indicating the overlay items and drawing cost");
+        desc.add_options()("agc", boost::program_options::value<std::string>(),
+                           "Set the AGC of the echothermd colorizer (quote the value)\n"
+                           "LINEAR              = range follows the scene (default)\n"
+                           "LINEAR min,max      = range locked in degrees C\n"
+                           "LOCK                = lock the range currently in use\n"
+                           "HISTEQ [plateau]    = histogram equalization, plateau 0-1\n"
+                           "WINDOW center,width = fixed temperature window in degrees C");
+        desc.add_options()("agcStatus", "Get a string indicating the AGC mode, range and cost");
+        desc.add_options()("colorizerStatus", "Get a string indicating the echothermd colorizer state");
+        desc.add_options()("memory", "Get current and peak memory usage of frame queues and buffers");
+        desc.add_options()("memoryBudget", boost::program_options::value<std::string>(),
+                           "Set the memory budget in MB for frame queues and buffers\n"
+                           "zero = unlimited");
+        desc.add_options()("traceStart",
+                           boost::program_options::value<std::string>()->implicit_value(""),
+                           "Start tracing to a Chrome trace event file (name optional) else defaults to Trace_[UTC].json");
+        desc.add_options()("traceStop", "Stop tracing and finish the trace file");
+        desc.add_options()("traceStatus", "Get a string indicating the current trace status");
         desc.add_options()("colorPalette", boost::program_options::value<std::string>(),
                            "Choose the color palette\n"
                            "COLOR_PALETTE_WHITE_HOT =  0\n"
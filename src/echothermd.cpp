@@ -6,12 +6,18 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+#include <cmath>
 #include <csignal>
+#include <cstdio>
 #include <cstring>
 #include <charconv>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <regex>
 #include <filesystem>
+#include <mutex>
 #include <signal.h>
 
 #include <boost/program_options.hpp>
@@ -19,6 +25,11 @@
 #include <boost/lexical_cast.hpp>
 
 #include "EchoThermCamera.h"
+#include "Trace.h"
+#include "AsyncLog.h"
+#include "MemoryBudget.h"
+#include "Benchmark.h"
+#include "VideoEncoder.h"
 
 namespace
 {
@@ -34,8 +45,39 @@ namespace
     static auto n_defaultFlatSceneFilterMode = 0; // DISABLED
     static auto n_defaultPipelineMode = 2;        // PIPELINE_PROCESSED
     static auto n_defaultMaxZoom = 16.0;
+    static auto n_defaultFrameStatsAlarm = 100.0; // milliseconds between frames
+    static std::string n_defaultTraceFilePath;        // empty = tracing disabled
+    static auto n_defaultColorizer = false;           // colorize in the SDK
+    static auto n_defaultAgcPlateau = 0.01;           // fraction of the pixels in one histogram bin
+    static auto n_defaultOverlay = 0;                 // Overlay::None
+    static auto n_defaultDenoise = 0.0;               // temporal noise reduction strength, 0 = disabled
+    static auto n_defaultOutputWidth = 0;             // 0 = sensor geometry
+    static auto n_defaultOutputHeight = 0;
+    static auto n_defaultOutputInterpolation = 1;     // cv::INTER_LINEAR
+    static auto n_defaultOutputRate = 0.0;            // Hz, 0 = every frame
+    static std::vector<Isotherm::Band> n_defaultIsothermBands; // empty = no isotherm
+    static auto n_defaultOutputDecimation = 1;
+    static auto n_defaultSegmentSeconds = 0.0;        // recording segment duration, 0 = no limit
+    static auto n_defaultSegmentMegabytes = 0.0;      // recording segment size, 0 = no limit
+    static auto n_defaultPreRollSeconds = 0.0;        // frames kept in memory for the next recording, 0 = disabled
+    static auto n_defaultPreRollMegabytes = 0.0;      // memory of the pre-roll, 0 = no limit
+    static std::string n_defaultRecordingCodec("AUTO"); // codec of the recordings, AUTO = from the file extension
+    static auto n_defaultRecordingThreads = 0;        // encoder threads, 0 = encoder default
+    static auto n_defaultRadiometricCompression = false; // radiometric files compressed losslessly
+    static auto n_defaultRadiometricCompressionThreads = 0; // compression threads, 0 = half the cores
+    static std::string n_defaultAgcCommand;           // AGC command applied when the camera is created
+    static std::vector<std::string> n_defaultOutputs; // additional loopback output profiles
+    static auto n_defaultHotspotThreshold = std::numeric_limits<double>::quiet_NaN(); // degrees C, NaN = detection off
+    static auto n_defaultHotspotMinArea = 4;          // pixels
 
     constexpr static inline auto const n_bufferSize = 1024;
+    constexpr static inline auto const n_defaultPostRollSeconds = 10.0;
+    // frames written at once by the radiometric recording, about half a second at 27 fps
+    constexpr static inline auto const n_defaultRadiometricFramesPerChunk = 16;
+    // a burst without formats writes lossless images and radiometric files
+    constexpr static inline auto const np_defaultBurstFormats = "png+etr";
+    // an interval capture without formats writes compact images and radiometric files
+    constexpr static inline auto const np_defaultIntervalFormats = "jpeg+etr";
     constexpr static inline auto const np_lockFile = "/tmp/echothermd.lock";
     constexpr static inline auto const np_logName = "echothermd";
     constexpr static inline auto const n_port = 9182;
@@ -57,6 +99,57 @@ namespace
 
     std::unique_ptr<EchoThermCamera> np_camera;
 
+    // clients that asked for hotspot events, written from the hotspot detector thread
+    std::mutex n_hotspotSubscribersMut;
+    std::vector<int> n_hotspotSubscribers;
+
+    void _publishHotspotEvent(std::string const &event)
+    {
+        std::lock_guard<decltype(n_hotspotSubscribersMut)> lock{n_hotspotSubscribersMut};
+        for (auto it = std::begin(n_hotspotSubscribers); it != std::end(n_hotspotSubscribers);)
+        {
+            // never block the detector on a slow client, a full socket buffer only drops this event
+            if (send(*it, event.c_str(), event.length(), MSG_NOSIGNAL | MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                AsyncLog::log(LOG_NOTICE, "Hotspot subscriber %d removed: %m", *it);
+                it = n_hotspotSubscribers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void _unsubscribeHotspots(int clientFileDescriptor)
+    {
+        std::lock_guard<decltype(n_hotspotSubscribersMut)> lock{n_hotspotSubscribersMut};
+        n_hotspotSubscribers.erase(std::remove(std::begin(n_hotspotSubscribers), std::end(n_hotspotSubscribers), clientFileDescriptor),
+                                   std::end(n_hotspotSubscribers));
+    }
+
+    // open client connections, each is charged n_bufferSize of ConnectionBuffers, used by the epoll loop only
+    std::vector<int> n_clientFileDescriptors;
+
+    void _openClient(int clientFileDescriptor)
+    {
+        n_clientFileDescriptors.push_back(clientFileDescriptor);
+        MemoryBudget::acquire(MemoryBudget::Category::ConnectionBuffers, n_bufferSize);
+    }
+
+    void _closeClient(int clientFileDescriptor)
+    {
+        auto const it = std::find(std::begin(n_clientFileDescriptors), std::end(n_clientFileDescriptors), clientFileDescriptor);
+        if (it == std::end(n_clientFileDescriptors))
+        {
+            return;
+        }
+        n_clientFileDescriptors.erase(it);
+        _unsubscribeHotspots(clientFileDescriptor);
+        close(clientFileDescriptor);
+        MemoryBudget::release(MemoryBudget::Category::ConnectionBuffers, n_bufferSize);
+    }
+
     std::string _desanitizeString(std::string const &input)
     {
         std::string output = input;
@@ -126,6 +219,33 @@ namespace
         //return ec;
     }
 
+    // image and/or radiometric formats joined by +, e.g. png+etr, to file extensions
+    // return false when a format is unknown
+    bool _parseStillFormats(std::string const &formats, std::string *p_imageExtension, std::string *p_radiometricExtension)
+    {
+        p_imageExtension->clear();
+        p_radiometricExtension->clear();
+        std::stringstream ss(formats);
+        std::string format;
+        while (std::getline(ss, format, '+'))
+        {
+            boost::to_lower(format);
+            if (format == "csv" || format == "etr")
+            {
+                *p_radiometricExtension = "." + format;
+            }
+            else if (format == "jpeg" || format == "jpg" || format == "png" || format == "tiff" || format == "tif" || format == "bmp" || format == "webp")
+            {
+                *p_imageExtension = "." + format;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     void _handleSignal(int signal)
     {
         syslog(LOG_NOTICE, "Received signal(%d) ", signal);
@@ -286,8 +406,24 @@ namespace
         return 0;
     }
 
-    std::string _parseCommand(char const *const p_command)
+    std::filesystem::path _getDefaultTraceFilePath()
+    {
+        std::filesystem::path filePath;
+        if (const char *home = std::getenv("HOME"); home)
+        {
+            auto now = std::chrono::system_clock::now();
+            auto utc_time = std::chrono::system_clock::to_time_t(now);
+            std::stringstream ss;
+            ss << "Trace_" << std::put_time(std::gmtime(&utc_time), "%Y_%m_%d_%H_%M_%S") << ".json";
+            filePath = std::filesystem::path(home) / ss.str();
+        }
+        return filePath;
+    }
+
+    // clientFileDescriptor is the connection the command came from, -1 for startup parameters
+    std::string _parseCommand(char const *const p_command, int const clientFileDescriptor = -1)
     {
+        TRACE_SCOPE("echothermd::_parseCommand");
         // Tokenize the command string
         std::string response = "";
         if (auto const *p_token = strtok(const_cast<char *>(p_command), " "); p_token)
@@ -394,14 +530,686 @@ namespace
                     }
                 }
             }
-            else if (strcmp(p_token, "GETZOOM") == 0)
+            else if (strcmp(p_token, "PAN") == 0)
+            {
+                // PAN x,y    -> center the zoomed view on sensor pixel x,y (subpixel)
+                // PAN CENTER -> center the zoomed view on the sensor
+                if ((p_token = strtok(nullptr, " ,")) == nullptr)
+                {
+                    syslog(LOG_ERR, "PAN command received, but no position was provided.");
+                }
+                else if (strcasecmp(p_token, "CENTER") == 0)
+                {
+                    if( np_camera ){
+                        syslog(LOG_NOTICE, "PAN CENTER");
+                        np_camera->centerPan();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to set pan: camera object does not exist");
+                    }
+                }
+                else
+                {
+                    char const *const p_xToken = p_token;
+                    double x = 0.0;
+                    double y = 0.0;
+                    if ((p_token = strtok(nullptr, " ,")) == nullptr)
+                    {
+                        syslog(LOG_ERR, "PAN command received, but no y position was provided.");
+                    }
+                    else if (_parseDouble(p_xToken, &x) != std::errc() || _parseDouble(p_token, &y) != std::errc())
+                    {
+                        syslog(LOG_ERR, "PAN cannot be set to %s,%s because it is not a number.", p_xToken, p_token);
+                    }
+                    else
+                    {
+                        if( np_camera ){
+                            syslog(LOG_NOTICE, "set PAN: %f,%f", x, y);
+                            np_camera->setPan(x, y);
+                        }
+                        else{
+                            syslog(LOG_ERR, "Unable to set pan: camera object does not exist");
+                        }
+                    }
+                }
+            }
+            else if (strcmp(p_token, "PANRATE") == 0)
+            {
+                // PANRATE x,y -> move the zoomed view at x,y displayed pixels per second
+                char const *const p_xToken = strtok(nullptr, " ,");
+                if (p_xToken == nullptr || (p_token = strtok(nullptr, " ,")) == nullptr)
+                {
+                    syslog(LOG_ERR, "PANRATE command received, but no x,y rate was provided.");
+                }
+                else
+                {
+                    double xRate = 0.0;
+                    double yRate = 0.0;
+                    if (_parseDouble(p_xToken, &xRate) != std::errc() || _parseDouble(p_token, &yRate) != std::errc())
+                    {
+                        syslog(LOG_ERR, "PANRATE cannot be set to %s,%s because it is not a number.", p_xToken, p_token);
+                    }
+                    else
+                    {
+                        if( np_camera ){
+                            syslog(LOG_NOTICE, "set PANRATE: %f,%f", xRate, yRate);
+                            np_camera->setPanRate(xRate, yRate);
+                        }
+                        else{
+                            syslog(LOG_ERR, "Unable to set pan rate: camera object does not exist");
+                        }
+                    }
+                }
+            }
+            else if (strcmp(p_token, "GETZOOM") == 0)
+            {
+                if( np_camera ){
+                    syslog(LOG_NOTICE, "GETZOOM");
+                    response = np_camera->getZoom();
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to get zoom: camera object does not exist");
+                }
+            }
+            else if (strcmp(p_token, "FRAMESTATS") == 0)
+            {
+                if( np_camera ){
+                    syslog(LOG_NOTICE, "FRAMESTATS");
+                    response = np_camera->getFrameStats();
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to get frame statistics: camera object does not exist");
+                }
+            }
+            else if (strcmp(p_token, "FRAMESTATSALARM") == 0)
+            {
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    syslog(LOG_ERR, "FRAMESTATSALARM command received, but no number was provided.");
+                }
+                else
+                {
+                    double number = 0.0;
+                    auto errorCode = _parseDouble(p_token, &number);
+                    if (errorCode == std::errc::invalid_argument)
+                    {
+                        syslog(LOG_ERR, "FRAMESTATSALARM cannot be set to %s because it is not a number.", p_token);
+                    }
+                    else if (errorCode == std::errc::result_out_of_range)
+                    {
+                        syslog(LOG_ERR, "FRAMESTATSALARM cannot be set to %s because it is out of range.", p_token);
+                    }
+                    else
+                    {
+                        if( np_camera ){
+                            syslog(LOG_NOTICE, "set FRAMESTATSALARM: %f", number);
+                            np_camera->setFrameStatsAlarm(number);
+                        }
+                        else{
+                            syslog(LOG_INFO, "Set default frameStatsAlarm: %.2f" , number);
+                            n_defaultFrameStatsAlarm = number;
+                        }
+                    }
+                }
+            }
+            else if (strcmp(p_token, "COLORIZER") == 0)
+            {
+                // COLORIZER                  -> report the colorizer state
+                // COLORIZER ON|OFF           -> colorize in echothermd or in the SDK
+                // COLORIZER RANGE AUTO       -> same as AGC LINEAR
+                // COLORIZER RANGE min,max    -> same as AGC LINEAR min,max
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getColorizerStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get colorizer status: camera object does not exist");
+                    }
+                }
+                else if (strcasecmp(p_token, "ON") == 0 || strcasecmp(p_token, "OFF") == 0)
+                {
+                    bool const enabled = strcasecmp(p_token, "ON") == 0;
+                    if( np_camera ){
+                        syslog(LOG_NOTICE, "COLORIZER %s", p_token);
+                        np_camera->setColorizer(enabled);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default colorizer: %s", p_token);
+                        n_defaultColorizer = enabled;
+                    }
+                }
+                else if (strcasecmp(p_token, "RANGE") == 0)
+                {
+                    char const *const p_minToken = strtok(nullptr, " ,");
+                    double minTemperature = 0.0;
+                    double maxTemperature = 0.0;
+                    if (p_minToken == nullptr)
+                    {
+                        syslog(LOG_ERR, "COLORIZER RANGE command received, but no range was provided.");
+                    }
+                    else if (!np_camera)
+                    {
+                        syslog(LOG_ERR, "Unable to set colorizer range: camera object does not exist");
+                    }
+                    else if (strcasecmp(p_minToken, "AUTO") == 0)
+                    {
+                        syslog(LOG_NOTICE, "COLORIZER RANGE AUTO");
+                        np_camera->setAgcLinear();
+                    }
+                    else if ((p_token = strtok(nullptr, " ,")) == nullptr ||
+                             _parseDouble(p_minToken, &minTemperature) != std::errc() || _parseDouble(p_token, &maxTemperature) != std::errc())
+                    {
+                        syslog(LOG_ERR, "COLORIZER RANGE must be AUTO or min,max in degrees C.");
+                    }
+                    else
+                    {
+                        syslog(LOG_NOTICE, "COLORIZER RANGE %f,%f", minTemperature, maxTemperature);
+                        np_camera->setAgcLinear(minTemperature, maxTemperature);
+                    }
+                }
+                else
+                {
+                    syslog(LOG_ERR, "COLORIZER command received with unknown argument %s.", p_token);
+                }
+            }
+            else if (strcmp(p_token, "MEMORY") == 0)
+            {
+                syslog(LOG_NOTICE, "MEMORY");
+                response = MemoryBudget::getStatus();
+            }
+            else if (strcmp(p_token, "MEMORYBUDGET") == 0)
+            {
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    syslog(LOG_ERR, "MEMORYBUDGET command received, but no number was provided.");
+                }
+                else
+                {
+                    double number = 0.0;
+                    auto errorCode = _parseDouble(p_token, &number);
+                    if (errorCode == std::errc::invalid_argument)
+                    {
+                        syslog(LOG_ERR, "MEMORYBUDGET cannot be set to %s because it is not a number.", p_token);
+                    }
+                    else if (errorCode == std::errc::result_out_of_range || number < 0)
+                    {
+                        syslog(LOG_ERR, "MEMORYBUDGET cannot be set to %s because it is out of range.", p_token);
+                    }
+                    else
+                    {
+                        // the budget is process wide, it can be set before or after the camera exists
+                        syslog(LOG_NOTICE, "set MEMORYBUDGET: %.1f MB", number);
+                        MemoryBudget::setBudget(size_t(number * 1024.0 * 1024.0));
+                    }
+                }
+            }
+            else if (strcmp(p_token, "TRACE") == 0)
+            {
+                // TRACE            -> report the trace status
+                // TRACE ON [path]  -> start tracing, default path is $HOME/Trace_[UTC].json
+                // TRACE OFF        -> stop tracing and finish the trace file
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    response = Trace::getStatus();
+                }
+                else if (strcasecmp(p_token, "ON") == 0)
+                {
+                    std::filesystem::path filePath;
+                    if ((p_token = strtok(nullptr, " ")) == nullptr)
+                    {
+                        filePath = _getDefaultTraceFilePath();
+                    }
+                    else
+                    {
+                        filePath = _desanitizeString(p_token);
+                    }
+                    if (filePath.empty())
+                    {
+                        response = "Unable to start tracing: no file path was specified and HOME is not set";
+                        syslog(LOG_ERR, "%s", response.c_str());
+                    }
+                    else if( np_camera ){
+                        syslog(LOG_NOTICE, "TRACE ON: %s", filePath.string().c_str());
+                        response = Trace::start(filePath);
+                    }
+                    else{
+                        // the trace thread can't be started before the daemon forks, so start it with the camera
+                        syslog(LOG_INFO, "Set default trace file: %s", filePath.string().c_str());
+                        n_defaultTraceFilePath = filePath.string();
+                    }
+                }
+                else if (strcasecmp(p_token, "OFF") == 0)
+                {
+                    syslog(LOG_NOTICE, "TRACE OFF");
+                    response = Trace::stop();
+                }
+                else
+                {
+                    syslog(LOG_ERR, "TRACE command received with unknown argument %s.", p_token);
+                }
+            }
+            else if (strcmp(p_token, "AGC") == 0)
+            {
+                // AGC                        -> report the AGC state
+                // AGC LINEAR                 -> the range follows the scene
+                // AGC LINEAR min,max         -> the range is locked at temperatures in degrees C
+                // AGC LOCK                   -> lock the range currently in use
+                // AGC HISTEQ [plateau]       -> histogram equalization, plateau 0-1 (default 0.01)
+                // AGC WINDOW center,width    -> fixed temperature window in degrees C
+                // the AGC is used while echothermd colorizes (COLORIZER ON)
+                char const *const p_mode = strtok(nullptr, " ,");
+                char const *const p_first = p_mode ? strtok(nullptr, " ,") : nullptr;
+                char const *const p_second = p_first ? strtok(nullptr, " ,") : nullptr;
+                double first = 0.0;
+                double second = 0.0;
+                bool const hasFirst = p_first && _parseDouble(p_first, &first) == std::errc();
+                bool const hasSecond = p_second && _parseDouble(p_second, &second) == std::errc();
+                if (p_mode == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getAgcStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get AGC status: camera object does not exist");
+                    }
+                }
+                else if ((p_first && !hasFirst) || (p_second && !hasSecond))
+                {
+                    syslog(LOG_ERR, "AGC %s command received with invalid numbers.", p_mode);
+                }
+                else if (!np_camera)
+                {
+                    std::stringstream ss;
+                    ss << "AGC " << p_mode;
+                    if (hasFirst)
+                    {
+                        ss << " " << first << (hasSecond ? "," + std::to_string(second) : "");
+                    }
+                    n_defaultAgcCommand = ss.str();
+                    syslog(LOG_INFO, "Set default AGC: %s", n_defaultAgcCommand.c_str());
+                }
+                else if (strcasecmp(p_mode, "LINEAR") == 0 && !hasFirst)
+                {
+                    syslog(LOG_NOTICE, "AGC LINEAR");
+                    np_camera->setAgcLinear();
+                }
+                else if (strcasecmp(p_mode, "LINEAR") == 0 && hasSecond)
+                {
+                    syslog(LOG_NOTICE, "AGC LINEAR %f,%f", first, second);
+                    np_camera->setAgcLinear(first, second);
+                }
+                else if (strcasecmp(p_mode, "LOCK") == 0)
+                {
+                    syslog(LOG_NOTICE, "AGC LOCK");
+                    np_camera->lockAgc();
+                }
+                else if (strcasecmp(p_mode, "HISTEQ") == 0)
+                {
+                    syslog(LOG_NOTICE, "AGC HISTEQ %f", hasFirst ? first : n_defaultAgcPlateau);
+                    np_camera->setAgcHistEq(hasFirst ? first : n_defaultAgcPlateau);
+                }
+                else if (strcasecmp(p_mode, "WINDOW") == 0 && hasSecond)
+                {
+                    syslog(LOG_NOTICE, "AGC WINDOW %f,%f", first, second);
+                    np_camera->setAgcWindow(first, second);
+                }
+                else
+                {
+                    syslog(LOG_ERR, "AGC command must be LINEAR [min,max], LOCK, HISTEQ [plateau] or WINDOW center,width.");
+                }
+            }
+            else if (strcmp(p_token, "DENOISE") == 0)
+            {
+                // DENOISE            -> report the noise reduction state
+                // DENOISE strength   -> fraction of the history kept in static areas (0-0.94)
+                // DENOISE OFF        -> disable the noise reduction
+                double strength = 0.0;
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getDenoiseStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get noise reduction status: camera object does not exist");
+                    }
+                }
+                else if (strcasecmp(p_token, "OFF") != 0 && (_parseDouble(p_token, &strength) != std::errc{} || strength < 0.0))
+                {
+                    syslog(LOG_ERR, "DENOISE command received with invalid strength %s.", p_token);
+                }
+                else if( np_camera ){
+                    np_camera->setDenoise(strength);
+                }
+                else{
+                    syslog(LOG_INFO, "Set default noise reduction strength: %f", strength);
+                    n_defaultDenoise = strength;
+                }
+            }
+            else if (strcmp(p_token, "OUTPUTRATE") == 0)
+            {
+                // OUTPUTRATE                           -> report the output rate and the kept and dropped frames
+                // OUTPUTRATE [rate=Hz][,decimate=N]    -> write one frame out of N, then at most Hz (primary output and recordings)
+                // OUTPUTRATE OFF                       -> write every frame
+                double rate = 0.0;
+                int decimation = 1;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ,")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getOutputRate();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get output rate: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "OFF") != 0)
+                {
+                    for (; p_token != nullptr && valid; p_token = strtok(nullptr, " ,"))
+                    {
+                        double number = 0.0;
+                        if (strncmp(p_token, "rate=", 5) == 0 && _parseDouble(p_token + 5, &number) == std::errc{} && number > 0.0)
+                        {
+                            rate = number;
+                        }
+                        else if (strncmp(p_token, "decimate=", 9) == 0 && _parseDouble(p_token + 9, &number) == std::errc{} && number >= 1.0 && number <= 1000.0)
+                        {
+                            decimation = int(number);
+                        }
+                        else
+                        {
+                            syslog(LOG_ERR, "OUTPUTRATE expects rate=Hz and/or decimate=N (1-1000), not %s.", p_token);
+                            valid = false;
+                        }
+                    }
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        syslog(LOG_NOTICE, "%s", np_camera->setOutputRate(rate, decimation).c_str());
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default output rate: %f Hz, decimation %d", rate, decimation);
+                        n_defaultOutputRate = rate;
+                        n_defaultOutputDecimation = decimation;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "OUTPUTSIZE") == 0)
+            {
+                // OUTPUTSIZE                                   -> report the sensor and output geometry
+                // OUTPUTSIZE WxH|SENSOR [NEAREST|LINEAR|CUBIC] -> scale the output (and recordings), default LINEAR
+                int width = 0;
+                int height = 0;
+                int interpolation = 1;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getOutputGeometry();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get output geometry: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "SENSOR") != 0 && (sscanf(p_token, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0))
+                {
+                    syslog(LOG_ERR, "OUTPUTSIZE command received with invalid geometry %s.", p_token);
+                    valid = false;
+                }
+                else if ((p_token = strtok(nullptr, " ")) != nullptr)
+                {
+                    if (strcasecmp(p_token, "NEAREST") == 0)
+                    {
+                        interpolation = 0;
+                    }
+                    else if (strcasecmp(p_token, "CUBIC") == 0)
+                    {
+                        interpolation = 2;
+                    }
+                    else if (strcasecmp(p_token, "LINEAR") != 0)
+                    {
+                        syslog(LOG_ERR, "OUTPUTSIZE interpolation must be NEAREST, LINEAR or CUBIC, not %s.", p_token);
+                        valid = false;
+                    }
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        syslog(LOG_NOTICE, "%s", np_camera->setOutputGeometry(width, height, interpolation).c_str());
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default output geometry: %dx%d, interpolation %d", width, height, interpolation);
+                        n_defaultOutputWidth = width;
+                        n_defaultOutputHeight = height;
+                        n_defaultOutputInterpolation = interpolation;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "ISOTHERM") == 0)
+            {
+                // ISOTHERM                              -> report the bands, highlighted pixels and cost
+                // ISOTHERM min:max:color[:opacity] ...  -> highlight up to 8 temperature bands, the first match wins
+                // ISOTHERM OFF                          -> remove the bands
+                std::vector<Isotherm::Band> bands;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getIsothermStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get isotherm status: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "OFF") != 0)
+                {
+                    for (; p_token != nullptr && valid; p_token = strtok(nullptr, " "))
+                    {
+                        Isotherm::Band band;
+                        if (auto const error = Isotherm::parseBand(p_token, &band); !error.empty())
+                        {
+                            syslog(LOG_ERR, "ISOTHERM: %s.", error.c_str());
+                            valid = false;
+                        }
+                        else if (bands.size() == Isotherm::n_maxBands)
+                        {
+                            syslog(LOG_ERR, "ISOTHERM accepts at most %zu bands.", Isotherm::n_maxBands);
+                            valid = false;
+                        }
+                        else
+                        {
+                            bands.push_back(band);
+                        }
+                    }
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        np_camera->setIsotherm(bands);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default isotherm: %zu bands", bands.size());
+                        n_defaultIsothermBands = bands;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "OVERLAY") == 0)
+            {
+                // OVERLAY                            -> report the overlay state
+                // OVERLAY ON [min,max,spot,hotspots] -> burn in the crosshairs, boxes and temperatures (default all)
+                // OVERLAY OFF                        -> disable the overlay
+                int overlayItems = Overlay::None;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getOverlayStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get overlay status: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "ON") == 0)
+                {
+                    while ((p_token = strtok(nullptr, " ,")) != nullptr)
+                    {
+                        if (strcasecmp(p_token, "MIN") == 0)
+                        {
+                            overlayItems |= Overlay::Min;
+                        }
+                        else if (strcasecmp(p_token, "MAX") == 0)
+                        {
+                            overlayItems |= Overlay::Max;
+                        }
+                        else if (strcasecmp(p_token, "SPOT") == 0)
+                        {
+                            overlayItems |= Overlay::Spot;
+                        }
+                        else if (strcasecmp(p_token, "HOTSPOTS") == 0)
+                        {
+                            overlayItems |= Overlay::Hotspots;
+                        }
+                        else
+                        {
+                            syslog(LOG_ERR, "OVERLAY ON received with unknown item %s.", p_token);
+                            valid = false;
+                        }
+                    }
+                    if (overlayItems == Overlay::None)
+                    {
+                        overlayItems = Overlay::All;
+                    }
+                }
+                else if (strcasecmp(p_token, "OFF") != 0)
+                {
+                    syslog(LOG_ERR, "OVERLAY command received with unknown argument %s.", p_token);
+                    valid = false;
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        syslog(LOG_NOTICE, "OVERLAY %d", overlayItems);
+                        np_camera->setOverlay(overlayItems);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default overlay: %d", overlayItems);
+                        n_defaultOverlay = overlayItems;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "HOTSPOTS") == 0)
+            {
+                // HOTSPOTS                          -> report the detection state and the current hotspots
+                // HOTSPOTS ON threshold[,minArea]   -> detect blobs above threshold degrees C
+                // HOTSPOTS OFF                      -> stop the detection
+                // HOTSPOTS SUBSCRIBE / UNSUBSCRIBE  -> push one event line per analyzed frame to this connection
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getHotspotStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get hotspot status: camera object does not exist");
+                    }
+                }
+                else if (strcasecmp(p_token, "SUBSCRIBE") == 0 || strcasecmp(p_token, "UNSUBSCRIBE") == 0)
+                {
+                    if (clientFileDescriptor < 0)
+                    {
+                        syslog(LOG_ERR, "HOTSPOTS %s is only valid from a client connection", p_token);
+                    }
+                    else
+                    {
+                        _unsubscribeHotspots(clientFileDescriptor);
+                        if (strcasecmp(p_token, "SUBSCRIBE") == 0)
+                        {
+                            std::lock_guard<decltype(n_hotspotSubscribersMut)> lock{n_hotspotSubscribersMut};
+                            n_hotspotSubscribers.push_back(clientFileDescriptor);
+                        }
+                        syslog(LOG_NOTICE, "HOTSPOTS %s from connection %d", p_token, clientFileDescriptor);
+                    }
+                }
+                else if (strcasecmp(p_token, "ON") == 0)
+                {
+                    double threshold = 0.0;
+                    double minArea = n_defaultHotspotMinArea;
+                    bool valid = (p_token = strtok(nullptr, " ,")) != nullptr && _parseDouble(p_token, &threshold) == std::errc{};
+                    if (valid && (p_token = strtok(nullptr, " ,")) != nullptr)
+                    {
+                        valid = _parseDouble(p_token, &minArea) == std::errc{} && minArea >= 1.0;
+                    }
+                    if (!valid)
+                    {
+                        syslog(LOG_ERR, "HOTSPOTS ON requires a threshold in degrees C and an optional minimum area in pixels.");
+                    }
+                    else if( np_camera ){
+                        np_camera->startHotspotDetection(threshold, (int)minArea, _publishHotspotEvent);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default hotspot detection: %f C, %d pixels", threshold, (int)minArea);
+                        n_defaultHotspotThreshold = threshold;
+                        n_defaultHotspotMinArea = (int)minArea;
+                    }
+                }
+                else if (strcasecmp(p_token, "OFF") == 0)
+                {
+                    if( np_camera ){
+                        np_camera->stopHotspotDetection();
+                    }
+                    else{
+                        n_defaultHotspotThreshold = std::numeric_limits<double>::quiet_NaN();
+                    }
+                }
+                else
+                {
+                    syslog(LOG_ERR, "HOTSPOTS command received with unknown argument %s.", p_token);
+                }
+            }
+            else if (strcmp(p_token, "OUTPUT") == 0)
+            {
+                // OUTPUT name:device=...,format=...  -> add or replace an additional loopback output
+                // OUTPUT REMOVE name                 -> remove an additional loopback output
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    response = "OUTPUT command received, but no output profile was provided";
+                    syslog(LOG_ERR, "%s", response.c_str());
+                }
+                else if (strcasecmp(p_token, "REMOVE") == 0)
+                {
+                    if ((p_token = strtok(nullptr, " ")) == nullptr)
+                    {
+                        response = "OUTPUT REMOVE command received, but no output name was provided";
+                        syslog(LOG_ERR, "%s", response.c_str());
+                    }
+                    else if( np_camera ){
+                        response = np_camera->removeOutput(_desanitizeString(p_token));
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to remove output: camera object does not exist");
+                    }
+                }
+                else if( np_camera ){
+                    response = np_camera->setOutput(_desanitizeString(p_token));
+                }
+                else{
+                    // applied when the camera object is created
+                    std::string const profileStr = _desanitizeString(p_token);
+                    syslog(LOG_INFO, "Set default output: %s", profileStr.c_str());
+                    n_defaultOutputs.push_back(profileStr);
+                }
+            }
+            else if (strcmp(p_token, "OUTPUTS") == 0)
             {
                 if( np_camera ){
-                    syslog(LOG_NOTICE, "GETZOOM");
-                    response = np_camera->getZoom();
+                    response = np_camera->getOutputs();
                 }
                 else{
-                    syslog(LOG_ERR, "Unable to get zoom: camera object does not exist");
+                    syslog(LOG_ERR, "Unable to get outputs: camera object does not exist");
                 }
             }
             else if (strcmp(p_token, "STATUS") == 0)
@@ -633,6 +1441,178 @@ namespace
                     syslog(LOG_ERR, "Unable to start recording: camera object does not exist");
                 }
             }
+            else if (strcmp(p_token, "RECORDINGSEGMENTS") == 0)
+            {
+                // RECORDINGSEGMENTS                    -> report the segment limits
+                // RECORDINGSEGMENTS seconds[,MB]       -> start a new file every seconds and/or MB (0 = no limit), applies to the next recording
+                // RECORDINGSEGMENTS OFF                -> record into a single file
+                double seconds = 0.0;
+                double megabytes = 0.0;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ,")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getRecordingStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get recording segments: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "OFF") != 0)
+                {
+                    if (_parseDouble(p_token, &seconds) != std::errc{} || seconds < 0.0)
+                    {
+                        syslog(LOG_ERR, "RECORDINGSEGMENTS expects seconds[,MB] or OFF, not %s.", p_token);
+                        valid = false;
+                    }
+                    else if ((p_token = strtok(nullptr, " ,")) != nullptr && (_parseDouble(p_token, &megabytes) != std::errc{} || megabytes < 0.0))
+                    {
+                        syslog(LOG_ERR, "RECORDINGSEGMENTS expects a size in MB, not %s.", p_token);
+                        valid = false;
+                    }
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        np_camera->setRecordingSegments(seconds, megabytes);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default recording segments: %f s, %f MB", seconds, megabytes);
+                        n_defaultSegmentSeconds = seconds;
+                        n_defaultSegmentMegabytes = megabytes;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "RECORDINGCODEC") == 0)
+            {
+                // RECORDINGCODEC                       -> report the codec, the threads and the available codecs
+                // RECORDINGCODEC codec[,threads]       -> MP4V, MJPG, FFV1, H264 or AUTO (from the file extension), applies to the next recording
+                int threads = 0;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ,")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getRecordingCodec();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get recording codec: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "AUTO") != 0 && VideoEncoder::findByName(p_token) == nullptr)
+                {
+                    syslog(LOG_ERR, "RECORDINGCODEC expects AUTO or one of %s, not %s.", VideoEncoder::getCodecList().c_str(), p_token);
+                    response = std::string("Unknown recording codec ") + p_token;
+                    valid = false;
+                }
+                std::string const codec = valid ? p_token : "";
+                if (valid && (p_token = strtok(nullptr, " ,")) != nullptr && (_parseInt(p_token, &threads) != std::errc{} || threads < 0))
+                {
+                    syslog(LOG_ERR, "RECORDINGCODEC expects a number of threads, not %s.", p_token);
+                    valid = false;
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        response = np_camera->setRecordingCodec(codec, threads);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default recording codec: %s, %d threads", codec.c_str(), threads);
+                        n_defaultRecordingCodec = codec;
+                        n_defaultRecordingThreads = threads;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "PREROLL") == 0)
+            {
+                // PREROLL                              -> report the pre-roll and the frames held
+                // PREROLL seconds[,MB]                 -> keep the last seconds of frames (in at most MB) for the next recording
+                // PREROLL OFF                          -> no pre-roll
+                double seconds = 0.0;
+                double megabytes = 0.0;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ,")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getPreRoll();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get pre-roll: camera object does not exist");
+                    }
+                    valid = false;
+                }
+                else if (strcasecmp(p_token, "OFF") != 0)
+                {
+                    if (_parseDouble(p_token, &seconds) != std::errc{} || seconds < 0.0)
+                    {
+                        syslog(LOG_ERR, "PREROLL expects seconds[,MB] or OFF, not %s.", p_token);
+                        valid = false;
+                    }
+                    else if ((p_token = strtok(nullptr, " ,")) != nullptr && (_parseDouble(p_token, &megabytes) != std::errc{} || megabytes < 0.0))
+                    {
+                        syslog(LOG_ERR, "PREROLL expects a size in MB, not %s.", p_token);
+                        valid = false;
+                    }
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        response = np_camera->setPreRoll(seconds, megabytes);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default pre-roll: %f s, %f MB", seconds, megabytes);
+                        n_defaultPreRollSeconds = seconds;
+                        n_defaultPreRollMegabytes = megabytes;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "TRIGGER") == 0)
+            {
+                // TRIGGER [postRollSeconds] [filePath] -> record the pre-roll and the next seconds (default 10), then finish the file
+                double postRollSeconds = n_defaultPostRollSeconds;
+                if ((p_token = strtok(nullptr, " ")) != nullptr && _parseDouble(p_token, &postRollSeconds) == std::errc{})
+                {
+                    p_token = strtok(nullptr, " ");
+                }
+                if( np_camera ){
+                    std::filesystem::path filePath;
+                    if (p_token != nullptr)
+                    {
+                        filePath = _desanitizeString(p_token);
+                    }
+                    else if (const char *home = std::getenv("HOME"))
+                    {
+                        auto const utcTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        std::stringstream ss;
+                        ss << "Event_" << std::put_time(std::gmtime(&utcTime), "%Y_%m_%d_%H_%M_%S") << np_camera->getRecordingExtension();
+                        filePath = std::filesystem::path(home) / ss.str();
+                    }
+                    syslog(LOG_INFO, "TRIGGER to: %s, post-roll %f s", filePath.string().c_str(), postRollSeconds);
+                    response = np_camera->trigger(filePath, postRollSeconds);
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to trigger a recording: camera object does not exist");
+                }
+            }
+            else if (strcmp(p_token, "STILLENCODERSTATUS") == 0)
+            {
+                if( np_camera ){
+                    response = np_camera->getStillEncoderStatus();
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to get the still encoder status: camera object does not exist");
+                }
+            }
+            else if (strcmp(p_token, "RECORDINGSTATUS") == 0)
+            {
+                if( np_camera ){
+                    response = np_camera->getRecordingStatus();
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to get recording status: camera object does not exist");
+                }
+            }
             else if (strcmp(p_token, "STOPRECORDING") == 0)
             {
                 if( np_camera ){
@@ -730,6 +1710,215 @@ namespace
                     syslog(LOG_ERR, "Unable to take radiometric screen shot: camera object does not exist");
                 }
             }           
+            else if (strcmp(p_token, "STARTRADIOMETRICRECORDING") == 0)
+            {
+                // STARTRADIOMETRICRECORDING [DIRECT] [framesPerChunk] [filePath] -> record every thermography frame losslessly (.etr)
+                // DIRECT writes the file with O_DIRECT, bypassing the page cache
+                int framesPerChunk = n_defaultRadiometricFramesPerChunk;
+                bool direct = false;
+                if ((p_token = strtok(nullptr, " ")) != nullptr && strcmp(p_token, "DIRECT") == 0)
+                {
+                    direct = true;
+                    p_token = strtok(nullptr, " ");
+                }
+                if (p_token != nullptr && _parseInt(p_token, &framesPerChunk) == std::errc{})
+                {
+                    p_token = strtok(nullptr, " ");
+                }
+                if( np_camera ){
+                    std::filesystem::path filePath;
+                    if (p_token != nullptr)
+                    {
+                        filePath = _desanitizeString(p_token);
+                    }
+                    else if (const char *home = std::getenv("HOME"))
+                    {
+                        auto const utcTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                        std::stringstream ss;
+                        ss << "RadiometricVideo_" << std::put_time(std::gmtime(&utcTime), "%Y_%m_%d_%H_%M_%S") << ".etr";
+                        filePath = std::filesystem::path(home) / ss.str();
+                    }
+                    syslog(LOG_NOTICE, "STARTRADIOMETRICRECORDING to: %s, %d frames per chunk%s", filePath.string().c_str(), framesPerChunk, direct ? ", direct I/O" : "");
+                    response = np_camera->startRadiometricRecording(filePath, size_t(std::max(framesPerChunk, 1)), direct);
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to start radiometric recording: camera object does not exist");
+                }
+            }
+            else if (strcmp(p_token, "BURST") == 0)
+            {
+                // BURST                            -> report the running burst or the result of the last one
+                // BURST count [formats] [directory] -> capture count consecutive frames, then write them in parallel
+                // formats = image and/or radiometric formats joined by +, e.g. png+etr (default), jpeg, csv
+                int frameCount = 0;
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getBurstStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get the burst status: camera object does not exist");
+                    }
+                }
+                else if (_parseInt(p_token, &frameCount) != std::errc{} || frameCount <= 0)
+                {
+                    syslog(LOG_ERR, "BURST expects a frame count.");
+                    response = "BURST expects count [formats] [directory]";
+                }
+                else
+                {
+                    std::string formats = np_defaultBurstFormats;
+                    std::string imageExtension;
+                    std::string radiometricExtension;
+                    // a value with an unknown format is the directory
+                    if ((p_token = strtok(nullptr, " ")) != nullptr && _parseStillFormats(p_token, &imageExtension, &radiometricExtension))
+                    {
+                        formats = p_token;
+                        p_token = strtok(nullptr, " ");
+                    }
+                    else
+                    {
+                        _parseStillFormats(formats, &imageExtension, &radiometricExtension);
+                    }
+                    if( np_camera ){
+                        std::filesystem::path directory;
+                        if (p_token != nullptr)
+                        {
+                            directory = _desanitizeString(p_token);
+                        }
+                        else if (const char *home = std::getenv("HOME"))
+                        {
+                            auto const utcTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                            std::stringstream ss;
+                            ss << "Burst_" << std::put_time(std::gmtime(&utcTime), "%Y_%m_%d_%H_%M_%S");
+                            directory = std::filesystem::path(home) / ss.str();
+                        }
+                        syslog(LOG_NOTICE, "BURST of %d frames (%s) to: %s", frameCount, formats.c_str(), directory.string().c_str());
+                        response = np_camera->burst(size_t(frameCount), imageExtension, radiometricExtension, directory);
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to take a burst: camera object does not exist");
+                    }
+                }
+            }
+            else if (strcmp(p_token, "INTERVAL") == 0)
+            {
+                // INTERVAL                                      -> report the time-lapse
+                // INTERVAL OFF                                  -> stop it
+                // INTERVAL seconds [LIVE] [formats] [directory] -> capture the frame closest to every tick,
+                //                                                  LIVE keeps the full output rate between captures
+                // formats = image and/or radiometric formats joined by +, e.g. jpeg+etr (default), png, csv
+                double seconds = 0.0;
+                if ((p_token = strtok(nullptr, " ")) == nullptr)
+                {
+                    if( np_camera ){
+                        response = np_camera->getIntervalStatus();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to get the interval status: camera object does not exist");
+                    }
+                }
+                else if (strcasecmp(p_token, "OFF") == 0)
+                {
+                    if( np_camera ){
+                        syslog(LOG_NOTICE, "INTERVAL OFF");
+                        response = np_camera->stopInterval();
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to stop the interval capture: camera object does not exist");
+                    }
+                }
+                else if (_parseDouble(p_token, &seconds) != std::errc{} || seconds <= 0.0)
+                {
+                    syslog(LOG_ERR, "INTERVAL expects seconds or OFF.");
+                    response = "INTERVAL expects seconds [LIVE] [formats] [directory] or OFF";
+                }
+                else
+                {
+                    bool lowPower = true;
+                    if ((p_token = strtok(nullptr, " ")) != nullptr && strcasecmp(p_token, "LIVE") == 0)
+                    {
+                        lowPower = false;
+                        p_token = strtok(nullptr, " ");
+                    }
+                    std::string formats = np_defaultIntervalFormats;
+                    std::string imageExtension;
+                    std::string radiometricExtension;
+                    // a value with an unknown format is the directory
+                    if (p_token != nullptr && _parseStillFormats(p_token, &imageExtension, &radiometricExtension))
+                    {
+                        formats = p_token;
+                        p_token = strtok(nullptr, " ");
+                    }
+                    else
+                    {
+                        _parseStillFormats(formats, &imageExtension, &radiometricExtension);
+                    }
+                    if( np_camera ){
+                        std::filesystem::path directory;
+                        if (p_token != nullptr)
+                        {
+                            directory = _desanitizeString(p_token);
+                        }
+                        else if (const char *home = std::getenv("HOME"))
+                        {
+                            auto const utcTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+                            std::stringstream ss;
+                            ss << "Interval_" << std::put_time(std::gmtime(&utcTime), "%Y_%m_%d_%H_%M_%S");
+                            directory = std::filesystem::path(home) / ss.str();
+                        }
+                        syslog(LOG_NOTICE, "INTERVAL of %.3f s (%s%s) to: %s", seconds, formats.c_str(), lowPower ? "" : ", live", directory.string().c_str());
+                        response = np_camera->startInterval(seconds, lowPower, imageExtension, radiometricExtension, directory);
+                    }
+                    else{
+                        syslog(LOG_ERR, "Unable to start the interval capture: camera object does not exist");
+                    }
+                }
+            }
+            else if (strcmp(p_token, "RADIOMETRICCOMPRESSION") == 0)
+            {
+                // RADIOMETRICCOMPRESSION ON[,threads]  -> compress the next radiometric recordings and .etr screenshots losslessly
+                // RADIOMETRICCOMPRESSION OFF           -> uncompressed (default)
+                int threads = 0;
+                bool enabled = false;
+                bool valid = true;
+                if ((p_token = strtok(nullptr, " ,")) == nullptr || (strcasecmp(p_token, "ON") != 0 && strcasecmp(p_token, "OFF") != 0))
+                {
+                    syslog(LOG_ERR, "RADIOMETRICCOMPRESSION expects ON[,threads] or OFF.");
+                    response = "RADIOMETRICCOMPRESSION expects ON[,threads] or OFF";
+                    valid = false;
+                }
+                else
+                {
+                    enabled = strcasecmp(p_token, "ON") == 0;
+                }
+                if (valid && enabled && (p_token = strtok(nullptr, " ,")) != nullptr && (_parseInt(p_token, &threads) != std::errc{} || threads < 0))
+                {
+                    syslog(LOG_ERR, "RADIOMETRICCOMPRESSION expects a number of threads, not %s.", p_token);
+                    valid = false;
+                }
+                if (valid)
+                {
+                    if( np_camera ){
+                        response = np_camera->setRadiometricCompression(enabled, threads);
+                    }
+                    else{
+                        syslog(LOG_INFO, "Set default radiometric compression: %s, %d threads", enabled ? "ON" : "OFF", threads);
+                        n_defaultRadiometricCompression = enabled;
+                        n_defaultRadiometricCompressionThreads = threads;
+                    }
+                }
+            }
+            else if (strcmp(p_token, "STOPRADIOMETRICRECORDING") == 0)
+            {
+                if( np_camera ){
+                    syslog(LOG_NOTICE, "STOPRADIOMETRICRECORDING");
+                    response = np_camera->stopRadiometricRecording();
+                }
+                else{
+                    syslog(LOG_ERR, "Unable to stop radiometric recording: camera object does not exist");
+                }
+            }
             else if (strcmp(p_token, "FORMAT") == 0)
             {
                 if ((p_token = strtok(nullptr, " ")) == nullptr)
@@ -813,7 +2002,8 @@ namespace
         // receive commands delimeted by "|", tokenize commands and then parse each command/value pair
         constexpr auto const *const p_delimiter = "|";
         char p_buffer[n_bufferSize];
-        int valRead = read(clientFileDescriptor, p_buffer, n_bufferSize);
+        // keep room for the terminator
+        int valRead = read(clientFileDescriptor, p_buffer, n_bufferSize - 1);
         if (valRead > 0)
         {
             const char *p_commands[n_maxEpollEvents] = {nullptr};
@@ -831,7 +2021,7 @@ namespace
                 }
                 for (int commandIndex = 0; commandIndex < commandCount; ++commandIndex)
                 {
-                    std::string const response = _parseCommand(p_commands[commandIndex]);
+                    std::string const response = _parseCommand(p_commands[commandIndex], clientFileDescriptor);
                     if (!response.empty())
                     {
                         char const *const p_response = response.c_str();
@@ -855,11 +2045,12 @@ namespace
         }
         else if (valRead == 0)
         {
-            close(clientFileDescriptor);
+            _closeClient(clientFileDescriptor);
         }
-        else
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
         {
             syslog(LOG_ERR, "unable to read client commands: %m");
+            _closeClient(clientFileDescriptor);
         }
     }
 
@@ -881,6 +2072,7 @@ namespace
         int gradientFilterMode = n_defaultGradientFilterMode;
         int flatSceneFilterMode = n_defaultFlatSceneFilterMode;
         double maxZoom = n_defaultMaxZoom;
+        double frameStatsAlarm = n_defaultFrameStatsAlarm;
 
         // Note: overrides for defaults were set by the parser in main  
 
@@ -894,6 +2086,7 @@ namespace
         syslog(LOG_NOTICE, "sharpenFilterMode = %d", sharpenFilterMode);
         syslog(LOG_NOTICE, "gradientFilterMode = %d", gradientFilterMode);
         syslog(LOG_NOTICE, "flatSceneFilterMode = %d", flatSceneFilterMode);
+        syslog(LOG_NOTICE, "frameStatsAlarm = %f", frameStatsAlarm);
 
         np_camera = std::make_unique<EchoThermCamera>();
         if( np_camera == nullptr ){
@@ -910,6 +2103,40 @@ namespace
         np_camera->setGradientFilter(gradientFilterMode);
         np_camera->setFlatSceneFilter(flatSceneFilterMode);
         np_camera->setMaxZoom(maxZoom);
+        np_camera->setFrameStatsAlarm(frameStatsAlarm);
+        np_camera->setColorizer(n_defaultColorizer);
+        np_camera->setDenoise(n_defaultDenoise);
+        np_camera->setOutputGeometry(n_defaultOutputWidth, n_defaultOutputHeight, n_defaultOutputInterpolation);
+        np_camera->setOutputRate(n_defaultOutputRate, n_defaultOutputDecimation);
+        np_camera->setOverlay(n_defaultOverlay);
+        np_camera->setIsotherm(n_defaultIsothermBands);
+        np_camera->setRecordingSegments(n_defaultSegmentSeconds, n_defaultSegmentMegabytes);
+        np_camera->setRecordingCodec(n_defaultRecordingCodec, n_defaultRecordingThreads);
+        np_camera->setRadiometricCompression(n_defaultRadiometricCompression, n_defaultRadiometricCompressionThreads);
+        np_camera->setPreRoll(n_defaultPreRollSeconds, n_defaultPreRollMegabytes);
+        if (!std::isnan(n_defaultHotspotThreshold))
+        {
+            np_camera->startHotspotDetection(n_defaultHotspotThreshold, n_defaultHotspotMinArea, _publishHotspotEvent);
+        }
+        if (!n_defaultAgcCommand.empty())
+        {
+            _parseCommand(n_defaultAgcCommand.c_str());
+        }
+        for (auto const &profileStr : n_defaultOutputs)
+        {
+            if (auto const outputStatus = np_camera->setOutput(profileStr); outputStatus.rfind("Could not", 0) == 0)
+            {
+                syslog(LOG_ERR, "%s", outputStatus.c_str());
+            }
+        }
+
+        // the frame path logs through a background thread, which can't be started before the daemon forks
+        AsyncLog::start();
+
+        if (!n_defaultTraceFilePath.empty())
+        {
+            Trace::start(n_defaultTraceFilePath);
+        }
 
         syslog(LOG_NOTICE, "Starting camera...");
         return np_camera->start();
@@ -1090,6 +2317,7 @@ int main(int argc, char *argv[])
 
         boost::program_options::options_description desc("Allowed options");
         desc.add_options()("help", "Produce this message");
+        desc.add_options()("benchmark", "Run the frame pipeline benchmarks on synthetic frames and exit (no camera needed)");
         desc.add_options()("daemon", "Start the process as a daemon");
         desc.add_options()("kill", "Kill the existing instance");
 
@@ -1151,6 +2379,64 @@ int main(int argc, char *argv[])
                            "Choose the initial state of the gradient filter\n"
                            "zero     = disabled\n"
                            "non-zero = enabled");
+        desc.add_options()("frameStatsAlarm", boost::program_options::value<std::string>(),
+                           "Set the initial frame stall alarm threshold in milliseconds between frames\n"
+                           "zero or negative = disabled");
+        desc.add_options()("output", boost::program_options::value<std::vector<std::string>>()->composing(),
+                           "Add a loopback output fed from the same capture session (may be repeated)\n"
+                           "name:device=/dev/videoN[,format=ARGB|GREY][,palette=SDK|0-8]\n"
+                           "[,min=C,max=C][,zoom=Z][,panx=X,pany=Y][,decimate=N][,rate=Hz]\n"
+                           "palette=SDK (default) uses the camera color frame,\n"
+                           "0-8 colorizes in echothermd with its own AGC range");
+        desc.add_options()("agc", boost::program_options::value<std::string>(),
+                           "Set the initial AGC of the echothermd colorizer\n"
+                           "LINEAR             = range follows the scene (default)\n"
+                           "LINEAR min,max     = range locked in degrees C\n"
+                           "HISTEQ [plateau]   = histogram equalization, plateau 0-1\n"
+                           "WINDOW center,width = fixed temperature window in degrees C");
+        desc.add_options()("denoise", boost::program_options::value<std::string>(),
+                           "Temporal noise reduction of the output before the zoom\n"
+                           "strength 0-0.94 (fraction of the history kept in static areas), 0 = disabled");
+        desc.add_options()("outputSize", boost::program_options::value<std::string>(),
+                           "Geometry of the loopback output and of the recordings (quote the value)\n"
+                           "\"WxH [NEAREST|LINEAR|CUBIC]\" = scale to W x H, the aspect ratio is kept\n"
+                           "SENSOR = sensor geometry (default)");
+        desc.add_options()("outputRate", boost::program_options::value<std::string>(),
+                           "Frame rate of the loopback output and of the recordings\n"
+                           "rate=Hz[,decimate=N] = one frame out of N, then at most Hz from the capture timestamps\n"
+                           "OFF = every frame (default)");
+        desc.add_options()("recordingSegments", boost::program_options::value<std::string>(),
+                           "Split recordings into files of at most seconds and/or MB, each file is playable on its own\n"
+                           "seconds[,MB] (0 = no limit) = files named <name>_001.mp4, <name>_002.mp4, ...\n"
+                           "OFF = a single file (default)");
+        desc.add_options()("recordingCodec", boost::program_options::value<std::string>(),
+                           "Codec of the recordings and encoder threads (0 = encoder default)\n"
+                           "codec[,threads] = MP4V (.mp4), MJPG (.avi), FFV1 (.mkv, lossless) or H264 (.mp4, where FFmpeg has it)\n"
+                           "AUTO = from the file extension: .mp4 MP4V, .avi MJPG, .mkv FFV1 (default)");
+        desc.add_options()("radiometricCompression", boost::program_options::value<std::string>(),
+                           "Compress the radiometric recordings and .etr radiometric screenshots losslessly\n"
+                           "ON[,threads] = delta prediction + deflate on threads (0 = half the cores), OFF = uncompressed (default)");
+        desc.add_options()("preRoll", boost::program_options::value<std::string>(),
+                           "Keep the last seconds of output frames in memory, a recording (or TRIGGER) starts with them\n"
+                           "seconds[,MB] (MB = memory limit, 0 = none), 0 = disabled (default)");
+        desc.add_options()("isotherm", boost::program_options::value<std::string>(),
+                           "Highlight temperature bands in the output (quote the value)\n"
+                           "\"min:max:color[:opacity] ...\" = up to 8 bands in degrees C, the first match wins\n"
+                           "color = red, green, blue, yellow, cyan, magenta, orange, white, black or RRGGBB");
+        desc.add_options()("hotspots", boost::program_options::value<std::string>(),
+                           "Detect and track hot objects above a temperature in degrees C\n"
+                           "threshold[,minArea] (minimum area in pixels, default 4)");
+        desc.add_options()("overlay", boost::program_options::value<std::string>()->implicit_value("min,max,spot,hotspots"),
+                           "Burn crosshairs and temperatures into the output (items optional)\n"
+                           "any of min,max,spot,hotspots (default all)");
+        desc.add_options()("colorizer", "Colorize the thermography frame in echothermd instead of the camera SDK");
+        desc.add_options()("memoryBudget", boost::program_options::value<std::string>(),
+                           "Set the memory budget in MB for frame queues and buffers\n"
+                           "frames are dropped and recordings refused rather than exceed it\n"
+                           "zero = unlimited (default)");
+        desc.add_options()("trace", boost::program_options::value<std::string>()->implicit_value(""),
+                           "Start tracing from startup to a Chrome trace event file (path optional)\n"
+                           "defaults to $HOME/Trace_[UTC].json");
         boost::program_options::variables_map vm;
         boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
         boost::program_options::notify(vm);
@@ -1161,6 +2447,11 @@ int main(int argc, char *argv[])
             returnCode = EXIT_SUCCESS;
             break;
         }
+        if (vm.count("benchmark")){
+            std::cout << Benchmark::run() << std::flush;
+            returnCode = EXIT_SUCCESS;
+            break;
+        }
 
         if (vm.count("kill")){            
             syslog(LOG_NOTICE, "Killing instance(s) of echothermd...\nPlease run echothermd again if you wish to restart the daemon.");
@@ -1263,6 +2554,103 @@ int main(int argc, char *argv[])
             std::string const commandStr = "SETRADIOMETRICFRAMEFORMAT " + parameterStr;
             _parseCommand(commandStr.c_str());
         }
+        if (vm.count("frameStatsAlarm"))
+        {
+            std::string const parameterStr = vm["frameStatsAlarm"].as<std::string>();
+            std::string const commandStr = "FRAMESTATSALARM " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("output"))
+        {
+            for (auto const &parameterStr : vm["output"].as<std::vector<std::string>>())
+            {
+                std::string const commandStr = "OUTPUT " + parameterStr;
+                _parseCommand(commandStr.c_str());
+            }
+        }
+        if (vm.count("denoise"))
+        {
+            std::string const parameterStr = vm["denoise"].as<std::string>();
+            std::string const commandStr = "DENOISE " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("outputRate"))
+        {
+            std::string const parameterStr = vm["outputRate"].as<std::string>();
+            std::string const commandStr = "OUTPUTRATE " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("recordingSegments"))
+        {
+            std::string const parameterStr = vm["recordingSegments"].as<std::string>();
+            std::string const commandStr = "RECORDINGSEGMENTS " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("recordingCodec"))
+        {
+            std::string const parameterStr = vm["recordingCodec"].as<std::string>();
+            std::string const commandStr = "RECORDINGCODEC " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("radiometricCompression"))
+        {
+            std::string const parameterStr = vm["radiometricCompression"].as<std::string>();
+            std::string const commandStr = "RADIOMETRICCOMPRESSION " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("preRoll"))
+        {
+            std::string const parameterStr = vm["preRoll"].as<std::string>();
+            std::string const commandStr = "PREROLL " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("outputSize"))
+        {
+            std::string const parameterStr = vm["outputSize"].as<std::string>();
+            std::string const commandStr = "OUTPUTSIZE " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("isotherm"))
+        {
+            std::string const parameterStr = vm["isotherm"].as<std::string>();
+            std::string const commandStr = "ISOTHERM " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("hotspots"))
+        {
+            std::string const parameterStr = vm["hotspots"].as<std::string>();
+            std::string const commandStr = "HOTSPOTS ON " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("overlay"))
+        {
+            std::string const parameterStr = vm["overlay"].as<std::string>();
+            std::string const commandStr = "OVERLAY ON " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("agc"))
+        {
+            std::string const parameterStr = vm["agc"].as<std::string>();
+            std::string const commandStr = "AGC " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("colorizer"))
+        {
+            std::string const commandStr = "COLORIZER ON";
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("memoryBudget"))
+        {
+            std::string const parameterStr = vm["memoryBudget"].as<std::string>();
+            std::string const commandStr = "MEMORYBUDGET " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
+        if (vm.count("trace"))
+        {
+            std::string const parameterStr = vm["trace"].as<std::string>();
+            std::string const commandStr = "TRACE ON " + parameterStr;
+            _parseCommand(commandStr.c_str());
+        }
 
         //=====================================================================
 
@@ -1445,6 +2833,7 @@ int main(int argc, char *argv[])
                     {
                         if (!_setNonBlocking(clientFileDescriptor))
                         {
+                            close(clientFileDescriptor);
                             returnCode = EXIT_FAILURE;
                             break;
                         }
@@ -1457,6 +2846,11 @@ int main(int argc, char *argv[])
                             close(clientFileDescriptor);
                             clientFileDescriptor = -1;
                         }
+                        else
+                        {
+                            // each open connection is read through a command buffer of n_bufferSize
+                            _openClient(clientFileDescriptor);
+                        }
                     }
                 }
                 else
@@ -1471,6 +2865,11 @@ int main(int argc, char *argv[])
     
     if( isDaemonProcess ){
         //syslog(LOG_NOTICE, "Exiting daemon(%d)...\n", getpid());
+        if (Trace::isEnabled())
+        {
+            Trace::stop();
+        }
+        AsyncLog::stop();
         if (serverFileDescriptor != -1)
         {
             close(serverFileDescriptor);
@@ -1479,9 +2878,9 @@ int main(int argc, char *argv[])
         {
             close(epollFileDescriptor);
         }
-        if (clientFileDescriptor != -1)
+        while (!n_clientFileDescriptors.empty())
         {
-            close(clientFileDescriptor);
+            _closeClient(n_clientFileDescriptors.back());
         }
     }
     sync();